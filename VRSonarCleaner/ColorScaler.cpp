@@ -1,5 +1,9 @@
 #include "ColorScaler.h"
 
+#include <algorithm>
+#include <limits>
+#include <emmintrin.h>
+
 ColorScaler::ColorScaler()
 {
 	setToDefaults();
@@ -28,12 +32,25 @@ void ColorScaler::setToDefaults()
 	minVal2 = 0.f;
 	maxVal2 = 1.f;
 	rangeVal2 = 1.f;
+
+	m_RangeMode = RangeMode_MinMax;
+	m_fClipPercentile = 1.f;
+	m_vfColorScaleCDF.clear();
+	m_vfBiValueCDF1.clear();
+	m_vfBiValueCDF2.clear();
+
+	buildColorMapLUT();
+	buildBiValueLUT();
 }
 
 
 void ColorScaler::setColorMap(ColorMap colorMap)
 {
-	m_ColorMap = colorMap;
+	if (colorMap != m_ColorMap || m_vuiColorMapLUT.size() == 0u)
+	{
+		m_ColorMap = colorMap;
+		buildColorMapLUT();
+	}
 }
 
 void ColorScaler::getScaledColor(float factor, float *r, float *g, float *b, ColorMap colorMapEnum)
@@ -100,6 +117,13 @@ void ColorScaler::getRainbowScaledColor(float factor, float *r, float *g, float
 	factor *= 6.f;
 	sextant = (int)factor;
 	vsf = factor - floorf(factor);
+
+	// the top of the range is the end of the last sextant
+	if (sextant > 5)
+	{
+		sextant = 5;
+		vsf = 1.f;
+	}
 	mid1 = vsf;
 	mid2 = 1.f - vsf;
 	switch (sextant)
@@ -350,7 +374,7 @@ float ColorScaler::getColorScaleFactor(double value)
 	else if (value >= maxColorScaleValue)
 		return 1.f;
 	else
-		return static_cast<float>((value - minColorScaleValue) / rangeColorScaleValue);
+		return equalize(static_cast<float>((value - minColorScaleValue) / rangeColorScaleValue), m_vfColorScaleCDF);
 }
 
 //BI VALUE SCALER:
@@ -410,7 +434,11 @@ void ColorScaler::resetBiValueScaleMinMax(double MinVal1, double MaxVal1, double
 
 void ColorScaler::setBiValueColorMap(ColorMap_BiValued biValueColorMapEnum)
 {
-	m_ColorMap_BiValue = biValueColorMapEnum;
+	if (biValueColorMapEnum != m_ColorMap_BiValue || m_vuiBiValueLUT.size() == 0u)
+	{
+		m_ColorMap_BiValue = biValueColorMapEnum;
+		buildBiValueLUT();
+	}
 }
 
 void ColorScaler::getBiValueScaledColor(double val1, double val2, float *r, float *g, float *b)
@@ -431,6 +459,9 @@ void ColorScaler::getBiValueScaledColor(double val1, double val2, float *r, floa
 	else
 		factor2 = static_cast<float>((val2 - minVal2) / rangeVal2);
 
+	factor1 = equalize(factor1, m_vfBiValueCDF1);
+	factor2 = equalize(factor2, m_vfBiValueCDF2);
+
 	switch (m_ColorMap_BiValue)
 	{
 	case RedBlue:
@@ -579,6 +610,214 @@ void ColorScaler::getBiValueScaledColor(double val1, double val2, float *r, floa
 	}
 }
 
+float ColorScaler::equalize(float factor, std::vector<float> const &cdf)
+{
+	if (cdf.size() < 2u)
+		return factor;
+
+	float pos = (std::min)((std::max)(factor, 0.f), 1.f) * static_cast<float>(cdf.size() - 1u);
+	size_t i = (std::min)(static_cast<size_t>(pos), cdf.size() - 2u);
+	float t = pos - static_cast<float>(i);
+
+	return cdf[i] + (cdf[i + 1u] - cdf[i]) * t;
+}
+
+unsigned int ColorScaler::packColor(float r, float g, float b)
+{
+	unsigned int red = static_cast<unsigned int>((std::min)((std::max)(r, 0.f), 1.f) * 255.f + 0.5f);
+	unsigned int green = static_cast<unsigned int>((std::min)((std::max)(g, 0.f), 1.f) * 255.f + 0.5f);
+	unsigned int blue = static_cast<unsigned int>((std::min)((std::max)(b, 0.f), 1.f) * 255.f + 0.5f);
+
+	return red | (green << 8) | (blue << 16) | (255u << 24);
+}
+
+void ColorScaler::buildColorMapLUT()
+{
+	m_vuiColorMapLUT.resize(COLORSCALER_LUT_SIZE);
+	m_vucColorMapLUTEdges.assign(COLORSCALER_LUT_SIZE, 0u);
+
+	auto sample = [this](double bin) {
+		float r = 0.f, g = 0.f, b = 0.f;
+		getScaledColor(equalize(static_cast<float>(bin / static_cast<double>(COLORSCALER_LUT_SIZE)), m_vfColorScaleCDF), &r, &g, &b);
+		return packColor(r, g, b);
+	};
+
+	// as for the bi-value maps, bins crossed by a band edge of a banded map are colored per value. The bands follow
+	// the factor in order, so a bin whose ends have its center's color lies within one band.
+	bool banded = m_ColorMap == RainbowBanded || m_ColorMap == BlueBanded;
+	double const margin = 0.01;
+
+	for (int i = 0; i < COLORSCALER_LUT_SIZE; ++i)
+	{
+		unsigned int color = sample(i + 0.5);
+
+		m_vuiColorMapLUT[i] = color;
+
+		if (banded && (sample(i - margin) != color || sample(i + 1. + margin) != color))
+			m_vucColorMapLUTEdges[i] = 1u;
+	}
+}
+
+void ColorScaler::buildBiValueLUT()
+{
+	// RedBlue maps the raw values directly and does not use a table
+	if (m_ColorMap_BiValue == RedBlue)
+	{
+		m_vuiBiValueLUT.clear();
+		m_vucBiValueLUTEdges.clear();
+		return;
+	}
+
+	m_vuiBiValueLUT.resize(COLORSCALER_BIVALUE_LUT_SIZE * COLORSCALER_BIVALUE_LUT_SIZE);
+	m_vucBiValueLUTEdges.resize(COLORSCALER_BIVALUE_LUT_SIZE * COLORSCALER_BIVALUE_LUT_SIZE);
+
+	// sample through getBiValueScaledColor() with a unit range so the bin centers are the factors
+	double savedMinVal1 = minVal1, savedMaxVal1 = maxVal1, savedRangeVal1 = rangeVal1;
+	double savedMinVal2 = minVal2, savedMaxVal2 = maxVal2, savedRangeVal2 = rangeVal2;
+	minVal1 = minVal2 = 0.;
+	maxVal1 = maxVal2 = 1.;
+	rangeVal1 = rangeVal2 = 1.;
+
+	auto sample = [this](double bin1, double bin2) {
+		float r = 0.f, g = 0.f, b = 0.f;
+		getBiValueScaledColor(bin1 / static_cast<double>(COLORSCALER_BIVALUE_LUT_SIZE), bin2 / static_cast<double>(COLORSCALER_BIVALUE_LUT_SIZE), &r, &g, &b);
+		return packColor(r, g, b);
+	};
+
+	// the bi-value maps are banded, so a bin whose corners differ has a band edge running through it. Its colors are
+	// computed per value instead. The corners are taken slightly outside the bin to cover values rounded into it.
+	double const margin = 0.01;
+
+	for (int i = 0; i < COLORSCALER_BIVALUE_LUT_SIZE; ++i)
+	{
+		for (int j = 0; j < COLORSCALER_BIVALUE_LUT_SIZE; ++j)
+		{
+			unsigned int color = sample(i + 0.5, j + 0.5);
+
+			bool edge =
+				sample(i - margin, j - margin) != color ||
+				sample(i + 1. + margin, j - margin) != color ||
+				sample(i - margin, j + 1. + margin) != color ||
+				sample(i + 1. + margin, j + 1. + margin) != color;
+
+			m_vuiBiValueLUT[i * COLORSCALER_BIVALUE_LUT_SIZE + j] = color;
+			m_vucBiValueLUTEdges[i * COLORSCALER_BIVALUE_LUT_SIZE + j] = edge ? 1u : 0u;
+		}
+	}
+
+	minVal1 = savedMinVal1;
+	maxVal1 = savedMaxVal1;
+	rangeVal1 = savedRangeVal1;
+	minVal2 = savedMinVal2;
+	maxVal2 = savedMaxVal2;
+	rangeVal2 = savedRangeVal2;
+}
+
+namespace
+{
+	// Maps values to table bins, clamped to [0, nBins - 1]. A zero range sends values above the minimum to the
+	// last bin like getColorScaleFactor() does. NaNs go to bin 0 in both the scalar and SSE versions.
+	struct BinMapping {
+		BinMapping(double minVal, double range, int nBins)
+			: offset(static_cast<float>(minVal))
+			, scale(range > 0. ? static_cast<float>(nBins / range) : std::numeric_limits<float>::max())
+			, maxBin(static_cast<float>(nBins - 1))
+		{}
+
+		int operator()(float value) const
+		{
+			float bin = (value - offset) * scale;
+
+			if (!(bin > 0.f))
+				return 0;
+
+			return static_cast<int>((std::min)(bin, maxBin));
+		}
+
+		__m128i operator()(__m128 values) const
+		{
+			// maxps returns its second operand if either is NaN
+			__m128 bins = _mm_mul_ps(_mm_sub_ps(values, _mm_set1_ps(offset)), _mm_set1_ps(scale));
+			bins = _mm_min_ps(_mm_max_ps(bins, _mm_setzero_ps()), _mm_set1_ps(maxBin));
+			return _mm_cvttps_epi32(bins);
+		}
+
+		float offset, scale, maxBin;
+	};
+}
+
+void ColorScaler::getScaledColors(float const *values, size_t count, unsigned int *colors)
+{
+	BinMapping toBin(minColorScaleValue, rangeColorScaleValue, COLORSCALER_LUT_SIZE);
+	unsigned int const *lut = m_vuiColorMapLUT.data();
+	unsigned char const *edges = m_vucColorMapLUTEdges.data();
+
+	size_t i = 0u;
+	for (; i + 4u <= count; i += 4u)
+	{
+		alignas(16) int bins[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(bins), toBin(_mm_loadu_ps(values + i)));
+
+		for (size_t k = 0u; k < 4u; ++k)
+			colors[i + k] = edges[bins[k]] ? getPackedScaledColor(values[i + k]) : lut[bins[k]];
+	}
+
+	for (; i < count; ++i)
+	{
+		int bin = toBin(values[i]);
+		colors[i] = edges[bin] ? getPackedScaledColor(values[i]) : lut[bin];
+	}
+}
+
+void ColorScaler::getBiValueScaledColors(float const *values1, float const *values2, size_t count, unsigned int *colors)
+{
+	if (m_ColorMap_BiValue == RedBlue)
+	{
+		for (size_t i = 0u; i < count; ++i)
+			colors[i] = packColor(values1[i], 0.f, values2[i]);
+
+		return;
+	}
+
+	BinMapping toBin1(minVal1, rangeVal1, COLORSCALER_BIVALUE_LUT_SIZE);
+	BinMapping toBin2(minVal2, rangeVal2, COLORSCALER_BIVALUE_LUT_SIZE);
+	unsigned int const *lut = m_vuiBiValueLUT.data();
+	unsigned char const *edges = m_vucBiValueLUTEdges.data();
+
+	size_t i = 0u;
+	for (; i + 4u <= count; i += 4u)
+	{
+		__m128i rows = toBin1(_mm_loadu_ps(values1 + i));
+		__m128i cols = toBin2(_mm_loadu_ps(values2 + i));
+
+		alignas(16) int bins[4];
+		_mm_store_si128(reinterpret_cast<__m128i*>(bins), _mm_add_epi32(_mm_slli_epi32(rows, COLORSCALER_BIVALUE_LUT_BITS), cols));
+
+		for (size_t k = 0u; k < 4u; ++k)
+			colors[i + k] = edges[bins[k]] ? getPackedBiValueColor(values1[i + k], values2[i + k]) : lut[bins[k]];
+	}
+
+	for (; i < count; ++i)
+	{
+		int bin = toBin1(values1[i]) * COLORSCALER_BIVALUE_LUT_SIZE + toBin2(values2[i]);
+		colors[i] = edges[bin] ? getPackedBiValueColor(values1[i], values2[i]) : lut[bin];
+	}
+}
+
+unsigned int ColorScaler::getPackedScaledColor(float value)
+{
+	float r = 0.f, g = 0.f, b = 0.f;
+	getScaledColorForValue(value, &r, &g, &b);
+	return packColor(r, g, b);
+}
+
+unsigned int ColorScaler::getPackedBiValueColor(float val1, float val2)
+{
+	float r = 0.f, g = 0.f, b = 0.f;
+	getBiValueScaledColor(val1, val2, &r, &g, &b);
+	return packColor(r, g, b);
+}
+
 void ColorScaler::setColorMode(Mode mode)
 {
 	m_ColorScaleMode = mode;
@@ -589,3 +828,35 @@ ColorScaler::Mode ColorScaler::getColorMode()
 	return m_ColorScaleMode;
 }
 
+void ColorScaler::setRangeMode(RangeMode mode)
+{
+	m_RangeMode = mode;
+}
+
+ColorScaler::RangeMode ColorScaler::getRangeMode()
+{
+	return m_RangeMode;
+}
+
+void ColorScaler::setClipPercentile(float percentile)
+{
+	m_fClipPercentile = (std::min)((std::max)(percentile, 0.f), 50.f);
+}
+
+float ColorScaler::getClipPercentile()
+{
+	return m_fClipPercentile;
+}
+
+void ColorScaler::setColorScaleEqualization(std::vector<float> const &cdf)
+{
+	m_vfColorScaleCDF = cdf;
+	buildColorMapLUT();
+}
+
+void ColorScaler::setBiValueEqualization(std::vector<float> const &cdf1, std::vector<float> const &cdf2)
+{
+	m_vfBiValueCDF1 = cdf1;
+	m_vfBiValueCDF2 = cdf2;
+	buildBiValueLUT();
+}
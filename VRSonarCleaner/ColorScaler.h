@@ -3,6 +3,11 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <vector>
+
+#define COLORSCALER_LUT_SIZE 1024
+#define COLORSCALER_BIVALUE_LUT_BITS 7
+#define COLORSCALER_BIVALUE_LUT_SIZE (1 << COLORSCALER_BIVALUE_LUT_BITS)
 
 
 class ColorScaler
@@ -25,6 +30,13 @@ public:
 		PurpleGreen,
 		Custom
 	};
+
+	// how the color range is derived from the data, see SonarScene::refreshColorScale()
+	enum RangeMode {
+		RangeMode_MinMax,
+		RangeMode_Percentile,	// clipped to the percentile range, ignoring outliers
+		RangeMode_Equalized		// min/max range, with colors spread evenly across the data (histogram equalization)
+	};
 	
 	ColorScaler();
 	virtual ~ColorScaler();
@@ -45,14 +57,39 @@ public:
 	void setBiValueColorMap(ColorMap_BiValued biValueColorMapEnum);
 	void getBiValueScaledColor(double val1, double val2, float *r, float *g, float *b);
 
+	// Batch versions of getScaledColorForValue() and getBiValueScaledColor() for whole point clouds. Colors are
+	// looked up from tables sampled from the color maps and written packed as RGBA8 (red in the lowest byte, alpha 255),
+	// so the continuous maps may differ from the per-value functions by one 8-bit step. Banded colors next to a band
+	// edge are computed per value, so the banded maps match exactly.
+	void getScaledColors(float const *values, size_t count, unsigned int *colors);
+	void getBiValueScaledColors(float const *values1, float const *values2, size_t count, unsigned int *colors);
+
 	void setColorMode(Mode mode);
 	Mode getColorMode();
 
+	void setRangeMode(RangeMode mode);
+	RangeMode getRangeMode();
+	void setClipPercentile(float percentile); // clips this percentage of the data at each end in RangeMode_Percentile
+	float getClipPercentile();
+
+	// Cumulative distributions of the data, sampled evenly across the current color scale ranges, used in place of the
+	// linear value to factor mapping when equalizing. Empty distributions disable equalization.
+	void setColorScaleEqualization(std::vector<float> const &cdf);
+	void setBiValueEqualization(std::vector<float> const &cdf1, std::vector<float> const &cdf2);
+
 private:
 	void getOrangeBrownScaledColor(float factor, float *r, float *g, float *b);
 	void getRainbowScaledColor(float factor, float *r, float *g, float *b);
 	void getBandedBlueScaledColor(float factor, float *r, float *g, float *b);
 	void getBandedRainbowScaledColor(float factor, float *r, float *g, float *b);
+
+	static float equalize(float factor, std::vector<float> const &cdf);
+
+	void buildColorMapLUT();
+	void buildBiValueLUT();
+	unsigned int getPackedScaledColor(float value);
+	unsigned int getPackedBiValueColor(float val1, float val2);
+	static unsigned int packColor(float r, float g, float b);
 	
 private:
 	ColorMap m_ColorMap;
@@ -64,6 +101,17 @@ private:
 	double minVal1, maxVal1, rangeVal1, minVal2, maxVal2, rangeVal2;
 
 	Mode m_ColorScaleMode;
+
+	RangeMode m_RangeMode;
+	float m_fClipPercentile;
+	std::vector<float> m_vfColorScaleCDF;
+	std::vector<float> m_vfBiValueCDF1, m_vfBiValueCDF2;
+
+	// color maps sampled at bin centers of the normalized value range, rebuilt when the map changes
+	std::vector<unsigned int> m_vuiColorMapLUT;
+	std::vector<unsigned char> m_vucColorMapLUTEdges; // bins crossed by a band edge of the banded maps, colored per value
+	std::vector<unsigned int> m_vuiBiValueLUT; // indexed [factor1 bin][factor2 bin]
+	std::vector<unsigned char> m_vucBiValueLUTEdges; // bins crossed by a band edge, colored per value
 };
 
 #endif
@@ -6,6 +6,7 @@
 #include "SelectAreaBehavior.h"
 #include "GrabObjectBehavior.h"
 #include "ScaleDataVolumeBehavior.h"
+#include "PointsCSVWriter.h"
 
 #include <fstream>
 #include <sstream>
@@ -139,33 +140,32 @@ void CurateStudyDataBehavior::savePoints()
 			"(" + std::to_string(i + 1) + ")" +
 			".csv");
 
-	std::ofstream outFile;
-	outFile.open(outFileName);
+	// text mode, so line endings are translated like they were with ofstream
+	FILE *outFile = fopen(outFileName.c_str(), "w");
 
-	if (outFile.is_open())
+	if (outFile)
 	{
 		std::cout << "Opened file " << outFileName << " for writing output" << std::endl;
-		outFile << "x,y,z,flag" << std::endl;
+		fputs("x,y,z,flag\n", outFile);
 	}
 	else
+	{
 		std::cout << "Error opening file " << outFileName << " for writing output" << std::endl;
+		return;
+	}
 
-	outFile.precision(std::numeric_limits<double>::max_digits10);
+	PointsCSVWriter writer(outFile);
 
 	for (auto &ds : m_pTableVolume->getDatasets())
 	{
 		SonarPointCloud* cloud = static_cast<SonarPointCloud*>(ds);
 
-		for (unsigned int i = 0u; i < cloud->getPointCount(); ++i)
-		{
-			if (cloud->getPointMark(i) == 1u)
-				continue;
-
-			outFile << cloud->getRawPointPosition(i).x << "," << cloud->getRawPointPosition(i).y << "," << cloud->getRawPointPosition(i).z << "," << (cloud->getPointPositionTPU(i) == 1.f ? "1" : "0") << std::endl;
-		}
+		writer.addPoints(cloud->getRawPointsPositions().data(), cloud->getPointsMarks().data(), cloud->getPointsPositionTPU().data(), cloud->getPointCount());
 	}
 
-	outFile.close();
+	writer.finish();
+
+	fclose(outFile);
 
 	std::cout << "File " << outFileName << " successfully written" << std::endl;
 }
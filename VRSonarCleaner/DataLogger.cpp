@@ -4,6 +4,7 @@
 #include <sstream>
 #include <string>
 #include <iomanip>
+#include <cstring>
 
 using namespace std::experimental::filesystem::v1;
 
@@ -12,19 +13,64 @@ void DataLogger::setLogDirectory(std::string dir)
 	m_LogDirectory = current_path().append(dir);
 }
 
+void DataLogger::setBinary(bool binary)
+{
+	m_bBinary = binary;
+}
+
+bool DataLogger::binary()
+{
+	return m_bBinary;
+}
+
+void DataLogger::setVerbose(bool verbose)
+{
+	m_bVerbose = verbose;
+}
+
+bool DataLogger::verbose()
+{
+	return m_bVerbose;
+}
+
 bool DataLogger::openLog(std::string logName, bool appendTimestampToLogname)
 {
+	stopWriter();
+
 	std::string filename = appendTimestampToLogname ? logName + "_" + getTimeString() : logName;
-	m_fsLog.open(std::string(m_LogDirectory.string() + filename));
+
+	if (m_bBinary)
+	{
+		m_fsLog.open(std::string(m_LogDirectory.string() + filename + ".evlog"), std::ios::out | std::ios::binary);
+
+		unsigned int fileHeader[2] = { EVENTLOG_MAGIC, EVENTLOG_VERSION };
+		if (m_fsLog.is_open())
+			m_fsLog.write(reinterpret_cast<char const*>(fileHeader), sizeof(fileHeader));
+	}
+	else
+		m_fsLog.open(std::string(m_LogDirectory.string() + filename));
+
+	if (m_fsLog.is_open())
+	{
+		m_bWriterRunning = true;
+		m_WriterThread = std::thread(&DataLogger::writerThread, this);
+	}
+
 	return m_fsLog.is_open();
 }
 
 void DataLogger::closeLog()
 {
+	stop();
+
+	// let producers that passed the logging check before stop() finish enqueueing, so the final drain gets them
+	while (m_nProducers > 0u)
+		std::this_thread::yield();
+
+	stopWriter();
+
 	if (m_fsLog.is_open())
 		m_fsLog.close();
-
-	stop();
 }
 
 void DataLogger::start()
@@ -34,9 +80,19 @@ void DataLogger::start()
 	if (m_bLogging)
 	{
 		m_tpLogStart = std::chrono::high_resolution_clock::now();
-	
-		if (m_strHeader != std::string())
-			m_fsLog << "id," << m_strHeader << "\n";
+
+		if (m_bBinary)
+		{
+			std::string records;
+			EventLog::encodeString(EventLog::Record_Identity, 0u, m_strID, records);
+
+			if (m_strHeader != std::string())
+				EventLog::encodeString(EventLog::Record_Header, 0u, m_strHeader, records);
+
+			enqueue(records);
+		}
+		else if (m_strHeader != std::string())
+			enqueue("id", m_strHeader);
 	}
 }
 
@@ -53,6 +109,15 @@ bool DataLogger::logging()
 void DataLogger::setID(std::string id)
 {
 	m_strID = id;
+
+	ProducerScope producer(*this);
+
+	if (producer.logging() && m_bBinary)
+	{
+		std::string record;
+		EventLog::encodeString(EventLog::Record_Identity, getTimeSinceLogStart(), m_strID, record);
+		enqueue(record);
+	}
 }
 
 void DataLogger::setHeader(std::string header)
@@ -62,46 +127,243 @@ void DataLogger::setHeader(std::string header)
 
 void DataLogger::logMessage(std::string message)
 {
-	if (m_bLogging)
-		m_fsLog << m_strID << ',' << message << "\n";	
+	ProducerScope producer(*this);
+
+	if (!producer.logging())
+		return;
+
+	if (m_bBinary)
+	{
+		std::string record;
+		EventLog::encodeString(EventLog::Record_Message, getTimeSinceLogStart(), message, record);
+		enqueue(record);
+	}
+	else
+		enqueue(m_strID, message);
 }
 
-std::string DataLogger::getTimeSinceLogStartString()
+void DataLogger::logPose(EventLog::Pose const &pose)
 {
-	if (!m_bLogging)
-		return "00:00:00.000";
+	ProducerScope producer(*this);
 
-	std::chrono::duration<double> elapsedTime(std::chrono::high_resolution_clock::now() - m_tpLogStart);
+	if (!producer.logging())
+		return;
+
+	if (m_bBinary)
+	{
+		std::string record;
+		EventLog::encode(pose, getTimeSinceLogStart(), record);
+		enqueue(record);
+	}
+	else
+		enqueue(m_strID, EventLog::format(pose, getTimeSinceLogStartString()));
+}
+
+void DataLogger::logPointsCleaned(EventLog::PointsCleaned const &event)
+{
+	ProducerScope producer(*this);
+
+	if (!producer.logging())
+		return;
+
+	if (m_bBinary)
+	{
+		std::string record;
+		EventLog::encode(event, getTimeSinceLogStart(), record);
+		enqueue(record);
+	}
+	else
+		enqueue(m_strID, EventLog::format(event, getTimeSinceLogStartString()));
+}
+
+void DataLogger::logTrialEvent(EventLog::Trial const &event)
+{
+	ProducerScope producer(*this);
+
+	if (!producer.logging())
+		return;
+
+	if (m_bBinary)
+	{
+		std::string record;
+		EventLog::encode(event, getTimeSinceLogStart(), record);
+		enqueue(record);
+	}
+	else
+		enqueue(m_strID, EventLog::format(event, getTimeSinceLogStartString()));
+}
+
+void DataLogger::enqueue(std::string const &id, std::string const &message)
+{
+	std::string line = id + ',' + message + '\n';
+
+	// a line may take at most half the ring, longer ones are truncated
+	size_t maxLength = DATALOGGER_SLOT_PAYLOAD * (DATALOGGER_RING_SLOTS / 2);
+	if (line.size() > maxLength)
+	{
+		line.resize(maxLength);
+		line.back() = '\n';
+	}
+
+	enqueue(line);
+}
+
+void DataLogger::enqueue(std::string const &data)
+{
+	// binary records cannot be truncated like text lines, so oversized ones are dropped
+	if (data.size() > DATALOGGER_SLOT_PAYLOAD * (DATALOGGER_RING_SLOTS / 2))
+	{
+		printf("WARNING: dropped %zu byte log record in %s\n", data.size(), __FUNCTION__);
+		return;
+	}
+
+	size_t nSlots = (data.size() + DATALOGGER_SLOT_PAYLOAD - 1u) / DATALOGGER_SLOT_PAYLOAD;
+
+	// claim nSlots consecutive slots once they are all free
+	size_t pos = m_nEnqueuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		bool free = true;
+		for (size_t i = 0u; i < nSlots && free; ++i)
+			free = m_vRing[(pos + i) & (DATALOGGER_RING_SLOTS - 1)].sequence.load(std::memory_order_acquire) == pos + i;
+
+		if (free)
+		{
+			if (m_nEnqueuePos.compare_exchange_weak(pos, pos + nSlots, std::memory_order_relaxed))
+				break;
+		}
+		else
+		{
+			size_t current = m_nEnqueuePos.load(std::memory_order_relaxed);
+
+			// ring is full, wait for the writer to catch up
+			if (current == pos)
+				std::this_thread::yield();
+
+			pos = current;
+		}
+	}
 
-	int hours, minutes, seconds, milliseconds;
+	for (size_t i = 0u; i < nSlots; ++i)
+	{
+		Slot &slot = m_vRing[(pos + i) & (DATALOGGER_RING_SLOTS - 1)];
 
-	hours = std::chrono::duration_cast<std::chrono::hours>(elapsedTime).count() % 24;
-	minutes = std::chrono::duration_cast<std::chrono::minutes>(elapsedTime).count() % 60;
-	seconds = std::chrono::duration_cast<std::chrono::seconds>(elapsedTime).count() % 60;
-	milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(elapsedTime).count() % 1000;
+		size_t offset = i * DATALOGGER_SLOT_PAYLOAD;
+		slot.length = static_cast<unsigned short>((std::min)(data.size() - offset, static_cast<size_t>(DATALOGGER_SLOT_PAYLOAD)));
+		memcpy(slot.data, data.data() + offset, slot.length);
 
-	std::stringstream ss;
-	ss << std::setw(2) << std::setfill('0') << hours;
-	ss << ":";
-	ss << std::setw(2) << std::setfill('0') << minutes;
-	ss << ":";
-	ss << std::setw(2) << std::setfill('0') << seconds;
-	ss << ".";
-	ss << std::setw(3) << std::setfill('0') << milliseconds;
+		slot.sequence.store(pos + i + 1u, std::memory_order_release);
+	}
+}
 
-	return ss.str();
+void DataLogger::writerThread()
+{
+	std::string batch;
+	batch.reserve(DATALOGGER_RING_SLOTS * DATALOGGER_SLOT_PAYLOAD);
+
+	for (;;)
+	{
+		bool running = m_bWriterRunning;
+
+		// drain everything published so far into one batch
+		for (;;)
+		{
+			Slot &slot = m_vRing[m_nDequeuePos & (DATALOGGER_RING_SLOTS - 1)];
+
+			if (slot.sequence.load(std::memory_order_acquire) != m_nDequeuePos + 1u)
+				break;
+
+			batch.append(slot.data, slot.length);
+			slot.sequence.store(m_nDequeuePos + DATALOGGER_RING_SLOTS, std::memory_order_release);
+			m_nDequeuePos++;
+		}
+
+		if (batch.size() > 0u)
+		{
+			m_fsLog.write(batch.data(), batch.size());
+			m_fsLog.flush();
+			batch.clear();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_mtxWriter);
+			m_nWrittenPos = m_nDequeuePos;
+		}
+		m_cvWritten.notify_all();
+
+		// a stop request is only honored after a final drain
+		if (!running)
+			break;
+
+		std::unique_lock<std::mutex> lock(m_mtxWriter);
+		m_cvWake.wait_for(lock, std::chrono::milliseconds(5));
+	}
 }
 
-DataLogger::DataLogger() : m_bLogging(false)
+void DataLogger::flush()
+{
+	if (!m_WriterThread.joinable())
+		return;
+
+	size_t target = m_nEnqueuePos.load();
+
+	std::unique_lock<std::mutex> lock(m_mtxWriter);
+	m_cvWake.notify_one();
+	m_cvWritten.wait(lock, [&]() { return m_nWrittenPos >= target; });
+}
+
+void DataLogger::stopWriter()
+{
+	if (!m_WriterThread.joinable())
+		return;
+
+	flush();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mtxWriter);
+		m_bWriterRunning = false;
+	}
+	m_cvWake.notify_one();
+
+	m_WriterThread.join();
+}
+
+unsigned int DataLogger::getTimeSinceLogStart()
+{
+	if (!m_bLogging)
+		return 0u;
+
+	std::chrono::duration<double> elapsedTime(std::chrono::high_resolution_clock::now() - m_tpLogStart);
+
+	return static_cast<unsigned int>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsedTime).count());
+}
+
+std::string DataLogger::getTimeSinceLogStartString()
+{
+	return EventLog::formatTime(getTimeSinceLogStart());
+}
+
+DataLogger::DataLogger()
+	: m_bLogging(false)
+	, m_nProducers(0u)
+	, m_bBinary(false)
+	, m_bVerbose(false)
+	, m_vRing(DATALOGGER_RING_SLOTS)
+	, m_nEnqueuePos(0u)
+	, m_nDequeuePos(0u)
+	, m_nWrittenPos(0u)
+	, m_bWriterRunning(false)
 {
 	m_LogDirectory = current_path();
+
+	for (size_t i = 0u; i < m_vRing.size(); ++i)
+		m_vRing[i].sequence = i;
 }
 
 
 DataLogger::~DataLogger()
 {
-	if (m_fsLog.is_open())
-		m_fsLog.close();
+	closeLog();
 }
 
 
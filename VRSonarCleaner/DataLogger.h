@@ -1,10 +1,19 @@
 #pragma once
 
 #include "BehaviorBase.h"
+#include "EventLog.h"
 #include <map>
 #include <sstream>
 #include <fstream>
 #include <filesystem>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+#define DATALOGGER_RING_SLOTS 8192		// must be a power of two
+#define DATALOGGER_SLOT_PAYLOAD 118		// bytes of a log line carried per slot
 
 class DataLogger
 {
@@ -19,6 +28,16 @@ public:
 	static std::string getTimeString();
 
 	void setLogDirectory(std::string dir);
+
+	// Binary logs store typed records (see EventLog.h) instead of text lines and get the extension .evlog.
+	// Set before opening the log; EventLog::convertToText() regenerates the text log from a binary one.
+	void setBinary(bool binary);
+	bool binary();
+
+	// Verbose logs keep per-item events (e.g. one line per cleaned point) where aggregated events are logged by default
+	void setVerbose(bool verbose);
+	bool verbose();
+
 	bool openLog(std::string logName, bool appendTimestampToLogname = true);
 	void closeLog();
 
@@ -29,18 +48,84 @@ public:
 	void setID(std::string id);
 	void setHeader(std::string header);
 
+	// Safe to call from any thread. The line is copied into a lock-free ring buffer and written to the log
+	// file by a background writer thread.
 	void logMessage(std::string message);
 
+	// Typed events, encoded as compact records in binary logs and formatted as text lines otherwise
+	void logPose(EventLog::Pose const &pose);
+	void logPointsCleaned(EventLog::PointsCleaned const &event);
+	void logTrialEvent(EventLog::Trial const &event);
+
+	// Blocks until every message logged before the call has been written to the log file
+	void flush();
+
+	unsigned int getTimeSinceLogStart(); // milliseconds
 	std::string getTimeSinceLogStartString();
 
 private:
 	DataLogger();
 	~DataLogger();
 
-	bool m_bLogging;
+	// Fixed-size record of a multi-producer, single-consumer bounded queue. A log line spans consecutive slots,
+	// which are claimed together, so lines from different threads never interleave.
+	struct Slot {
+		std::atomic<size_t> sequence;	// == position when free, position + 1 when filled
+		unsigned short length;
+		char data[DATALOGGER_SLOT_PAYLOAD];
+	};
+
+	// Counts a producer in while it enqueues, so closeLog() can wait for producers that saw logging still on
+	// instead of leaving their records in the ring for the next log. logging() is checked after counting in, so
+	// either closeLog() sees the producer or the producer sees logging off.
+	class ProducerScope {
+	public:
+		explicit ProducerScope(DataLogger &logger)
+			: m_Logger(logger)
+			, m_bCounted(logger.m_bLogging)
+		{
+			if (m_bCounted)
+				m_Logger.m_nProducers++;
+		}
+
+		~ProducerScope()
+		{
+			if (m_bCounted)
+				m_Logger.m_nProducers--;
+		}
+
+		bool logging() const
+		{
+			return m_bCounted && m_Logger.m_bLogging;
+		}
+
+	private:
+		DataLogger &m_Logger;
+		bool m_bCounted;
+	};
+
+	void enqueue(std::string const &id, std::string const &message);
+	void enqueue(std::string const &data);
+	void writerThread();
+	void stopWriter();
+
+	std::atomic<bool> m_bLogging;
+	std::atomic<unsigned int> m_nProducers;
+	bool m_bBinary;
+	bool m_bVerbose;
 
 	std::ofstream m_fsLog;
 
+	std::vector<Slot> m_vRing;
+	std::atomic<size_t> m_nEnqueuePos;
+	size_t m_nDequeuePos;				// only touched by the writer thread
+	std::atomic<size_t> m_nWrittenPos;	// slots before this position have been written to the file
+
+	std::thread m_WriterThread;
+	std::atomic<bool> m_bWriterRunning;
+	std::mutex m_mtxWriter;
+	std::condition_variable m_cvWake, m_cvWritten;
+
 	std::string m_strID, m_strHeader;
 
 	std::experimental::filesystem::v1::path m_LogDirectory;
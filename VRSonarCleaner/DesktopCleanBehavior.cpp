@@ -4,6 +4,8 @@
 #include "Renderer.h"
 #include "DataLogger.h"
 
+#include <filesystem>
+
 using namespace std::chrono_literals;
 
 DesktopCleanBehavior::DesktopCleanBehavior(DataVolume* pointCloudVolume)
@@ -63,10 +65,24 @@ unsigned int DesktopCleanBehavior::checkPoints()
 {
 	bool hit = false;
 
+	bool logRanges = DataLogger::getInstance().logging() && !DataLogger::getInstance().verbose();
+
 	for (auto &ds : m_pDataVolume->getDatasets())
 	{
 		SonarPointCloud* cloud = static_cast<SonarPointCloud*>(ds);
 
+		EventLog::PointsCleaned event;
+
+		if (logRanges)
+		{
+			event.cloud = std::experimental::filesystem::v1::path(cloud->getName()).filename().string();
+			event.volPos = m_pDataVolume->getPosition();
+			event.volQuat = m_pDataVolume->getOrientation();
+			event.volDims = m_pDataVolume->getDimensions();
+		}
+
+		EventLog::PointsCleanedCollector collector(event, DESKTOP_CLEAN_MAX_LOGGED_RANGES, [](EventLog::PointsCleaned const &e) { DataLogger::getInstance().logPointsCleaned(e); });
+
 		for (unsigned int i = 0u; i < cloud->getPointCount(); ++i)
 		{
 			glm::vec3 in = m_pDataVolume->convertToWorldCoords(cloud->getRawPointPosition(i));
@@ -80,32 +96,33 @@ unsigned int DesktopCleanBehavior::checkPoints()
 				cloud->markPoint(i, 1);
 				hit = true;
 
-				if (DataLogger::getInstance().logging())
-				{
-					std::stringstream ss;
-
-					ss << ((cloud->getPointDepthTPU(i) == 1.f) ? "Bad Point Cleaned" : "Good Point Cleaned");
-					ss << "\t" << DataLogger::getInstance().getTimeSinceLogStartString();
-					ss << "\t";
-					ss << "point-id:\"" << i << "\"";
-					ss << ";";
-					ss << "point-pos:\"" << in.x << "," << in.y << "," << in.z << "\"";
-					ss << ";";
-					ss << "point-pos-screen:\"" << out.x << "," << out.y << "\"";
-					ss << ";";
-					ss << "vol-pos:\"" << m_pDataVolume->getPosition().x << "," << m_pDataVolume->getPosition().y << "," << m_pDataVolume->getPosition().z << "\"";
-					ss << ";";
-					ss << "vol-quat:\"" << m_pDataVolume->getOrientation().x << "," << m_pDataVolume->getOrientation().y << "," << m_pDataVolume->getOrientation().z << "," << m_pDataVolume->getOrientation().w << "\"";
-					ss << ";";
-					ss << "vol-dims:\"" << m_pDataVolume->getDimensions().x << "," << m_pDataVolume->getDimensions().y << "," << m_pDataVolume->getDimensions().z << "\"";
-
-					DataLogger::getInstance().logMessage(ss.str());
-				}
+				// points are visited in index order
+				if (logRanges)
+					collector.add(i, cloud->getPointDepthTPU(i) == 1.f);
+				else if (DataLogger::getInstance().logging())
+					logPointCleaned(cloud, i, in, out);
 			}
 		}
+
+		collector.finish();
+
 		if (hit)
 			cloud->setRefreshNeeded();
 	}
 
 	return hit;
-}
\ No newline at end of file
+}
+
+void DesktopCleanBehavior::logPointCleaned(SonarPointCloud* cloud, unsigned int index, glm::vec3 const &worldPos, glm::vec3 const &screenPos)
+{
+	EventLog::PointCleaned event;
+	event.bad = cloud->getPointDepthTPU(index) == 1.f;
+	event.index = index;
+	event.worldPos = worldPos;
+	event.screenPos = glm::vec2(screenPos);
+	event.volPos = m_pDataVolume->getPosition();
+	event.volQuat = m_pDataVolume->getOrientation();
+	event.volDims = m_pDataVolume->getDimensions();
+
+	DataLogger::getInstance().logMessage(EventLog::format(event, DataLogger::getInstance().getTimeSinceLogStartString()));
+}
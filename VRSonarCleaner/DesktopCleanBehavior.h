@@ -7,6 +7,7 @@
 
 #define POINT_CLOUD_CLEAN_PROBE_ROTATION_RATE std::chrono::duration<float, std::milli>(2000)
 #define POINT_CLOUD_HIGHLIGHT_BLINK_RATE std::chrono::duration<float, std::milli>(250)
+#define DESKTOP_CLEAN_MAX_LOGGED_RANGES 4096	// index ranges per "Points Cleaned" event, larger selections are split
 
 class DesktopCleanBehavior :
 	public InitializableBehavior
@@ -29,6 +30,9 @@ private:
 
 
 private:
+	// Each lasso logs one "Points Cleaned" event per cloud with the cleaned point index ranges, or the
+	// per-point "Bad/Good Point Cleaned" lines if the logger is verbose
 	unsigned int checkPoints();
+	void logPointCleaned(SonarPointCloud* cloud, unsigned int index, glm::vec3 const &worldPos, glm::vec3 const &screenPos);
 };
 
@@ -0,0 +1,575 @@
+#include "EventLog.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+namespace
+{
+	void putVarint(unsigned long long value, std::string &out)
+	{
+		while (value >= 0x80u)
+		{
+			out.push_back(static_cast<char>((value & 0x7Fu) | 0x80u));
+			value >>= 7;
+		}
+		out.push_back(static_cast<char>(value));
+	}
+
+	void putFloats(float const *values, size_t count, std::string &out)
+	{
+		out.append(reinterpret_cast<char const*>(values), count * sizeof(float));
+	}
+
+	void putVec3(glm::vec3 const &v, std::string &out)
+	{
+		putFloats(&v.x, 3u, out);
+	}
+
+	void putQuat(glm::quat const &q, std::string &out)
+	{
+		float xyzw[4] = { q.x, q.y, q.z, q.w };
+		putFloats(xyzw, 4u, out);
+	}
+
+	void putString(std::string const &str, std::string &out)
+	{
+		putVarint(str.size(), out);
+		out.append(str);
+	}
+
+	void putPose(EventLog::Pose const &pose, std::string &out)
+	{
+		out.push_back(static_cast<char>(pose.devices));
+
+		for (int i = 0; i < EventLog::Pose::DeviceCount; ++i)
+		{
+			if (pose.devices & (1u << i))
+			{
+				putVec3(pose.pos[i], out);
+				putQuat(pose.quat[i], out);
+			}
+		}
+	}
+
+	// Wraps an encoded payload in its record header
+	void putRecord(EventLog::RecordType type, unsigned int timeMs, std::string const &payload, std::string &out)
+	{
+		out.push_back(static_cast<char>(type));
+		putVarint(payload.size(), out);
+		putVarint(timeMs, out);
+		out.append(payload);
+	}
+
+	// Bounds-checked reader over a record payload; once a read fails all further reads fail too
+	class Reader
+	{
+	public:
+		Reader(char const *data, size_t size) : m_pBegin(data), m_pData(data), m_pEnd(data + size), m_bOK(true) {}
+
+		bool ok() { return m_bOK; }
+		size_t bytesRead() { return static_cast<size_t>(m_pData - m_pBegin); }
+
+		unsigned long long getVarint()
+		{
+			unsigned long long value = 0ull;
+
+			for (int shift = 0; shift < 64; shift += 7)
+			{
+				if (m_pData >= m_pEnd)
+					break;
+
+				unsigned char byte = static_cast<unsigned char>(*m_pData++);
+				value |= static_cast<unsigned long long>(byte & 0x7Fu) << shift;
+
+				if (!(byte & 0x80u))
+					return value;
+			}
+
+			m_bOK = false;
+			return 0ull;
+		}
+
+		unsigned char getByte()
+		{
+			if (m_pData >= m_pEnd)
+			{
+				m_bOK = false;
+				return 0u;
+			}
+
+			return static_cast<unsigned char>(*m_pData++);
+		}
+
+		void getFloats(float *values, size_t count)
+		{
+			if (static_cast<size_t>(m_pEnd - m_pData) < count * sizeof(float))
+			{
+				m_bOK = false;
+				memset(values, 0, count * sizeof(float));
+				return;
+			}
+
+			memcpy(values, m_pData, count * sizeof(float));
+			m_pData += count * sizeof(float);
+		}
+
+		glm::vec3 getVec3()
+		{
+			glm::vec3 v;
+			getFloats(&v.x, 3u);
+			return v;
+		}
+
+		glm::quat getQuat()
+		{
+			float xyzw[4];
+			getFloats(xyzw, 4u);
+			return glm::quat(xyzw[3], xyzw[0], xyzw[1], xyzw[2]);
+		}
+
+		std::string getString()
+		{
+			unsigned long long length = getVarint();
+
+			if (!m_bOK || length > static_cast<unsigned long long>(m_pEnd - m_pData))
+			{
+				m_bOK = false;
+				return std::string();
+			}
+
+			std::string str(m_pData, static_cast<size_t>(length));
+			m_pData += length;
+			return str;
+		}
+
+		EventLog::Pose getPose()
+		{
+			EventLog::Pose pose;
+			pose.devices = getByte();
+
+			for (int i = 0; i < EventLog::Pose::DeviceCount; ++i)
+			{
+				if (pose.devices & (1u << i))
+				{
+					pose.pos[i] = getVec3();
+					pose.quat[i] = getQuat();
+				}
+			}
+
+			return pose;
+		}
+
+	private:
+		char const *m_pBegin;
+		char const *m_pData;
+		char const *m_pEnd;
+		bool m_bOK;
+	};
+
+	// Writes key:"value" fields, separated by semicolons
+	class FieldWriter
+	{
+	public:
+		FieldWriter(std::ostream &os) : m_os(os), m_bFirst(true) {}
+
+		std::ostream& field(char const *key)
+		{
+			if (!m_bFirst)
+				m_os << ";";
+			m_bFirst = false;
+
+			return m_os << key << ":";
+		}
+
+		void vec3(char const *key, glm::vec3 const &v)
+		{
+			field(key) << "\"" << v.x << "," << v.y << "," << v.z << "\"";
+		}
+
+		void quat(char const *key, glm::quat const &q)
+		{
+			field(key) << "\"" << q.x << "," << q.y << "," << q.z << "," << q.w << "\"";
+		}
+
+		void pose(EventLog::Pose const &pose)
+		{
+			static char const *posKeys[EventLog::Pose::DeviceCount] = { "hmd-pos", "primary-controller-pos", "secondary-controller-pos" };
+			static char const *quatKeys[EventLog::Pose::DeviceCount] = { "hmd-quat", "primary-controller-quat", "secondary-controller-quat" };
+
+			for (int i = 0; i < EventLog::Pose::DeviceCount; ++i)
+			{
+				if (pose.devices & (1u << i))
+				{
+					vec3(posKeys[i], pose.pos[i]);
+					quat(quatKeys[i], pose.quat[i]);
+				}
+			}
+		}
+
+	private:
+		std::ostream &m_os;
+		bool m_bFirst;
+	};
+}
+
+void EventLog::Pose::set(Device device, glm::mat4 const &deviceToWorld)
+{
+	devices |= 1u << device;
+	pos[device] = glm::vec3(deviceToWorld[3]);
+	quat[device] = glm::quat_cast(deviceToWorld);
+}
+
+EventLog::PointsCleanedCollector::PointsCleanedCollector(PointsCleaned const &prototype, size_t maxRanges, std::function<void(PointsCleaned const &)> emit)
+	: m_Event(prototype)
+	, m_nMaxRanges(maxRanges > 0u ? maxRanges : 1u)
+	, m_funcEmit(emit)
+{
+	m_Event.ranges.clear();
+	m_Event.badCount = m_Event.goodCount = 0u;
+}
+
+void EventLog::PointsCleanedCollector::add(unsigned int index, bool bad)
+{
+	if (m_Event.ranges.size() > 0u && m_Event.ranges.back().first + m_Event.ranges.back().count == index)
+		m_Event.ranges.back().count++;
+	else
+	{
+		if (m_Event.ranges.size() == m_nMaxRanges)
+			finish();
+
+		PointRange range;
+		range.first = index;
+		range.count = 1u;
+		m_Event.ranges.push_back(range);
+	}
+
+	if (bad)
+		m_Event.badCount++;
+	else
+		m_Event.goodCount++;
+}
+
+void EventLog::PointsCleanedCollector::finish()
+{
+	if (m_Event.ranges.size() > 0u)
+		m_funcEmit(m_Event);
+
+	m_Event.ranges.clear();
+	m_Event.badCount = m_Event.goodCount = 0u;
+}
+
+void EventLog::encodeString(RecordType type, unsigned int timeMs, std::string const &str, std::string &out)
+{
+	putRecord(type, timeMs, str, out);
+}
+
+void EventLog::encode(Pose const &pose, unsigned int timeMs, std::string &out)
+{
+	std::string payload;
+	putPose(pose, payload);
+
+	putRecord(Record_Pose, timeMs, payload, out);
+}
+
+void EventLog::encode(PointsCleaned const &event, unsigned int timeMs, std::string &out)
+{
+	std::string payload;
+	payload.reserve(64u + event.cloud.size() + event.ranges.size() * 4u);
+
+	putString(event.cloud, payload);
+	putVarint(event.badCount, payload);
+	putVarint(event.goodCount, payload);
+	putVec3(event.volPos, payload);
+	putQuat(event.volQuat, payload);
+	putVec3(event.volDims, payload);
+
+	// ranges are sorted, so each one is stored as the gap after the previous range and its length
+	putVarint(event.ranges.size(), payload);
+	unsigned int prevEnd = 0u;
+	for (auto const &r : event.ranges)
+	{
+		putVarint(r.first - prevEnd, payload);
+		putVarint(r.count, payload);
+		prevEnd = r.first + r.count;
+	}
+
+	putRecord(Record_PointsCleaned, timeMs, payload, out);
+}
+
+void EventLog::encode(Trial const &event, unsigned int timeMs, std::string &out)
+{
+	std::string payload;
+
+	unsigned char flags = (event.end ? 1u : 0u) | (event.hasCamera ? 2u : 0u) | (event.hasTotals ? 4u : 0u);
+	payload.push_back(static_cast<char>(flags));
+
+	putString(event.trialType, payload);
+	putString(event.fileName, payload);
+	putString(event.fileCategory, payload);
+	putVec3(event.volPos, payload);
+	putQuat(event.volQuat, payload);
+	putVec3(event.volDims, payload);
+	putPose(event.pose, payload);
+
+	if (event.hasCamera)
+	{
+		putVec3(event.camPos, payload);
+		putVec3(event.camLookat, payload);
+	}
+
+	if (event.hasTotals)
+	{
+		putVarint(event.totalCleaned, payload);
+		putVarint(event.totalMistakes, payload);
+	}
+
+	putRecord(Record_Trial, timeMs, payload, out);
+}
+
+std::string EventLog::formatTime(unsigned int timeMs)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%02u:%02u:%02u.%03u", (timeMs / 3600000u) % 24u, (timeMs / 60000u) % 60u, (timeMs / 1000u) % 60u, timeMs % 1000u);
+
+	return std::string(buf);
+}
+
+std::string EventLog::format(Pose const &pose, std::string const &time)
+{
+	std::stringstream ss;
+	ss << "Pose" << "\t" << time << "\t";
+
+	FieldWriter fw(ss);
+	fw.pose(pose);
+
+	return ss.str();
+}
+
+std::string EventLog::format(PointsCleaned const &event, std::string const &time)
+{
+	std::stringstream ss;
+	ss << "Points Cleaned" << "\t" << time << "\t";
+
+	FieldWriter fw(ss);
+	fw.field("cloud") << "\"" << event.cloud << "\"";
+
+	// inclusive index ranges, e.g. "0-99,250-250"
+	fw.field("point-ranges") << "\"";
+	for (size_t i = 0u; i < event.ranges.size(); ++i)
+		ss << (i > 0u ? "," : "") << event.ranges[i].first << "-" << event.ranges[i].first + event.ranges[i].count - 1u;
+	ss << "\"";
+
+	fw.field("bad-cleaned") << "\"" << event.badCount << "\"";
+	fw.field("good-cleaned") << "\"" << event.goodCount << "\"";
+	fw.vec3("vol-pos", event.volPos);
+	fw.quat("vol-quat", event.volQuat);
+	fw.vec3("vol-dims", event.volDims);
+
+	return ss.str();
+}
+
+std::string EventLog::format(PointCleaned const &event, std::string const &time)
+{
+	std::stringstream ss;
+	ss << (event.bad ? "Bad Point Cleaned" : "Good Point Cleaned") << "\t" << time << "\t";
+
+	FieldWriter fw(ss);
+	fw.field("point-id") << "\"" << event.index << "\"";
+	fw.vec3("point-pos", event.worldPos);
+	fw.field("point-pos-screen") << "\"" << event.screenPos.x << "," << event.screenPos.y << "\"";
+	fw.vec3("vol-pos", event.volPos);
+	fw.quat("vol-quat", event.volQuat);
+	fw.vec3("vol-dims", event.volDims);
+
+	return ss.str();
+}
+
+std::string EventLog::format(Trial const &event, std::string const &time)
+{
+	std::stringstream ss;
+	ss << (event.end ? "Trial End" : "Trial Begin") << "\t" << time << "\t";
+
+	FieldWriter fw(ss);
+	fw.field("trial-type") << "\"" << event.trialType << "\"";
+	fw.field("file-name") << "\"" << event.fileName << "\"";
+	fw.field("file-category") << "\"" << event.fileCategory << "\"";
+	fw.vec3("vol-pos", event.volPos);
+	fw.quat("vol-quat", event.volQuat);
+	fw.vec3("vol-dims", event.volDims);
+	fw.pose(event.pose);
+
+	if (event.hasCamera)
+	{
+		fw.vec3("cam-pos", event.camPos);
+		fw.vec3("cam-lookat", event.camLookat);
+	}
+
+	if (event.hasTotals)
+	{
+		fw.field("total-cleaned") << "\"" << event.totalCleaned << "\"";
+		fw.field("total-mistakes") << "\"" << event.totalMistakes << "\"";
+	}
+
+	return ss.str();
+}
+
+bool EventLog::convertToText(std::string binaryLogName, std::string textLogName)
+{
+	FILE *in = fopen(binaryLogName.c_str(), "rb");
+	if (!in)
+	{
+		printf("ERROR: could not open %s in %s\n", binaryLogName.c_str(), __FUNCTION__);
+		return false;
+	}
+
+	std::vector<char> data;
+	char buf[1 << 16];
+	size_t nRead;
+	while ((nRead = fread(buf, 1, sizeof(buf), in)) > 0u)
+		data.insert(data.end(), buf, buf + nRead);
+	fclose(in);
+
+	unsigned int magic = 0u, version = 0u;
+	if (data.size() >= 8u)
+	{
+		memcpy(&magic, data.data(), 4u);
+		memcpy(&version, data.data() + 4u, 4u);
+	}
+
+	if (magic != EVENTLOG_MAGIC)
+	{
+		printf("ERROR: %s is not an event log\n", binaryLogName.c_str());
+		return false;
+	}
+
+	if (version > EVENTLOG_VERSION)
+	{
+		printf("ERROR: %s has unsupported event log version %u\n", binaryLogName.c_str(), version);
+		return false;
+	}
+
+	FILE *out = fopen(textLogName.c_str(), "w");
+	if (!out)
+	{
+		printf("ERROR: could not create %s in %s\n", textLogName.c_str(), __FUNCTION__);
+		return false;
+	}
+
+	std::string id;
+	size_t nRecords = 0u;
+	size_t pos = 8u;
+
+	while (pos < data.size())
+	{
+		Reader header(data.data() + pos + 1u, data.size() - pos - 1u);
+		unsigned char type = static_cast<unsigned char>(data[pos]);
+		unsigned long long payloadSize = header.getVarint();
+		unsigned int timeMs = static_cast<unsigned int>(header.getVarint());
+
+		size_t headerSize = 1u + header.bytesRead();
+
+		if (!header.ok() || payloadSize > data.size() - pos - headerSize)
+		{
+			printf("WARNING: %s ends with a truncated record after %zu records\n", binaryLogName.c_str(), nRecords);
+			break;
+		}
+
+		char const *payloadData = data.data() + pos + headerSize;
+		Reader payload(payloadData, static_cast<size_t>(payloadSize));
+		pos += headerSize + static_cast<size_t>(payloadSize);
+		nRecords++;
+
+		std::string line;
+		std::string time = formatTime(timeMs);
+
+		switch (type)
+		{
+		case Record_Identity:
+			id.assign(payloadData, static_cast<size_t>(payloadSize));
+			continue;
+		case Record_Header:
+			line = "id," + std::string(payloadData, static_cast<size_t>(payloadSize));
+			break;
+		case Record_Message:
+			line = id + "," + std::string(payloadData, static_cast<size_t>(payloadSize));
+			break;
+		case Record_Pose:
+			line = id + "," + format(payload.getPose(), time);
+			break;
+		case Record_PointsCleaned:
+		{
+			PointsCleaned event;
+			event.cloud = payload.getString();
+			event.badCount = static_cast<unsigned int>(payload.getVarint());
+			event.goodCount = static_cast<unsigned int>(payload.getVarint());
+			event.volPos = payload.getVec3();
+			event.volQuat = payload.getQuat();
+			event.volDims = payload.getVec3();
+
+			unsigned long long nRanges = payload.getVarint();
+			unsigned int prevEnd = 0u;
+			for (unsigned long long i = 0u; i < nRanges && payload.ok(); ++i)
+			{
+				PointRange r;
+				r.first = prevEnd + static_cast<unsigned int>(payload.getVarint());
+				r.count = static_cast<unsigned int>(payload.getVarint());
+				event.ranges.push_back(r);
+				prevEnd = r.first + r.count;
+			}
+
+			line = id + "," + format(event, time);
+			break;
+		}
+		case Record_Trial:
+		{
+			Trial event;
+			unsigned char flags = payload.getByte();
+			event.end = (flags & 1u) != 0u;
+			event.hasCamera = (flags & 2u) != 0u;
+			event.hasTotals = (flags & 4u) != 0u;
+			event.trialType = payload.getString();
+			event.fileName = payload.getString();
+			event.fileCategory = payload.getString();
+			event.volPos = payload.getVec3();
+			event.volQuat = payload.getQuat();
+			event.volDims = payload.getVec3();
+			event.pose = payload.getPose();
+
+			if (event.hasCamera)
+			{
+				event.camPos = payload.getVec3();
+				event.camLookat = payload.getVec3();
+			}
+
+			if (event.hasTotals)
+			{
+				event.totalCleaned = static_cast<unsigned int>(payload.getVarint());
+				event.totalMistakes = static_cast<unsigned int>(payload.getVarint());
+			}
+
+			line = id + "," + format(event, time);
+			break;
+		}
+		default:
+			// record type from a newer version
+			continue;
+		}
+
+		if (!payload.ok())
+		{
+			printf("WARNING: skipping malformed record of type %u in %s\n", type, binaryLogName.c_str());
+			continue;
+		}
+
+		line.push_back('\n');
+		fwrite(line.data(), 1, line.size(), out);
+	}
+
+	fclose(out);
+
+	printf("Converted %zu records from %s to %s\n", nRecords, binaryLogName.c_str(), textLogName.c_str());
+
+	return true;
+}
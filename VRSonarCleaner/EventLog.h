@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <glm.hpp>
+#include <gtc/quaternion.hpp>
+
+#define EVENTLOG_MAGIC 0x474C5645u		// "EVLG"
+#define EVENTLOG_VERSION 1u
+
+// Binary study event log. A log file starts with the magic number and version (4 bytes each, little-endian),
+// followed by records of the form
+//
+//	type (1 byte) | payload size (varint) | milliseconds since log start (varint) | payload
+//
+// Integers are LEB128 varints, floats are stored raw and strings are a varint length followed by the characters.
+// Readers skip record types they do not know, so new types can be added without breaking old converters.
+// The text formatters below produce exactly the lines the text log has always contained, so a binary log
+// can be converted back to the text format offline.
+namespace EventLog
+{
+	enum RecordType {
+		Record_Identity = 0,		// participant id prepended to the lines that follow
+		Record_Header = 1,			// column header line
+		Record_Message = 2,			// preformatted text line
+		Record_Pose = 3,
+		Record_PointsCleaned = 4,
+		Record_Trial = 5
+	};
+
+	// Tracked device poses, e.g. sampled every frame during a trial
+	struct Pose {
+		enum Device {
+			HMD = 0,
+			PrimaryController,
+			SecondaryController,
+			DeviceCount
+		};
+
+		unsigned char devices;	// bit mask of the valid devices
+		glm::vec3 pos[DeviceCount];
+		glm::quat quat[DeviceCount];
+
+		Pose() : devices(0u) {}
+
+		void set(Device device, glm::mat4 const &deviceToWorld);
+	};
+
+	struct PointRange {
+		unsigned int first;
+		unsigned int count;
+	};
+
+	// Points of one cloud cleaned at the same time, as sorted, non-overlapping index ranges
+	struct PointsCleaned {
+		std::string cloud;
+		std::vector<PointRange> ranges;
+		unsigned int badCount;		// cleaned points that were flagged as bad data
+		unsigned int goodCount;		// cleaned points that were not (mistakes)
+		glm::vec3 volPos;
+		glm::quat volQuat;
+		glm::vec3 volDims;
+
+		PointsCleaned() : badCount(0u), goodCount(0u) {}
+	};
+
+	// One cleaned point, logged per point in verbose logs
+	struct PointCleaned {
+		bool bad;
+		unsigned int index;
+		glm::vec3 worldPos;
+		glm::vec2 screenPos;
+		glm::vec3 volPos;
+		glm::quat volQuat;
+		glm::vec3 volDims;
+
+		PointCleaned() : bad(false), index(0u) {}
+	};
+
+	// Collects points cleaned in increasing index order into the ranges of PointsCleaned events: a point either
+	// extends the last range or starts a new one. An event is passed to emit() when starting a range would exceed
+	// maxRanges, and by finish(), so a large selection is split into several events. Each event carries the
+	// bad/good counts of its own points and the cloud and volume fields of the prototype.
+	class PointsCleanedCollector
+	{
+	public:
+		PointsCleanedCollector(PointsCleaned const &prototype, size_t maxRanges, std::function<void(PointsCleaned const &)> emit);
+
+		void add(unsigned int index, bool bad);
+		void finish();
+
+	private:
+		PointsCleaned m_Event;
+		size_t m_nMaxRanges;
+		std::function<void(PointsCleaned const &)> m_funcEmit;
+	};
+
+	// "Trial Begin" and "Trial End" events
+	struct Trial {
+		bool end;
+		std::string trialType;
+		std::string fileName;
+		std::string fileCategory;
+		glm::vec3 volPos;
+		glm::quat volQuat;
+		glm::vec3 volDims;
+		Pose pose;
+		bool hasCamera;
+		glm::vec3 camPos;
+		glm::vec3 camLookat;
+		bool hasTotals;
+		unsigned int totalCleaned;
+		unsigned int totalMistakes;
+
+		Trial() : end(false), hasCamera(false), hasTotals(false), totalCleaned(0u), totalMistakes(0u) {}
+	};
+
+	// Appends one complete record to out
+	void encodeString(RecordType type, unsigned int timeMs, std::string const &str, std::string &out);
+	void encode(Pose const &pose, unsigned int timeMs, std::string &out);
+	void encode(PointsCleaned const &event, unsigned int timeMs, std::string &out);
+	void encode(Trial const &event, unsigned int timeMs, std::string &out);
+
+	// Text log formatting: event name, tab, time, tab, then the event's key:"value" fields separated by semicolons
+	std::string formatTime(unsigned int timeMs); // HH:MM:SS.mmm
+	std::string format(Pose const &pose, std::string const &time);
+	std::string format(PointsCleaned const &event, std::string const &time);
+	std::string format(PointCleaned const &event, std::string const &time);
+	std::string format(Trial const &event, std::string const &time);
+
+	// Regenerates the text log from a binary log. Returns false if the input cannot be read or is not an event log;
+	// a truncated final record (e.g. after a crash) ends the conversion with a warning.
+	bool convertToText(std::string binaryLogName, std::string textLogName);
+}
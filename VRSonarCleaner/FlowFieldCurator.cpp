@@ -7,11 +7,12 @@
 
 using namespace std::chrono_literals;
 
-FlowFieldCurator::FlowFieldCurator(TrackedDeviceManager* pTDM, FlowVolume* flowVol, int gridRes)
+FlowFieldCurator::FlowFieldCurator(TrackedDeviceManager* pTDM, FlowVolume* flowVol, int gridRes, bool quantize)
 	: m_pTDM(pTDM)
 	, m_pFlowVolume(flowVol)
 	, m_pvec3MovingPt(NULL)
 	, m_iGridRes(gridRes)
+	, m_bQuantize(quantize)
 	, m_mat4CPOffsetTransform(glm::translate(glm::mat4(), glm::vec3(1.f)) * glm::scale(glm::mat4(), glm::vec3(static_cast<float>(gridRes - 1) / 2.f)) * glm::translate(glm::mat4(), glm::vec3(1.f)))
 	, m_mat4CPOffsetTransformInv(glm::inverse(m_mat4CPOffsetTransform))
 {
@@ -149,7 +150,7 @@ bool FlowFieldCurator::loadRandomFlowGrid()
 
 	if (m_pVFG->save("flowgrid_test.fg", false))
 	{
-		m_pFlowVolume->addFlowGrid("flowgrid_test.fg", true);
+		m_pFlowVolume->addFlowGrid("flowgrid_test.fg", true, true, m_bQuantize);
 		loadMetaFile("flowgrid_test.fg.cp");
 
 		return true;
@@ -182,7 +183,7 @@ bool FlowFieldCurator::loadFlowGridFromCurrentCPs()
 
 	if (system(ss.str().c_str()) == EXIT_SUCCESS)
 	{
-		m_pFlowVolume->addFlowGrid("flowgrid_test.fg", true);
+		m_pFlowVolume->addFlowGrid("flowgrid_test.fg", true, true, m_bQuantize);
 		loadMetaFile("flowgrid_test.fg.cp");
 
 		return true;
@@ -9,7 +9,8 @@ class FlowFieldCurator :
 	public BehaviorBase
 {
 public:
-	FlowFieldCurator(TrackedDeviceManager* pTDM, FlowVolume* flowVol, int gridRes = 32);
+	// If quantize is set, the generated grids are stored as 16-bit cells
+	FlowFieldCurator(TrackedDeviceManager* pTDM, FlowVolume* flowVol, int gridRes = 32, bool quantize = false);
 	~FlowFieldCurator();
 
 	void update();
@@ -41,6 +42,7 @@ private:
 	glm::vec3 m_vec3ControllerToMovingPt;
 
 	int m_iGridRes;
+	bool m_bQuantize;
 
 private:
 	bool loadRandomFlowGrid();
@@ -1,12 +1,86 @@
 #include "FlowGrid.h"
 
+#include <future>
+#include <thread>
+#include <limits>
+#ifdef FLOWGRID_SIMD
+#include <emmintrin.h>
+#endif
+
 using namespace std::chrono_literals;
 
-FlowGrid::FlowGrid(const char* filename, bool useZInsteadOfDepth)
+namespace
+{
+	// Timestep file: this header, then the cell records (isWater, u, v, w) of each timestep in turn, x-outermost
+	// and z-innermost as in flowgrid files. The magic number is written last, so an incomplete file is rewritten.
+	struct TimestepFileHeader {
+		unsigned int magic;
+		unsigned int version;
+		int xCells, yCells, zCells, timesteps;
+		long long sourceBytes;
+		float minValues[4];		// range of u, v, w and |velocity| over all cells
+		float maxValues[4];
+	};
+
+	size_t const TIMESTEP_RECORD_BYTES = sizeof(int) + 3u * sizeof(float);
+
+#ifdef FLOWGRID_SIMD
+	inline __m128 loadCell(glm::vec4 const &cell)
+	{
+		return _mm_loadu_ps(&cell.x);
+	}
+
+	inline __m128 loadCell(glm::i16vec4 const &cell)
+	{
+		// sign-extends the int16 components to int32 by unpacking each into the upper half and shifting it down
+		__m128i packed = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(&cell));
+		return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(packed, packed), 16));
+	}
+
+	inline __m128 loadVec3(glm::vec3 const &v)
+	{
+		return _mm_setr_ps(v.x, v.y, v.z, 0.f);
+	}
+
+	inline glm::vec3 storeVec3(__m128 v)
+	{
+		alignas(16) float f[4];
+		_mm_store_ps(f, v);
+		return glm::vec3(f[0], f[1], f[2]);
+	}
+
+	// Sums the water corners of a cell weighted by weights, in the same order as the scalar sampler, and returns
+	// the total weight of those corners (1 if all are water)
+	template <typename CellType>
+	float sumWaterCorners(CellType const *cells, size_t const *offsets, float const *weights, unsigned int waterCorners, glm::vec3 &sum)
+	{
+		__m128 acc = _mm_setzero_ps();
+		float total = 0.f;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			if (!(waterCorners & (1u << corner)))
+				continue;
+
+			acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weights[corner]), loadCell(cells[offsets[corner]])));
+			total += weights[corner];
+		}
+
+		sum = storeVec3(acc);
+		return waterCorners == 0xFFu ? 1.f : total;
+	}
+#endif
+}
+
+FlowGrid::FlowGrid(const char* filename, bool useZInsteadOfDepth, int streamLookahead, bool quantize)
 	: Dataset(filename)
 	, m_fMinTime(-1.f)
 	, m_fMaxTime(-1.f)
 	, m_bUsesZInsteadOfDepth(useZInsteadOfDepth)
+	, m_bQuantize(quantize)
+	, m_nStreamSlots(0)
+	, m_iStreamWindowStart(0)
+	, m_bStreamStop(false)
+	, m_nStreamStalls(0)
 {
 	FILE *inputFile;
 	printf("opening: %s\n", filename);
@@ -41,6 +115,18 @@ FlowGrid::FlowGrid(const char* filename, bool useZInsteadOfDepth)
 	checkNewPosition(glm::dvec3(m_fXMin, m_fYMin, m_fZMin));
 	checkNewPosition(glm::dvec3(m_fXMax, m_fYMax, m_fZMax));
 
+	//streaming only pays off if some timesteps can stay on disk
+	glm::vec4 streamMinValues, streamMaxValues;
+	if (streamLookahead >= 0 && streamLookahead + 2 < m_nTimesteps)
+	{
+		long long cellsOffset = _ftelli64(inputFile) + static_cast<long long>(m_nZCells + m_nTimesteps) * sizeof(float);
+
+		if (openTimestepFile(filename, cellsOffset, true, m_bUsesZInsteadOfDepth, &streamMinValues, &streamMaxValues))
+			m_nStreamSlots = streamLookahead + 2;
+		else
+			printf("WARNING: unable to stream flowgrid %s, loading all timesteps\n", filename);
+	}
+
 	init();
 
 	float tempDepth;
@@ -49,6 +135,7 @@ FlowGrid::FlowGrid(const char* filename, bool useZInsteadOfDepth)
 		fread(&tempDepth, sizeof(float), 1, inputFile);
 		setDepthValue(i, tempDepth);
 	}
+	updateDepthLookup();
 
 	float tempTime;
 	for (int i = 0; i < m_nTimesteps; i++)
@@ -57,49 +144,40 @@ FlowGrid::FlowGrid(const char* filename, bool useZInsteadOfDepth)
 		setTimeValue(i, tempTime);
 	}
 
-	int index4d;
-	int tempIsWater;
-	float tempU, tempV, tempW;
-	for (int x = 0; x<m_nXCells; x++)
+	if (m_nStreamSlots > 0)
 	{
-		for (int y = 0; y<m_nYCells; y++)
-		{
-			for (int z = 0; z<m_nZCells; z++)
-			{
-				for (int t = 0; t<m_nTimesteps; t++)
-				{
-					index4d = (t*m_nXYZCells) + (z*m_nXYCells) + (y*m_nXCells) + x;
-					fread(&tempIsWater, sizeof(int), 1, inputFile);
-					fread(&tempU, sizeof(float), 1, inputFile);
-					fread(&tempV, sizeof(float), 1, inputFile);
-					if (m_bUsesZInsteadOfDepth)
-					{
-						fread(&tempW, sizeof(float), 1, inputFile);
-						setIsWaterValue(x, y, z, t, tempIsWater == 0 ? false : true);
-						setCellValue(x, y, z, t, tempU, tempV, tempW);
-					}
-					else
-					{
-						tempW = 0.f;
-						setIsWaterValue(x, y, z, t, tempIsWater == 0 ? false : true);
-						setCellValue(x, y, z, t, tempU, tempV, tempW);
-					}
+		m_fMaxVelocity = streamMaxValues.w;
 
+		//timesteps are quantized as they are read, so the range has to be known up front
+		if (m_bQuantize)
+			setQuantizationRange(streamMinValues, streamMaxValues);
 
-				}//end for z
-			}//end for z
-		}//end for y
-	}//end for x
+		//start out with the first timesteps resident
+		m_StreamThread = std::thread(&FlowGrid::streamThread, this);
+
+		std::unique_lock<std::mutex> lock(m_StreamMutex);
+		m_cvStreamRead.wait(lock, [this] { return isResident(m_nStreamSlots - 1) || m_bStreamStop; });
+	}
+	else
+	{
+		loadCells(inputFile, true, m_bUsesZInsteadOfDepth);
+
+		if (m_bQuantize)
+			quantizeCells();
+	}
 
 	fclose(inputFile);
 
 	m_bLoaded = true;
 
-	printf("Imported FlowGrid from %s\n", filename);
+	if (m_nStreamSlots > 0)
+		printf("Streaming FlowGrid from %s, %d of %d timesteps resident\n", filename, m_nStreamSlots, m_nTimesteps);
+	else
+		printf("Imported FlowGrid from %s\n", filename);
 
 }//end file loading constructor
 
-FlowGrid::FlowGrid(const char * filename, float xMin, float xMax, int xCount, float yMin, float yMax, int yCount, float zMin, float zMax, int zCount)
+FlowGrid::FlowGrid(const char * filename, float xMin, float xMax, int xCount, float yMin, float yMax, int yCount, float zMin, float zMax, int zCount, bool quantize)
 	: Dataset(filename)
 	, m_fMinTime(-1.f)
 	, m_fMaxTime(-1.f)
@@ -114,6 +192,11 @@ FlowGrid::FlowGrid(const char * filename, float xMin, float xMax, int xCount, fl
 	, m_fZMax(zMax)
 	, m_nZCells(zCount)
 	, m_nTimesteps(1)
+	, m_bQuantize(quantize)
+	, m_nStreamSlots(0)
+	, m_iStreamWindowStart(0)
+	, m_bStreamStop(false)
+	, m_nStreamStalls(0)
 {
 	FILE *inputFile;
 	printf("Opening binary file as flowgrid: %s\n", filename);
@@ -135,49 +218,551 @@ FlowGrid::FlowGrid(const char * filename, float xMin, float xMax, int xCount, fl
 
 	for (int i = 0; i < m_nZCells; i++)
 		setDepthValue(i, static_cast<float>(i) * m_fZCellSize);
+	updateDepthLookup();
 
 	for (int i = 0; i < m_nTimesteps; i++)
 	{
 		setTimeValue(i, 1.f);
 	}
 
-	int index4d;
-	float tempU, tempV, tempW;
-	for (int x = 0; x < m_nXCells; x++)
+	loadCells(inputFile, false, true);
+
+	if (m_bQuantize)
+		quantizeCells();
+
+	fclose(inputFile);
+
+	m_bLoaded = true;
+
+	printf("Imported FlowGrid from binary file %s\n", filename);
+}
+
+void FlowGrid::loadCells(FILE *file, bool hasIsWater, bool hasW)
+{
+	size_t recordSize = ((hasIsWater ? 1u : 0u) + 2u + (hasW ? 1u : 0u)) * sizeof(float);
+	size_t slabBytes = static_cast<size_t>(m_nYCells) * m_nZCells * m_nTimesteps * recordSize;
+
+	if (slabBytes == 0u || m_nXCells <= 0)
+		return;
+
+	int slabsPerChunk = static_cast<int>((std::min)(static_cast<size_t>(m_nXCells), (std::max)(FLOWGRID_LOAD_CHUNK_BYTES / slabBytes, static_cast<size_t>(1u))));
+
+	// one chunk is transposed while the next one is read
+	std::vector<char> chunks[2];
+
+	auto readChunk = [file, slabBytes](std::vector<char> *chunk, int nSlabs) -> size_t {
+		chunk->resize(nSlabs * slabBytes);
+		return fread(chunk->data(), 1, chunk->size(), file);
+	};
+
+	unsigned int nThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+	int rowsPerThread = (m_nYCells + nThreads - 1) / nThreads;
+
+	std::future<size_t> pendingRead = std::async(std::launch::async, readChunk, &chunks[0], slabsPerChunk);
+	bool truncated = false;
+
+	for (int x0 = 0, i = 0; x0 < m_nXCells; x0 += slabsPerChunk, ++i)
 	{
-		for (int y = 0; y < m_nYCells; y++)
+		std::vector<char> &chunk = chunks[i & 1];
+		int nSlabs = (std::min)(slabsPerChunk, m_nXCells - x0);
+
+		size_t nRead = pendingRead.get();
+		if (nRead < chunk.size())
 		{
-			for (int z = 0; z < m_nZCells; z++)
+			if (!truncated)
+				printf("WARNING: flowgrid file ends early, missing cells are set to zero\n");
+			truncated = true;
+			//a partly read record counts as missing
+			nRead -= nRead % recordSize;
+			memset(chunk.data() + nRead, 0, chunk.size() - nRead);
+		}
+
+		if (x0 + nSlabs < m_nXCells)
+			pendingRead = std::async(std::launch::async, readChunk, &chunks[(i + 1) & 1], (std::min)(slabsPerChunk, m_nXCells - x0 - nSlabs));
+
+		std::vector<std::future<float>> futures;
+		for (int y0 = 0; y0 < m_nYCells; y0 += rowsPerThread)
+			futures.push_back(std::async(std::launch::async, &FlowGrid::transposeCells, this, chunk.data(), x0, nSlabs, y0, (std::min)(y0 + rowsPerThread, m_nYCells), hasIsWater, hasW, 0, m_nTimesteps));
+
+		for (auto &f : futures)
+			m_fMaxVelocity = (std::max)(m_fMaxVelocity, f.get());
+	}
+}
+
+float FlowGrid::transposeCells(char const *records, int x0, int nSlabs, int yBegin, int yEnd, bool hasIsWater, bool hasW, int firstTimestep, int nTimesteps)
+{
+	size_t recordSize = ((hasIsWater ? 1u : 0u) + 2u + (hasW ? 1u : 0u)) * sizeof(float);
+	size_t slabRecords = static_cast<size_t>(m_nYCells) * m_nZCells * nTimesteps;
+
+	float maxVelocity = 0.f;
+
+	for (int y = yBegin; y < yEnd; ++y)
+	{
+		for (int xb = 0; xb < nSlabs; xb += FLOWGRID_TRANSPOSE_BLOCK)
+		{
+			int xbEnd = (std::min)(xb + FLOWGRID_TRANSPOSE_BLOCK, nSlabs);
+
+			for (int z = 0; z < m_nZCells; ++z)
 			{
-				for (int t = 0; t < m_nTimesteps; t++)
+				for (int t = 0; t < nTimesteps; ++t)
 				{
-					index4d = (t*m_nXYZCells) + (z*m_nXYCells) + (y*m_nXCells) + x;
-					fread(&tempU, sizeof(float), 1, inputFile);
-					fread(&tempV, sizeof(float), 1, inputFile);
-					fread(&tempW, sizeof(float), 1, inputFile);
-					setIsWaterValue(x, y, z, t, true);
-					setCellValue(x, y, z, t, tempU, tempV, tempW);
-				}//end for z
-			}//end for z
-		}//end for y
-	}//end for x
+					// record of cell (x, y, z, t) within its x slab
+					size_t srcRecord = (static_cast<size_t>(y) * m_nZCells + z) * nTimesteps + t;
+					size_t dst = getCellIndex(x0, y, z, firstTimestep + t);
+					size_t waterRow = getWaterMaskWord(0, y, z, firstTimestep + t);
 
-	fclose(inputFile);
+					for (int x = xb; x < xbEnd; ++x)
+					{
+						char const *rec = records + (x * slabRecords + srcRecord) * recordSize;
 
-	m_bLoaded = true;
+						int isWater = 1;
+						if (hasIsWater)
+						{
+							memcpy(&isWater, rec, sizeof(int));
+							rec += sizeof(int);
+						}
 
-	printf("Imported FlowGrid from binary file %s\n", filename);
+						float uvw[3] = { 0.f, 0.f, 0.f };
+						memcpy(uvw, rec, (hasW ? 3u : 2u) * sizeof(float));
+
+						float velocity = sqrt(uvw[0] * uvw[0] + uvw[1] * uvw[1] + uvw[2] * uvw[2]);
+
+						setCell(dst + x, glm::vec4(uvw[0], uvw[1], uvw[2], velocity));
+
+						// the mask starts out cleared and rows are owned by one thread each
+						if (isWater != 0)
+							m_vuiWaterMask[waterRow + ((x0 + x) >> 5)] |= 1u << ((x0 + x) & 31);
+
+						if (velocity > maxVelocity)
+							maxVelocity = velocity;
+					}
+				}
+			}
+		}
+	}
+
+	return maxVelocity;
 }
 
 FlowGrid::~FlowGrid()
 {
+	if (m_StreamThread.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_StreamMutex);
+			m_bStreamStop = true;
+		}
+		m_cvStreamRequest.notify_all();
+		m_StreamThread.join();
+	}
+}
+
+bool FlowGrid::openTimestepFile(const char* filename, long long cellsOffset, bool hasIsWater, bool hasW, glm::vec4 *minValues, glm::vec4 *maxValues)
+{
+	m_strTimestepFile = std::string(filename) + ".tsteps";
+
+	FILE *source = fopen(filename, "rb");
+	if (source == NULL)
+		return false;
+	_fseeki64(source, 0, SEEK_END);
+	long long sourceBytes = _ftelli64(source);
+	fclose(source);
+
+	long long expectedBytes = static_cast<long long>(sizeof(TimestepFileHeader)) + static_cast<long long>(m_nXCells) * m_nYCells * m_nZCells * m_nTimesteps * TIMESTEP_RECORD_BYTES;
+
+	FILE *file = fopen(m_strTimestepFile.c_str(), "rb");
+	if (file)
+	{
+		TimestepFileHeader header;
+		bool valid = fread(&header, sizeof(header), 1, file) == 1;
+
+		_fseeki64(file, 0, SEEK_END);
+		valid = valid && _ftelli64(file) == expectedBytes;
+		fclose(file);
+
+		if (valid && header.magic == FLOWGRID_TIMESTEP_FILE_MAGIC && header.version == FLOWGRID_TIMESTEP_FILE_VERSION &&
+			header.xCells == m_nXCells && header.yCells == m_nYCells && header.zCells == m_nZCells && header.timesteps == m_nTimesteps &&
+			header.sourceBytes == sourceBytes)
+		{
+			*minValues = glm::vec4(header.minValues[0], header.minValues[1], header.minValues[2], header.minValues[3]);
+			*maxValues = glm::vec4(header.maxValues[0], header.maxValues[1], header.maxValues[2], header.maxValues[3]);
+			return true;
+		}
+	}
+
+	printf("Writing flowgrid timestep file %s\n", m_strTimestepFile.c_str());
+
+	return writeTimestepFile(filename, cellsOffset, hasIsWater, hasW, sourceBytes, minValues, maxValues);
+}
+
+bool FlowGrid::writeTimestepFile(const char* filename, long long cellsOffset, bool hasIsWater, bool hasW, long long sourceBytes, glm::vec4 *minValues, glm::vec4 *maxValues)
+{
+	FILE *source = fopen(filename, "rb");
+	if (source == NULL)
+		return false;
+
+	FILE *file = fopen(m_strTimestepFile.c_str(), "wb");
+	if (file == NULL)
+	{
+		fclose(source);
+		return false;
+	}
+
+	TimestepFileHeader header;
+	memset(&header, 0, sizeof(header));
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && _fseeki64(source, cellsOffset, SEEK_SET) == 0;
+
+	size_t recordSize = ((hasIsWater ? 1u : 0u) + 2u + (hasW ? 1u : 0u)) * sizeof(float);
+	size_t slabCells = static_cast<size_t>(m_nYCells) * m_nZCells;
+	size_t slabBytes = slabCells * m_nTimesteps * recordSize;
+	long long timestepBytes = static_cast<long long>(m_nXCells) * slabCells * TIMESTEP_RECORD_BYTES;
+
+	int slabsPerChunk = static_cast<int>((std::min)(static_cast<size_t>(m_nXCells), (std::max)(FLOWGRID_LOAD_CHUNK_BYTES / (std::max)(slabBytes, static_cast<size_t>(1u)), static_cast<size_t>(1u))));
+
+	std::vector<char> chunk, timestepRecords;
+	glm::vec4 minCell(std::numeric_limits<float>::max());
+	glm::vec4 maxCell(-std::numeric_limits<float>::max());
+	bool truncated = false;
+
+	// each chunk of x slabs holds a contiguous part of every timestep
+	for (int x0 = 0; ok && x0 < m_nXCells; x0 += slabsPerChunk)
+	{
+		int nSlabs = (std::min)(slabsPerChunk, m_nXCells - x0);
+		size_t nCells = nSlabs * slabCells;
+
+		chunk.resize(nSlabs * slabBytes);
+		size_t nRead = fread(chunk.data(), 1, chunk.size(), source);
+		if (nRead < chunk.size())
+		{
+			if (!truncated)
+				printf("WARNING: flowgrid file ends early, missing cells are set to zero\n");
+			truncated = true;
+			//a partly read record counts as missing
+			nRead -= nRead % recordSize;
+			memset(chunk.data() + nRead, 0, chunk.size() - nRead);
+		}
+
+		timestepRecords.resize(nCells * m_nTimesteps * TIMESTEP_RECORD_BYTES);
+
+		for (size_t c = 0u; c < nCells; ++c)
+		{
+			for (int t = 0; t < m_nTimesteps; ++t)
+			{
+				char const *rec = chunk.data() + (c * m_nTimesteps + t) * recordSize;
+
+				int isWater = 1;
+				if (hasIsWater)
+				{
+					memcpy(&isWater, rec, sizeof(int));
+					rec += sizeof(int);
+				}
+
+				float uvw[3] = { 0.f, 0.f, 0.f };
+				memcpy(uvw, rec, (hasW ? 3u : 2u) * sizeof(float));
+
+				glm::vec4 cell(uvw[0], uvw[1], uvw[2], sqrt(uvw[0] * uvw[0] + uvw[1] * uvw[1] + uvw[2] * uvw[2]));
+				minCell = glm::min(minCell, cell);
+				maxCell = glm::max(maxCell, cell);
+
+				char *dst = timestepRecords.data() + (t * nCells + c) * TIMESTEP_RECORD_BYTES;
+				memcpy(dst, &isWater, sizeof(int));
+				memcpy(dst + sizeof(int), uvw, sizeof(uvw));
+			}
+		}
+
+		for (int t = 0; ok && t < m_nTimesteps; ++t)
+		{
+			long long offset = static_cast<long long>(sizeof(header)) + t * timestepBytes + static_cast<long long>(x0) * slabCells * TIMESTEP_RECORD_BYTES;
+
+			ok = _fseeki64(file, offset, SEEK_SET) == 0 &&
+				fwrite(timestepRecords.data() + t * nCells * TIMESTEP_RECORD_BYTES, TIMESTEP_RECORD_BYTES, nCells, file) == nCells;
+		}
+	}
+
+	if (ok)
+	{
+		header.magic = FLOWGRID_TIMESTEP_FILE_MAGIC;
+		header.version = FLOWGRID_TIMESTEP_FILE_VERSION;
+		header.xCells = m_nXCells;
+		header.yCells = m_nYCells;
+		header.zCells = m_nZCells;
+		header.timesteps = m_nTimesteps;
+		header.sourceBytes = sourceBytes;
+		for (int i = 0; i < 4; i++)
+		{
+			header.minValues[i] = minCell[i];
+			header.maxValues[i] = maxCell[i];
+		}
+
+		ok = _fseeki64(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+	}
+
+	fclose(source);
+	ok = fclose(file) == 0 && ok;
+
+	if (!ok)
+	{
+		printf("Unable to write flowgrid timestep file %s!\n", m_strTimestepFile.c_str());
+		remove(m_strTimestepFile.c_str());
+		return false;
+	}
+
+	*minValues = minCell;
+	*maxValues = maxCell;
+
+	return true;
+}
+
+void FlowGrid::readTimestep(FILE *file, int t, std::vector<char> &buffer)
+{
+	size_t timestepBytes = static_cast<size_t>(m_nXYZCells) * TIMESTEP_RECORD_BYTES;
+	long long offset = static_cast<long long>(sizeof(TimestepFileHeader)) + t * static_cast<long long>(timestepBytes);
+
+	buffer.resize(timestepBytes);
+
+	size_t nRead = _fseeki64(file, offset, SEEK_SET) == 0 ? fread(buffer.data(), 1, timestepBytes, file) : 0u;
+	if (nRead < timestepBytes)
+	{
+		printf("WARNING: flowgrid timestep file %s ends early, missing cells are set to zero\n", m_strTimestepFile.c_str());
+		memset(buffer.data() + nRead, 0, timestepBytes - nRead);
+	}
+
+	size_t maskWords = static_cast<size_t>(m_nZCells) * m_nYCells * m_nWaterMaskRowWords;
+	std::fill_n(m_vuiWaterMask.begin() + getSlot(t) * maskWords, maskWords, 0u);
+
+	unsigned int nThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+	int rowsPerThread = (m_nYCells + nThreads - 1) / nThreads;
+
+	std::vector<std::future<float>> futures;
+	for (int y0 = 0; y0 < m_nYCells; y0 += rowsPerThread)
+		futures.push_back(std::async(std::launch::async, &FlowGrid::transposeCells, this, buffer.data(), 0, m_nXCells, y0, (std::min)(y0 + rowsPerThread, m_nYCells), true, true, t, 1));
+
+	for (auto &f : futures)
+		f.get();
+}
+
+void FlowGrid::streamThread()
+{
+	FILE *file = fopen(m_strTimestepFile.c_str(), "rb");
+	std::vector<char> buffer;
+
+	std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+	if (file == NULL)
+	{
+		printf("Unable to open flowgrid timestep file %s!\n", m_strTimestepFile.c_str());
+		m_bStreamStop = true;
+		m_cvStreamRead.notify_all();
+		return;
+	}
+
+	while (!m_bStreamStop)
+	{
+		//playback loops, so past the last timestep the window wraps around to the first ones
+		auto inWindow = [this](int t) { return (t - m_iStreamWindowStart + m_nTimesteps) % m_nTimesteps < m_nStreamSlots; };
+
+		//first timestep of the window that isn't resident, in playback order
+		int next = -1;
+		for (int i = 0; i < m_nStreamSlots && next < 0; i++)
+		{
+			int t = (m_iStreamWindowStart + i) % m_nTimesteps;
+			if (!isResident(t))
+				next = t;
+		}
+
+		if (next < 0)
+		{
+			m_cvStreamRequest.wait(lock);
+			continue;
+		}
+
+		//the window has as many timesteps as there are slots, so with one of them missing a slot is empty or holds
+		//a timestep outside the window. Mark it as being replaced before overwriting it.
+		int replaced = 0;
+		while (m_pSlotTimesteps[replaced] >= 0 && inWindow(m_pSlotTimesteps[replaced]))
+			replaced++;
+
+		std::atomic<int> &slot = m_pSlotTimesteps[replaced];
+		int evicted = slot.load(std::memory_order_relaxed);
+		slot.store(-1);
+
+		lock.unlock();
+
+		//samplers that counted themselves in on the slot before it was marked finish reading it first, still
+		//finding the evicted timestep in it
+		while (m_pSlotReaders[replaced].load() > 0)
+			std::this_thread::yield();
+
+		if (evicted >= 0)
+			m_pTimestepSlots[evicted].store(-1);
+		m_pTimestepSlots[next].store(replaced);
+
+		readTimestep(file, next, buffer);
+		lock.lock();
+
+		slot.store(next, std::memory_order_release);
+		m_cvStreamRead.notify_all();
+	}
+
+	fclose(file);
+}
+
+void FlowGrid::updateStream(float time)
+{
+	if (m_nStreamSlots == 0)
+		return;
+
+	TimeBracket bracket = getTimeBracket(time);
+
+	std::unique_lock<std::mutex> lock(m_StreamMutex);
+
+	if (bracket.t1 != m_iStreamWindowStart)
+	{
+		m_iStreamWindowStart = bracket.t1;
+		m_cvStreamRequest.notify_all();
+	}
+
+	if (!isResident(bracket))
+	{
+		m_nStreamStalls++;
+		m_cvStreamRead.wait(lock, [this, &bracket] { return isResident(bracket) || m_bStreamStop; });
+	}
+}
+
+bool FlowGrid::isStreaming() const
+{
+	return m_nStreamSlots > 0;
+}
+
+bool FlowGrid::isQuantized() const
+{
+	return m_vQuantizedCells.size() > 0u;
+}
+
+int FlowGrid::getStreamStalls() const
+{
+	return m_nStreamStalls;
+}
+
+size_t FlowGrid::getResidentBytes() const
+{
+	return m_vCells.capacity() * sizeof(glm::vec4) + m_vQuantizedCells.capacity() * sizeof(glm::i16vec4) + m_vuiWaterMask.capacity() * sizeof(unsigned int);
+}
+
+void FlowGrid::setQuantizationRange(glm::vec4 const &minValues, glm::vec4 const &maxValues)
+{
+	m_vec4QuantizeOffset = (minValues + maxValues) * 0.5f;
+	m_vec4QuantizeScale = (maxValues - minValues) / 65534.f;
+
+	//a constant component only needs the offset
+	for (int i = 0; i < 4; i++)
+	{
+		if (!(m_vec4QuantizeScale[i] > 0.f))
+			m_vec4QuantizeScale[i] = 1.f;
+	}
+}
+
+void FlowGrid::quantizeCells()
+{
+	if (m_vCells.empty())
+		return;
+
+	glm::vec4 minCell(std::numeric_limits<float>::max());
+	glm::vec4 maxCell(-std::numeric_limits<float>::max());
+	for (auto const &cell : m_vCells)
+	{
+		minCell = glm::min(minCell, cell);
+		maxCell = glm::max(maxCell, cell);
+	}
+
+	setQuantizationRange(minCell, maxCell);
+
+	m_vQuantizedCells.resize(m_vCells.size());
+	for (size_t i = 0u; i < m_vCells.size(); ++i)
+		setCell(i, m_vCells[i]);
+
+	std::vector<glm::vec4>().swap(m_vCells);
+}
+
+glm::vec4 FlowGrid::getCell(size_t index) const
+{
+	if (m_vQuantizedCells.empty())
+		return m_vCells[index];
+	else
+		return m_vec4QuantizeOffset + m_vec4QuantizeScale * glm::vec4(m_vQuantizedCells[index]);
+}
+
+void FlowGrid::setCell(size_t index, glm::vec4 const &cell)
+{
+	if (m_vQuantizedCells.empty())
+		m_vCells[index] = cell;
+	else
+		m_vQuantizedCells[index] = glm::i16vec4(glm::clamp(glm::round((cell - m_vec4QuantizeOffset) / m_vec4QuantizeScale), glm::vec4(-32767.f), glm::vec4(32767.f)));
+}
+
+int FlowGrid::getSlot(int t) const
+{
+	if (m_nStreamSlots == 0)
+		return t;
+
+	//any slot will do for a timestep that isn't resident, samplers have failed on it before reading
+	int slot = m_pTimestepSlots[t].load(std::memory_order_acquire);
+	return slot >= 0 ? slot : 0;
+}
+
+bool FlowGrid::isResident(int t) const
+{
+	if (m_nStreamSlots == 0)
+		return true;
+
+	int slot = m_pTimestepSlots[t].load(std::memory_order_acquire);
+	return slot >= 0 && m_pSlotTimesteps[slot].load(std::memory_order_acquire) == t;
+}
+
+bool FlowGrid::isResident(TimeBracket const &bracket) const
+{
+	return isResident(bracket.t1) && isResident(bracket.t2);
+}
+
+FlowGrid::ReadScope::ReadScope(FlowGrid const &grid, int t1, int t2)
+	: m_Grid(grid)
+	, m_bResident(true)
+{
+	m_iSlots[0] = m_iSlots[1] = -1;
+
+	if (grid.m_nStreamSlots == 0)
+		return;
 
+	int timesteps[2] = { t1, t2 };
+	for (int i = 0; i < (t2 != t1 ? 2 : 1) && m_bResident; i++)
+	{
+		int slot = grid.m_pTimestepSlots[timesteps[i]].load();
+		if (slot < 0)
+		{
+			m_bResident = false;
+			break;
+		}
+
+		//counted in before checking, see streamThread()
+		grid.m_pSlotReaders[slot]++;
+		m_iSlots[i] = slot;
+		m_bResident = grid.m_pSlotTimesteps[slot].load() == timesteps[i];
+	}
+}
+
+FlowGrid::ReadScope::~ReadScope()
+{
+	for (int i = 0; i < 2; i++)
+	{
+		if (m_iSlots[i] >= 0)
+			m_Grid.m_pSlotReaders[m_iSlots[i]].fetch_sub(1, std::memory_order_release);
+	}
 }
 
 void FlowGrid::init()
 {
 	m_nActiveTimestep = -1;
-	m_arrfTimes = new float[m_nTimesteps];
+	m_vfTimes.resize(m_nTimesteps);
 	m_nGridSize2d = m_nXCells * m_nYCells;
 	m_nGridSize3d = m_nXCells * m_nYCells * m_nZCells;
 	m_nGridSize4d = m_nXCells * m_nYCells * m_nZCells * m_nTimesteps;
@@ -191,6 +776,7 @@ void FlowGrid::init()
 	m_fZRange = glm::abs(m_fZMax - m_fZMin);
 	m_vDepthValues.resize(m_nZCells);
 	m_bDepthsSet = false;
+	m_bDepthsDescending = false;
 
 	m_fXCellSize = m_fXRange / m_fXCells;
 	m_fYCellSize = m_fYRange / m_fYCells;
@@ -198,21 +784,44 @@ void FlowGrid::init()
 	
 	m_fMaxVelocity = 0;
 
-	//allocate storage arrays
-	m_arrbIsWater = new bool[m_nGridSize4d];
+	//allocate storage arrays, only for the resident timesteps when streaming
+	int nStoredTimesteps = m_nStreamSlots > 0 ? m_nStreamSlots : m_nTimesteps;
+
+	m_nWaterMaskRowWords = (m_nXCells + 31) / 32;
+	m_vuiWaterMask.assign(static_cast<size_t>(m_nYCells) * m_nZCells * nStoredTimesteps * m_nWaterMaskRowWords, 0u);
 	//bathyDepth2d = new float[gridSize2d];
 
-	m_arrfUValues = new float[m_nGridSize4d];
-	m_arrfVValues = new float[m_nGridSize4d];
-	m_arrfWValues = new float[m_nGridSize4d];
-	m_arrfVelocityValues = new float[m_nGridSize4d];
+	m_vec4QuantizeOffset = glm::vec4(0.f);
+	m_vec4QuantizeScale = glm::vec4(1.f);
+
+	//streamed timesteps are quantized as they are read, loaded cells once they are all in
+	if (m_bQuantize && m_nStreamSlots > 0)
+		m_vQuantizedCells.resize(static_cast<size_t>(m_nXYZCells) * nStoredTimesteps);
+	else
+		m_vCells.resize(static_cast<size_t>(m_nXYZCells) * nStoredTimesteps);
+
+	if (m_nStreamSlots > 0)
+	{
+		m_pSlotTimesteps.reset(new std::atomic<int>[m_nStreamSlots]);
+		for (int i = 0; i < m_nStreamSlots; i++)
+			m_pSlotTimesteps[i] = -1;
+
+		m_pTimestepSlots.reset(new std::atomic<int>[m_nTimesteps]);
+		for (int i = 0; i < m_nTimesteps; i++)
+			m_pTimestepSlots[i] = -1;
+
+		m_pSlotReaders.reset(new std::atomic<int>[m_nStreamSlots]);
+		for (int i = 0; i < m_nStreamSlots; i++)
+			m_pSlotReaders[i] = 0;
+	}
 	//tValues = new float[m_nGridSize4d];
 	//sValues = new float[m_nGridSize4d];
 
-	m_fLastTimeRequested = -1.f;
+	m_bUseSIMD = true;
 
 	m_bIllustrativeParticlesEnabled = true;
 	m_nIllustrativeParticles = 10000;
+	m_nActiveIllustrativeParticles = 0;
 	m_fIllustrativeParticleTrailTime = 500ms;
 	m_fIllustrativeParticleLifetime = 2500ms;
 	m_fIllustrativeParticleSize = 1.f;
@@ -221,18 +830,14 @@ void FlowGrid::init()
 	m_fIllustrativeParticleVelocityScale = 0.001f;//0.000001;
 }
 
-void FlowGrid::deleteSelf()
+size_t FlowGrid::getCellIndex(int x, int y, int z, int t) const
 {
-	delete[] m_arrfTimes;
-	delete[] m_arrbIsWater;
-	//delete[] bathyDepth2d;
-	delete[] m_arrfUValues;
-	delete[] m_arrfVValues;
-	delete[] m_arrfWValues;
-	delete[] m_arrfVelocityValues;
-	//delete[] tValues;
-	//delete[] sValues;
+	return static_cast<size_t>(getSlot(t)) * m_nXYZCells + static_cast<size_t>(z) * m_nXYCells + static_cast<size_t>(y) * m_nXCells + x;
+}
 
+size_t FlowGrid::getWaterMaskWord(int x, int y, int z, int t) const
+{
+	return ((static_cast<size_t>(getSlot(t)) * m_nZCells + z) * m_nYCells + y) * m_nWaterMaskRowWords + (x >> 5);
 }
 
 void FlowGrid::setDepthValue(int depthIndex, float depth)
@@ -240,6 +845,71 @@ void FlowGrid::setDepthValue(int depthIndex, float depth)
 	m_vDepthValues[depthIndex] = depth;
 }
 
+void FlowGrid::updateDepthLookup()
+{
+	int nLevels = static_cast<int>(m_vDepthValues.size());
+
+	m_bDepthsDescending = nLevels > 1 && m_vDepthValues.back() < m_vDepthValues.front();
+	m_vfSortedDepths = m_vDepthValues;
+
+	m_viDepthBucketLevels.clear();
+	m_fDepthBucketsPerUnit = 0.f;
+
+	if (nLevels < 2 || m_bDepthsDescending)
+		return;
+
+	float minGap = std::numeric_limits<float>::max();
+	for (int i = 1; i < nLevels; i++)
+		minGap = (std::min)(minGap, m_vfSortedDepths[i] - m_vfSortedDepths[i - 1]);
+
+	//repeated levels can't be told apart by buckets, leave it to the binary search
+	if (!(minGap > 0.f))
+		return;
+
+	//buckets half the smallest gap wide, so rounding can't put two levels into the same bucket
+	double nBuckets = 2. * (static_cast<double>(m_vfSortedDepths.back()) - m_vfSortedDepths.front()) / minGap + 1.;
+	if (nBuckets > FLOWGRID_DEPTH_LOOKUP_MAX_BUCKETS)
+		return;
+
+	m_fDepthBucketsPerUnit = 2.f / minGap;
+
+	int lastBucket = static_cast<int>((m_vfSortedDepths.back() - m_vfSortedDepths.front()) * m_fDepthBucketsPerUnit);
+	m_viDepthBucketLevels.resize(lastBucket + 1);
+
+	int level = 0;
+	for (int bucket = 0; bucket <= lastBucket; bucket++)
+	{
+		while (level < nLevels && static_cast<int>((m_vfSortedDepths[level] - m_vfSortedDepths.front()) * m_fDepthBucketsPerUnit) < bucket)
+			level++;
+		m_viDepthBucketLevels[bucket] = level;
+	}
+}
+
+int FlowGrid::getDepthLevel(float depth) const
+{
+	int nLevels = static_cast<int>(m_vfSortedDepths.size());
+
+	//scanning decreasing levels for the last one at or above the depth stops at the first or the last level
+	if (m_bDepthsDescending)
+		return depth >= m_vfSortedDepths.back() ? nLevels - 1 : 0;
+
+	//before the first level (or not a number)
+	if (nLevels == 0 || !(depth > m_vfSortedDepths.front()))
+		return 0;
+
+	if (depth >= m_vfSortedDepths.back())
+		return nLevels - 1;
+
+	if (m_viDepthBucketLevels.size() > 0u)
+	{
+		//all levels counted by the bucket are above the depth, the next one may be too
+		int level = m_viDepthBucketLevels[static_cast<int>((depth - m_vfSortedDepths.front()) * m_fDepthBucketsPerUnit)];
+		return m_vfSortedDepths[level] > depth ? level - 1 : level;
+	}
+
+	return static_cast<int>(std::upper_bound(m_vfSortedDepths.begin(), m_vfSortedDepths.end(), depth) - m_vfSortedDepths.begin()) - 1;
+}
+
 float FlowGrid::getMinDepth()
 {
 	return m_vDepthValues.front();
@@ -253,7 +923,7 @@ float FlowGrid::getMaxDepth()
 
 void FlowGrid::setTimeValue(int timeIndex, float timeValue)
 {
-	m_arrfTimes[timeIndex] = timeValue;
+	m_vfTimes[timeIndex] = timeValue;
 	if (timeValue < m_fMinTime || m_fMinTime == -1.f)
 		m_fMinTime = timeValue;
 	if (timeValue > m_fMaxTime || m_fMaxTime == -1.f)
@@ -262,141 +932,116 @@ void FlowGrid::setTimeValue(int timeIndex, float timeValue)
 
 void FlowGrid::setCellValue(int x, int y, int z, int timestep, float u, float v)
 {
-	int index4d = (timestep*m_nXYZCells) + (z*m_nXYCells) + (y*m_nXCells) + x;
-	m_arrfUValues[index4d] = u;
-	m_arrfVValues[index4d] = v;
-	m_arrfVelocityValues[index4d] = sqrt(u*u + v*v);
+	size_t index = getCellIndex(x, y, z, timestep);
+	glm::vec4 cell = getCell(index);
+	cell.x = u;
+	cell.y = v;
+	cell.w = sqrt(u*u + v*v);
+	setCell(index, cell);
 	
-	if (m_arrfVelocityValues[index4d] > m_fMaxVelocity)
-		m_fMaxVelocity = m_arrfVelocityValues[index4d];
+	if (cell.w > m_fMaxVelocity)
+		m_fMaxVelocity = cell.w;
 }
 
 void FlowGrid::setCellValue(int x, int y, int z, int timestep, float u, float v, float w)
 {
-	int index4d = (timestep*m_nXYZCells) + (z*m_nXYCells) + (y*m_nXCells) + x;
-	m_arrfUValues[index4d] = u;
-	m_arrfVValues[index4d] = v;
-	m_arrfWValues[index4d] = w;
-	m_arrfVelocityValues[index4d] = sqrt(u*u + v*v + w*w);
+	float velocity = sqrt(u*u + v*v + w*w);
+	setCell(getCellIndex(x, y, z, timestep), glm::vec4(u, v, w, velocity));
 	
-	if (m_arrfVelocityValues[index4d] > m_fMaxVelocity)
-		m_fMaxVelocity = m_arrfVelocityValues[index4d];
+	if (velocity > m_fMaxVelocity)
+		m_fMaxVelocity = velocity;
 }
 
 void FlowGrid::setIsWaterValue(int x, int y, int z, int t, bool isCellWater)
 {
-	m_arrbIsWater[(t*m_nXYZCells) + (z*m_nXYCells) + (y*m_nXCells) + x] = isCellWater;
+	unsigned int &word = m_vuiWaterMask[getWaterMaskWord(x, y, z, t)];
+	unsigned int bit = 1u << (x & 31);
+
+	word = isCellWater ? (word | bit) : (word & ~bit);
+}
+
+bool FlowGrid::isWater(int x, int y, int z, int t) const
+{
+	return (m_vuiWaterMask[getWaterMaskWord(x, y, z, t)] >> (x & 31)) & 1u;
 }
 
-bool FlowGrid::getIsWaterAt(float lonX, float latY, float depth, float time)
+bool FlowGrid::getIsWaterAt(float lonX, float latY, float depth, float time) const
 {
 	int x = (int)floor(((lonX-m_fXMin)/m_fXCellSize)+0.5);
 	int y = (int)floor(((latY- m_fYMin)/ m_fYCellSize)+0.5);
-	int z = 0;
-	for (int i=0;i<m_nZCells;i++)
-	{
-		if (depth >= m_vDepthValues[i])
-			z = i;
-	}
+	int z = getDepthLevel(depth);
 
 	int t = 0;
 	for (int i=0;i<m_nTimesteps;i++)
 	{
-		if (time >= m_arrfTimes[i])
+		if (time >= m_vfTimes[i])
 		{
 			t = i;
 		}
 	}
 	
-	return m_arrbIsWater[(t*m_nXYZCells) + (z*m_nXYCells) + (y*m_nXCells) + x];
+	ReadScope scope(*this, t, t);
+
+	return scope.resident() && isWater(x, y, z, t);
 }
 
-bool FlowGrid::getUVat(float lonX, float latY, float depth, float time, float *u, float *v)
+FlowGrid::TimeBracket FlowGrid::getTimeBracket(float time) const
 {
-	//first we check time requested to see if its the same as last time
-	if (time != m_fLastTimeRequested)
+	TimeBracket bracket;
+	bracket.onTimestep = true;
+	bracket.factor1 = 1.f;
+	bracket.factor2 = 0.f;
+
+	//first timestep not before the requested time
+	int above = static_cast<int>(std::lower_bound(m_vfTimes.begin(), m_vfTimes.end(), time) - m_vfTimes.begin());
+
+	if (above < m_nTimesteps && time == m_vfTimes[above])
 	{
-		//new time, have to find time values anew
-		m_fLastTimeRequested = time;
-		
-		//find if on timestep exactly, or is between what times
-		int above = -1;
-		int below = -1;
-		m_bLastTimeOnTimestep = false;
-		for (int i=0;i<m_nTimesteps;i++)
-		{
-			if (time > m_arrfTimes[i])
-			{
-				below = i;
-			}
-			else if (time == m_arrfTimes[i])
-			{
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = i;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = i;
-				m_fLastTimeFactor2 = 0;
-				above = i;
-				below = i;
-				break;
-			}
-			else if (time < m_arrfTimes[i])
-			{
-				above = i;
-				break;
-			}
-		}
-		if (!m_bLastTimeOnTimestep) //if didn't match a timestep exactly
-		{
-			//if was below min time
-			if (below == -1)
-			{
-				//set to min time
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = 0;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = 0;
-				m_fLastTimeFactor2 = 0;
-			}
-			//if was above max time
-			else if (above == -1)
-			{
-				//set to max time
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = m_nTimesteps-1;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = m_nTimesteps-1;
-				m_fLastTimeFactor2 = 0;
-			}
-			else //is in between two timesteps
-			{
-				//set both times and factor for each
-				float range = m_arrfTimes[above] - m_arrfTimes[below];
-				float fromBelow = time - m_arrfTimes[below];
-				float factor = fromBelow / range;
-				m_iLastTime1 = below;
-				m_fLastTimeFactor1 = 1-factor;
-				m_iLastTime2 = above;
-				m_fLastTimeFactor2 = factor;
-			}
-		}//end if !lastTimeOnTimestep
+		//on timestep exactly
+		bracket.t1 = bracket.t2 = above;
+	}
+	else if (above == 0)
+	{
+		//below min time (or not a number), set to min time
+		bracket.t1 = bracket.t2 = 0;
+	}
+	else if (above == m_nTimesteps)
+	{
+		//above max time, set to max time
+		bracket.t1 = bracket.t2 = m_nTimesteps - 1;
+	}
+	else
+	{
+		//in between two timesteps, set both times and factor for each
+		int below = above - 1;
+		float factor = (time - m_vfTimes[below]) / (m_vfTimes[above] - m_vfTimes[below]);
+
+		bracket.onTimestep = false;
+		bracket.t1 = below;
+		bracket.factor1 = 1.f - factor;
+		bracket.t2 = above;
+		bracket.factor2 = factor;
+	}
 
-	}//if time not same as last time
+	return bracket;
+}
+
+bool FlowGrid::getUVat(float lonX, float latY, float depth, float time, float *u, float *v) const
+{
+	TimeBracket bracket = getTimeBracket(time);
+	ReadScope scope(*this, bracket.t1, bracket.t2);
+	if (!scope.resident())
+		return false;
 
 	
 	//now we have time(s) and factor(s)
 
 	//find closest depth level? HACK: just use deepest one not below requested depth for now, maybe fix later if more accuracy needed
-	int deepestLevelAbove = 0;
 	if (depth < 0 || depth > m_vDepthValues.back()+500)  //HACK: MAGIC NUMBER (500) FIX LATER?
 	{
 		return false;
 	}
-	for (int i=0;i<m_nZCells;i++)
-	{
-		if (depth >= m_vDepthValues[i])
-			deepestLevelAbove = i;
-	}
+	int deepestLevelAbove = getDepthLevel(depth);
 	//get index of requested location
 	int x = (int)floor(((lonX-m_fXMin)/m_fXCellSize)+0.5);
 	int y = (int)floor(((latY- m_fYMin)/ m_fYCellSize)+0.5);
@@ -409,11 +1054,9 @@ bool FlowGrid::getUVat(float lonX, float latY, float depth, float time, float *u
 	//check if in bounds of the dataset
 	if (x < 0 || y < 0 || z < 0 || x > m_nXCells-1 || y > m_nYCells-1 || z > m_nZCells-1)
 		return false;
-	//xyz index
-	int index3d = ((z*m_nXYCells)+(y*m_nXCells)+(x));
 			
 	//check if in water
-	if (!m_arrbIsWater[(m_iLastTime1*m_nXYZCells) + index3d])
+	if (!isWater(x, y, z, bracket.t1))
 	{
 		//printf("not in water\n");
 		return false; //if not in water, return false
@@ -421,18 +1064,21 @@ bool FlowGrid::getUVat(float lonX, float latY, float depth, float time, float *u
 	else
 	{
 		//if single timestep
-		if (m_bLastTimeOnTimestep)
+		if (bracket.onTimestep)
 		{
-			*u = m_arrfUValues[(m_iLastTime1*m_nXYZCells) + index3d];
-			*v = m_arrfVValues[(m_iLastTime1*m_nXYZCells) + index3d];
+			glm::vec4 cell = getCell(getCellIndex(x, y, z, bracket.t1));
+			*u = cell.x;
+			*v = cell.y;
 			//printf("on timestep\n");
 			//printf ("U: %f, V: %f\n", uValues[(lastTime1*size3d) + index3d], vValues[(lastTime1*size3d) + index3d]);
 		}
 		else //between timesteps
 		{ 
 			//printf("betwen timesteps\n");
-			*u = (m_arrfUValues[(m_iLastTime1*m_nXYZCells) + index3d]*m_fLastTimeFactor1) + (m_arrfUValues[(m_iLastTime2*m_nXYZCells) + index3d]*m_fLastTimeFactor2);
-			*v = (m_arrfVValues[(m_iLastTime1*m_nXYZCells) + index3d]*m_fLastTimeFactor1) + (m_arrfVValues[(m_iLastTime2*m_nXYZCells) + index3d]*m_fLastTimeFactor2);
+			glm::vec4 cell1 = getCell(getCellIndex(x, y, z, bracket.t1));
+			glm::vec4 cell2 = getCell(getCellIndex(x, y, z, bracket.t2));
+			*u = (cell1.x*bracket.factor1) + (cell2.x*bracket.factor2);
+			*v = (cell1.y*bracket.factor1) + (cell2.y*bracket.factor2);
 			//printf ("U: %f, V: %f\n", (uValues[(lastTime1*size3d) + index3d]*lastTimeFactor1) + (uValues[(lastTime2*size3d) + index3d]*lastTimeFactor2), (vValues[(lastTime1*size3d) + index3d]*lastTimeFactor1) + (vValues[(lastTime2*size3d) + index3d]*lastTimeFactor2));
 		}
 		return true;
@@ -441,100 +1087,19 @@ bool FlowGrid::getUVat(float lonX, float latY, float depth, float time, float *u
 }//end getUVat()
 
 
-bool FlowGrid::getUVWat(float lonX, float latY, float depth, float time, float *u, float *v, float *w)
+bool FlowGrid::getUVWat(float lonX, float latY, float depth, float time, float *u, float *v, float *w) const
 {
 	if (lonX < m_fXMin || lonX > m_fXMax ||
 		latY < m_fYMin || latY > m_fYMax ||
 		depth < m_fZMin || depth > m_fZMax)
 		return false;
 
-	//first we check time requested to see if its the same as last time
-	if (time != m_fLastTimeRequested)
-	{
-		//new time, have to find time values anew
-		m_fLastTimeRequested = time;
-		
-		//find if on timestep exactly, or is between what times
-		int above = -1;
-		int below = -1;
-		m_bLastTimeOnTimestep = false;
-		for (int i=0;i<m_nTimesteps;i++)
-		{
-			if (time > m_arrfTimes[i])
-			{
-				below = i;
-			}
-			else if (time == m_arrfTimes[i])
-			{
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = i;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = i;
-				m_fLastTimeFactor2 = 0;
-				above = i;
-				below = i;
-				break;
-			}
-			else if (time < m_arrfTimes[i])
-			{
-				above = i;
-				break;
-			}
-		}
-		if (!m_bLastTimeOnTimestep) //if didn't match a timestep exactly
-		{
-			//if was below min time
-			if (below == -1)
-			{
-				//set to min time
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = 0;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = 0;
-				m_fLastTimeFactor2 = 0;
-			}
-			//if was above max time
-			else if (above == -1)
-			{
-				//set to max time
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = m_nTimesteps-1;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = m_nTimesteps-1;
-				m_fLastTimeFactor2 = 0;
-			}
-			else //is in between two timesteps
-			{
-				//set both times and factor for each
-				float range = m_arrfTimes[above] - m_arrfTimes[below];
-				float fromBelow = time - m_arrfTimes[below];
-				float factor = fromBelow / range;
-				m_iLastTime1 = below;
-				m_fLastTimeFactor1 = 1-factor;
-				m_iLastTime2 = above;
-				m_fLastTimeFactor2 = factor;
-			}
-		}//end if !lastTimeOnTimestep
-
-	}//if time not same as last time
+	TimeBracket bracket = getTimeBracket(time);
+	ReadScope scope(*this, bracket.t1, bracket.t2);
+	if (!scope.resident())
+		return false;
 	//now we have time(s) and factor(s)
 
-	
-	//find closest depth level? HACK: just use deepest one not below requested depth for now, maybe fix later if more accuracy needed
-	int deepestLevelAbove = 0;
-	for (int i=0;i<m_nZCells;i++)
-	{
-		if (m_bUsesZInsteadOfDepth)
-		{
-			if (depth <= m_vDepthValues[i])
-				deepestLevelAbove = i;
-		}
-		else
-		{
-			if (depth >= m_vDepthValues[i])
-				deepestLevelAbove = i;
-		}
-	}
 	//get index of requested location
 	int x = (int)floor(((lonX - m_fXMin) / m_fXCellSize));
 	int y = (int)floor(((latY - m_fYMin) / m_fYCellSize));
@@ -547,12 +1112,9 @@ bool FlowGrid::getUVWat(float lonX, float latY, float depth, float time, float *
 	//check if in bounds of the dataset
 	if (x < 0 || y < 0 || z < 0 || x > m_nXCells-1 || y > m_nYCells-1 || z > m_nZCells-1)
 		return false;
-
-	//xyz index
-	int index3d = ((z*m_nXYCells)+(y*m_nXCells)+(x));
 			
 	//check if in water
-	if (!m_arrbIsWater[(m_iLastTime1*m_nXYZCells) + index3d])
+	if (!isWater(x, y, z, bracket.t1))
 	{
 		//printf("not in water\n");
 		return false; //if not in water, return false
@@ -560,20 +1122,23 @@ bool FlowGrid::getUVWat(float lonX, float latY, float depth, float time, float *
 	else
 	{
 		//if single timestep
-		if (m_bLastTimeOnTimestep)
+		if (bracket.onTimestep)
 		{
-			*u = m_arrfUValues[(m_iLastTime1*m_nXYZCells) + index3d];
-			*v = m_arrfVValues[(m_iLastTime1*m_nXYZCells) + index3d];
-			*w = m_arrfWValues[(m_iLastTime1*m_nXYZCells) + index3d];
+			glm::vec4 cell = getCell(getCellIndex(x, y, z, bracket.t1));
+			*u = cell.x;
+			*v = cell.y;
+			*w = cell.z;
 			//printf("on timestep\n");
 			//printf ("U: %f, V: %f\n", uValues[(lastTime1*size3d) + index3d], vValues[(lastTime1*size3d) + index3d]);
 		}
 		else //between timesteps
 		{ 
 			//printf("betwen timesteps\n");
-			*u = (m_arrfUValues[(m_iLastTime1*m_nXYZCells) + index3d]*m_fLastTimeFactor1) + (m_arrfUValues[(m_iLastTime2*m_nXYZCells) + index3d]*m_fLastTimeFactor2);
-			*v = (m_arrfVValues[(m_iLastTime1*m_nXYZCells) + index3d]*m_fLastTimeFactor1) + (m_arrfVValues[(m_iLastTime2*m_nXYZCells) + index3d]*m_fLastTimeFactor2);
-			*w = (m_arrfWValues[(m_iLastTime1*m_nXYZCells) + index3d]*m_fLastTimeFactor1) + (m_arrfWValues[(m_iLastTime2*m_nXYZCells) + index3d]*m_fLastTimeFactor2);
+			glm::vec4 cell1 = getCell(getCellIndex(x, y, z, bracket.t1));
+			glm::vec4 cell2 = getCell(getCellIndex(x, y, z, bracket.t2));
+			*u = (cell1.x*bracket.factor1) + (cell2.x*bracket.factor2);
+			*v = (cell1.y*bracket.factor1) + (cell2.y*bracket.factor2);
+			*w = (cell1.z*bracket.factor1) + (cell2.z*bracket.factor2);
 			//printf ("U: %f, V: %f\n", (uValues[(lastTime1*size3d) + index3d]*lastTimeFactor1) + (uValues[(lastTime2*size3d) + index3d]*lastTimeFactor2), (vValues[(lastTime1*size3d) + index3d]*lastTimeFactor1) + (vValues[(lastTime2*size3d) + index3d]*lastTimeFactor2));
 		}
 		return true;
@@ -583,92 +1148,315 @@ bool FlowGrid::getUVWat(float lonX, float latY, float depth, float time, float *
 
 
 
-bool FlowGrid::getVelocityAt(float lonX, float latY, float depth, float time, float *velocity)
+bool FlowGrid::getUVWatInterpolated(float lonX, float latY, float depth, float time, float *u, float *v, float *w) const
 {
-	//first we check time requested to see if its the same as last time
-	if (time != m_fLastTimeRequested)
+	return getUVWatInterpolated(lonX, latY, depth, getTimeBracket(time), u, v, w);
+}
+
+bool FlowGrid::getUVWatInterpolated(float lonX, float latY, float depth, TimeBracket const &bracket, float *u, float *v, float *w) const
+{
+	glm::vec3 pos(lonX, latY, depth);
+	glm::vec3 vel;
+	bool valid;
+
+	getUVWatInterpolated(&pos, 1u, bracket, &vel, &valid);
+
+	if (valid)
 	{
-		//new time, have to find time values anew
-		m_fLastTimeRequested = time;
-		
-		//find if on timestep exactly, or is between what times
-		int above = -1;
-		int below = -1;
-		m_bLastTimeOnTimestep = false;
-		for (int i=0;i<m_nTimesteps;i++)
+		*u = vel.x;
+		*v = vel.y;
+		*w = vel.z;
+	}
+
+	return valid;
+}
+
+size_t FlowGrid::getUVWatInterpolated(glm::vec3 const *positions, size_t count, float time, glm::vec3 *velocities, bool *valid) const
+{
+	return getUVWatInterpolated(positions, count, getTimeBracket(time), velocities, valid);
+}
+
+size_t FlowGrid::getUVWatInterpolated(glm::vec3 const *positions, size_t count, TimeBracket const &bracket, glm::vec3 *velocities, bool *valid) const
+{
+	ReadScope scope(*this, bracket.t1, bracket.t2);
+	if (!scope.resident())
+	{
+		std::fill(valid, valid + count, false);
+		return 0u;
+	}
+
+	size_t nValid;
+	if (m_vQuantizedCells.empty())
+		nValid = interpolateCells(m_vCells.data(), positions, count, bracket, velocities, valid);
+	else
+		nValid = interpolateCells(m_vQuantizedCells.data(), positions, count, bracket, velocities, valid);
+
+	return nValid;
+}
+
+size_t FlowGrid::advectRK4(glm::vec3 const *positions, size_t count, float time, float step, glm::vec3 *newPositions, bool *valid) const
+{
+	//all four stages of all positions sample the same time
+	TimeBracket bracket = getTimeBracket(time);
+
+	glm::vec3 stagePos[FLOWGRID_RK4_BATCH], k[FLOWGRID_RK4_BATCH], kSum[FLOWGRID_RK4_BATCH];
+	bool stageValid[FLOWGRID_RK4_BATCH];
+
+	size_t nValid = 0u;
+
+	for (size_t batch = 0u; batch < count; batch += FLOWGRID_RK4_BATCH)
+	{
+		size_t n = (std::min)(count - batch, static_cast<size_t>(FLOWGRID_RK4_BATCH));
+		glm::vec3 const *startPos = positions + batch;
+		bool *ok = valid + batch;
+
+		// samples the stage velocities k; positions that failed a stage keep going with k = 0, their result is dropped
+		auto sampleStage = [&](glm::vec3 const *stagePositions) {
+			getUVWatInterpolated(stagePositions, n, bracket, k, stageValid);
+			for (size_t i = 0u; i < n; ++i)
+			{
+				ok[i] = ok[i] && stageValid[i];
+				if (!ok[i])
+					k[i] = glm::vec3(0.f);
+			}
+		};
+
+		std::fill(ok, ok + n, true);
+
+#ifdef FLOWGRID_SIMD
+		if (m_bUseSIMD)
 		{
-			if (time > m_arrfTimes[i])
+			// the same operations in the same order as below, on one register per position
+			__m128 start[FLOWGRID_RK4_BATCH], sum[FLOWGRID_RK4_BATCH];
+			__m128 stepSize = _mm_set1_ps(step), half = _mm_set1_ps(0.5f), two = _mm_set1_ps(2.f), sixth = _mm_set1_ps(6.f);
+
+			sampleStage(startPos);
+			for (size_t i = 0u; i < n; ++i)
 			{
-				below = i;
+				__m128 kv = loadVec3(k[i]);
+				start[i] = loadVec3(startPos[i]);
+				sum[i] = kv;
+				stagePos[i] = storeVec3(_mm_add_ps(start[i], _mm_mul_ps(_mm_mul_ps(kv, stepSize), half)));
 			}
-			else if (time == m_arrfTimes[i])
+
+			sampleStage(stagePos);
+			for (size_t i = 0u; i < n; ++i)
 			{
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = i;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = i;
-				m_fLastTimeFactor2 = 0;
-				above = i;
-				below = i;
-				break;
+				__m128 kv = loadVec3(k[i]);
+				sum[i] = _mm_add_ps(sum[i], _mm_mul_ps(two, kv));
+				stagePos[i] = storeVec3(_mm_add_ps(start[i], _mm_mul_ps(_mm_mul_ps(kv, stepSize), half)));
 			}
-			else if (time < m_arrfTimes[i])
+
+			sampleStage(stagePos);
+			for (size_t i = 0u; i < n; ++i)
 			{
-				above = i;
-				break;
+				__m128 kv = loadVec3(k[i]);
+				sum[i] = _mm_add_ps(sum[i], _mm_mul_ps(two, kv));
+				stagePos[i] = storeVec3(_mm_add_ps(start[i], _mm_mul_ps(kv, stepSize)));
+			}
+
+			sampleStage(stagePos);
+			for (size_t i = 0u; i < n; ++i)
+			{
+				if (!ok[i])
+					continue;
+
+				sum[i] = _mm_add_ps(sum[i], loadVec3(k[i]));
+				newPositions[batch + i] = storeVec3(_mm_add_ps(start[i], _mm_div_ps(_mm_mul_ps(stepSize, sum[i]), sixth)));
+				nValid++;
 			}
+
+			continue;
+		}
+#endif
+
+		sampleStage(startPos);
+		for (size_t i = 0u; i < n; ++i)
+		{
+			kSum[i] = k[i];
+			stagePos[i] = startPos[i] + k[i] * step * 0.5f;
+		}
+
+		sampleStage(stagePos);
+		for (size_t i = 0u; i < n; ++i)
+		{
+			kSum[i] += 2.f * k[i];
+			stagePos[i] = startPos[i] + k[i] * step * 0.5f;
+		}
+
+		sampleStage(stagePos);
+		for (size_t i = 0u; i < n; ++i)
+		{
+			kSum[i] += 2.f * k[i];
+			stagePos[i] = startPos[i] + k[i] * step;
+		}
+
+		sampleStage(stagePos);
+		for (size_t i = 0u; i < n; ++i)
+		{
+			if (!ok[i])
+				continue;
+
+			kSum[i] += k[i];
+			newPositions[batch + i] = startPos[i] + step * kSum[i] / 6.f;
+			nValid++;
+		}
+	}
+
+	return nValid;
+}
+
+template <typename CellType>
+size_t FlowGrid::interpolateCells(CellType const *cellData, glm::vec3 const *positions, size_t count, TimeBracket const &bracket, glm::vec3 *velocities, bool *valid) const
+{
+	int nSlices = bracket.onTimestep ? 1 : 2;
+	int sliceTimestep[2] = { bracket.t1, bracket.t2 };
+	float sliceWeight[2] = { bracket.onTimestep ? 1.f : bracket.factor1, bracket.factor2 };
+
+	glm::vec3 gridMin(m_fXMin, m_fYMin, m_fZMin);
+	glm::vec3 gridMax(m_fXMax, m_fYMax, m_fZMax);
+	glm::vec3 invCellSize(1.f / m_fXCellSize, 1.f / m_fYCellSize, 1.f / m_fZCellSize);
+	glm::ivec3 maxCell(m_nXCells - 1, m_nYCells - 1, m_nZCells - 1);
+
+	// continuous cell coordinates of a block, cell centers are at k + 0.5
+	float gx[FLOWGRID_SAMPLE_BLOCK], gy[FLOWGRID_SAMPLE_BLOCK], gz[FLOWGRID_SAMPLE_BLOCK];
+	bool inside[FLOWGRID_SAMPLE_BLOCK];
+
+	size_t nValid = 0u;
+
+	for (size_t block = 0u; block < count; block += FLOWGRID_SAMPLE_BLOCK)
+	{
+		size_t n = (std::min)(count - block, static_cast<size_t>(FLOWGRID_SAMPLE_BLOCK));
+
+		for (size_t i = 0u; i < n; ++i)
+		{
+			glm::vec3 const &p = positions[block + i];
+
+			inside[i] = p.x >= gridMin.x && p.x <= gridMax.x && p.y >= gridMin.y && p.y <= gridMax.y && p.z >= gridMin.z && p.z <= gridMax.z;
+			gx[i] = (p.x - gridMin.x) * invCellSize.x;
+			gy[i] = (p.y - gridMin.y) * invCellSize.y;
+			gz[i] = (p.z - gridMin.z) * invCellSize.z;
 		}
-		if (!m_bLastTimeOnTimestep) //if didn't match a timestep exactly
+
+		for (size_t i = 0u; i < n; ++i)
 		{
-			//if was below min time
-			if (below == -1)
+			bool &ok = valid[block + i];
+			ok = false;
+
+			if (!inside[i])
+				continue;
+
+			// the containing cell decides validity, as in getUVWat
+			glm::ivec3 cell(static_cast<int>(gx[i]), static_cast<int>(gy[i]), static_cast<int>(gz[i]));
+			if (cell.x > maxCell.x || cell.y > maxCell.y || cell.z > maxCell.z || !isWater(cell.x, cell.y, cell.z, bracket.t1))
+				continue;
+
+			// interpolate between the centers around the position, clamped to the outermost centers at the edges
+			glm::vec3 c = glm::clamp(glm::vec3(gx[i], gy[i], gz[i]) - 0.5f, glm::vec3(0.f), glm::vec3(maxCell));
+			glm::ivec3 c0(c);
+			glm::ivec3 c1 = glm::min(c0 + 1, maxCell);
+			glm::vec3 f = c - glm::vec3(c0);
+
+			alignas(16) float weights[8];
+#ifdef FLOWGRID_SIMD
+			if (m_bUseSIMD)
 			{
-				//set to min time
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = 0;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = 0;
-				m_fLastTimeFactor2 = 0;
+				__m128 xy = _mm_mul_ps(_mm_setr_ps(1.f - f.x, f.x, 1.f - f.x, f.x), _mm_setr_ps(1.f - f.y, 1.f - f.y, f.y, f.y));
+				_mm_store_ps(weights, _mm_mul_ps(xy, _mm_set1_ps(1.f - f.z)));
+				_mm_store_ps(weights + 4, _mm_mul_ps(xy, _mm_set1_ps(f.z)));
 			}
-			//if was above max time
-			else if (above == -1)
+			else
+#endif
 			{
-				//set to max time
-				m_bLastTimeOnTimestep = true;
-				m_iLastTime1 = m_nTimesteps-1;
-				m_fLastTimeFactor1 = 1;
-				m_iLastTime2 = m_nTimesteps-1;
-				m_fLastTimeFactor2 = 0;
+				for (int corner = 0; corner < 8; ++corner)
+					weights[corner] = ((corner & 1) ? f.x : 1.f - f.x) * ((corner & 2) ? f.y : 1.f - f.y) * ((corner & 4) ? f.z : 1.f - f.z);
 			}
-			else //is in between two timesteps
+
+			// corner k is at (k & 1, k & 2, k & 4) relative to c0, and rows (k >> 1) share their y and z
+			size_t dx = static_cast<size_t>(c1.x - c0.x);
+			size_t dy = static_cast<size_t>(c1.y - c0.y) * m_nXCells;
+			size_t dz = static_cast<size_t>(c1.z - c0.z) * m_nXYCells;
+			size_t offsets[8] = { 0u, dx, dy, dy + dx, dz, dz + dx, dz + dy, dz + dy + dx };
+
+			glm::vec3 sum(0.f);
+			float totalWeight = 0.f;
+
+			for (int s = 0; s < nSlices; ++s)
 			{
-				//set both times and factor for each
-				float range = m_arrfTimes[above] - m_arrfTimes[below];
-				float fromBelow = time - m_arrfTimes[below];
-				float factor = fromBelow / range;
-				m_iLastTime1 = below;
-				m_fLastTimeFactor1 = 1-factor;
-				m_iLastTime2 = above;
-				m_fLastTimeFactor2 = factor;
+				int t = sliceTimestep[s];
+				CellType const *cells = cellData + getCellIndex(c0.x, c0.y, c0.z, t);
+
+				unsigned int waterCorners = 0u;
+				for (int row = 0; row < 4; ++row)
+				{
+					unsigned int const *rowMask = &m_vuiWaterMask[getWaterMaskWord(0, (row & 1) ? c1.y : c0.y, (row & 2) ? c1.z : c0.z, t)];
+					waterCorners |= ((rowMask[c0.x >> 5] >> (c0.x & 31)) & 1u) << (2 * row);
+					waterCorners |= ((rowMask[c1.x >> 5] >> (c1.x & 31)) & 1u) << (2 * row + 1);
+				}
+
+				glm::vec3 sliceSum(0.f);
+				float sliceTotal = 0.f;
+
+#ifdef FLOWGRID_SIMD
+				if (m_bUseSIMD)
+					sliceTotal = sumWaterCorners(cells, offsets, weights, waterCorners, sliceSum);
+				else
+#endif
+				if (waterCorners == 0xFFu)
+				{
+					for (int corner = 0; corner < 8; ++corner)
+						sliceSum += weights[corner] * glm::vec3(cells[offsets[corner]]);
+					sliceTotal = 1.f;
+				}
+				else
+				{
+					for (int corner = 0; corner < 8; ++corner)
+					{
+						if (!(waterCorners & (1u << corner)))
+							continue;
+
+						sliceSum += weights[corner] * glm::vec3(cells[offsets[corner]]);
+						sliceTotal += weights[corner];
+					}
+				}
+
+				// a slice without water around the position (e.g. the shoreline moved) is left out
+				if (sliceTotal > 0.f)
+				{
+					sum += sliceSum * (sliceWeight[s] / sliceTotal);
+					totalWeight += sliceWeight[s];
+				}
+			}
+
+			if (totalWeight > 0.f)
+			{
+				// quantized cells are decoded once per sample, float cells have a zero offset and unit scale
+				velocities[block + i] = glm::vec3(m_vec4QuantizeOffset) + glm::vec3(m_vec4QuantizeScale) * (sum / totalWeight);
+				ok = true;
+				nValid++;
 			}
-		}//end if !lastTimeOnTimestep
+		}
+	}
+
+	return nValid;
+}
 
-	}//if time not same as last time
+bool FlowGrid::getVelocityAt(float lonX, float latY, float depth, float time, float *velocity) const
+{
+	TimeBracket bracket = getTimeBracket(time);
+	ReadScope scope(*this, bracket.t1, bracket.t2);
+	if (!scope.resident())
+		return false;
 
 	
 	//now we have time(s) and factor(s)
 
 	//find closest depth level? HACK: just use deepest one not below requested depth for now, maybe fix later if more accuracy needed
-	int deepestLevelAbove = 0;
 	if (depth < 0 || depth > m_vDepthValues.back()+500)  //HACK: MAGIC NUMBER (500) FIX LATER?
 	{
 		return false;
 	}
-	for (int i=0;i<m_nZCells;i++)
-	{
-		if (depth >= m_vDepthValues[i])
-			deepestLevelAbove = i;
-	}
+	int deepestLevelAbove = getDepthLevel(depth);
 	//get index of requested location
 	int x = (int)floor(((lonX-m_fXMin)/m_fXCellSize)+0.5);
 	int y = (int)floor(((latY- m_fYMin)/ m_fYCellSize)+0.5);
@@ -681,11 +1469,9 @@ bool FlowGrid::getVelocityAt(float lonX, float latY, float depth, float time, fl
 	//check if in bounds of the dataset
 	if (x < 0 || y < 0 || z < 0 || x > m_nXCells -1 || y > m_nYCells-1 || z > m_nZCells-1)
 		return false;
-	//xyz index
-	int index3d = ((z*m_nXYCells)+(y*m_nXCells)+(x));
 			
 	//check if in water
-	if (!m_arrbIsWater[(m_iLastTime1*m_nXYZCells) + index3d])
+	if (!isWater(x, y, z, bracket.t1))
 	{
 		//printf("not in water\n");
 		return false; //if not in water, return false
@@ -693,20 +1479,20 @@ bool FlowGrid::getVelocityAt(float lonX, float latY, float depth, float time, fl
 	else
 	{
 		//if single timestep
-		if (m_bLastTimeOnTimestep)
+		if (bracket.onTimestep)
 		{
-			*velocity = m_arrfVelocityValues[(m_iLastTime1*m_nXYZCells) + index3d];
+			*velocity = getCell(getCellIndex(x, y, z, bracket.t1)).w;
 		}
 		else //between timesteps
 		{ 
-			*velocity = (m_arrfVelocityValues[(m_iLastTime1*m_nXYZCells) + index3d]* m_fLastTimeFactor1) + (m_arrfVelocityValues[(m_iLastTime2*m_nXYZCells) + index3d]* m_fLastTimeFactor2);
+			*velocity = (getCell(getCellIndex(x, y, z, bracket.t1)).w * bracket.factor1) + (getCell(getCellIndex(x, y, z, bracket.t2)).w * bracket.factor2);
 		}
 		return true;
 	}
 
 }//end getVelocityAt()
 
-bool FlowGrid::contains(float x, float y)
+bool FlowGrid::contains(float x, float y) const
 {
 	if (x < m_fXMin)
 		return false;
@@ -720,7 +1506,7 @@ bool FlowGrid::contains(float x, float y)
 		return true;
 }
 
-bool FlowGrid::contains(float x, float y, float z)
+bool FlowGrid::contains(float x, float y, float z) const
 {
 	if (x < m_fXMin)
 		return false;
@@ -754,13 +1540,7 @@ void FlowGrid::getXYZofCell(int cellIndex, float *lonX, float *latY, float *dept
 
 	//*depth = bathyDepth2d[(y*xCells) + x];
 
-	float z = 0;
-	for (int i=0;i<m_nZCells;i++)
-	{
-		if (*depth >= m_vDepthValues[i])
-			z = static_cast<float>(i);
-	}
-	*depth = z;
+	*depth = static_cast<float>(getDepthLevel(*depth));
 
 	//printf("Cell %d of %d is %f, %f, %f\n", cellIndex, gridSize2d, *lonX, *latY, *depth);
 }
@@ -920,7 +1700,7 @@ bool FlowGrid::getCellBounds(float m_fXMin, float m_fXMax, float ymin, float yma
 
 float FlowGrid::getTimeAtTimestep(int timestep)
 {
-	return m_arrfTimes[timestep];
+	return m_vfTimes[timestep];
 }
 
 int FlowGrid::getNumTimeCells()
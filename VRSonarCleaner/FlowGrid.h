@@ -7,23 +7,71 @@
 #include <algorithm> 
 #include <vector>
 #include <chrono>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <GL/glew.h>
 #include <glm.hpp>
+#include <gtc/type_precision.hpp>
 #include "Dataset.h"
 
+#ifndef FLOWGRID_LOAD_CHUNK_BYTES
+#define FLOWGRID_LOAD_CHUNK_BYTES (static_cast<size_t>(64u) << 20)	// file bytes read at once when loading cells
+#endif
+#define FLOWGRID_TRANSPOSE_BLOCK 16									// x cells transposed together, so stores along x fill whole cache lines
+#define FLOWGRID_SAMPLE_BLOCK 64									// positions whose cell coordinates are computed together by the batch sampler
+#define FLOWGRID_RK4_BATCH 16										// positions advected together by advectRK4, each stage samples them in one call
+// SSE2, which every x64 CPU has, for the batch sampler and RK4 steps, unless FLOWGRID_NO_SIMD is defined
+#if !defined(FLOWGRID_NO_SIMD) && (defined(_M_X64) || defined(__SSE2__))
+#define FLOWGRID_SIMD
+#endif
+#define FLOWGRID_DEPTH_LOOKUP_MAX_BUCKETS 8192						// larger depth lookup tables fall back to binary search
+#define FLOWGRID_TIMESTEP_FILE_MAGIC 0x53544746u					// "FGTS", timestep file written for streaming
+#define FLOWGRID_TIMESTEP_FILE_VERSION 2u
+
 class FlowGrid : public Dataset
 {
 	public:
 		//FlowGrid(float minX, float maxX, int cellsX, float minY, float maxY, int cellsY, int cellsZ, int timesteps);
-		FlowGrid(const char* filename, bool useZInsteadOfDepth);
-		FlowGrid(const char* filename, float xMin, float xMax, int xCount, float yMin, float yMax, int yCount, float zMin, float zMax, int zCount);
+		// With a streamLookahead of 0 or more, only the two timesteps bracketing the current time and the next
+		// streamLookahead timesteps are kept in memory. They are read on a background thread from a copy of the cells
+		// stored one timestep after the other, which is written next to the file (filename.tsteps) the first time.
+		// If quantize is set, cells are stored as 16-bit integers scaled to the range of each component (half the memory).
+		FlowGrid(const char* filename, bool useZInsteadOfDepth, int streamLookahead = -1, bool quantize = false);
+		FlowGrid(const char* filename, float xMin, float xMax, int xCount, float yMin, float yMax, int yCount, float zMin, float zMax, int zCount, bool quantize = false);
 		virtual ~FlowGrid();
 
+		// Timesteps bracketing a sample time and their weights. Found by binary search over the timestep values
+		// without touching the grid, so sampling can run on several threads and a bracket can be reused for a batch.
+		struct TimeBracket {
+			int t1, t2;
+			float factor1, factor2;
+			bool onTimestep;	// t1 == t2, factor1 == 1
+		};
+
 		void init();
 
-		void deleteSelf();
+		// Streaming: moves the resident timesteps to those bracketing time and queues the following ones for reading,
+		// continuing with the first timesteps after the last one so looping playback doesn't stall on the wrap.
+		// Waits only if a bracketing timestep hasn't been read yet, which is counted as a stall. Sampling never waits,
+		// it fails for timesteps that aren't resident. Call from the thread that samples, before sampling at time.
+		void updateStream(float time);
+		bool isStreaming() const;
+		bool isQuantized() const;
+		int getStreamStalls() const;
+		size_t getResidentBytes() const;
 
+		// Depth levels must be monotonic (increasing or decreasing). Call updateDepthLookup() after changing them.
 		void setDepthValue(int depthIndex, float depth);
+		void updateDepthLookup();
+
+		// Last level at or above depth in value (the first level for depths below all of them), as a scan over the
+		// levels would find. For increasing levels that is the deepest level not past depth. Decreasing levels give
+		// the last level for depths at or above it and the first one otherwise.
+		int getDepthLevel(float depth) const;
 
 		void setTimeValue(int timeIndex, float timeValue);		
 		
@@ -32,19 +80,43 @@ class FlowGrid : public Dataset
 		//void setCellValue(int x, int y, int z, int timestep, float u, float v, float t, float s);
 
 		void setIsWaterValue(int x, int y, int z, int t, bool isCellWater);
-		
-		bool getUVat(float lonX, float latY, float depth, float time, float *u, float *v);
-		bool getUVWat(float lonX, float latY, float depth, float time, float *u, float *v, float *w);
-		bool getVelocityAt(float lonX, float latY, float depth, float time, float *velocity);
+		bool isWater(int x, int y, int z, int t) const;
+
+		// Times before the first or after the last timestep clamp to that timestep
+		TimeBracket getTimeBracket(float time) const;
+
+		// The sampling functions are const and keep no state, so they can be called concurrently
+		bool getUVat(float lonX, float latY, float depth, float time, float *u, float *v) const;
+		bool getUVWat(float lonX, float latY, float depth, float time, float *u, float *v, float *w) const;
+		bool getVelocityAt(float lonX, float latY, float depth, float time, float *velocity) const;
+
+		// Quadrilinear sampling: trilinear between cell centers and linear between timesteps. Corners that are not water
+		// are left out and the remaining weights renormalized. Fails like getUVWat outside the grid or if the cell
+		// containing the position is not water.
+		bool getUVWatInterpolated(float lonX, float latY, float depth, float time, float *u, float *v, float *w) const;
+		bool getUVWatInterpolated(float lonX, float latY, float depth, TimeBracket const &bracket, float *u, float *v, float *w) const;
+
+		// Batch version: samples count positions at the same time. Positions are processed in blocks whose cell
+		// coordinates are computed in one vectorizable pass before the cells are gathered. valid[i] tells whether
+		// velocities[i] was set. Returns the number of valid samples.
+		size_t getUVWatInterpolated(glm::vec3 const *positions, size_t count, float time, glm::vec3 *velocities, bool *valid) const;
+		size_t getUVWatInterpolated(glm::vec3 const *positions, size_t count, TimeBracket const &bracket, glm::vec3 *velocities, bool *valid) const;
+
+		// Fourth-order Runge-Kutta step of count positions through the flow at time, moving them by velocity * step.
+		// The stages are run for batches of positions, sampling each batch with one call to the batch sampler.
+		// valid[i] is false, and newPositions[i] left as it was, if a stage position was outside the grid or water.
+		// Returns the number of valid steps. With FLOWGRID_SIMD, the stages and the sampler's corner weights and
+		// sums run on SSE registers unless m_bUseSIMD is cleared.
+		size_t advectRK4(glm::vec3 const *positions, size_t count, float time, float step, glm::vec3 *newPositions, bool *valid) const;
 		//bool getUVTSat(float lonX, float latY, float depth, float time, float *u, float *v, float *t, float *s);
-		bool getIsWaterAt(float lonX, float latY, float depth, float time);
+		bool getIsWaterAt(float lonX, float latY, float depth, float time) const;
 		//float getBathyDepthAt(float lonX, float latY);
 		//void getInfoOnWaterCellsAt(float lonX, float latY, int *numCells, );
 
 		//void setScaleDepthMinMax(float min, float max);
 
-		bool contains(float x, float y);
-		bool contains(float x, float y, float z);
+		bool contains(float x, float y) const;
+		bool contains(float x, float y, float z) const;
 		
 		//dynamic terrain mod:
 		int getNumXYCells();
@@ -82,26 +154,23 @@ public:
 		int m_nGridSize2d, m_nGridSize3d, m_nGridSize4d;
 		int m_nXYZCells, m_nXYCells;
 
-		
-		float m_fLastTimeRequested;
-		bool m_bLastTimeOnTimestep;
-		int m_iLastTime1, m_iLastTime2;
-		float m_fLastTimeFactor1, m_fLastTimeFactor2;
 	
 		float m_fMaxVelocity;
+		bool m_bUseSIMD;	// SSE sampling and RK4 steps if FLOWGRID_SIMD is defined, clear to run the scalar code
 
-		float* m_arrfUValues;
-		float* m_arrfVValues;
-		float* m_arrfWValues;
-		float* m_arrfVelocityValues;
+		std::vector<glm::vec4> m_vCells;	// (u, v, w, |velocity|) per cell, t-outermost and x-innermost
+		std::vector<glm::i16vec4> m_vQuantizedCells;	// used instead of m_vCells if the grid is quantized
+		glm::vec4 m_vec4QuantizeOffset, m_vec4QuantizeScale;	// cell = offset + scale * quantized cell
 		//float* tValues;
 		//float* sValues;
-		float* m_arrfTimes;
+		std::vector<float> m_vfTimes;
 		int m_nTimesteps;
 		
 		int m_nActiveTimestep;
 
-		bool* m_arrbIsWater;
+		// water mask bitset, padded to whole 32-bit words per x row so rows can be written by different threads
+		std::vector<unsigned int> m_vuiWaterMask;
+		int m_nWaterMaskRowWords;
 				
 		//float *bathyDepth2d;
 		//float minBathyDepth;
@@ -112,6 +181,7 @@ public:
 		//particle sys stuff:
 		bool m_bIllustrativeParticlesEnabled;
 		int m_nIllustrativeParticles;
+		int m_nActiveIllustrativeParticles;	// particles advected in this grid, counted by the particle system each update
 		glm::vec3 m_vec3IllustrativeParticlesColor;
 
 		float m_fIllustrativeParticleVelocityScale;
@@ -124,6 +194,87 @@ public:
 
 		float m_fMinTime;
 		float m_fMaxTime;
+
+private:
+		// Reads all cell records, which files store x-outermost and t-innermost, and transposes them into the
+		// t-outermost, x-innermost storage arrays. The file is read in large chunks of whole x slabs; each read
+		// overlaps the transpose of the previous chunk, which is split across threads by y rows.
+		void loadCells(FILE *file, bool hasIsWater, bool hasW);
+
+		// Transposes the rows yBegin to yEnd of nSlabs x slabs starting at x0, each holding nTimesteps records per cell
+		// for the timesteps from firstTimestep on, returns the largest velocity
+		float transposeCells(char const *records, int x0, int nSlabs, int yBegin, int yEnd, bool hasIsWater, bool hasW, int firstTimestep, int nTimesteps);
+
+		// Streaming: reuses the timestep file for filename if it matches, writes it otherwise. Returns the range of
+		// the cell values (u, v, w, |velocity|) over all timesteps.
+		bool openTimestepFile(const char* filename, long long cellsOffset, bool hasIsWater, bool hasW, glm::vec4 *minValues, glm::vec4 *maxValues);
+		bool writeTimestepFile(const char* filename, long long cellsOffset, bool hasIsWater, bool hasW, long long sourceBytes, glm::vec4 *minValues, glm::vec4 *maxValues);
+		void readTimestep(FILE *file, int t, std::vector<char> &buffer);
+		void streamThread();
+
+		// Storage slot of timestep t. When streaming, a timestep gets the slot it is read into.
+		int getSlot(int t) const;
+		bool isResident(int t) const;
+		bool isResident(TimeBracket const &bracket) const;
+
+		// Quantization: the scale of each component spreads its range over the int16 values; values outside it are clamped
+		void setQuantizationRange(glm::vec4 const &minValues, glm::vec4 const &maxValues);
+		void quantizeCells();	// converts the loaded cells and frees them
+		glm::vec4 getCell(size_t index) const;
+		void setCell(size_t index, glm::vec4 const &cell);
+
+		// Batch sampler body for either storage, decoding quantized cells once per sample after interpolating
+		template <typename CellType>
+		size_t interpolateCells(CellType const *cellData, glm::vec3 const *positions, size_t count, TimeBracket const &bracket, glm::vec3 *velocities, bool *valid) const;
+
+		size_t getCellIndex(int x, int y, int z, int t) const;
+		size_t getWaterMaskWord(int x, int y, int z, int t) const;
+
+		// Depth level lookup for increasing levels: the range of the levels is split into uniform buckets narrower
+		// than the smallest gap between levels, so each bucket holds at most one level. A bucket stores how many
+		// levels lie in buckets below it, which leaves one comparison to find the level of a depth. Empty if the
+		// table would be too large.
+		std::vector<float> m_vfSortedDepths;
+		std::vector<int> m_viDepthBucketLevels;
+		bool m_bDepthsDescending;
+		float m_fDepthBucketsPerUnit;
+
+		// Counts a sampler in on the storage slots of the timesteps it reads, for as long as it reads them. The
+		// reading thread marks a slot as being replaced before waiting for the slot's readers to leave, and a sampler
+		// counts itself in before checking residency, so either the sampler sees that the timestep is gone and fails,
+		// or the reading thread waits for it. Samplers never wait. Does nothing if all timesteps are loaded.
+		class ReadScope {
+		public:
+			ReadScope(FlowGrid const &grid, int t1, int t2);
+			~ReadScope();
+
+			bool resident() const
+			{
+				return m_bResident;
+			}
+
+		private:
+			FlowGrid const &m_Grid;
+			int m_iSlots[2];
+			bool m_bResident;
+		};
+
+		// Streaming: timestep held by each storage slot (-1 while it is being read), the slot of each timestep
+		// (-1 if it is in none) and the samplers reading each slot. The window holds as many timesteps as there are
+		// slots, from m_iStreamWindowStart on and wrapping around to the first timesteps, since playback loops. The
+		// reading thread only replaces timesteps outside the window, once no sampler is reading them (see ReadScope).
+		bool m_bQuantize;
+		int m_nStreamSlots;		// 0 if all timesteps are loaded
+		std::unique_ptr<std::atomic<int>[]> m_pSlotTimesteps;
+		std::unique_ptr<std::atomic<int>[]> m_pTimestepSlots;
+		mutable std::unique_ptr<std::atomic<int>[]> m_pSlotReaders;
+		std::string m_strTimestepFile;
+		std::thread m_StreamThread;
+		std::mutex m_StreamMutex;
+		std::condition_variable m_cvStreamRequest, m_cvStreamRead;
+		int m_iStreamWindowStart;
+		bool m_bStreamStop;
+		std::atomic<int> m_nStreamStalls;
 };
 
 #endif
@@ -0,0 +1,156 @@
+#include "FlowGridLookup.h"
+
+#include <algorithm>
+#include <limits>
+
+FlowGridLookup::FlowGridLookup()
+	: m_vec3Min(0.f)
+	, m_vec3Max(0.f)
+	, m_vec3BinsPerUnit(0.f)
+	, m_ivec3Bins(0)
+{
+}
+
+FlowGridLookup::~FlowGridLookup()
+{
+}
+
+void FlowGridLookup::update(std::vector<FlowGrid*> const &grids)
+{
+	if (grids == m_vpGrids)
+		return;
+
+	m_vpGrids = grids;
+	build();
+}
+
+void FlowGridLookup::build()
+{
+	m_vuiBinStarts.clear();
+	m_vuiBinGrids.clear();
+	m_ivec3Bins = glm::ivec3(0);
+
+	if (m_vpGrids.size() < FLOWGRIDLOOKUP_MIN_GRIDS)
+		return;
+
+	std::vector<glm::vec3> gridMins, gridMaxs;
+	glm::vec3 minExtent(std::numeric_limits<float>::max());
+	for (auto const &grid : m_vpGrids)
+	{
+		// depths may be stored in either order
+		gridMins.push_back(glm::vec3(grid->m_fXMin, grid->m_fYMin, (std::min)(grid->getMinDepth(), grid->getMaxDepth())));
+		gridMaxs.push_back(glm::vec3(grid->m_fXMax, grid->m_fYMax, (std::max)(grid->getMinDepth(), grid->getMaxDepth())));
+
+		// flat grids don't set the bin size
+		glm::vec3 extent = gridMaxs.back() - gridMins.back();
+		for (int axis = 0; axis < 3; ++axis)
+			if (extent[axis] > 0.f)
+				minExtent[axis] = (std::min)(minExtent[axis], extent[axis]);
+	}
+
+	m_vec3Min = gridMins[0];
+	m_vec3Max = gridMaxs[0];
+	for (size_t i = 1u; i < m_vpGrids.size(); ++i)
+	{
+		m_vec3Min = glm::min(m_vec3Min, gridMins[i]);
+		m_vec3Max = glm::max(m_vec3Max, gridMaxs[i]);
+	}
+
+	glm::vec3 extent = m_vec3Max - m_vec3Min;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (extent[axis] > 0.f)
+			m_ivec3Bins[axis] = static_cast<int>((std::min)(std::ceil(2.f * extent[axis] / minExtent[axis]), static_cast<float>(FLOWGRIDLOOKUP_MAX_BINS_PER_AXIS)));
+		else
+			m_ivec3Bins[axis] = 1;
+
+		m_vec3BinsPerUnit[axis] = extent[axis] > 0.f ? static_cast<float>(m_ivec3Bins[axis]) / extent[axis] : 0.f;
+	}
+
+	size_t nBins = static_cast<size_t>(m_ivec3Bins.x) * m_ivec3Bins.y * m_ivec3Bins.z;
+
+	glm::vec3 binSize = extent / glm::vec3(m_ivec3Bins);
+
+	// add the grids to the bins they overlap in collection order. Grids after one covering a whole bin are never
+	// reached there, which keeps bins inside nested grids short.
+	std::vector<std::vector<unsigned int>> binGrids(nBins);
+	std::vector<bool> binCovered(nBins, false);
+	for (size_t i = 0u; i < m_vpGrids.size(); ++i)
+	{
+		glm::ivec3 first = getBin(gridMins[i]);
+		glm::ivec3 last = getBin(gridMaxs[i]);
+		bool containsAny = m_vpGrids[i]->getMinDepth() <= m_vpGrids[i]->getMaxDepth();
+
+		for (int z = first.z; z <= last.z; ++z)
+			for (int y = first.y; y <= last.y; ++y)
+				for (int x = first.x; x <= last.x; ++x)
+				{
+					size_t bin = (static_cast<size_t>(z) * m_ivec3Bins.y + y) * m_ivec3Bins.x + x;
+					if (binCovered[bin])
+						continue;
+
+					binGrids[bin].push_back(static_cast<unsigned int>(i));
+
+					// with some margin, as positions are binned with rounding
+					glm::vec3 binMin = m_vec3Min + (glm::vec3(x, y, z) - 0.01f) * binSize;
+					glm::vec3 binMax = m_vec3Min + (glm::vec3(x + 1, y + 1, z + 1) + 0.01f) * binSize;
+					if (containsAny && glm::all(glm::lessThanEqual(gridMins[i], binMin)) && glm::all(glm::greaterThanEqual(gridMaxs[i], binMax)))
+						binCovered[bin] = true;
+				}
+	}
+
+	m_vuiBinStarts.resize(nBins + 1u);
+	m_vuiBinStarts[0] = 0u;
+	for (size_t i = 0u; i < nBins; ++i)
+	{
+		m_vuiBinGrids.insert(m_vuiBinGrids.end(), binGrids[i].begin(), binGrids[i].end());
+		m_vuiBinStarts[i + 1u] = static_cast<unsigned int>(m_vuiBinGrids.size());
+	}
+}
+
+glm::ivec3 FlowGridLookup::getBin(glm::vec3 const &pos) const
+{
+	// positions are within the bounds, so only the upper edge needs clamping
+	return glm::ivec3(
+		(std::min)(static_cast<int>((pos.x - m_vec3Min.x) * m_vec3BinsPerUnit.x), m_ivec3Bins.x - 1),
+		(std::min)(static_cast<int>((pos.y - m_vec3Min.y) * m_vec3BinsPerUnit.y), m_ivec3Bins.y - 1),
+		(std::min)(static_cast<int>((pos.z - m_vec3Min.z) * m_vec3BinsPerUnit.z), m_ivec3Bins.z - 1));
+}
+
+FlowGrid* FlowGridLookup::findGrid(glm::vec3 const &pos) const
+{
+	if (m_vpGrids.size() < FLOWGRIDLOOKUP_MIN_GRIDS)
+	{
+		//contains() compares false to NaN, so it would accept them
+		if (glm::any(glm::isnan(pos)))
+			return NULL;
+
+		for (auto const &grid : m_vpGrids)
+			if (grid->contains(pos.x, pos.y, pos.z))
+				return grid;
+
+		return NULL;
+	}
+
+	// also rejects NaN positions
+	if (m_vuiBinGrids.empty() ||
+		!(pos.x >= m_vec3Min.x && pos.x <= m_vec3Max.x &&
+		pos.y >= m_vec3Min.y && pos.y <= m_vec3Max.y &&
+		pos.z >= m_vec3Min.z && pos.z <= m_vec3Max.z))
+		return NULL;
+
+	// same as getBin, without returning the bin through memory
+	int x = (std::min)(static_cast<int>((pos.x - m_vec3Min.x) * m_vec3BinsPerUnit.x), m_ivec3Bins.x - 1);
+	int y = (std::min)(static_cast<int>((pos.y - m_vec3Min.y) * m_vec3BinsPerUnit.y), m_ivec3Bins.y - 1);
+	int z = (std::min)(static_cast<int>((pos.z - m_vec3Min.z) * m_vec3BinsPerUnit.z), m_ivec3Bins.z - 1);
+	size_t binIndex = (static_cast<size_t>(z) * m_ivec3Bins.y + y) * m_ivec3Bins.x + x;
+
+	for (unsigned int i = m_vuiBinStarts[binIndex]; i < m_vuiBinStarts[binIndex + 1u]; ++i)
+	{
+		FlowGrid *grid = m_vpGrids[m_vuiBinGrids[i]];
+		if (grid->contains(pos.x, pos.y, pos.z))
+			return grid;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+#include "FlowGrid.h"
+
+#define FLOWGRIDLOOKUP_MIN_GRIDS 4				// fewer grids are tested in turn
+#define FLOWGRIDLOOKUP_MAX_BINS_PER_AXIS 32
+
+// Uniform bins over the bounds of a set of flow grids, so finding the grid a position lies in only tests the grids
+// overlapping its bin instead of every grid. Bins are about half the size of the smallest grid along each axis. Each bin
+// lists its grids in collection order, so findGrid returns the same grid as testing contains() on every grid in turn,
+// except for NaN positions, which are in no grid.
+class FlowGridLookup
+{
+public:
+	FlowGridLookup();
+	~FlowGridLookup();
+
+	// Rebuilds the bins if the grids are not the ones they were built for
+	void update(std::vector<FlowGrid*> const &grids);
+
+	// First grid containing pos, or NULL, also for NaN positions
+	FlowGrid* findGrid(glm::vec3 const &pos) const;
+
+private:
+	void build();
+	glm::ivec3 getBin(glm::vec3 const &pos) const;
+
+	std::vector<FlowGrid*> m_vpGrids;
+	glm::vec3 m_vec3Min, m_vec3Max;
+	glm::vec3 m_vec3BinsPerUnit;
+	glm::ivec3 m_ivec3Bins;
+	std::vector<unsigned int> m_vuiBinStarts;	// bin i holds m_vuiBinGrids[m_vuiBinStarts[i]] up to m_vuiBinGrids[m_vuiBinStarts[i + 1]]
+	std::vector<unsigned int> m_vuiBinGrids;
+};
@@ -31,14 +31,14 @@ void FlowScene::init()
 	if (0)
 	{
 		flowGrids.push_back("resources/data/flowgrid/gb.fg");
-		m_pFlowVolume = new FlowVolume(flowGrids, false);
+		m_pFlowVolume = new FlowVolume(flowGrids, false, true, FLOWSCENE_QUANTIZE_GRIDS);
 		m_pFlowVolume->setDimensions(glm::vec3(fmin(m_vec3RoomSize.x, m_vec3RoomSize.z) * 0.5f, fmin(m_vec3RoomSize.x, m_vec3RoomSize.z) * 0.5f, m_vec3RoomSize.y * 0.05f));
 		m_pFlowVolume->setParticleVelocityScale(0.5f);
 	}
 	else
 	{
 		flowGrids.push_back("resources/data/bin/vectors_400.bov");
-		m_pFlowVolume = new FlowVolume(flowGrids, true, false);
+		m_pFlowVolume = new FlowVolume(flowGrids, true, false, FLOWSCENE_QUANTIZE_GRIDS);
 		m_pFlowVolume->setParticleVelocityScale(0.01f);
 
 	}
@@ -125,7 +125,7 @@ void FlowScene::update()
 
 
 		//if (!BehaviorManager::getInstance().getBehavior("flowcurator"))
-		//	BehaviorManager::getInstance().addBehavior("flowcurator", new FlowFieldCurator(m_pTDM, m_pFlowVolume));
+		//	BehaviorManager::getInstance().addBehavior("flowcurator", new FlowFieldCurator(m_pTDM, m_pFlowVolume, 32, FLOWSCENE_QUANTIZE_GRIDS));
 
 		//if (!BehaviorManager::getInstance().getBehavior("debugprobe"))
 		//	BehaviorManager::getInstance().addBehavior("debugprobe", new DebugProbe(m_pTDM->getPrimaryController(), m_pFlowVolume));
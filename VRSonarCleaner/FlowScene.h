@@ -4,6 +4,8 @@
 #include "FlowVolume.h"
 #include <SDL.h>
 
+#define FLOWSCENE_QUANTIZE_GRIDS false	// store the flow grids as 16-bit cells, halving their memory
+
 class FlowScene :
 	public Scene
 {
@@ -5,7 +5,7 @@
 
 using namespace std::chrono_literals;
 
-FlowVolume::FlowVolume(std::vector<std::string> flowGrids, bool useZInsteadOfDepth, bool fgFile)
+FlowVolume::FlowVolume(std::vector<std::string> flowGrids, bool useZInsteadOfDepth, bool fgFile, bool quantize)
 	: DataVolume(
 		glm::vec3(0.f, 1.f, 0.f), 
 		glm::angleAxis(glm::radians(-90.f), glm::vec3(1.f, 0.f, 0.f)),
@@ -21,7 +21,7 @@ FlowVolume::FlowVolume(std::vector<std::string> flowGrids, bool useZInsteadOfDep
 	//Z-toward monitor
 
 	for (auto fg : flowGrids)
-		addFlowGrid(fg, useZInsteadOfDepth, fgFile);
+		addFlowGrid(fg, useZInsteadOfDepth, fgFile, quantize);
 		
 	m_fFlowRoomTime = m_fFlowRoomMinTime;
 	m_tpLastTimeUpdate = std::chrono::high_resolution_clock::now();
@@ -34,12 +34,18 @@ FlowVolume::~FlowVolume()
 
 }
 
-void FlowVolume::addFlowGrid(std::string fileName, bool useZInsteadOfDepth, bool fgFile)
+void FlowVolume::addFlowGrid(std::string fileName, bool useZInsteadOfDepth, bool fgFile, bool quantize)
 {
 	// Check if flowgrid already exists with that name
 	removeFlowGrid(fileName);
 
-	FlowGrid* tempFG = fgFile ? new FlowGrid(fileName.c_str(), useZInsteadOfDepth) : new FlowGrid(fileName.c_str(), 0.f, 1.f, 400, 0.f, 1.f, 400, 0.f, 1.f, 400);
+	int streamLookahead = -1;
+	std::error_code ec;
+	uintmax_t fileBytes = std::experimental::filesystem::v1::file_size(fileName, ec);
+	if (fgFile && !ec && fileBytes > FLOWVOLUME_STREAM_MIN_FILE_BYTES)
+		streamLookahead = FLOWVOLUME_STREAM_LOOKAHEAD;
+
+	FlowGrid* tempFG = fgFile ? new FlowGrid(fileName.c_str(), useZInsteadOfDepth, streamLookahead, quantize) : new FlowGrid(fileName.c_str(), 0.f, 1.f, 400, 0.f, 1.f, 400, 0.f, 1.f, 400, quantize);
 	m_vpFlowGrids.push_back(tempFG);
 	add(tempFG);
 
@@ -63,9 +69,9 @@ void FlowVolume::removeFlowGrid(std::string fileName)
 		if (m_pParticleSystem)
 		{
 			m_pParticleSystem->m_vpFlowGridCollection = m_vpFlowGrids;
-			for (auto &p : m_pParticleSystem->m_vpParticles)
-				if (p->m_pFlowGrid == (*fgPresent))
-					p->m_pFlowGrid = NULL;
+			for (auto &grid : m_pParticleSystem->m_Particles.m_vpFlowGrids)
+				if (grid == (*fgPresent))
+					grid = NULL;
 		}
 
 		remove(*fgPresent);
@@ -8,6 +8,7 @@
 #include <algorithm>
 #include <chrono>
 #include <future>
+#include <filesystem>
 
 #include <glm.hpp>
 
@@ -16,14 +17,18 @@
 #include "IllustrativeParticleSystem.h"
 #include "FlowGrid.h"
 
+#define FLOWVOLUME_STREAM_MIN_FILE_BYTES (static_cast<uintmax_t>(2u) << 30)	// larger flowgrid files are streamed instead of loaded
+#define FLOWVOLUME_STREAM_LOOKAHEAD 8											// timesteps read ahead of playback when streaming
+
 class FlowVolume
 	: public DataVolume
 {
 public:
-	FlowVolume(std::vector<std::string> flowGrids, bool useZInsteadOfDepth, bool fgFile = true);
+	// If quantize is set, the grids are stored as 16-bit cells, which halves their memory but rounds the velocities
+	FlowVolume(std::vector<std::string> flowGrids, bool useZInsteadOfDepth, bool fgFile = true, bool quantize = false);
 	virtual ~FlowVolume();
 
-	void addFlowGrid(std::string fileName, bool useZInsteadOfDepth, bool fgFile = true);
+	void addFlowGrid(std::string fileName, bool useZInsteadOfDepth, bool fgFile = true, bool quantize = false);
 	void removeFlowGrid(std::string fileName);
 
 	glm::vec3 getFlowWorldCoords(glm::vec3 pt_WorldCoords);
@@ -10,6 +10,7 @@
 #define COLOR_ATTRIB_LOCATION					3
 #define INSTANCE_POSITION_ATTRIB_LOCATION		4
 #define INSTANCE_COLOR_ATTRIB_LOCATION			5
+#define INSTANCE_HIGHLIGHT_ATTRIB_LOCATION		6
 
 
 // SHADER UNIFORMS: layout(location = _____)
@@ -37,4 +38,8 @@
 // LIGHTING DEFINITIONS
 #define MAX_LIGHTS 10
 
+
+// POINT CLOUD DEFINITIONS
+#define POINT_HIGHLIGHT_BLINK_PERIOD 0.25f // in seconds
+
 #endif // PREAMBLE_GLSL
\ No newline at end of file
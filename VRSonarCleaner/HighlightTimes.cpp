@@ -0,0 +1,122 @@
+#include "HighlightTimes.h"
+
+#include <algorithm>
+
+HighlightTimes::HighlightTimes()
+	: m_bFullUploadNeeded(true)
+{
+}
+
+HighlightTimes::~HighlightTimes()
+{
+}
+
+void HighlightTimes::resize(unsigned int nSlots)
+{
+	m_vfTimes.assign(nSlots, -1.f);
+	m_vuiDirtySlots.clear();
+	m_bFullUploadNeeded = true;
+}
+
+void HighlightTimes::clear()
+{
+	m_vfTimes.clear();
+	m_vuiDirtySlots.clear();
+	m_bFullUploadNeeded = true;
+}
+
+void HighlightTimes::set(unsigned int slot, float seconds)
+{
+	m_vfTimes[slot] = seconds;
+
+	// a pending full upload will pick up the change anyway
+	if (!m_bFullUploadNeeded)
+		m_vuiDirtySlots.push_back(slot);
+}
+
+float HighlightTimes::get(unsigned int slot) const
+{
+	return m_vfTimes[slot];
+}
+
+void HighlightTimes::resetAll()
+{
+	std::fill(m_vfTimes.begin(), m_vfTimes.end(), -1.f);
+	m_vuiDirtySlots.clear();
+	m_bFullUploadNeeded = true;
+}
+
+void HighlightTimes::permute(std::vector<unsigned int> const &sourceSlots)
+{
+	std::vector<float> times(sourceSlots.size());
+
+	for (size_t slot = 0u; slot < sourceSlots.size(); ++slot)
+		times[slot] = m_vfTimes[sourceSlots[slot]];
+
+	m_vfTimes.swap(times);
+	m_vuiDirtySlots.clear();
+	m_bFullUploadNeeded = true;
+}
+
+bool HighlightTimes::uploadNeeded() const
+{
+	return m_bFullUploadNeeded || m_vuiDirtySlots.size() > 0u;
+}
+
+bool HighlightTimes::fullUploadNeeded() const
+{
+	return m_bFullUploadNeeded;
+}
+
+size_t HighlightTimes::upload(UploadFunction const &upload)
+{
+	size_t bytes = 0u;
+
+	if (m_bFullUploadNeeded)
+	{
+		if (m_vfTimes.size() > 0u)
+			upload(0u, static_cast<unsigned int>(m_vfTimes.size()), m_vfTimes.data());
+
+		bytes = m_vfTimes.size() * sizeof(float);
+	}
+	else
+	{
+		// coalesce changed slots into contiguous runs and only upload those
+		std::sort(m_vuiDirtySlots.begin(), m_vuiDirtySlots.end());
+
+		size_t runStart = 0u;
+		for (size_t i = 1u; i <= m_vuiDirtySlots.size(); ++i)
+		{
+			if (i < m_vuiDirtySlots.size() && m_vuiDirtySlots[i] <= m_vuiDirtySlots[i - 1u] + 1u)
+				continue;
+
+			unsigned int first = m_vuiDirtySlots[runStart];
+			unsigned int count = m_vuiDirtySlots[i - 1u] - first + 1u;
+
+			upload(first, count, &m_vfTimes[first]);
+			bytes += count * sizeof(float);
+
+			runStart = i;
+		}
+	}
+
+	markUploaded();
+
+	return bytes;
+}
+
+void HighlightTimes::markUploaded()
+{
+	m_vuiDirtySlots.clear();
+	m_bFullUploadNeeded = false;
+}
+
+unsigned int HighlightTimes::size() const
+{
+	return static_cast<unsigned int>(m_vfTimes.size());
+}
+
+float const* HighlightTimes::getData() const
+{
+	return m_vfTimes.data();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <vector>
+#include <functional>
+
+// CPU side of the per-instance highlight start times that the point shader animates from.
+// Times are stored densely per render slot (negative = not highlighted) because every instanced and indirect
+// draw fetches one attribute per instance. Only the slots written since the last upload are sent to the GPU,
+// coalesced into contiguous runs, unless a full upload has been requested.
+class HighlightTimes
+{
+public:
+	typedef std::function<void(unsigned int first, unsigned int count, float const *data)> UploadFunction;
+
+	HighlightTimes();
+	~HighlightTimes();
+
+	// Sets the number of slots; all slots are reset to not highlighted and a full upload is requested
+	void resize(unsigned int nSlots);
+	void clear();
+
+	void set(unsigned int slot, float seconds);
+	float get(unsigned int slot) const;
+
+	// Unhighlights every slot and requests a full upload
+	void resetAll();
+
+	// Reorders the slots so that new slot i holds the time of old slot sourceSlots[i], e.g. after a LOD rebuild
+	void permute(std::vector<unsigned int> const &sourceSlots);
+
+	bool uploadNeeded() const;
+	bool fullUploadNeeded() const;
+
+	// Calls upload for every changed run (or once for all slots after a full upload request), then clears
+	// the changes. Returns the number of bytes passed to upload.
+	size_t upload(UploadFunction const &upload);
+
+	// Marks the current times as present on the GPU, e.g. after creating the buffer from getData()
+	void markUploaded();
+
+	unsigned int size() const;
+	float const* getData() const;
+
+private:
+	std::vector<float> m_vfTimes;
+	std::vector<unsigned int> m_vuiDirtySlots;
+	bool m_bFullUploadNeeded;
+};
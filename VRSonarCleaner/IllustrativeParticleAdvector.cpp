@@ -0,0 +1,222 @@
+#include "IllustrativeParticleAdvector.h"
+
+#include <algorithm>
+#include <atomic>
+#include <future>
+#include <thread>
+
+IllustrativeParticleAdvector::IllustrativeParticleAdvector()
+	: m_bUseEuler(false)
+	, m_nThreads(0u)
+{
+}
+
+IllustrativeParticleAdvector::~IllustrativeParticleAdvector()
+{
+
+}
+
+void IllustrativeParticleAdvector::advect(IllustrativeParticlePool &particles, std::vector<FlowGrid*> const &flowGrids, float time, std::chrono::duration<float, std::milli> timeSinceLastUpdate, std::chrono::time_point<std::chrono::high_resolution_clock> tick)
+{
+	m_FlowGridLookup.update(flowGrids);
+
+	particles.sortLiveParticles();
+	std::vector<int> const &activeParticles = particles.getLiveParticles();
+	size_t nChunks = (activeParticles.size() + PARTICLE_SYSTEM_ADVECTION_CHUNK_SIZE - 1u) / PARTICLE_SYSTEM_ADVECTION_CHUNK_SIZE;
+	std::vector<std::vector<int>> chunkDeadParticles(nChunks);
+	std::atomic<size_t> nextChunk(0u);
+	bool haveFlowGrids = flowGrids.size() > 0u;
+
+	auto advectChunks = [&]() {
+		for (size_t chunk = nextChunk++; chunk < nChunks; chunk = nextChunk++)
+		{
+			size_t begin = chunk * PARTICLE_SYSTEM_ADVECTION_CHUNK_SIZE;
+			size_t end = (std::min)(begin + PARTICLE_SYSTEM_ADVECTION_CHUNK_SIZE, activeParticles.size());
+			advectParticles(particles, haveFlowGrids, &activeParticles[begin], end - begin, time, timeSinceLastUpdate, tick, chunkDeadParticles[chunk]);
+		}
+	};
+
+	unsigned int nThreads = m_nThreads > 0u ? m_nThreads : (std::max)(std::thread::hardware_concurrency(), 1u);
+	size_t nWorkers = (std::min)(static_cast<size_t>(nThreads), nChunks);
+
+	// this thread works on chunks as well
+	std::vector<std::future<void>> workers;
+	for (size_t i = 1u; i < nWorkers; ++i)
+		workers.push_back(std::async(std::launch::async, advectChunks));
+
+	advectChunks();
+
+	for (auto &w : workers)
+		w.get();
+
+	for (auto const &dead : chunkDeadParticles)
+		for (auto const &particle : dead)
+			particles.release(particle);
+}
+
+void IllustrativeParticleAdvector::advectParticles(IllustrativeParticlePool &particles, bool haveFlowGrids, int const *chunk, size_t count, float time, std::chrono::duration<float, std::milli> timeSinceLastUpdate, std::chrono::time_point<std::chrono::high_resolution_clock> tick, std::vector<int> &deadParticles)
+{
+	std::vector<glm::vec3> newPositions(count);
+
+	// particles to integrate with rk4, as (flowgrid, index into chunk)
+	std::vector<std::pair<FlowGrid*, size_t>> rk4Particles;
+	rk4Particles.reserve(count);
+
+	for (size_t i = 0u; i < count; ++i)
+	{
+		int particle = chunk[i];
+
+		//once attached, particles keep their flow grid; rk4/eulerForward check they are still inside it
+		FlowGrid *&flowGrid = particles.m_vpFlowGrids[particle];
+		if (!flowGrid)
+			flowGrid = m_FlowGridLookup.findGrid(particles.m_vvec3Positions[particle]);
+
+		if (flowGrid) // did we find a flow grid?
+		{
+			if (m_bUseEuler)
+				newPositions[i] = eulerForward(particles, particle, time, timeSinceLastUpdate.count());
+			else
+				rk4Particles.push_back(std::make_pair(flowGrid, i));
+		}
+		else
+		{
+			//if there are flow grids, lets kill it, so it doesn't clutter the scene
+			if (haveFlowGrids)
+			{
+				particles.reset(particle);
+				deadParticles.push_back(particle);
+			}
+			else
+			{
+				newPositions[i] = particles.m_vvec3Positions[particle];
+			}
+		}
+	}
+
+	// integrate the particles of each flowgrid in batches
+	std::sort(rk4Particles.begin(), rk4Particles.end());
+
+	int batchParticles[FLOWGRID_RK4_BATCH];
+	glm::vec3 batchPositions[FLOWGRID_RK4_BATCH];
+
+	for (size_t begin = 0u; begin < rk4Particles.size();)
+	{
+		FlowGrid *flowGrid = rk4Particles[begin].first;
+
+		size_t n = 0u;
+		while (begin + n < rk4Particles.size() && n < FLOWGRID_RK4_BATCH && rk4Particles[begin + n].first == flowGrid)
+		{
+			batchParticles[n] = chunk[rk4Particles[begin + n].second];
+			n++;
+		}
+
+		rk4(particles, flowGrid, batchParticles, n, time, timeSinceLastUpdate.count(), batchPositions);
+
+		for (size_t i = 0u; i < n; ++i)
+			newPositions[rk4Particles[begin + i].second] = batchPositions[i];
+
+		begin += n;
+	}
+
+	std::chrono::duration<float> prodTimeSeconds = timeSinceLastUpdate;
+
+	for (size_t i = 0u; i < count; ++i)
+	{
+		int particle = chunk[i];
+
+		// removed above
+		if (particles.isDead(particle))
+			continue;
+
+		glm::vec3 currentPos = particles.m_vvec3Positions[particle];
+		glm::vec3 newPos = newPositions[i];
+
+		newPos.z += particles.m_vfGravity[particle] / prodTimeSeconds.count();
+
+		if (!particles.isDying(particle))
+			particles.m_vvec3Velocities[particle] = (newPos - currentPos) / prodTimeSeconds.count();
+
+		particles.updatePosition(particle, tick, newPos);
+
+		if (particles.isDead(particle))
+			deadParticles.push_back(particle);
+	}//end for all particles
+}
+
+glm::vec3 IllustrativeParticleAdvector::eulerForward(IllustrativeParticlePool &particles, int particle, float time, float delta)
+{
+	glm::vec3 currentPos = particles.m_vvec3Positions[particle];
+	FlowGrid *flowGrid = particles.m_vpFlowGrids[particle];
+	glm::vec3 vel;
+
+	//get UVW at current position (checks in bounds or not)
+	if (!flowGrid->getUVWatInterpolated(currentPos.x, currentPos.y, currentPos.z, time, &vel.x, &vel.y, &vel.z))
+	{
+		particles.setDying(particle);
+		return currentPos;
+	}
+
+
+	//calc new position
+	float prodTimeVelocity = delta * flowGrid->m_fIllustrativeParticleVelocityScale;
+
+	glm::vec3 ret(currentPos + vel * prodTimeVelocity * 10.f);
+
+	if (!flowGrid->contains(ret.x, ret.y, ret.z))
+		particles.setDying(particle);
+
+	return ret;
+}
+
+void IllustrativeParticleAdvector::rk4(IllustrativeParticlePool &particles, FlowGrid *flowGrid, int const *batch, size_t count, float time, float delta, glm::vec3 *newPositions)
+{
+	float prodTimeVelocity = delta * flowGrid->m_fIllustrativeParticleVelocityScale;
+
+	glm::vec3 startPos[FLOWGRID_RK4_BATCH];
+	bool valid[FLOWGRID_RK4_BATCH];
+
+	for (size_t first = 0u; first < count; first += FLOWGRID_RK4_BATCH)
+	{
+		size_t n = (std::min)(count - first, static_cast<size_t>(FLOWGRID_RK4_BATCH));
+
+		for (size_t i = 0u; i < n; ++i)
+			startPos[i] = particles.m_vvec3Positions[batch[first + i]];
+
+		flowGrid->advectRK4(startPos, n, time, prodTimeVelocity, newPositions + first, valid);
+
+		for (size_t i = 0u; i < n; ++i)
+		{
+			int particle = batch[first + i];
+
+			if (!valid[i])
+			{
+				newPositions[first + i] = eulerForward(particles, particle, time, delta);
+				continue;
+			}
+
+			//check in bounds or not
+			if (!flowGrid->contains(newPositions[first + i].x, newPositions[first + i].y, newPositions[first + i].z))
+				particles.setDying(particle);
+		}
+	}
+}
+
+void IllustrativeParticleAdvector::setEulerIntegration()
+{
+	m_bUseEuler = true;
+}
+
+void IllustrativeParticleAdvector::setRK4Integration()
+{
+	m_bUseEuler = false;
+}
+
+bool IllustrativeParticleAdvector::isEulerIntegration() const
+{
+	return m_bUseEuler;
+}
+
+void IllustrativeParticleAdvector::setThreads(unsigned int nThreads)
+{
+	m_nThreads = nThreads;
+}
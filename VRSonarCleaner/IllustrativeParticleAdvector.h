@@ -0,0 +1,50 @@
+#ifndef __IllustrativeParticleAdvector_h__
+#define __IllustrativeParticleAdvector_h__
+
+#include <vector>
+#include <chrono>
+
+#include <glm.hpp>
+
+#include "FlowGrid.h"
+#include "FlowGridLookup.h"
+#include "IllustrativeParticlePool.h"
+
+#define PARTICLE_SYSTEM_ADVECTION_CHUNK_SIZE 1024	// particles advected per task
+
+// Moves the live particles of a pool through the flowgrids with Euler or RK4 integration, on worker threads.
+// Kept apart from IllustrativeParticleSystem, which owns the GL buffers, so it runs without a GL context.
+class IllustrativeParticleAdvector
+{
+public:
+	IllustrativeParticleAdvector();
+	virtual ~IllustrativeParticleAdvector();
+
+	// Advects the live particles in fixed-size chunks. Worker tasks take the next chunk until none are left, and
+	// particles that died in a chunk are collected per chunk and released in chunk order, so the result does not
+	// depend on the number of threads. Particles outside every flowgrid die, unless there are no flowgrids.
+	void advect(IllustrativeParticlePool &particles, std::vector<FlowGrid*> const &flowGrids, float time, std::chrono::duration<float, std::milli> timeSinceLastUpdate, std::chrono::time_point<std::chrono::high_resolution_clock> tick);
+
+	void setEulerIntegration();
+	void setRK4Integration();
+	bool isEulerIntegration() const;
+
+	// Number of threads advecting particles, 0 for the hardware concurrency
+	void setThreads(unsigned int nThreads);
+
+private:
+	bool m_bUseEuler;
+	unsigned int m_nThreads;
+
+	FlowGridLookup m_FlowGridLookup;
+
+	// Advects count particles, collecting those that died or left every flowgrid (which are reset) in deadParticles
+	void advectParticles(IllustrativeParticlePool &particles, bool haveFlowGrids, int const *chunk, size_t count, float time, std::chrono::duration<float, std::milli> timeSinceLastUpdate, std::chrono::time_point<std::chrono::high_resolution_clock> tick, std::vector<int> &deadParticles);
+
+	glm::vec3 eulerForward(IllustrativeParticlePool &particles, int particle, float time, float delta);
+	// Integrates count particles in flowGrid with FlowGrid::advectRK4. Particles with a stage position outside the
+	// grid or water fall back to eulerForward.
+	void rk4(IllustrativeParticlePool &particles, FlowGrid *flowGrid, int const *batch, size_t count, float time, float delta, glm::vec3 *newPositions);
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "IllustrativeParticlePool.h"
+
+using namespace std::chrono_literals;
+
+IllustrativeParticlePool::IllustrativeParticlePool(int capacity)
+	: m_nCapacity(capacity)
+	, m_iFirstFree(capacity > 0 ? 0 : -1)
+	, m_bLiveSorted(true)
+{
+	size_t n = static_cast<size_t>(capacity);
+
+	m_vvec3Positions.resize(n);
+	m_vvec3Velocities.resize(n);
+	m_vvec3Colors.resize(n);
+	m_vfGravity.resize(n);
+	m_vpFlowGrids.resize(n);
+	m_vucFlags.resize(n);
+	m_vtpBirthTimes.resize(n);
+	m_vtpTimesToStartDying.resize(n);
+	m_vmsTrailTimes.resize(n);
+	m_vfLastUpdateTimes.resize(n);
+	m_vfLiveTimeElapsed.resize(n);
+
+	m_vvec3TrailPositions.resize(n * MAX_NUM_TRAIL_POSITIONS);
+	m_vfTrailTimes.resize(n * MAX_NUM_TRAIL_POSITIONS);
+	m_vusTrailStarts.resize(n);
+	m_vusTrailCounts.resize(n);
+
+	m_viLiveParticles.reserve(n);
+	m_viLiveSeeds.reserve(n);
+	m_viLiveIndices.resize(n, -1);
+	m_viSeedIndices.resize(n, -1);
+	m_viNextFree.resize(n);
+	m_vuiLiveMask.resize((n + 31u) / 32u, 0u);
+
+	// all slots start out free
+	for (int i = 0; i < capacity; ++i)
+	{
+		reset(i);
+		m_viNextFree[i] = i + 1 < capacity ? i + 1 : -1;
+	}
+}
+
+IllustrativeParticlePool::~IllustrativeParticlePool()
+{
+
+}
+
+int IllustrativeParticlePool::getCapacity() const
+{
+	return m_nCapacity;
+}
+
+int IllustrativeParticlePool::allocate()
+{
+	int particle = m_iFirstFree;
+	if (particle < 0)
+		return -1;
+
+	m_iFirstFree = m_viNextFree[particle];
+	m_viNextFree[particle] = -1;
+
+	m_viLiveIndices[particle] = static_cast<int>(m_viLiveParticles.size());
+	m_viLiveParticles.push_back(particle);
+	m_vuiLiveMask[particle >> 5] |= 1u << (particle & 31);
+	m_bLiveSorted = false;
+
+	return particle;
+}
+
+void IllustrativeParticlePool::release(int particle)
+{
+	if (m_viLiveIndices[particle] < 0)
+		return;
+
+	removeFromList(m_viLiveParticles, m_viLiveIndices, particle);
+	if (m_viSeedIndices[particle] >= 0)
+		removeFromList(m_viLiveSeeds, m_viSeedIndices, particle);
+
+	m_vuiLiveMask[particle >> 5] &= ~(1u << (particle & 31));
+	m_bLiveSorted = false;
+
+	// the other attributes are set by init() when the slot is used again
+	m_vucFlags[particle] = Flag_Dead;
+	m_vpFlowGrids[particle] = NULL;
+
+	m_viNextFree[particle] = m_iFirstFree;
+	m_iFirstFree = particle;
+}
+
+void IllustrativeParticlePool::removeFromList(std::vector<int> &list, std::vector<int> &indices, int particle)
+{
+	// move the last particle into the removed one's place
+	int index = indices[particle];
+	int last = list.back();
+	list[index] = last;
+	indices[last] = index;
+	list.pop_back();
+	indices[particle] = -1;
+}
+
+int IllustrativeParticlePool::getNumLive() const
+{
+	return static_cast<int>(m_viLiveParticles.size());
+}
+
+int IllustrativeParticlePool::getNumLiveSeeds() const
+{
+	return static_cast<int>(m_viLiveSeeds.size());
+}
+
+std::vector<int> const & IllustrativeParticlePool::getLiveParticles() const
+{
+	return m_viLiveParticles;
+}
+
+std::vector<int> const & IllustrativeParticlePool::getLiveSeeds() const
+{
+	return m_viLiveSeeds;
+}
+
+void IllustrativeParticlePool::sortLiveParticles()
+{
+	if (m_bLiveSorted)
+		return;
+
+	int index = 0;
+	for (size_t word = 0u; word < m_vuiLiveMask.size(); ++word)
+	{
+		unsigned int mask = m_vuiLiveMask[word];
+
+		for (int bit = 0; mask != 0u; ++bit, mask >>= 1)
+		{
+			// skip empty bytes
+			while ((mask & 0xFFu) == 0u)
+			{
+				bit += 8;
+				mask >>= 8;
+			}
+
+			if (mask & 1u)
+			{
+				int particle = static_cast<int>(word * 32u) + bit;
+				m_viLiveParticles[index] = particle;
+				m_viLiveIndices[particle] = index++;
+			}
+		}
+	}
+
+	m_bLiveSorted = true;
+}
+
+void IllustrativeParticlePool::init(int particle, glm::vec3 pos, glm::vec3 color, float gravity, std::chrono::milliseconds timeToLive, std::chrono::milliseconds trailTime, std::chrono::time_point<std::chrono::high_resolution_clock> currentTime, bool userCreated)
+{
+	m_vucFlags[particle] = userCreated ? Flag_UserCreated : 0;
+	m_vvec3Positions[particle] = pos;
+	m_vvec3Velocities[particle] = glm::vec3(0.f);
+	m_vvec3Colors[particle] = color;
+	m_vfGravity[particle] = gravity;
+	m_vpFlowGrids[particle] = NULL;
+	m_vtpBirthTimes[particle] = currentTime;
+	m_vtpTimesToStartDying[particle] = currentTime + timeToLive;
+	m_vmsTrailTimes[particle] = trailTime;
+	m_vfLastUpdateTimes[particle] = 0.f;
+	m_vfLiveTimeElapsed[particle] = 0.f;
+
+	// the trail starts with the starting position
+	size_t ring = static_cast<size_t>(particle) * MAX_NUM_TRAIL_POSITIONS;
+	m_vvec3TrailPositions[ring] = pos;
+	m_vfTrailTimes[ring] = 0.f;
+	m_vusTrailStarts[particle] = 0u;
+	m_vusTrailCounts[particle] = 1u;
+
+	if (!userCreated && m_viSeedIndices[particle] < 0)
+	{
+		m_viSeedIndices[particle] = static_cast<int>(m_viLiveSeeds.size());
+		m_viLiveSeeds.push_back(particle);
+	}
+	else if (userCreated && m_viSeedIndices[particle] >= 0)
+	{
+		removeFromList(m_viLiveSeeds, m_viSeedIndices, particle);
+	}
+}
+
+void IllustrativeParticlePool::reset(int particle)
+{
+	m_vucFlags[particle] = Flag_Dead;
+	m_vvec3Positions[particle] = glm::vec3(0.f);
+	m_vvec3Velocities[particle] = glm::vec3(0.f);
+	m_vvec3Colors[particle] = glm::vec3(0.f);
+	m_vfGravity[particle] = 0.f;
+	m_vpFlowGrids[particle] = NULL;
+	m_vtpBirthTimes[particle] = std::chrono::time_point<std::chrono::high_resolution_clock>();
+	m_vtpTimesToStartDying[particle] = std::chrono::time_point<std::chrono::high_resolution_clock>();
+	m_vmsTrailTimes[particle] = 0ms;
+	m_vfLastUpdateTimes[particle] = 0.f;
+	m_vfLiveTimeElapsed[particle] = 0.f;
+	m_vusTrailStarts[particle] = 0u;
+	m_vusTrailCounts[particle] = 0u;
+}
+
+void IllustrativeParticlePool::updatePosition(int particle, std::chrono::time_point<std::chrono::high_resolution_clock> currentTime, glm::vec3 const &newPos)
+{
+	if (isDead(particle))
+		return;
+
+	float now = std::chrono::duration<float, std::milli>(currentTime - m_vtpBirthTimes[particle]).count();
+	m_vfLastUpdateTimes[particle] = now;
+
+	if (currentTime >= m_vtpTimesToStartDying[particle])
+		m_vucFlags[particle] |= Flag_Dying;
+
+	size_t ring = static_cast<size_t>(particle) * MAX_NUM_TRAIL_POSITIONS;
+	unsigned short &start = m_vusTrailStarts[particle];
+	unsigned short &count = m_vusTrailCounts[particle];
+
+	if (!isDying(particle))//translate particle, filling next spot in the ring with new position/timestamp
+	{
+		// a full ring drops its oldest position
+		if (count == MAX_NUM_TRAIL_POSITIONS)
+		{
+			start = (start + 1u) % MAX_NUM_TRAIL_POSITIONS;
+			count--;
+		}
+
+		size_t head = ring + (start + count) % MAX_NUM_TRAIL_POSITIONS;
+		m_vvec3TrailPositions[head] = newPos;
+		m_vfTrailTimes[head] = now;
+		count++;
+
+		m_vvec3Positions[particle] = newPos;
+	}//end if not dying
+
+	m_vfLiveTimeElapsed[particle] = count > 0u ? now - m_vfTrailTimes[ring + start] : 0.f;
+
+	float trailTime = static_cast<float>(m_vmsTrailTimes[particle].count());
+	while (count > 0u && now - m_vfTrailTimes[ring + start] > trailTime)
+	{
+		start = (start + 1u) % MAX_NUM_TRAIL_POSITIONS;
+		count--;
+	}
+
+	if (isDying(particle) && count == 0u)
+		m_vucFlags[particle] |= Flag_Dead;
+}
+
+void IllustrativeParticlePool::shiftTimes(int particle, std::chrono::milliseconds elapsed)
+{
+	if (isDead(particle))
+		return;
+
+	// trail and update times are relative to the birth time
+	m_vtpBirthTimes[particle] += elapsed;
+	m_vtpTimesToStartDying[particle] += elapsed;
+}
+
+bool IllustrativeParticlePool::isDead(int particle) const
+{
+	return (m_vucFlags[particle] & Flag_Dead) != 0;
+}
+
+bool IllustrativeParticlePool::isDying(int particle) const
+{
+	return (m_vucFlags[particle] & Flag_Dying) != 0;
+}
+
+bool IllustrativeParticlePool::isUserCreated(int particle) const
+{
+	return (m_vucFlags[particle] & Flag_UserCreated) != 0;
+}
+
+void IllustrativeParticlePool::setDying(int particle)
+{
+	m_vucFlags[particle] |= Flag_Dying;
+}
+
+int IllustrativeParticlePool::getNumLivePositions(int particle) const
+{
+	return isDead(particle) ? 0 : m_vusTrailCounts[particle];
+}
+
+glm::vec3 const & IllustrativeParticlePool::getLivePosition(int particle, int index) const
+{
+	return m_vvec3TrailPositions[static_cast<size_t>(particle) * MAX_NUM_TRAIL_POSITIONS + (m_vusTrailStarts[particle] + index) % MAX_NUM_TRAIL_POSITIONS];
+}
+
+float IllustrativeParticlePool::getLivePositionTime(int particle, int index) const
+{
+	return m_vfTrailTimes[static_cast<size_t>(particle) * MAX_NUM_TRAIL_POSITIONS + (m_vusTrailStarts[particle] + index) % MAX_NUM_TRAIL_POSITIONS];
+}
@@ -0,0 +1,114 @@
+#ifndef __IllustrativeParticlePool_h__
+#define __IllustrativeParticlePool_h__
+
+#include <vector>
+#include <chrono>
+
+#include <glm.hpp>
+
+#include "FlowGrid.h"
+
+// number of particle positions to store for things like trails, etc.
+#define MAX_NUM_TRAIL_POSITIONS 100
+
+// Fixed-capacity particle storage as one array per attribute (structure of arrays), indexed by particle slot.
+// Each particle's trail is a ring of MAX_NUM_TRAIL_POSITIONS entries packed into one shared array, with the
+// oldest entry and the number of entries stored per particle. Trail times are milliseconds since the particle's
+// birth, so shifting the birth time shifts its whole trail (see shiftTimes).
+// Slots of dead particles are chained into a free list, and the live particles and the live seeds among them are
+// kept in dense lists that remove a slot by moving the last one into its place, so taking and returning a slot
+// are constant time and the live particles can be visited without looking at the dead ones. Removing slots that
+// way scrambles the live list, so it can be put back into slot order (see sortLiveParticles).
+class IllustrativeParticlePool
+{
+public:
+	enum Flags {
+		Flag_Dead = 1,
+		Flag_Dying = 2,		// no longer moves, the trail fades out
+		Flag_UserCreated = 4	// emitted by dye poles/pots, seeds aren't
+	};
+
+	IllustrativeParticlePool(int capacity);
+	virtual ~IllustrativeParticlePool();
+
+	int getCapacity() const;
+
+	// Takes a slot off the free list and adds it to the live particles, returns -1 if the pool is full.
+	// Initialize the particle with init() before using it.
+	int allocate();
+
+	// Marks a particle dead and returns its slot to the free list
+	void release(int particle);
+
+	int getNumLive() const;
+	int getNumLiveSeeds() const;
+	std::vector<int> const & getLiveParticles() const;	// in no particular order, unless sorted
+	std::vector<int> const & getLiveSeeds() const;
+
+	// Sorts the live particles by slot, so walking them walks the attribute arrays in memory order. Takes time
+	// proportional to the live particles plus a pass over a bitmask of the slots, and nothing if none were
+	// allocated or released since the last sort.
+	void sortLiveParticles();
+
+	void init(int particle, glm::vec3 pos, glm::vec3 color, float gravity, std::chrono::milliseconds timeToLive, std::chrono::milliseconds trailTime, std::chrono::time_point<std::chrono::high_resolution_clock> currentTime, bool userCreated);
+
+	// Clears a particle and marks it dead. It stays in the live lists until it is released.
+	void reset(int particle);
+
+	// Appends newPos to the trail unless the particle is dying, drops trail positions older than the trail time
+	// and marks dying particles dead once their trail is gone
+	void updatePosition(int particle, std::chrono::time_point<std::chrono::high_resolution_clock> currentTime, glm::vec3 const &newPos);
+
+	// Moves all times of a live particle forward, e.g. after a pause
+	void shiftTimes(int particle, std::chrono::milliseconds elapsed);
+
+	bool isDead(int particle) const;
+	bool isDying(int particle) const;
+	bool isUserCreated(int particle) const;
+	void setDying(int particle);
+
+	// Trail positions from the oldest (index 0) to the current one
+	int getNumLivePositions(int particle) const;
+	glm::vec3 const & getLivePosition(int particle, int index) const;
+	float getLivePositionTime(int particle, int index) const;	// ms since birth
+
+	// Per particle attributes
+	std::vector<glm::vec3> m_vvec3Positions;	// current position, the newest trail position
+	std::vector<glm::vec3> m_vvec3Velocities;	// displacement per second of the last update
+	std::vector<glm::vec3> m_vvec3Colors;
+	std::vector<float> m_vfGravity;
+	std::vector<FlowGrid*> m_vpFlowGrids;		// grid the particle is advected in, NULL until attached
+	std::vector<unsigned char> m_vucFlags;
+	std::vector<std::chrono::time_point<std::chrono::high_resolution_clock>> m_vtpBirthTimes;
+	std::vector<std::chrono::time_point<std::chrono::high_resolution_clock>> m_vtpTimesToStartDying;
+	std::vector<std::chrono::milliseconds> m_vmsTrailTimes;
+	std::vector<float> m_vfLastUpdateTimes;		// ms since birth
+	std::vector<float> m_vfLiveTimeElapsed;		// ms from the oldest trail position to the last update
+
+	// Trail rings, MAX_NUM_TRAIL_POSITIONS entries per particle
+	std::vector<glm::vec3> m_vvec3TrailPositions;
+	std::vector<float> m_vfTrailTimes;			// ms since birth
+	std::vector<unsigned short> m_vusTrailStarts;	// ring index of the oldest entry
+	std::vector<unsigned short> m_vusTrailCounts;
+
+private:
+	int m_nCapacity;
+
+	// live particles and live seeds, and the position of each slot in them (-1 if not in it)
+	std::vector<int> m_viLiveParticles;
+	std::vector<int> m_viLiveSeeds;
+	std::vector<int> m_viLiveIndices;
+	std::vector<int> m_viSeedIndices;
+
+	// free list: the next free slot of each free slot (-1 for the last one)
+	std::vector<int> m_viNextFree;
+	int m_iFirstFree;	// -1 if the pool is full
+
+	// bit per slot, set for live particles
+	std::vector<unsigned int> m_vuiLiveMask;
+	bool m_bLiveSorted;
+
+	void removeFromList(std::vector<int> &list, std::vector<int> &indices, int particle);
+};
+
+#endif
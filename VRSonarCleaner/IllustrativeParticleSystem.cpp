@@ -3,13 +3,16 @@
 //NOTE: modified from VTT4D to use x,z lat/long and y as depth dimension!
 
 #include <glm.hpp>
-#include <map>
 
 using namespace std::chrono_literals;
 
 IllustrativeParticleSystem::IllustrativeParticleSystem(std::vector<FlowGrid*> FlowGridCollection)
-	: m_bReadyToTransferData(false)
-	, m_bUseEuler(false)
+	: m_Particles(MAX_PARTICLES)
+	, m_nIndexCount(0)
+	, m_nStagedVertexCount(0u)
+	, m_nStagedIndexCount(0u)
+	, m_nBufferVertexCapacity(0u)
+	, m_bReadyToTransferData(false)
 {
 	m_vpFlowGridCollection = FlowGridCollection;
 
@@ -18,11 +21,6 @@ IllustrativeParticleSystem::IllustrativeParticleSystem(std::vector<FlowGrid*> Fl
 	m_nMaxParticles = MAX_PARTICLES;
 
 	printf("Initializing particle system...");
-	m_vpParticles.resize(MAX_PARTICLES);
-	for (auto &particle : m_vpParticles)
-	{
-		particle = new IllustrativeParticle();
-	}
 
 	initGL();
 
@@ -36,34 +34,32 @@ IllustrativeParticleSystem::~IllustrativeParticleSystem()
 
 void IllustrativeParticleSystem::resetParticles()
 {
-	for (auto p : m_vpParticles)
-		p->reset();
+	while (m_Particles.getNumLive() > 0)
+		m_Particles.release(m_Particles.getLiveParticles().back());
 }
 
-void IllustrativeParticleSystem::addDyeParticle(double x, double y, double z, float r, float g, float b, std::chrono::milliseconds lifetime)
+int IllustrativeParticleSystem::allocateParticle()
 {
-	//find particle to replace:
-	int deadParticleToReplace = -1;
-	int nonUserParticle = -1;
-	for (int i=0;i<m_nMaxParticles;i++)
+	int particle = m_Particles.allocate();
+
+	// replace a seed if there are no free particles left
+	if (particle < 0 && m_Particles.getNumLiveSeeds() > 0)
 	{
-		if (m_vpParticles[i]->m_bDead)
-		{
-			deadParticleToReplace = i;
-			break;
-		}
-		else if (!m_vpParticles[i]->m_bUserCreated && nonUserParticle < 0)
-		{
-			nonUserParticle = i;
-		}
+		m_Particles.release(m_Particles.getLiveSeeds().back());
+		particle = m_Particles.allocate();
 	}
 
-	int particleIndexToReplace = deadParticleToReplace >= 0 ? deadParticleToReplace : nonUserParticle;
+	return particle;
+}
+
+void IllustrativeParticleSystem::addDyeParticle(double x, double y, double z, float r, float g, float b, std::chrono::milliseconds lifetime)
+{
+	int particleIndexToReplace = allocateParticle();
 
 	if (particleIndexToReplace == -1)
 	{
 		printf("YOU SHOULD NEVER SEE THIS! 18515 addDyeParticle()");
-		particleIndexToReplace = 0;
+		return;
 	}
 
 	//randomize the lifetimes by +\- 25% so they dont all die simultaneously	
@@ -71,29 +67,7 @@ void IllustrativeParticleSystem::addDyeParticle(double x, double y, double z, fl
 	
 	std::chrono::time_point<std::chrono::high_resolution_clock> tick = std::chrono::high_resolution_clock::now();
 
-	IllustrativeParticle* p = m_vpParticles[particleIndexToReplace];
-
-	p->m_bDead = false;
-	p->m_bDying = false;
-	p->m_bUserCreated = true;
-	p->m_fGravity = 0;
-	p->m_msTimeToLive;
-	p->m_msTrailTime = 1000ms;
-	p->m_iBufferHead = 1;
-	p->m_iBufferTail = 0;
-	p->m_pFlowGrid = NULL;
-	p->m_tpBirthTime = tick;
-	p->m_tpLastUpdateTimestamp;
-	p->m_msLiveTimeElapsed = 0ms;
-	p->m_tpTimeDeathBegan = std::chrono::time_point<std::chrono::high_resolution_clock>();
-	p->m_tpTimeToStartDying = tick + lifetime;
-	p->m_vec3Color = glm::vec3(0.25f, 0.95f, 1.f);
-	p->m_vec3StartingPosition = glm::vec3(x, y, z);
-	p->m_vtpTimes.clear();
-	p->m_vtpTimes[0] = tick;
-	p->m_vvec3Positions.clear();
-	p->m_vvec3Positions[0] = p->m_vec3StartingPosition;
-	p->m_vvec3Positions[1] = p->m_vec3StartingPosition;
+	m_Particles.init(particleIndexToReplace, glm::vec3(x, y, z), glm::vec3(0.25f, 0.95f, 1.f), 0.f, lifetime, 1000ms, tick, true);
 }
 
 void IllustrativeParticleSystem::update(float time)
@@ -109,87 +83,24 @@ void IllustrativeParticleSystem::update(float time)
 		return;
 	else
 		m_tpLastParticleUpdate = tick;
+
+	//streamed grids have to hold the timesteps around time before sampling there
+	for (auto const &grid : m_vpFlowGridCollection)
+		grid->updateStream(time);
 	
 	//printf("Updating existing particles..\n");
 	
-	glm::vec3 currentPos, newPos;
-	glm::vec3 vel;
-	
-	// Take inventory of dead particles and particles which can be killed
-	std::vector<IllustrativeParticle*> deadParticles;
-	std::vector<IllustrativeParticle*> recyclableParticles;
-	std::vector<IllustrativeParticle*> activeParticles;
-	for (auto const &particle : m_vpParticles)
-	{
-		if (particle->m_bDead)
-			deadParticles.push_back(particle);
-		else
-		{
-			if (!particle->m_bUserCreated)
-				recyclableParticles.push_back(particle);
-
-			activeParticles.push_back(particle);
-		}
-	}
-
-	// initialize a map from flowgrids to active particle counts
-	std::map<FlowGrid*, int> activeWithinGridMap;
+	// reset the active particle counts of the flowgrids
 	for (auto const &grid : m_vpFlowGridCollection)
-		activeWithinGridMap[grid] = 0;
-	
+		grid->m_nActiveIllustrativeParticles = 0;
 
-	std::vector<IllustrativeParticle*> removedParticles;
-	//Update all current particles
-	for (auto const &particle : activeParticles)
-	{
-		//get current position
-		currentPos = particle->getCurrentXYZ();
+	m_Advector.advect(m_Particles, m_vpFlowGridCollection, time, timeSinceLastUpdate, tick);
+	std::vector<int> const &activeParticles = m_Particles.getLiveParticles();
 
-		if (!particle->m_pFlowGrid) //if not attached to a flow grid
-		{
-			for (auto const &fg : m_vpFlowGridCollection)
-			{
-				if (fg->contains(currentPos.x, currentPos.y, currentPos.z))
-				{
-					//found one
-					particle->m_pFlowGrid = fg;
-					break;
-				}
-			}
-		}//end if not attached to flow grid
-
-		if (particle->m_pFlowGrid) // did we find a flow grid?
-		{
-			newPos = m_bUseEuler ? eulerForward(particle, time, timeSinceLastUpdate.count()) : rk4(particle, time, timeSinceLastUpdate.count());
-			activeWithinGridMap[particle->m_pFlowGrid]++;
-		}
-		else
-		{
-			//if there are flow grids, lets kill it, so it doesn't clutter the scene
-			if (m_vpFlowGridCollection.size() > 0)
-			{
-				particle->reset();
-				removedParticles.push_back(particle);
-				deadParticles.push_back(particle);
-				continue;
-			}
-			else
-			{
-				newPos = currentPos; 
-				activeWithinGridMap[particle->m_pFlowGrid]++;
-			}
-		}
-
-		std::chrono::duration<float> prodTimeSeconds = timeSinceLastUpdate;
-
-		newPos.z += particle->m_fGravity / prodTimeSeconds.count();
-
-		particle->updatePosition(tick, newPos.x, newPos.y, newPos.z);		
-	}//end for all active particles
-
-	// Now remove non-active particles
-	for (auto const &p : removedParticles)
-		activeParticles.erase(std::remove(activeParticles.begin(), activeParticles.end(), p), activeParticles.end());
+	// count the particles in each flowgrid
+	for (auto const &particle : activeParticles)
+		if (m_Particles.m_vpFlowGrids[particle])
+			m_Particles.m_vpFlowGrids[particle]->m_nActiveIllustrativeParticles++;
 
 	//handle dyepoles/emitters
 
@@ -203,30 +114,18 @@ void IllustrativeParticleSystem::update(float time)
 			std::vector<glm::vec3> emittedPositions = pot->getParticlesToEmit(numToSpawn);
 			for (int i = 0; i < (numToSpawn > MAX_PARTICLES ? MAX_PARTICLES : numToSpawn); ++i )
 			{
-				IllustrativeParticle* particleToUse = NULL;
-				if (deadParticles.size() > 0)
-				{
-					particleToUse = deadParticles.back();
-					deadParticles.pop_back();
-					activeParticles.push_back(particleToUse);
-				}
-				else if (recyclableParticles.size() > 0)
-				{
-					particleToUse = recyclableParticles.back();
-					recyclableParticles.pop_back();
-				}
-				else
+				int particleToUse = allocateParticle();
+				if (particleToUse < 0)
 				{
 					//no particles left, what do we do here?
 					//printf("ERROR: PARTICLE SYSTEM MAXXED OUT!\n  You can try to raise the max number of particles.\n");
+					break;
 				}
 
 				//randomize the lifetimes by +\- 50f% so they dont all die simultaneously
 				std::chrono::milliseconds lifetime = std::chrono::duration_cast<std::chrono::milliseconds>(pot->getLifetime() * ((float)(rand() % 25) / 100.f) + pot->getLifetime() * 0.75f);
 				
-				particleToUse->reset();
-
-				particleToUse->init(emittedPositions[i], pot->getColor(), pot->getGravity(), lifetime, pot->m_msTrailTime, tick, true);
+				m_Particles.init(particleToUse, emittedPositions[i], pot->getColor(), pot->getGravity(), lifetime, pot->m_msTrailTime, tick, true);
 			}//end for numToSpawn
 		}
 	}
@@ -241,30 +140,17 @@ void IllustrativeParticleSystem::update(float time)
 			{
 				for (auto const &particlePos : emitter->getParticlesToEmit(numToSpawn))
 				{
-					IllustrativeParticle* particleToUse = NULL;
-					if (deadParticles.size() > 0)
-					{
-						particleToUse = deadParticles.back();
-						deadParticles.pop_back();
-					}
-					else if (recyclableParticles.size() > 0)
-					{
-						particleToUse = recyclableParticles.back();
-						recyclableParticles.pop_back();
-					}
-					else
+					int particleToUse = allocateParticle();
+					if (particleToUse < 0)
 					{
 						//no particles left, what do we do here?
 						//printf("ERROR: PARTICLE SYSTEM MAXXED OUT!\n  You can try to raise the max number of particles.\n");
+						break;
 					}
 
 					std::chrono::milliseconds  lifetime = std::chrono::duration_cast<std::chrono::milliseconds>(emitter->getLifetime() * ((float)(rand() % 25) / 100.f) + emitter->getLifetime() * 0.75f);  //randomize the lifetimes by +\- 50f% so they dont all die simultaneously					
 					
-					particleToUse->reset();
-
-					particleToUse->init(particlePos, emitter->getColor(), emitter->getGravity(), lifetime, emitter->m_msTrailTime, tick, true);
-
-					activeParticles.push_back(particleToUse);
+					m_Particles.init(particleToUse, particlePos, emitter->getColor(), emitter->getGravity(), lifetime, emitter->m_msTrailTime, tick, true);
 				}//end for numToSpawn
 			}
 		}
@@ -283,7 +169,7 @@ void IllustrativeParticleSystem::update(float time)
 		if (grid->m_bIllustrativeParticlesEnabled)
 		{
 			//if more particles needed
-			int numNeeded = grid->m_nIllustrativeParticles - activeWithinGridMap[grid];
+			int numNeeded = grid->m_nIllustrativeParticles - grid->m_nActiveIllustrativeParticles;
 
 			if (numNeeded > 0)
 			{
@@ -293,7 +179,7 @@ void IllustrativeParticleSystem::update(float time)
 				maxScaledZ = abs(grid->getMaxDepth());
 				scaledZRange = maxScaledZ - minScaledZ;
 
-				while (numNeeded > 0 && !skipGrid && deadParticles.size() > 0u)
+				while (numNeeded > 0 && !skipGrid && m_Particles.getNumLive() < m_Particles.getCapacity())
 				{
 					inWater = false;
 					chancesNotInWater = 10000;
@@ -322,16 +208,11 @@ void IllustrativeParticleSystem::update(float time)
 						//randomize the lifetimes by +\- 25f% so they dont all die simultaneously
 						std::chrono::milliseconds lifetime = std::chrono::duration_cast<std::chrono::milliseconds>(grid->m_fIllustrativeParticleLifetime * ((float)(rand()%25) / 100.f) + grid->m_fIllustrativeParticleLifetime * 0.75f);
 
-						IllustrativeParticle* particleToUse = deadParticles.back();
-						deadParticles.pop_back();
+						int particleToUse = m_Particles.allocate();
 
-						particleToUse->reset();
+						m_Particles.init(particleToUse, randPos, grid->m_vec3IllustrativeParticlesColor, 0, lifetime, grid->m_fIllustrativeParticleTrailTime, tick, false);
 
-						particleToUse->init(randPos, grid->m_vec3IllustrativeParticlesColor, 0, lifetime, grid->m_fIllustrativeParticleTrailTime, tick, false);
-
-						particleToUse->m_pFlowGrid = grid;
-
-						activeParticles.push_back(particleToUse);
+						m_Particles.m_vpFlowGrids[particleToUse] = grid;
 							
 						numNeeded--;
 					}
@@ -341,55 +222,65 @@ void IllustrativeParticleSystem::update(float time)
 		}//end if illust. parts enabled
 	}//end for each flowgrid
 
-	m_nLastCountLiveParticles = m_nMaxParticles - static_cast<int>(deadParticles.size());
-	m_nLastCountLiveSeeds = static_cast<int>(activeParticles.size());
+	m_nLastCountLiveParticles = m_Particles.getNumLive();
+	m_nLastCountLiveSeeds = m_Particles.getNumLiveSeeds();
 
-	size_t count = 0;
-	for (size_t i = 0; i < m_vpParticles.size(); ++i)
+	// count the trail vertices first, so the staging buffers grow at most once
+	size_t nVertices = 0u;
+	size_t nIndices = 0u;
+	for (auto const &i : activeParticles)
 	{
-		int numPositions = m_vpParticles[i]->getNumLivePositions();
-		if (numPositions > 1)
+		size_t numPositions = static_cast<size_t>(m_Particles.getNumLivePositions(i));
+		if (numPositions > 1u)
 		{
-			std::chrono::milliseconds timeElapsed = m_vpParticles[i]->m_msLiveTimeElapsed;
-
-			for (int j = 0; j < numPositions - 1; j++)
-			{
-				int posIndex1 = m_vpParticles[i]->getLivePosition(j);
-				int posIndex2 = m_vpParticles[i]->getLivePosition(j + 1);
-
-				glm::vec3 pos1, pos2;
-
-				pos1.x = m_vpParticles[i]->m_vvec3Positions[posIndex1].x;
-				pos1.y = m_vpParticles[i]->m_vvec3Positions[posIndex1].y;
-				pos1.z = m_vpParticles[i]->m_vvec3Positions[posIndex1].z;
+			nVertices += numPositions;
+			nIndices += 2u * (numPositions - 1u);
+		}
+	}
 
-				pos2.x = m_vpParticles[i]->m_vvec3Positions[posIndex2].x;
-				pos2.y = m_vpParticles[i]->m_vvec3Positions[posIndex2].y;
-				pos2.z = m_vpParticles[i]->m_vvec3Positions[posIndex2].z;
+	if (nVertices > m_vvec3PositionsBuffer.size())
+	{
+		size_t capacity = (std::max)(nVertices, m_vvec3PositionsBuffer.size() * 3u / 2u);
+		m_vvec3PositionsBuffer.resize(capacity);
+		m_vvec4ColorBuffer.resize(capacity);
+	}
 
-				float opacity1 = 1.f - (m_vpParticles[i]->m_tpLastUpdateTimestamp - m_vpParticles[i]->m_vtpTimes[posIndex1]) / std::chrono::duration<float>(timeElapsed);
-				float opacity2 = 1.f - (m_vpParticles[i]->m_tpLastUpdateTimestamp - m_vpParticles[i]->m_vtpTimes[posIndex2]) / std::chrono::duration<float>(timeElapsed);
+	if (nIndices > m_vuiIndices.size())
+		m_vuiIndices.resize((std::max)(nIndices, m_vuiIndices.size() * 3u / 2u));
 
-				glm::vec4 col1(m_vpParticles[i]->m_vec3Color, opacity1);
-				glm::vec4 col2(m_vpParticles[i]->m_vec3Color, opacity2);
+	// one vertex per trail position, and a line between each pair of consecutive positions
+	size_t vertex = 0u;
+	size_t index = 0u;
+	for (auto const &i : activeParticles)
+	{
+		int numPositions = m_Particles.getNumLivePositions(i);
+		if (numPositions > 1)
+		{
+			float lastUpdate = m_Particles.m_vfLastUpdateTimes[i];
+			float timeElapsed = m_Particles.m_vfLiveTimeElapsed[i];
+			glm::vec3 const &color = m_Particles.m_vvec3Colors[i];
 
-				m_arrvec3PositionsBuffer[count] = pos1;
-				m_arrvec4ColorBuffer[count] = col1;
-				m_arruiIndices[count] = static_cast<GLuint>(count);
+			for (int j = 0; j < numPositions; j++)
+			{
+				float opacity = 1.f - (lastUpdate - m_Particles.getLivePositionTime(i, j)) / timeElapsed;
 
-				count++;
+				m_vvec3PositionsBuffer[vertex + j] = m_Particles.getLivePosition(i, j);
+				m_vvec4ColorBuffer[vertex + j] = glm::vec4(color, opacity);
+			}//end for each position
 
-				m_arrvec3PositionsBuffer[count] = pos2;
-				m_arrvec4ColorBuffer[count] = col2;
-				m_arruiIndices[count] = static_cast<GLuint>(count);
+			for (int j = 0; j < numPositions - 1; j++)
+			{
+				m_vuiIndices[index++] = static_cast<GLuint>(vertex + j);
+				m_vuiIndices[index++] = static_cast<GLuint>(vertex + j + 1);
+			}
 
-				count++;
-			}//end for each position
+			vertex += numPositions;
 		}//end if two live positions (enough to draw 1 line segment)
 	}//end for each particle
 
+	m_nStagedVertexCount = vertex;
+	m_nStagedIndexCount = index;
 	m_bReadyToTransferData = true;
-	m_nIndexCount = static_cast<GLsizei>(count);
 }
 
 bool IllustrativeParticleSystem::prepareForRender()
@@ -397,28 +288,38 @@ bool IllustrativeParticleSystem::prepareForRender()
 	if (!m_bReadyToTransferData)
 		return false;
 
-	GLsizei numPositions, numColors;
-	numPositions = numColors = m_nIndexCount;
+	m_bReadyToTransferData = false;
 
-	if (numPositions < 2)
+	if (m_nStagedIndexCount < 2u)
+	{
+		m_nIndexCount = 0;
 		return false;
+	}
 
 	glBindBuffer(GL_ARRAY_BUFFER, this->m_glVBO);
-	// Buffer orphaning
+
+	// grow the vertex buffer like the staging buffers
+	if (m_nStagedVertexCount > m_nBufferVertexCapacity)
+	{
+		m_nBufferVertexCapacity = (std::max)(m_nStagedVertexCount, m_nBufferVertexCapacity * 3u / 2u);
+		glBufferData(GL_ARRAY_BUFFER, m_nBufferVertexCapacity * (sizeof(glm::vec3) + sizeof(glm::vec4)), NULL, GL_DYNAMIC_DRAW);
+	}
+
 	// Sub buffer data for points, then colors
-	glBufferSubData(GL_ARRAY_BUFFER, 0, numPositions * sizeof(glm::vec3), m_arrvec3PositionsBuffer);
-	glBufferSubData(GL_ARRAY_BUFFER, numPositions * sizeof(glm::vec3), numColors * sizeof(glm::vec4), m_arrvec4ColorBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, m_nStagedVertexCount * sizeof(glm::vec3), m_vvec3PositionsBuffer.data());
+	glBufferSubData(GL_ARRAY_BUFFER, m_nStagedVertexCount * sizeof(glm::vec3), m_nStagedVertexCount * sizeof(glm::vec4), m_vvec4ColorBuffer.data());
 
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->m_glEBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_nIndexCount * sizeof(GLuint), 0, GL_STREAM_DRAW);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_nIndexCount * sizeof(GLuint), m_arruiIndices, GL_STREAM_DRAW);
+	// Buffer orphaning
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_nStagedIndexCount * sizeof(GLuint), 0, GL_STREAM_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_nStagedIndexCount * sizeof(GLuint), m_vuiIndices.data(), GL_STREAM_DRAW);
 	
 	// Set color attribute pointer now that point array size is known
 	glBindVertexArray(this->m_glVAO);
-	glVertexAttribPointer(COLOR_ATTRIB_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (GLvoid*)(numPositions * sizeof(glm::vec3)));
+	glVertexAttribPointer(COLOR_ATTRIB_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4), (GLvoid*)(m_nStagedVertexCount * sizeof(glm::vec3)));
 	glBindVertexArray(0);
 
-	m_bReadyToTransferData = false;
+	m_nIndexCount = static_cast<GLsizei>(m_nStagedIndexCount);
 
 	return true;
 }
@@ -429,9 +330,8 @@ void IllustrativeParticleSystem::initGL()
 	glGenBuffers(1, &m_glEBO);
 
 	glBindVertexArray(this->m_glVAO);
-	// Bind the array and allocate its storage
+	// Bind the array, its storage is allocated once trail vertices are uploaded
 	glBindBuffer(GL_ARRAY_BUFFER, this->m_glVBO);
-	glNamedBufferStorage(m_glVBO, MAX_PARTICLES * MAX_NUM_TRAIL_POSITIONS * (sizeof(glm::vec3) + sizeof(glm::vec4)), NULL, GL_DYNAMIC_STORAGE_BIT);
 
 	// Now do the same with the element array buffer
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->m_glEBO);
@@ -447,66 +347,6 @@ void IllustrativeParticleSystem::initGL()
 }
 
 
-glm::vec3 IllustrativeParticleSystem::eulerForward(IllustrativeParticle* particle, float time, float delta)
-{
-	glm::vec3 currentPos = particle->getCurrentXYZ();
-	glm::vec3 vel;
-
-	//get UVW at current position (checks in bounds or not)
-	if (!particle->m_pFlowGrid->getUVWat(currentPos.x, currentPos.y, currentPos.z, time, &vel.x, &vel.y, &vel.z))
-	{
-		particle->m_bDying = true;
-		return currentPos;
-	}
-	
-
-	//calc new position
-	float prodTimeVelocity = delta * particle->m_pFlowGrid->m_fIllustrativeParticleVelocityScale;
-
-	glm::vec3 ret(currentPos + vel * prodTimeVelocity * 10.f);
-
-	if (!particle->m_pFlowGrid->contains(ret.x, ret.y, ret.z))
-		particle->m_bDying = true;
-
-	return ret;
-}
-
-glm::vec3 IllustrativeParticleSystem::rk4(IllustrativeParticle * particle, float time, float delta)
-{
-	glm::vec3 startPos = particle->getCurrentXYZ();
-	glm::vec3 k1, k2, k3, k4, y1, y2, y3, newPos;
-
-	float prodTimeVelocity = delta * particle->m_pFlowGrid->m_fIllustrativeParticleVelocityScale;
-
-	//get UVW at current position
-	if (!particle->m_pFlowGrid->getUVWat(startPos.x, startPos.y, startPos.z, time, &k1.x, &k1.y, &k1.z))
-		return eulerForward(particle, time, delta);
-
-	y1 = startPos + k1 * prodTimeVelocity * 0.5f;
-
-	if (!particle->m_pFlowGrid->getUVWat(y1.x, y1.y, y1.z, time, &k2.x, &k2.y, &k2.z))
-		return eulerForward(particle, time, delta);
-
-	y2 = startPos + k2 * prodTimeVelocity * 0.5f;
-
-	if (!particle->m_pFlowGrid->getUVWat(y2.x, y2.y, y2.z, time, &k3.x, &k3.y, &k3.z))
-		return eulerForward(particle, time, delta);
-
-	y3 = startPos + k3 * prodTimeVelocity;
-
-	if (!particle->m_pFlowGrid->getUVWat(y3.x, y3.y, y3.z, time, &k4.x, &k4.y, &k4.z))
-		return eulerForward(particle, time, delta);
-
-	newPos = startPos + prodTimeVelocity * (k1 + 2.f * k2 + 2.f * k3 + k4) / 6.f;
-
-	//check in bounds or not
-	if (!particle->m_pFlowGrid->contains(newPos.x, newPos.y, newPos.z))
-		particle->m_bDying = true;
-
-	return newPos;
-}
-
-
 int IllustrativeParticleSystem::getNumLiveParticles()
 {
 	return m_nLastCountLiveParticles;// maxNumParticles;//particles.size();
@@ -547,12 +387,17 @@ GLsizei IllustrativeParticleSystem::getIndexCount()
 
 void IllustrativeParticleSystem::setEulerIntegration()
 {
-	m_bUseEuler = true;
+	m_Advector.setEulerIntegration();
 }
 
 void IllustrativeParticleSystem::setRK4Integration()
 {
-	m_bUseEuler = false;
+	m_Advector.setRK4Integration();
+}
+
+void IllustrativeParticleSystem::setAdvectionThreads(unsigned int nThreads)
+{
+	m_Advector.setThreads(nThreads);
 }
 
 int IllustrativeParticleSystem::addDyePole(double x, double y, float minZ, float maxZ)
@@ -649,15 +494,7 @@ void IllustrativeParticleSystem::unPause()
 {
 	std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::high_resolution_clock::now() - m_tpPauseTime);
 
-	for (int i=0;i<m_nMaxParticles;i++)
-	{
-		if (!m_vpParticles[i]->m_bDead)
-		{
-			m_vpParticles[i]->m_tpBirthTime += elapsedTime;
-			m_vpParticles[i]->m_tpLastUpdateTimestamp += elapsedTime;
-			for (int j=0;j<100;j++)
-				m_vpParticles[i]->m_vtpTimes[j] += elapsedTime;
-		}
-	}//end for each particle
+	for (auto const &particle : m_Particles.getLiveParticles())
+		m_Particles.shiftTimes(particle, elapsedTime);
 
 }//end unPause()
@@ -6,7 +6,8 @@
 #include <chrono>
 #include <functional>
 #include "FlowGrid.h"
-#include "IllustrativeParticle.h"
+#include "IllustrativeParticlePool.h"
+#include "IllustrativeParticleAdvector.h"
 #include "IllustrativeDyePole.h"
 #include "IllustrativeParticleEmitter.h"
 #include "Renderer.h"
@@ -43,11 +44,9 @@ public:
 	std::chrono::time_point<std::chrono::high_resolution_clock> m_tpPauseTime;
 	
 	int m_nMaxParticles;
-	std::vector<IllustrativeParticle*> m_vpParticles;
+	IllustrativeParticlePool m_Particles;
 
 	std::vector<FlowGrid*> m_vpFlowGridCollection;
-
-	bool m_bUseEuler;
 	
 	//int getNumParticles();
 	int getNumLiveParticles();
@@ -57,7 +56,7 @@ public:
 	int getNumDyeParticles();
 	int m_nLastCountLiveParticles;
 	int m_nLastCountLiveSeeds;
-	GLsizei m_nIndexCount;
+	GLsizei m_nIndexCount;	// indices uploaded for drawing
 
 	bool prepareForRender();
 	GLuint getVAO();
@@ -66,21 +65,31 @@ public:
 	void setEulerIntegration();
 	void setRK4Integration();
 
+	// Number of threads advecting particles, 0 for the hardware concurrency
+	void setAdvectionThreads(unsigned int nThreads);
+
 	int m_nStreakSegments;
 
 private:
-	// Holds all particle positions and their trails in one array and colors in another
-	glm::vec3 m_arrvec3PositionsBuffer[MAX_PARTICLES * MAX_NUM_TRAIL_POSITIONS];
-	glm::vec4 m_arrvec4ColorBuffer[MAX_PARTICLES * MAX_NUM_TRAIL_POSITIONS];
-	GLuint m_arruiIndices[MAX_PARTICLES * MAX_NUM_TRAIL_POSITIONS];
+	// Trail vertices of the live particles, positions in one array and colors in another, and line indices
+	// between consecutive trail vertices. Filled by update() and uploaded by prepareForRender(); the arrays
+	// only grow, by at least half their size, and hold m_nStagedVertexCount and m_nStagedIndexCount entries.
+	std::vector<glm::vec3> m_vvec3PositionsBuffer;
+	std::vector<glm::vec4> m_vvec4ColorBuffer;
+	std::vector<GLuint> m_vuiIndices;
+	size_t m_nStagedVertexCount;
+	size_t m_nStagedIndexCount;
+	size_t m_nBufferVertexCapacity;	// vertices the VBO has room for
+
+	IllustrativeParticleAdvector m_Advector;
 
 	GLuint m_glVAO, m_glVBO, m_glEBO;
 	void initGL();
 
 	bool m_bReadyToTransferData;
 
-	glm::vec3 eulerForward(IllustrativeParticle* particle, float time, float delta);
-	glm::vec3 rk4(IllustrativeParticle* particle, float time, float delta);
+	// A free particle, or a replaced seed if there is none; -1 if there are no seeds either
+	int allocateParticle();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,344 @@
+#include "LASFile.h"
+
+#include <vector>
+#include <deque>
+#include <future>
+#include <thread>
+#include <algorithm>
+#include <limits>
+#include <stdio.h>
+#include <string.h>
+
+#include "laszip_api.h"
+
+// points fetched per block on the worker threads that feed the writer
+#define LAS_WRITE_BLOCK_POINTS 65536u
+
+namespace
+{
+	// laszip_load_dll() fails if the DLL is already loaded, so it is loaded once for all readers and writers
+	bool loadDLL()
+	{
+		static bool s_bLoaded = laszip_load_dll() == 0;
+
+		if (!s_bLoaded)
+			fprintf(stderr, "DLL ERROR: loading LASzip DLL\n");
+
+		return s_bLoaded;
+	}
+
+	bool isLAZ(std::string const &fileName)
+	{
+		return fileName.size() >= 4u && (fileName.compare(fileName.size() - 4u, 4u, ".laz") == 0 || fileName.compare(fileName.size() - 4u, 4u, ".LAZ") == 0);
+	}
+
+	// Finds the byte offsets of the TPU float attributes within each point's extra bytes from the LAS extra bytes
+	// VLR (user ID LASF_Spec, record ID 4), which holds one 192 byte descriptor per attribute in storage order
+	void findTPUAttributes(laszip_header const *header, int &depthTPUOffset, int &positionTPUOffset)
+	{
+		static const int s_TypeSizes[11] = { 0, 1, 1, 2, 2, 4, 4, 8, 8, 4, 8 };
+
+		depthTPUOffset = positionTPUOffset = -1;
+
+		for (laszip_U32 i = 0u; i < header->number_of_variable_length_records; ++i)
+		{
+			laszip_vlr const &vlr = header->vlrs[i];
+
+			if (strncmp(vlr.user_id, "LASF_Spec", sizeof(vlr.user_id)) != 0 || vlr.record_id != 4u || vlr.data == NULL)
+				continue;
+
+			int offset = 0;
+
+			for (unsigned int d = 0u; d + 192u <= vlr.record_length_after_header; d += 192u)
+			{
+				laszip_U8 type = vlr.data[d + 2u];
+				laszip_U8 options = vlr.data[d + 3u];
+				char name[33] = {};
+				memcpy(name, vlr.data + d + 4u, 32u);
+
+				if (type > 30u)
+					return;
+
+				if (type == 9u && strcmp(name, "depth TPU") == 0)
+					depthTPUOffset = offset;
+				else if (type == 9u && strcmp(name, "position TPU") == 0)
+					positionTPUOffset = offset;
+
+				// type 0 is opaque bytes sized by options, 11-20 and 21-30 are 2 and 3 element arrays of 1-10
+				offset += type == 0u ? options : type <= 10u ? s_TypeSizes[type] : type <= 20u ? 2 * s_TypeSizes[type - 10u] : 3 * s_TypeSizes[type - 20u];
+			}
+		}
+	}
+}
+
+bool LASFile::read(std::string fileName, std::function<void(long long, bool)> begin, std::function<void(long long, Point const &)> point)
+{
+	if (!loadDLL())
+		return false;
+
+	laszip_POINTER laszip_reader;
+	if (laszip_create(&laszip_reader))
+	{
+		fprintf(stderr, "DLL ERROR: creating laszip reader\n");
+		return false;
+	}
+
+	laszip_BOOL is_compressed = 0;
+	if (laszip_open_reader(laszip_reader, fileName.c_str(), &is_compressed))
+	{
+		fprintf(stderr, "DLL ERROR: opening laszip reader for '%s'\n", fileName.c_str());
+		laszip_destroy(laszip_reader);
+		return false;
+	}
+
+	laszip_header* header;
+	laszip_point* lasPoint;
+
+	if (laszip_get_header_pointer(laszip_reader, &header) || laszip_get_point_pointer(laszip_reader, &lasPoint))
+	{
+		fprintf(stderr, "DLL ERROR: getting header and point pointers from laszip reader\n");
+		laszip_close_reader(laszip_reader);
+		laszip_destroy(laszip_reader);
+		return false;
+	}
+
+	laszip_I64 npoints = (header->number_of_point_records ? header->number_of_point_records : header->extended_number_of_point_records);
+
+	fprintf(stderr, "file '%s' is %scompressed and contains %lld points\n", fileName.c_str(), (is_compressed ? "" : "un"), static_cast<long long>(npoints));
+
+	int depthTPUOffset, positionTPUOffset;
+	findTPUAttributes(header, depthTPUOffset, positionTPUOffset);
+
+	begin(npoints, depthTPUOffset >= 0 && positionTPUOffset >= 0);
+
+	Point p = {};
+	bool success = true;
+
+	for (laszip_I64 i = 0; i < npoints && success; ++i)
+	{
+		if (laszip_read_point(laszip_reader))
+		{
+			fprintf(stderr, "DLL ERROR: reading point %lld\n", static_cast<long long>(i));
+			success = false;
+			break;
+		}
+
+		// scaled and offset coordinates, so files with their own scale and offset round trip
+		laszip_F64 coordinates[3];
+		laszip_get_coordinates(laszip_reader, coordinates);
+
+		p.position = glm::dvec3(coordinates[0], coordinates[1], coordinates[2]);
+		p.color = glm::vec3(lasPoint->rgb[0], lasPoint->rgb[1], lasPoint->rgb[2]) / 65535.f;
+
+		if (depthTPUOffset >= 0 && depthTPUOffset + static_cast<int>(sizeof(float)) <= lasPoint->num_extra_bytes)
+			memcpy(&p.depthTPU, lasPoint->extra_bytes + depthTPUOffset, sizeof(float));
+		if (positionTPUOffset >= 0 && positionTPUOffset + static_cast<int>(sizeof(float)) <= lasPoint->num_extra_bytes)
+			memcpy(&p.positionTPU, lasPoint->extra_bytes + positionTPUOffset, sizeof(float));
+
+		point(i, p);
+	}
+
+	if (laszip_close_reader(laszip_reader))
+	{
+		fprintf(stderr, "DLL ERROR: closing laszip reader\n");
+		success = false;
+	}
+
+	laszip_destroy(laszip_reader);
+
+	return success;
+}
+
+bool LASFile::write(std::string fileName, unsigned int count, glm::dvec3 bbMin, glm::dvec3 bbMax, bool withColors, bool withTPU, std::function<void(unsigned int, Point &)> getPoint, unsigned int nThreads)
+{
+	if (!loadDLL())
+		return false;
+
+	if (nThreads == 0u)
+		nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	laszip_POINTER laszip_writer;
+	if (laszip_create(&laszip_writer))
+	{
+		fprintf(stderr, "DLL ERROR: creating laszip writer\n");
+		return false;
+	}
+
+	laszip_header* header;
+
+	if (laszip_get_header_pointer(laszip_writer, &header))
+	{
+		fprintf(stderr, "DLL ERROR: getting header pointer from laszip writer\n");
+		laszip_destroy(laszip_writer);
+		return false;
+	}
+
+	// offset to the center of the bounds and use the finest power of ten scale (down to 0.1mm) that keeps the
+	// integer coordinates within range
+	glm::dvec3 offset = glm::floor((bbMin + bbMax) * 0.5);
+	glm::dvec3 halfExtent = glm::max(bbMax - offset, offset - bbMin);
+	double scale = 0.0001;
+	while (scale < 1.0e6 && std::max(halfExtent.x, std::max(halfExtent.y, halfExtent.z)) / scale >= 2.0e9)
+		scale *= 10.;
+
+	header->version_major = 1;
+	header->version_minor = 2;
+	strncpy(header->generating_software, "VRSonarCleaner", sizeof(header->generating_software) - 1u);
+	header->point_data_format = withColors ? 2 : 0;
+	header->point_data_record_length = withColors ? 26 : 20;
+	header->number_of_point_records = count;
+	header->number_of_points_by_return[0] = count;
+	header->x_scale_factor = header->y_scale_factor = header->z_scale_factor = scale;
+	header->x_offset = offset.x;
+	header->y_offset = offset.y;
+	header->z_offset = offset.z;
+	header->min_x = bbMin.x;
+	header->min_y = bbMin.y;
+	header->min_z = bbMin.z;
+	header->max_x = bbMax.x;
+	header->max_y = bbMax.y;
+	header->max_z = bbMax.z;
+
+	// LAS extra bytes data type 9 (float), passed as the type minus one
+	if (withTPU && (laszip_add_attribute(laszip_writer, 8, "depth TPU", "total propagated depth uncertainty", 1.0, 0.0) ||
+		laszip_add_attribute(laszip_writer, 8, "position TPU", "total propagated positional uncertainty", 1.0, 0.0)))
+	{
+		fprintf(stderr, "DLL ERROR: adding TPU attributes to laszip writer\n");
+		laszip_destroy(laszip_writer);
+		return false;
+	}
+
+	// LASzip chunks and compresses the points itself
+	if (laszip_open_writer(laszip_writer, fileName.c_str(), isLAZ(fileName) ? 1 : 0))
+	{
+		fprintf(stderr, "DLL ERROR: opening laszip writer for '%s'\n", fileName.c_str());
+		laszip_destroy(laszip_writer);
+		return false;
+	}
+
+	laszip_point* point;
+
+	if (laszip_get_point_pointer(laszip_writer, &point))
+	{
+		fprintf(stderr, "DLL ERROR: getting point pointer from laszip writer\n");
+		laszip_close_writer(laszip_writer);
+		laszip_destroy(laszip_writer);
+		return false;
+	}
+
+	point->return_number = 1;
+	point->number_of_returns = 1;
+
+	// the points are fetched in blocks on worker threads, so getPoint() is called concurrently, and written in order
+	// by this thread. A bounded number of blocks is in flight.
+	auto fetchBlock = [&getPoint](unsigned int first, unsigned int n) {
+		std::vector<Point> block(n);
+		for (unsigned int i = 0u; i < n; ++i)
+			getPoint(first + i, block[i]);
+		return block;
+	};
+
+	std::deque<std::future<std::vector<Point>>> blocks;
+	size_t maxBlocksInFlight = 2u * nThreads;
+	unsigned int nextBlock = 0u;
+	unsigned int index = 0u;
+	bool success = true;
+
+	while (success && index < count)
+	{
+		while (nextBlock < count && blocks.size() < maxBlocksInFlight)
+		{
+			unsigned int n = std::min(LAS_WRITE_BLOCK_POINTS, count - nextBlock);
+			blocks.push_back(std::async(std::launch::async, fetchBlock, nextBlock, n));
+			nextBlock += n;
+		}
+
+		std::vector<Point> block = blocks.front().get();
+		blocks.pop_front();
+
+		for (auto const &p : block)
+		{
+			laszip_F64 coordinates[3] = { p.position.x, p.position.y, p.position.z };
+			laszip_set_coordinates(laszip_writer, coordinates);
+
+			if (withColors)
+			{
+				point->rgb[0] = static_cast<laszip_U16>(glm::clamp(p.color.r, 0.f, 1.f) * 65535.f + 0.5f);
+				point->rgb[1] = static_cast<laszip_U16>(glm::clamp(p.color.g, 0.f, 1.f) * 65535.f + 0.5f);
+				point->rgb[2] = static_cast<laszip_U16>(glm::clamp(p.color.b, 0.f, 1.f) * 65535.f + 0.5f);
+			}
+
+			if (withTPU)
+			{
+				memcpy(point->extra_bytes, &p.depthTPU, sizeof(float));
+				memcpy(point->extra_bytes + sizeof(float), &p.positionTPU, sizeof(float));
+			}
+
+			// the inventory replaces the header bounds with those of the quantized points when the writer closes
+			if (laszip_write_point(laszip_writer) || laszip_update_inventory(laszip_writer))
+			{
+				fprintf(stderr, "DLL ERROR: writing point %u\n", index);
+				success = false;
+				break;
+			}
+
+			++index;
+		}
+	}
+
+	// let blocks still being fetched finish before getPoint() goes out of scope
+	for (auto &block : blocks)
+		block.wait();
+
+	if (laszip_close_writer(laszip_writer))
+	{
+		fprintf(stderr, "DLL ERROR: closing laszip writer for '%s'\n", fileName.c_str());
+		success = false;
+	}
+
+	laszip_destroy(laszip_writer);
+
+	return success;
+}
+
+bool LASFile::writeCloud(std::string fileName, Cloud const &cloud, unsigned int nThreads, unsigned int *nWritten)
+{
+	std::vector<unsigned int> kept;
+	kept.reserve(cloud.count);
+
+	glm::dvec3 bbMin(std::numeric_limits<double>::max());
+	glm::dvec3 bbMax(-std::numeric_limits<double>::max());
+
+	for (unsigned int i = 0u; i < cloud.count; ++i)
+	{
+		if (cloud.marks && cloud.marks[i] == 1u)
+			continue;
+
+		kept.push_back(i);
+		bbMin = glm::min(bbMin, cloud.positions[i]);
+		bbMax = glm::max(bbMax, cloud.positions[i]);
+	}
+
+	if (kept.empty())
+		bbMin = bbMax = glm::dvec3(0.0);
+
+	// points are stored in LAS as heights, and as depths in the cloud
+	glm::dvec3 lasMin(bbMin.x, bbMin.y, -bbMax.z);
+	glm::dvec3 lasMax(bbMax.x, bbMax.y, -bbMin.z);
+
+	bool withTPU = cloud.depthTPU != NULL && cloud.positionTPU != NULL;
+
+	bool success = write(fileName, static_cast<unsigned int>(kept.size()), lasMin, lasMax, cloud.colors != NULL, withTPU, [&cloud, &kept, withTPU](unsigned int i, Point &p) {
+		unsigned int index = kept[i];
+		glm::dvec3 const &pt = cloud.positions[index];
+		p.position = glm::dvec3(pt.x, pt.y, -pt.z);
+		p.color = cloud.colors ? cloud.colors[index] : glm::vec3(0.f);
+		p.depthTPU = withTPU ? cloud.depthTPU[index] : 0.f;
+		p.positionTPU = withTPU ? cloud.positionTPU[index] : 0.f;
+	}, nThreads);
+
+	if (nWritten)
+		*nWritten = success ? static_cast<unsigned int>(kept.size()) : 0u;
+
+	return success;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <functional>
+#include <glm.hpp>
+
+// LAS and LAZ point cloud files, read and written through the LASzip DLL
+class LASFile
+{
+public:
+	struct Point {
+		glm::dvec3 position; // LAS coordinates, z is height
+		glm::vec3 color; // RGB in [0, 1]
+		float depthTPU;
+		float positionTPU;
+	};
+
+	// Point columns of a cloud as SonarPointCloud stores them, with z as depth. colors, or both TPUs, are NULL if
+	// the cloud has none. Points marked 1 are deleted.
+	struct Cloud {
+		unsigned int count;
+		glm::dvec3 const *positions;
+		glm::vec3 const *colors;
+		float const *depthTPU;
+		float const *positionTPU;
+		unsigned int const *marks;
+	};
+
+	// Reads a LAS or LAZ file. begin(count, hasTPU) is called with the point count from the header and whether the
+	// file has the TPU extra bytes attributes written by write(), then point(index, p) for each point in file order.
+	// The TPUs are 0 if the file has none.
+	static bool read(std::string fileName, std::function<void(long long, bool)> begin, std::function<void(long long, Point const &)> point);
+
+	// Writes count points fetched by getPoint(index, p) as LAS 1.2, compressed to LAZ if the file name ends in
+	// .laz, optionally with RGB colors and the TPUs as extra bytes attributes. bbMin and bbMax bound the points and
+	// choose the scale and offset. The points are fetched in blocks on nThreads worker threads (0 = hardware
+	// concurrency), so getPoint() is called concurrently, while LASzip's writer chunks and compresses them in order.
+	static bool write(std::string fileName, unsigned int count, glm::dvec3 bbMin, glm::dvec3 bbMax, bool withColors, bool withTPU, std::function<void(unsigned int, Point &)> getPoint, unsigned int nThreads = 0u);
+
+	// Writes the points of a cloud that are not deleted, bounded by those points, with its colors or TPUs.
+	// nWritten, if given, receives the number of points written.
+	static bool writeCloud(std::string fileName, Cloud const &cloud, unsigned int nThreads = 0u, unsigned int *nWritten = NULL);
+};
@@ -11,7 +11,6 @@ PointCleanProbe::PointCleanProbe(ViveController* pController, DataVolume* pointC
 	, m_bProbeActive(false)
 	, m_bWaitForTriggerRelease(true)
 	, m_pHMD(vr::VRSystem())
-	, m_fPtHighlightAmt(1.f)
 	, m_tpLastTime(std::chrono::high_resolution_clock::now())
 	, m_fCursorHoopAngle(0.f)
 	, m_nPointsSelected(0u)
@@ -315,9 +314,6 @@ unsigned int PointCleanProbe::checkPoints()
 
 	unsigned int selectedPoints(0u);
 
-	float delta = m_msElapsedTime.count() / POINT_CLOUD_HIGHLIGHT_BLINK_RATE.count();
-	m_fPtHighlightAmt = fmodf(m_fPtHighlightAmt + delta, 1.f);
-
 	glm::vec3 vec3CurrentCursorPos = getPosition();
 	glm::vec3 vec3LastCursorPos = getLastPosition();
 
@@ -358,8 +354,6 @@ unsigned int PointCleanProbe::checkPoints()
 			(vec3CurrentCursorPos.z - vec3LastCursorPos.z) * (vec3CurrentCursorPos.z - vec3LastCursorPos.z);
 
 		// POINTS CHECK
-		bool pointsRefresh = false;
-
 		for (unsigned int i = 0u; i < cloud->getPointCount(); ++i)
 		{
 			//skip already marked points
@@ -372,10 +366,7 @@ unsigned int PointCleanProbe::checkPoints()
 			if (!checkPointInAABB(thisPt, vec3MinProbeAABB, vec3MaxProbeAABB))
 			{
 				if (cloud->getPointMark(i) != 0)
-				{
 					cloud->markPoint(i, 0);
-					pointsRefresh = true;
-				}
 				continue;
 			}
 
@@ -455,21 +446,17 @@ unsigned int PointCleanProbe::checkPoints()
 				}
 				else
 				{
-					cloud->markPoint(i, static_cast<int>(100.f + 100.f * m_fPtHighlightAmt));
+					// highlight blinking is animated by the point shader, so only points entering the probe need marking
+					if (cloud->getPointMark(i) < 100)
+						cloud->markPoint(i, 100);
 					selectedPoints++;
 				}
-
-				pointsRefresh = true;
 			}
 			else if (cloud->getPointMark(i) != 0)
 			{
 				cloud->markPoint(i, 0);
-				pointsRefresh = true;
 			}
 		}
-
-		if (pointsRefresh)
-			cloud->setRefreshNeeded();
 	}
 	
 	if (m_bAnyHits)
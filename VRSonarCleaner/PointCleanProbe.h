@@ -5,7 +5,6 @@
 #include "openvr.h"
 
 #define POINT_CLOUD_CLEAN_PROBE_ROTATION_RATE std::chrono::duration<float, std::milli>(2000)
-#define POINT_CLOUD_HIGHLIGHT_BLINK_RATE std::chrono::duration<float, std::milli>(250)
 
 class PointCleanProbe :
 	public ProbeBehavior
@@ -25,7 +24,6 @@ private:
 	bool m_bProbeActive;
 	bool m_bWaitForTriggerRelease;
 	bool m_bAnyHits;
-	float m_fPtHighlightAmt;
 	unsigned int m_nPointsSelected;
 
 	vr::IVRSystem *m_pHMD;
@@ -0,0 +1,345 @@
+#include "PointCloudLOD.h"
+
+#include <algorithm>
+#include <queue>
+#include <limits>
+
+PointCloudLOD::PointCloudLOD(unsigned int gridResolution, unsigned int maxLeafPoints, unsigned int maxDepth)
+	: m_nGridResolution(gridResolution)
+	, m_nMaxLeafPoints(maxLeafPoints)
+	, m_nMaxDepth(maxDepth)
+	, m_nPreviewPointCount(0u)
+{
+}
+
+PointCloudLOD::~PointCloudLOD()
+{
+}
+
+void PointCloudLOD::build(std::vector<glm::vec3> const &positions, std::vector<unsigned int> const *previewPoints, float previewSpacing)
+{
+	clear();
+
+	if (positions.size() == 0u)
+		return;
+
+	glm::vec3 bbMin(std::numeric_limits<float>::max());
+	glm::vec3 bbMax(-std::numeric_limits<float>::max());
+
+	for (auto const &p : positions)
+	{
+		bbMin = glm::min(bbMin, p);
+		bbMax = glm::max(bbMax, p);
+	}
+
+	// octree cells are cubes
+	float cubeSize = (std::max)((std::max)(bbMax.x - bbMin.x, bbMax.y - bbMin.y), (std::max)(bbMax.z - bbMin.z, std::numeric_limits<float>::epsilon()));
+
+	Node root;
+	root.bbMin = bbMin;
+	root.bbMax = bbMin + glm::vec3(cubeSize);
+	root.level = 0u;
+	std::fill(root.children, root.children + 8, -1);
+	m_vNodes.push_back(root);
+
+	unsigned int res = m_nGridResolution;
+
+	// the preview points make up the levels whose grid is coarser than the preview spacing and
+	// the first level finer than it, which takes all the preview points not yet placed above
+	std::vector<bool> inPreview;
+	unsigned int previewLevel = 0u;
+
+	if (previewPoints)
+	{
+		inPreview.resize(positions.size(), false);
+		for (auto i : *previewPoints)
+			inPreview[i] = true;
+
+		for (float spacing = cubeSize / static_cast<float>(res); spacing > previewSpacing && previewLevel < m_nMaxDepth; spacing *= 0.5f)
+			previewLevel++;
+	}
+
+	// points still to be distributed to each node, freed once the node is processed
+	std::vector<std::vector<unsigned int>> nodePoints(1);
+	nodePoints[0].resize(positions.size());
+	for (unsigned int i = 0u; i < positions.size(); ++i)
+		nodePoints[0][i] = i;
+
+	m_vuiPointOrder.reserve(positions.size());
+
+	std::vector<unsigned char> occupied(res * res * res, 0u);
+	std::vector<unsigned int> touchedCells;
+	std::vector<unsigned int> childPoints[8];
+
+	// nodes are appended in breadth-first order as they are created, so processing them in order
+	// lays out every level of the hierarchy after the one above it
+	for (size_t n = 0u; n < m_vNodes.size(); ++n)
+	{
+		std::vector<unsigned int> points;
+		points.swap(nodePoints[n]);
+
+		Node &node = m_vNodes[n];
+		glm::vec3 nodeSize = node.bbMax - node.bbMin;
+		node.spacing = nodeSize.x / static_cast<float>(res);
+		node.first = static_cast<unsigned int>(m_vuiPointOrder.size());
+
+		// nodes down to the preview level are always split, so the points below them stay out of the preview
+		bool previewNode = previewPoints && node.level <= previewLevel;
+
+		if ((points.size() <= m_nMaxLeafPoints && !previewNode) || node.level >= m_nMaxDepth)
+		{
+			m_vuiPointOrder.insert(m_vuiPointOrder.end(), points.begin(), points.end());
+			node.count = static_cast<unsigned int>(points.size());
+
+			if (previewNode)
+				m_nPreviewPointCount = node.first + node.count;
+
+			continue;
+		}
+
+		glm::vec3 center = node.bbMin + nodeSize * 0.5f;
+		float cellsPerUnit = static_cast<float>(res) / nodeSize.x;
+
+		// above the preview level, only preview points are stratified into the node
+		bool previewOnly = previewPoints && node.level < previewLevel;
+		bool allPreview = previewPoints && node.level == previewLevel;
+
+		if (allPreview)
+			node.spacing = (std::max)(previewSpacing, node.spacing);
+
+		for (auto i : points)
+		{
+			glm::vec3 const &p = positions[i];
+
+			bool keep;
+			if (allPreview)
+			{
+				keep = inPreview[i];
+			}
+			else if (previewOnly && !inPreview[i])
+			{
+				keep = false;
+			}
+			else
+			{
+				glm::uvec3 cell = glm::uvec3(glm::clamp(glm::ivec3((p - node.bbMin) * cellsPerUnit), glm::ivec3(0), glm::ivec3(res - 1)));
+				unsigned int key = (cell.z * res + cell.y) * res + cell.x;
+
+				keep = !occupied[key];
+				if (keep)
+				{
+					occupied[key] = 1u;
+					touchedCells.push_back(key);
+				}
+			}
+
+			if (keep)
+			{
+				m_vuiPointOrder.push_back(i);
+			}
+			else
+			{
+				unsigned int octant = (p.x >= center.x ? 1u : 0u) | (p.y >= center.y ? 2u : 0u) | (p.z >= center.z ? 4u : 0u);
+				childPoints[octant].push_back(i);
+			}
+		}
+
+		for (auto key : touchedCells)
+			occupied[key] = 0u;
+		touchedCells.clear();
+
+		node.count = static_cast<unsigned int>(m_vuiPointOrder.size()) - node.first;
+
+		if (previewNode)
+			m_nPreviewPointCount = node.first + node.count;
+
+		for (unsigned int octant = 0u; octant < 8u; ++octant)
+		{
+			if (childPoints[octant].size() == 0u)
+				continue;
+
+			Node child;
+			child.bbMin = glm::vec3(
+				(octant & 1u) ? center.x : m_vNodes[n].bbMin.x,
+				(octant & 2u) ? center.y : m_vNodes[n].bbMin.y,
+				(octant & 4u) ? center.z : m_vNodes[n].bbMin.z
+			);
+			child.bbMax = child.bbMin + nodeSize * 0.5f;
+			child.level = m_vNodes[n].level + 1u;
+			std::fill(child.children, child.children + 8, -1);
+
+			// careful: push_back invalidates the node reference
+			m_vNodes[n].children[octant] = static_cast<int>(m_vNodes.size());
+			m_vNodes.push_back(child);
+
+			nodePoints.push_back(std::vector<unsigned int>());
+			nodePoints.back().swap(childPoints[octant]);
+		}
+	}
+}
+
+void PointCloudLOD::clear()
+{
+	m_vNodes.clear();
+	m_vuiPointOrder.clear();
+	m_nPreviewPointCount = 0u;
+}
+
+bool PointCloudLOD::isBuilt()
+{
+	return m_vNodes.size() > 0u;
+}
+
+std::vector<PointCloudLOD::Node> const & PointCloudLOD::getNodes()
+{
+	return m_vNodes;
+}
+
+std::vector<unsigned int> const & PointCloudLOD::getPointOrder()
+{
+	return m_vuiPointOrder;
+}
+
+unsigned int PointCloudLOD::getPreviewPointCount()
+{
+	return m_nPreviewPointCount;
+}
+
+float PointCloudLOD::getScreenSpaceError(unsigned int node, glm::mat4 const &modelView, float projectionFactor)
+{
+	Node const &n = m_vNodes[node];
+
+	float scale = (std::max)(glm::length(glm::vec3(modelView[0])), (std::max)(glm::length(glm::vec3(modelView[1])), glm::length(glm::vec3(modelView[2]))));
+
+	glm::vec3 center = glm::vec3(modelView * glm::vec4((n.bbMin + n.bbMax) * 0.5f, 1.f));
+	float radius = glm::length(n.bbMax - n.bbMin) * 0.5f * scale;
+
+	float distance = glm::length(center) - radius;
+
+	// viewer is inside the node's bounding sphere
+	if (distance <= std::numeric_limits<float>::epsilon())
+		return std::numeric_limits<float>::max();
+
+	return n.spacing * scale * projectionFactor / distance;
+}
+
+void PointCloudLOD::getFrustumPlanes(glm::mat4 const &modelViewProjection, glm::vec4 (&frustumPlanes)[6])
+{
+	glm::mat4 m = glm::transpose(modelViewProjection);
+
+	frustumPlanes[0] = m[3] + m[0]; // left
+	frustumPlanes[1] = m[3] - m[0]; // right
+	frustumPlanes[2] = m[3] + m[1]; // bottom
+	frustumPlanes[3] = m[3] - m[1]; // top
+	frustumPlanes[4] = m[3] + m[2]; // near
+	frustumPlanes[5] = m[3] - m[2]; // far
+}
+
+bool PointCloudLOD::isInFrustum(unsigned int node, glm::vec4 const (&frustumPlanes)[6])
+{
+	Node const &n = m_vNodes[node];
+
+	for (auto const &plane : frustumPlanes)
+	{
+		// test the box corner furthest along the plane normal
+		glm::vec3 p(
+			plane.x >= 0.f ? n.bbMax.x : n.bbMin.x,
+			plane.y >= 0.f ? n.bbMax.y : n.bbMin.y,
+			plane.z >= 0.f ? n.bbMax.z : n.bbMin.z
+		);
+
+		if (glm::dot(glm::vec3(plane), p) + plane.w < 0.f)
+			return false;
+	}
+
+	return true;
+}
+
+unsigned int PointCloudLOD::select(glm::mat4 const &modelView, glm::mat4 const &projection, float viewportHeight, float maxScreenSpaceError, unsigned int pointBudget, std::vector<unsigned int> &selectedNodes)
+{
+	return select(modelView, projection, viewportHeight, maxScreenSpaceError, pointBudget, std::vector<glm::mat4>(1, projection * modelView), selectedNodes);
+}
+
+unsigned int PointCloudLOD::select(glm::mat4 const &modelView, glm::mat4 const &projection, float viewportHeight, float maxScreenSpaceError, unsigned int pointBudget, std::vector<glm::mat4> const &cullModelViewProjections, std::vector<unsigned int> &selectedNodes)
+{
+	selectedNodes.clear();
+
+	if (m_vNodes.size() == 0u)
+		return 0u;
+
+	// pixels per unit length at unit distance
+	float projectionFactor = projection[1][1] * viewportHeight * 0.5f;
+
+	struct Frustum {
+		glm::vec4 planes[6];
+	};
+
+	std::vector<Frustum> frusta(cullModelViewProjections.size());
+	for (size_t i = 0u; i < frusta.size(); ++i)
+		getFrustumPlanes(cullModelViewProjections[i], frusta[i].planes);
+
+	auto isVisible = [&](unsigned int node) {
+		for (auto const &f : frusta)
+			if (isInFrustum(node, f.planes))
+				return true;
+		return false;
+	};
+
+	typedef std::pair<float, unsigned int> QueueEntry;
+	std::priority_queue<QueueEntry> queue;
+
+	if (isVisible(0u))
+		queue.push(QueueEntry(std::numeric_limits<float>::max(), 0u));
+
+	unsigned int nPoints = 0u;
+
+	while (!queue.empty())
+	{
+		unsigned int n = queue.top().second;
+		queue.pop();
+
+		if (n != 0u && nPoints + m_vNodes[n].count > pointBudget)
+			break;
+
+		selectedNodes.push_back(n);
+		nPoints += m_vNodes[n].count;
+
+		if (getScreenSpaceError(n, modelView, projectionFactor) <= maxScreenSpaceError)
+			continue;
+
+		for (int i = 0; i < 8; ++i)
+		{
+			int child = m_vNodes[n].children[i];
+
+			if (child >= 0 && isVisible(static_cast<unsigned int>(child)))
+				queue.push(QueueEntry(getScreenSpaceError(child, modelView, projectionFactor), static_cast<unsigned int>(child)));
+		}
+	}
+
+	return nPoints;
+}
+
+void PointCloudLOD::getRanges(std::vector<unsigned int> const &nodes, std::vector<Range> &ranges)
+{
+	ranges.clear();
+
+	for (auto n : nodes)
+	{
+		Range r;
+		r.first = m_vNodes[n].first;
+		r.count = m_vNodes[n].count;
+		ranges.push_back(r);
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](Range const &lhs, Range const &rhs) { return lhs.first < rhs.first; });
+
+	size_t nMerged = 0u;
+	for (size_t i = 0u; i < ranges.size(); ++i)
+	{
+		if (nMerged > 0u && ranges[nMerged - 1u].first + ranges[nMerged - 1u].count == ranges[i].first)
+			ranges[nMerged - 1u].count += ranges[i].count;
+		else
+			ranges[nMerged++] = ranges[i];
+	}
+	ranges.resize(nMerged);
+}
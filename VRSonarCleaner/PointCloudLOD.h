@@ -0,0 +1,72 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+// Octree level-of-detail hierarchy for point clouds. Each node keeps a spatially
+// stratified subset of the points in its cell (at most one point per cell of a
+// grid at the node's resolution) and passes the remaining points down to its
+// children. Node points are stored contiguously in breadth-first order, so a node
+// can be drawn as a single range of a point buffer laid out in getPointOrder().
+class PointCloudLOD
+{
+public:
+	struct Node {
+		glm::vec3 bbMin;
+		glm::vec3 bbMax;
+		float spacing;		// grid cell size of the node's stratified subset
+		unsigned int level;
+		unsigned int first; // first slot of this node in the point order
+		unsigned int count;	// number of points held by this node
+		int children[8];	// child node indices, -1 if no child in that octant
+	};
+
+	struct Range {
+		unsigned int first;
+		unsigned int count;
+	};
+
+public:
+	PointCloudLOD(unsigned int gridResolution = 32u, unsigned int maxLeafPoints = 4096u, unsigned int maxDepth = 16u);
+	~PointCloudLOD();
+
+	// If previewPoints is given (e.g. a precomputed even subsample with point spacing previewSpacing), the coarse
+	// levels are stratified from those points only, down to the first level finer than previewSpacing, which takes
+	// the rest of them. The preview is then the leading getPreviewPointCount() slots of the point order.
+	void build(std::vector<glm::vec3> const &positions, std::vector<unsigned int> const *previewPoints = NULL, float previewSpacing = 0.f);
+	void clear();
+
+	bool isBuilt();
+
+	std::vector<Node> const & getNodes();
+	std::vector<unsigned int> const & getPointOrder(); // point slot -> point index
+	unsigned int getPreviewPointCount();
+
+	// Selects the nodes to draw, refining nodes whose projected point spacing exceeds maxScreenSpaceError pixels,
+	// coarsest and largest error first, until pointBudget would be exceeded. The root is always selected when it
+	// is in view, even if it alone exceeds the budget, so a cloud never disappears. Nodes outside the view frustum
+	// (including beyond the far plane) are culled along with their subtrees. Returns the number of points selected.
+	unsigned int select(glm::mat4 const &modelView, glm::mat4 const &projection, float viewportHeight, float maxScreenSpaceError, unsigned int pointBudget, std::vector<unsigned int> &selectedNodes);
+
+	// As above, but nodes are culled against several model-view-projections (e.g. both eyes of a stereo view)
+	// and kept if they are inside any of them. Screen space errors are still measured in modelView/projection.
+	unsigned int select(glm::mat4 const &modelView, glm::mat4 const &projection, float viewportHeight, float maxScreenSpaceError, unsigned int pointBudget, std::vector<glm::mat4> const &cullModelViewProjections, std::vector<unsigned int> &selectedNodes);
+
+	// Converts a node selection to a sorted list of point slot ranges, merging adjacent ranges
+	void getRanges(std::vector<unsigned int> const &nodes, std::vector<Range> &ranges);
+
+	float getScreenSpaceError(unsigned int node, glm::mat4 const &modelView, float projectionFactor);
+	bool isInFrustum(unsigned int node, glm::vec4 const (&frustumPlanes)[6]);
+
+	// Extracts the six clip planes of a model-view-projection matrix in model coordinates
+	static void getFrustumPlanes(glm::mat4 const &modelViewProjection, glm::vec4 (&frustumPlanes)[6]);
+
+private:
+	unsigned int m_nGridResolution;
+	unsigned int m_nMaxLeafPoints;
+	unsigned int m_nMaxDepth;
+
+	std::vector<Node> m_vNodes;
+	std::vector<unsigned int> m_vuiPointOrder;
+	unsigned int m_nPreviewPointCount;
+};
@@ -0,0 +1,134 @@
+#include "PointCloudSubsampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+#include <thread>
+#include <unordered_map>
+
+namespace
+{
+	// voxel coordinates are packed into 21 bits per axis
+	const unsigned int MAX_VOXEL_COORD = 0x1FFFFFu;
+
+	struct VoxelSample {
+		float distSq;
+		unsigned int index;
+
+		// nearest to the voxel center wins, ties go to the lower point index
+		bool betterThan(VoxelSample const &other) const
+		{
+			return distSq < other.distSq || (distSq == other.distSq && index < other.index);
+		}
+	};
+
+	typedef std::unordered_map<unsigned long long, VoxelSample> VoxelMap;
+
+	void binPoints(std::vector<glm::vec3> const &positions, size_t begin, size_t end, glm::vec3 origin, float voxelSize, VoxelMap &voxels)
+	{
+		float invVoxelSize = 1.f / voxelSize;
+
+		for (size_t i = begin; i < end; ++i)
+		{
+			glm::vec3 rel = (positions[i] - origin) * invVoxelSize;
+			glm::vec3 cell = glm::min(glm::floor(rel), glm::vec3(static_cast<float>(MAX_VOXEL_COORD)));
+
+			unsigned long long key =
+				static_cast<unsigned long long>(cell.x) |
+				(static_cast<unsigned long long>(cell.y) << 21) |
+				(static_cast<unsigned long long>(cell.z) << 42);
+
+			glm::vec3 offset = rel - cell - glm::vec3(0.5f);
+
+			VoxelSample sample;
+			sample.distSq = glm::dot(offset, offset);
+			sample.index = static_cast<unsigned int>(i);
+
+			auto it = voxels.find(key);
+			if (it == voxels.end())
+				voxels.emplace(key, sample);
+			else if (sample.betterThan(it->second))
+				it->second = sample;
+		}
+	}
+}
+
+std::vector<unsigned int> PointCloudSubsampler::voxelGrid(std::vector<glm::vec3> const &positions, float voxelSize, unsigned int nThreads)
+{
+	std::vector<unsigned int> kept;
+
+	if (positions.size() == 0u || !(voxelSize > 0.f))
+		return kept;
+
+	glm::vec3 origin(std::numeric_limits<float>::max());
+	glm::vec3 bbMax(-std::numeric_limits<float>::max());
+	for (auto const &p : positions)
+	{
+		origin = glm::min(origin, p);
+		bbMax = glm::max(bbMax, p);
+	}
+
+	// grow the voxels if needed so the extent fits in the voxel keys instead of distant voxels sharing a key
+	glm::vec3 extent = bbMax - origin;
+	float maxExtent = (std::max)(extent.x, (std::max)(extent.y, extent.z));
+	voxelSize = (std::max)(voxelSize, maxExtent / static_cast<float>(MAX_VOXEL_COORD));
+
+	if (nThreads == 0u)
+		nThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+	size_t chunkSize = (positions.size() + nThreads - 1u) / nThreads;
+
+	std::vector<VoxelMap> threadVoxels(nThreads);
+	std::vector<std::future<void>> futures;
+
+	for (unsigned int t = 0u; t < nThreads; ++t)
+	{
+		size_t begin = (std::min)(positions.size(), t * chunkSize);
+		size_t end = (std::min)(positions.size(), begin + chunkSize);
+
+		futures.push_back(std::async(std::launch::async, binPoints, std::cref(positions), begin, end, origin, voxelSize, std::ref(threadVoxels[t])));
+	}
+
+	for (auto &f : futures)
+		f.get();
+
+	// merge the per-thread voxels into the first map
+	VoxelMap &voxels = threadVoxels[0];
+	for (unsigned int t = 1u; t < nThreads; ++t)
+	{
+		for (auto const &v : threadVoxels[t])
+		{
+			auto it = voxels.find(v.first);
+			if (it == voxels.end())
+				voxels.insert(v);
+			else if (v.second.betterThan(it->second))
+				it->second = v.second;
+		}
+
+		VoxelMap().swap(threadVoxels[t]);
+	}
+
+	kept.reserve(voxels.size());
+	for (auto const &v : voxels)
+		kept.push_back(v.second.index);
+
+	std::sort(kept.begin(), kept.end());
+
+	return kept;
+}
+
+float PointCloudSubsampler::estimateVoxelSize(glm::vec3 bbMin, glm::vec3 bbMax, unsigned int targetCount)
+{
+	glm::vec3 dims = bbMax - bbMin;
+
+	// area of the two largest extents
+	float sorted[3] = { dims.x, dims.y, dims.z };
+	std::sort(sorted, sorted + 3);
+	float area = sorted[1] * sorted[2];
+
+	if (targetCount == 0u || !(area > 0.f))
+		return (std::max)(sorted[2], std::numeric_limits<float>::epsilon());
+
+	return std::sqrt(area / static_cast<float>(targetCount));
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <glm.hpp>
+
+// Evenly distributed point cloud subsampling. Unlike taking every Nth point, which
+// aliases against the ordering of swath data, this keeps one point per occupied
+// voxel: the point nearest the voxel center.
+class PointCloudSubsampler
+{
+public:
+	// Returns the indices of the kept points in ascending order. The points are binned in parallel on nThreads
+	// worker threads (0 = hardware concurrency) and the result does not depend on the thread count. The voxel size is
+	// raised if needed so the point extent is at most 2^21 - 1 voxels along each axis.
+	static std::vector<unsigned int> voxelGrid(std::vector<glm::vec3> const &positions, float voxelSize, unsigned int nThreads = 0u);
+
+	// Estimates the voxel size that keeps about targetCount points of a 2.5D (e.g. bathymetric) surface
+	static float estimateVoxelSize(glm::vec3 bbMin, glm::vec3 bbMax, unsigned int targetCount);
+};
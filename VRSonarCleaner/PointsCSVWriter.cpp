@@ -0,0 +1,62 @@
+#include "PointsCSVWriter.h"
+
+#include <algorithm>
+#include <thread>
+
+PointsCSVWriter::PointsCSVWriter(FILE *file, unsigned int blockSize, unsigned int nBlocksInFlight)
+	: m_pFile(file)
+	, m_nBlockSize((std::max)(blockSize, 1u))
+	, m_nMaxBlocksInFlight(nBlocksInFlight > 0u ? nBlocksInFlight : (std::max)(std::thread::hardware_concurrency(), 2u))
+{
+}
+
+PointsCSVWriter::~PointsCSVWriter()
+{
+	finish();
+}
+
+void PointsCSVWriter::addPoints(glm::dvec3 const *positions, unsigned int const *marks, float const *flags, unsigned int count)
+{
+	for (unsigned int first = 0u; first < count; first += m_nBlockSize)
+	{
+		if (m_qBlocks.size() >= m_nMaxBlocksInFlight)
+			writeOldestBlock();
+
+		m_qBlocks.push_back(std::async(std::launch::async, formatRows, positions, marks, flags, first, (std::min)(m_nBlockSize, count - first)));
+	}
+}
+
+void PointsCSVWriter::finish()
+{
+	while (m_qBlocks.size() > 0u)
+		writeOldestBlock();
+}
+
+void PointsCSVWriter::writeOldestBlock()
+{
+	std::string rows = m_qBlocks.front().get();
+	m_qBlocks.pop_front();
+
+	fwrite(rows.data(), 1u, rows.size(), m_pFile);
+}
+
+std::string PointsCSVWriter::formatRows(glm::dvec3 const *positions, unsigned int const *marks, float const *flags, unsigned int first, unsigned int count)
+{
+	std::string rows;
+	rows.reserve(static_cast<size_t>(count) * 64u);
+
+	char line[128];
+
+	for (unsigned int i = first; i < first + count; ++i)
+	{
+		if (marks[i] == 1u)
+			continue;
+
+		glm::dvec3 const &pt = positions[i];
+		int len = snprintf(line, sizeof(line), "%.17g,%.17g,%.17g,%s\n", pt.x, pt.y, pt.z, flags[i] == 1.f ? "1" : "0");
+
+		rows.append(line, len);
+	}
+
+	return rows;
+}
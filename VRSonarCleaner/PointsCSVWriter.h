@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <deque>
+#include <future>
+#include <glm.hpp>
+
+// Writes point rows "x,y,z,flag" to a CSV file. Rows are formatted in blocks on worker threads and written in
+// order, one write per block, with a bounded number of blocks in flight.
+class PointsCSVWriter
+{
+public:
+	// nBlocksInFlight = 0 uses the hardware concurrency, at least 2
+	PointsCSVWriter(FILE *file, unsigned int blockSize = 1u << 18, unsigned int nBlocksInFlight = 0u);
+	~PointsCSVWriter();
+
+	// Queues the points not marked deleted (1). The arrays must stay valid until finish() returns.
+	// A point's flag is 1 if its flag value is exactly 1, else 0.
+	void addPoints(glm::dvec3 const *positions, unsigned int const *marks, float const *flags, unsigned int count);
+
+	// Writes all queued rows
+	void finish();
+
+	// Formats the non-deleted points in [first, first + count) as CSV rows. "%.17g" is what an ostream with
+	// max_digits10 precision produces, so the output matches writing the values with operator<<.
+	static std::string formatRows(glm::dvec3 const *positions, unsigned int const *marks, float const *flags, unsigned int first, unsigned int count);
+
+private:
+	void writeOldestBlock();
+
+	FILE *m_pFile;
+	unsigned int m_nBlockSize;
+	size_t m_nMaxBlocksInFlight;
+	std::deque<std::future<std::string>> m_qBlocks;
+};
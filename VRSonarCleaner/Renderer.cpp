@@ -952,8 +952,14 @@ void Renderer::processRenderQueue(std::vector<RendererSubmission> &renderQueue)
 			glFrontFace(i.vertWindingOrder);
 
 			glBindVertexArray(i.VAO);
-			if (i.instanced)
-				glDrawElementsInstancedBaseVertex(i.glPrimitiveType, i.vertCount, i.indexType, (GLvoid*)i.indexByteOffset, i.instanceCount, i.indexBaseVertex);
+			if (i.indirectBuffer)
+			{
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, i.indirectBuffer);
+				glMultiDrawElementsIndirect(i.glPrimitiveType, i.indexType, (GLvoid*)i.indirectByteOffset, i.indirectDrawCount, 0);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			}
+			else if (i.instanced)
+				glDrawElementsInstancedBaseVertexBaseInstance(i.glPrimitiveType, i.vertCount, i.indexType, (GLvoid*)i.indexByteOffset, i.instanceCount, i.indexBaseVertex, i.instanceBase);
 			else
 				glDrawElementsBaseVertex(i.glPrimitiveType, i.vertCount, i.indexType, (GLvoid*)i.indexByteOffset, i.indexBaseVertex);
 			glBindVertexArray(0);
@@ -1873,7 +1879,7 @@ GLuint Renderer::createInstancedDataBufferVBO(std::vector<glm::vec3>* instancePo
 	return buffer;
 }
 
-GLuint Renderer::createInstancedPrimitiveVAO(std::string primitiveName, GLuint instanceDataVBO, GLsizei instanceCount, GLsizei instanceStride)
+GLuint Renderer::createInstancedPrimitiveVAO(std::string primitiveName, GLuint instanceDataVBO, GLsizei instanceCount, GLsizei instanceStride, GLuint instanceHighlightVBO)
 {
 	if (!instanceDataVBO)
 	{
@@ -1906,6 +1912,17 @@ GLuint Renderer::createInstancedPrimitiveVAO(std::string primitiveName, GLuint i
 			glEnableVertexAttribArray(INSTANCE_COLOR_ATTRIB_LOCATION);
 			glVertexAttribPointer(INSTANCE_COLOR_ATTRIB_LOCATION, 4, GL_FLOAT, GL_FALSE, sizeof(glm::vec4) * instanceStride, (GLvoid*)(instanceCount * sizeof(glm::vec3)));
 			glVertexAttribDivisor(INSTANCE_COLOR_ATTRIB_LOCATION, 1);
+
+		// Describe per-instance highlight timestamps, if any
+		if (instanceHighlightVBO)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, instanceHighlightVBO);
+				glEnableVertexAttribArray(INSTANCE_HIGHLIGHT_ATTRIB_LOCATION);
+				glVertexAttribPointer(INSTANCE_HIGHLIGHT_ATTRIB_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float) * instanceStride, (GLvoid*)0);
+				glVertexAttribDivisor(INSTANCE_HIGHLIGHT_ATTRIB_LOCATION, 1);
+		}
+		else
+			glVertexAttrib1f(INSTANCE_HIGHLIGHT_ATTRIB_LOCATION, -1.f);
 	glBindVertexArray(0);
 
 	return vao;
@@ -30,6 +30,16 @@ public:
 		GLuint m_nResolveFramebufferId;
 	};
 
+	// Layout of a glMultiDrawElementsIndirect command
+	struct DrawElementsIndirectCommand
+	{
+		GLuint	count;
+		GLuint	instanceCount;
+		GLuint	firstIndex;
+		GLint	baseVertex;
+		GLuint	baseInstance;
+	};
+
 	struct RendererSubmission
 	{
 		GLenum				glPrimitiveType;
@@ -48,6 +58,10 @@ public:
 		bool				hasTransparency;
 		bool				instanced;
 		GLsizei				instanceCount;
+		GLuint				instanceBase;
+		GLuint				indirectBuffer;			// if set, draws indirectDrawCount commands from this buffer instead
+		unsigned long long	indirectByteOffset;
+		GLsizei				indirectDrawCount;
 		glm::vec4			transparencySortPosition;
 		glm::mat4			modelToWorldTransform;
 
@@ -68,6 +82,10 @@ public:
 			, hasTransparency(false)
 			, instanced(false)
 			, instanceCount(0u)
+			, instanceBase(0u)
+			, indirectBuffer(0u)
+			, indirectByteOffset(0ull)
+			, indirectDrawCount(0)
 			, transparencySortPosition(glm::vec4(0.f, 0.f, 0.f, -1.f))
 			, modelToWorldTransform(glm::mat4())
 		{}
@@ -191,7 +209,7 @@ public:
 	void drawFrustum(SceneViewInfo const * svi);
 
 	GLuint createInstancedDataBufferVBO(std::vector<glm::vec3> *instancePositions, std::vector<glm::vec4> *instanceColors);
-	GLuint createInstancedPrimitiveVAO(std::string primitiveName, GLuint instanceDataVBO, GLsizei instanceCount, GLsizei instanceStride = 1);
+	GLuint createInstancedPrimitiveVAO(std::string primitiveName, GLuint instanceDataVBO, GLsizei instanceCount, GLsizei instanceStride = 1, GLuint instanceHighlightVBO = 0);
 
 	GLuint getPrimitiveVAO();
 	GLuint getPrimitiveVBO();
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <vector>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <functional>
+
+// A buffer recomputed on a worker thread into a shadow copy, which is swapped with the front buffer at a frame
+// boundary. Each request() supersedes the ones before it: the worker may poll isSuperseded() to stop early, and
+// the result of a superseded request is never swapped in. The worker only touches the shadow buffer and the owning
+// thread only the front buffer, so neither needs a lock. request() may be called from any thread, the rest only
+// from the thread owning the front buffer.
+template <typename T>
+class ShadowBuffer
+{
+public:
+	ShadowBuffer()
+		: m_nRequest(0u)
+		, m_nRunning(0u)
+		, m_nApplied(0u)
+	{}
+
+	~ShadowBuffer()
+	{
+		abandon();
+	}
+
+	void request()
+	{
+		m_nRequest++;
+	}
+
+	bool isSuperseded(unsigned int request) const
+	{
+		return m_nRequest != request;
+	}
+
+	// True if a request is waiting for a worker to be started
+	bool isPending() const
+	{
+		return !m_future.valid() && m_nApplied != m_nRequest;
+	}
+
+	// Starts a worker running compute(shadowBuffer, request) for the latest request. Only call when isPending().
+	void start(std::function<void(std::vector<T>&, unsigned int)> compute)
+	{
+		m_nRunning = m_nRequest;
+		m_future = std::async(std::launch::async, compute, std::ref(m_vShadow), m_nRunning);
+	}
+
+	// Swaps the result of a finished worker into front if it is still the latest request, returns true if swapped
+	bool swap(std::vector<T> &front)
+	{
+		if (!m_future.valid() || m_future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			return false;
+
+		m_future.get();
+
+		if (m_nRunning != m_nRequest)
+			return false;
+
+		front.swap(m_vShadow);
+		m_nApplied = m_nRunning;
+
+		return true;
+	}
+
+	// Blocks until the worker in flight, if any, has finished
+	void wait()
+	{
+		if (m_future.valid())
+			m_future.wait();
+	}
+
+	// Supersedes the worker in flight and waits for it to stop
+	void abandon()
+	{
+		request();
+		wait();
+	}
+
+private:
+	std::vector<T> m_vShadow; // owned by the worker while it runs
+	std::future<void> m_future;
+	std::atomic<unsigned int> m_nRequest;
+	unsigned int m_nRunning;
+	unsigned int m_nApplied;
+};
@@ -2,31 +2,40 @@
 
 #include "GLSLpreamble.h"
 #include "Renderer.h"
+#include "PointCloudSubsampler.h"
+#include "LASFile.h"
 
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <numeric>
 #include <limits>
+#include <algorithm>
+#include <sys/stat.h>
 
 #include <gtc/type_ptr.hpp>
-
-#include "laszip_api.h"
+#include <gtc/packing.hpp>
 
 #include "kdtree.h"
 
+#define PREVIEW_CACHE_MAGIC 0x56505343u // "CSPV"
+#define PREVIEW_CACHE_VERSION 2u
+
 SonarPointCloud::SonarPointCloud(ColorScaler * const colorScaler, std::string fileName, SONAR_FILETYPE filetype)
 	: Dataset(fileName, (filetype == XYZF || filetype == QIMERA) ? true : false)
 	, m_Sonar_Filetype(filetype)
 	, m_glVAO(0u)
 	, m_glPreviewVAO(0u)
 	, m_glPointsBufferVBO(0u)
+	, m_glHighlightBufferVBO(0u)
 	, m_pColorScaler(colorScaler)
 	, m_iPreviewReductionFactor(10)
 	, m_bPointsAllocated(false)
 	, m_bEnabled(true)
 	, refreshNeeded(true)
 	, previewRefreshNeeded(true)
+	, m_bTrackDeletions(false)
+	, m_bFileColors(false)
 	, m_nPoints(0)
 	, colorMode(1) //0=predefined 1=scaled
 	, colorScale(2)
@@ -60,6 +69,8 @@ SonarPointCloud::SonarPointCloud(ColorScaler * const colorScaler, std::string fi
 
 SonarPointCloud::~SonarPointCloud()
 {	
+	// abandon any recolor in flight
+	m_RecolorBuffer.abandon();
 }
 
 void SonarPointCloud::initPoints(int numPointsToAllocate)
@@ -74,6 +85,9 @@ void SonarPointCloud::initPoints(int numPointsToAllocate)
 		m_vuiPointsMarks.clear();
 		m_vfPointsDepthTPU.clear();
 		m_vfPointsPositionTPU.clear();
+		m_HighlightTimes.clear();
+		m_vuiPointsRenderSlots.clear();
+		m_LOD.clear();
 	}
 	
 	m_vdvec3RawPointsPositions.resize(m_nPoints);
@@ -83,6 +97,11 @@ void SonarPointCloud::initPoints(int numPointsToAllocate)
 	m_vuiPointsMarks.resize(m_nPoints);
 	m_vfPointsDepthTPU.resize(m_nPoints);
 	m_vfPointsPositionTPU.resize(m_nPoints);
+	m_HighlightTimes.resize(m_nPoints);
+
+	// render order matches point order until the LOD hierarchy is built
+	m_vuiPointsRenderSlots.resize(m_nPoints);
+	std::iota(m_vuiPointsRenderSlots.begin(), m_vuiPointsRenderSlots.end(), 0u);
 
 
 	m_bPointsAllocated = true;
@@ -93,7 +112,7 @@ void SonarPointCloud::setPoint(int index, double lonX, double latY, double depth
 	glm::dvec3 pt(lonX, latY, depth);
 	m_vdvec3RawPointsPositions[index] = pt;
 	
-	m_vvec4PointsColors[index] = glm::vec4(0.75f, 0.75f, 0.75f, 1.f);
+	m_vvec4PointsColors[m_vuiPointsRenderSlots[index]] = glm::vec4(0.75f, 0.75f, 0.75f, 1.f);
 
 	m_vfPointsDepthTPU[index] = 0.f;
 	m_vfPointsPositionTPU[index] = 0.f;
@@ -110,7 +129,7 @@ void SonarPointCloud::setUncertaintyPoint(int index, double lonX, double latY, d
 
 	float r, g, b;
 	m_pColorScaler->getBiValueScaledColor(depthTPU, positionTPU, &r, &g, &b);
-	m_vvec4PointsColors[index] = glm::vec4(r, g, b, 1.f);
+	m_vvec4PointsColors[m_vuiPointsRenderSlots[index]] = glm::vec4(r, g, b, 1.f);
 
 
 	m_vfPointsDepthTPU[index] = depthTPU;
@@ -138,7 +157,7 @@ void SonarPointCloud::setColoredPoint(int index, double lonX, double latY, doubl
 	m_vdvec3RawPointsPositions[index] = pt;
 
 	m_vvec3DefaultPointsColors[index] = glm::vec3(r, g, b);
-	m_vvec4PointsColors[index] = glm::vec4(m_vvec3DefaultPointsColors[index], 1.f);
+	m_vvec4PointsColors[m_vuiPointsRenderSlots[index]] = glm::vec4(m_vvec3DefaultPointsColors[index], 1.f);
 
 	m_vfPointsDepthTPU[index] = 0.f;
 	m_vfPointsPositionTPU[index] = 0.f;
@@ -408,140 +427,33 @@ bool SonarPointCloud::loadLIDAR()
 
 	Renderer::getInstance().showMessage(std::string("Loading ") + getName());
 
-
-	if (laszip_load_dll())
-	{
-		fprintf(stderr, "DLL ERROR: loading LASzip DLL\n");
-		return false;
-	}
-
-	// get version of LASzip DLL
-
-	laszip_U8 version_major;
-	laszip_U8 version_minor;
-	laszip_U16 version_revision;
-	laszip_U32 version_build;
-
-	if (laszip_get_version(&version_major, &version_minor, &version_revision, &version_build))
-	{
-		fprintf(stderr, "DLL ERROR: getting LASzip DLL version number\n");
-		return false;
-	}
-
-	fprintf(stderr, "LASzip DLL v%d.%d r%d (build %d)\n", (int)version_major, (int)version_minor, (int)version_revision, (int)version_build);
-
-	// create the reader
-
-	laszip_POINTER laszip_reader;
-	if (laszip_create(&laszip_reader))
-	{
-		fprintf(stderr, "DLL ERROR: creating laszip reader\n");
-		return false;
-	}
-
-	// open the reader
-
-	laszip_BOOL is_compressed = 0;
-	if (laszip_open_reader(laszip_reader, getName().c_str(), &is_compressed))
-	{
-		fprintf(stderr, "DLL ERROR: opening laszip reader for '%s'\n", getName().c_str());
-		return false;
-	}
-
-	fprintf(stderr, "file '%s' is %scompressed\n", getName().c_str(), (is_compressed ? "" : "un"));
-
-	// get a pointer to the header of the reader that was just populated
-
-	laszip_header* header;
-
-	if (laszip_get_header_pointer(laszip_reader, &header))
-	{
-		fprintf(stderr, "DLL ERROR: getting header pointer from laszip reader\n");
-		return false;
-	}
-
-
-	std::cout << "Compressed: " << (is_compressed ? "true" : "false") << std::endl;
-	std::cout << "Signature: " << header->generating_software << std::endl;
-	std::cout << "Points count: " << header->number_of_point_records << std::endl;
-	std::cout << "X Min: " << header->min_x << std::endl;
-	std::cout << "X Max: " << header->max_x << std::endl;
-	std::cout << "Y Min: " << header->min_y << std::endl;
-	std::cout << "Y Max: " << header->max_y << std::endl;
-	std::cout << "Z Min: " << header->min_z << std::endl;
-	std::cout << "Z Max: " << header->max_z << std::endl;
-
-	// how many points does the file have
-
-	laszip_I64 npoints = (header->number_of_point_records ? header->number_of_point_records : header->extended_number_of_point_records);
-
-	// report how many points the file has
-
-	fprintf(stderr, "file '%s' contains %I64d points\n", getName().c_str(), npoints);
-
-	initPoints(npoints);
-
-	// get a pointer to the points that will be read
-
-	laszip_point* point;
-
-	if (laszip_get_point_pointer(laszip_reader, &point))
-	{
-		fprintf(stderr, "DLL ERROR: getting point pointer from laszip reader\n");
-		return false;
-	}	
-
-	// read the points
-
-	laszip_I64 p_count = 0;
 	double averageHeight = 0.0;
 
-	while (p_count < npoints)
-	{
-		// read a point
-
-		if (laszip_read_point(laszip_reader))
-		{
-			fprintf(stderr, "DLL ERROR: reading point %I64d\n", p_count);
-		}
-
-		glm::vec3 color(point->rgb[0], point->rgb[1], point->rgb[2]);
-		color /= float(1 << 16);
-
-		setColoredPoint(p_count++, point->X, point->Y, -point->Z, color.r, color.g, color.b);
-		averageHeight += point->Z;
-	}
+	// files exported with TPUs load like sonar data, colored from the TPUs, and other files keep their RGB colors
+	bool success = LASFile::read(getName(), [this](long long count, bool hasTPU) {
+		m_bFileColors = !hasTPU;
+		initPoints(static_cast<int>(count));
+	}, [this, &averageHeight](long long index, LASFile::Point const &p) {
+		if (m_bFileColors)
+			setColoredPoint(static_cast<int>(index), p.position.x, p.position.y, -p.position.z, p.color.r, p.color.g, p.color.b);
+		else
+			setUncertaintyPoint(static_cast<int>(index), p.position.x, p.position.y, -p.position.z, p.depthTPU, p.positionTPU);
+		averageHeight += p.position.z;
+	});
 
-	fprintf(stderr, "successfully read %I64d points\n", p_count);
+	if (!success)
+		return false;
 
 	averageHeight /= m_nPoints;
 
-	printf("Loaded %d points\n", npoints);
+	printf("Loaded %u points\n", m_nPoints);
 
 	printf("Original Min/Maxes:\n");
 	printf("X Min: %f Max: %f\n", getXMin(), getXMax());
 	printf("Y Min: %f Max: %f\n", getYMin(), getYMax());
 	printf("Height Min: %f Max: %f\n", getZMin(), getZMax());
 	printf("Height Avg: %f\n", averageHeight);
-	
-
-	// close the reader
-
-	if (laszip_close_reader(laszip_reader))
-	{
-		fprintf(stderr, "DLL ERROR: closing laszip reader\n");
-		return false;
-	}
 
-	// destroy the reader
-
-	if (laszip_destroy(laszip_reader))
-	{
-		fprintf(stderr, "DLL ERROR: destroying laszip reader\n");
-		return false;
-	}
-
-	
 	adjustPoints();
 
 	setRefreshNeeded();
@@ -610,6 +522,28 @@ bool SonarPointCloud::loadLIDAR()
 
 
 
+bool SonarPointCloud::exportLAS(std::string fileName, std::vector<unsigned int> const &marks)
+{
+	printf("Exporting %s to %s\n", getName().c_str(), fileName.c_str());
+
+	// clouds colored from a file keep their colors, others keep their TPUs
+	LASFile::Cloud cloud;
+	cloud.count = m_nPoints;
+	cloud.positions = m_vdvec3RawPointsPositions.data();
+	cloud.colors = m_bFileColors ? m_vvec3DefaultPointsColors.data() : NULL;
+	cloud.depthTPU = m_bFileColors ? NULL : m_vfPointsDepthTPU.data();
+	cloud.positionTPU = m_bFileColors ? NULL : m_vfPointsPositionTPU.data();
+	cloud.marks = marks.data();
+
+	unsigned int nWritten = 0u;
+	bool success = LASFile::writeCloud(fileName, cloud, 0u, &nWritten);
+
+	if (success)
+		printf("Exported %u points to %s\n", nWritten, fileName.c_str());
+
+	return success;
+}
+
 bool SonarPointCloud::loadStudyCSV()
 {
 	printf("Loading Study Point Cloud from %s\n", getName().c_str());
@@ -697,6 +631,9 @@ bool SonarPointCloud::loadStudyCSV()
 
 void SonarPointCloud::update()
 {
+	if (m_bLoaded)
+		updateRecolor();
+
 	if (m_bLoaded && (refreshNeeded || previewRefreshNeeded))
 	{
 		// Sub buffer data for colors...
@@ -705,6 +642,18 @@ void SonarPointCloud::update()
 		refreshNeeded = false;
 		previewRefreshNeeded = false;
 	}
+
+	if (m_bLoaded && m_HighlightTimes.uploadNeeded())
+		uploadHighlightTimes();
+}
+
+void SonarPointCloud::uploadHighlightTimes()
+{
+	GLuint buffer = m_glHighlightBufferVBO;
+
+	m_HighlightTimes.upload([buffer](unsigned int first, unsigned int count, float const *data) {
+		glNamedBufferSubData(buffer, first * sizeof(float), count * sizeof(float), data);
+	});
 }
 
 GLuint SonarPointCloud::getVAO()
@@ -727,7 +676,15 @@ GLuint SonarPointCloud::getPreviewVAO()
 
 unsigned int SonarPointCloud::getPreviewPointCount()
 {
-	return getPointCount() / m_iPreviewReductionFactor;
+	if (!ready() || !m_LOD.isBuilt())
+		return 0;
+	else
+		return m_LOD.getPreviewPointCount();
+}
+
+PointCloudLOD* SonarPointCloud::getLOD()
+{
+	return &m_LOD;
 }
 
 SonarPointCloud::SONAR_FILETYPE SonarPointCloud::getFiletype()
@@ -817,7 +774,7 @@ bool SonarPointCloud::s_funcPosTPUMaxCompare(SonarPointCloud * const & lhs, Sona
 
 glm::vec3 SonarPointCloud::getDefaultPointColor(unsigned int index)
 {
-	if (m_Sonar_Filetype == SonarPointCloud::LIDAR_LAS)
+	if (m_bFileColors)
 	{
 		return m_vvec3DefaultPointsColors[index];
 	}
@@ -843,12 +800,179 @@ glm::vec3 SonarPointCloud::getDefaultPointColor(unsigned int index)
 	}
 }
 
+void SonarPointCloud::getDefaultPointColors(ColorScaler *colorScaler, unsigned int first, unsigned int count, unsigned int *colors)
+{
+	if (m_bFileColors)
+	{
+		for (unsigned int i = 0; i < count; ++i)
+			colors[i] = glm::packUnorm4x8(glm::vec4(m_vvec3DefaultPointsColors[first + i], 1.f));
+		return;
+	}
+
+	switch (colorScaler->getColorMode())
+	{
+	case ColorScaler::Mode::ColorScale:
+	{
+		std::vector<float> depths(count);
+		for (unsigned int i = 0; i < count; ++i)
+			depths[i] = static_cast<float>(m_vdvec3RawPointsPositions[first + i].z);
+
+		colorScaler->getScaledColors(depths.data(), depths.size(), colors);
+		break;
+	}
+	case ColorScaler::Mode::ColorScale_BiValue:
+	{
+		colorScaler->getBiValueScaledColors(&m_vfPointsDepthTPU[first], &m_vfPointsPositionTPU[first], count, colors);
+		break;
+	}
+	default:
+		std::fill(colors, colors + count, 0u);
+		break;
+	}
+}
+
 void SonarPointCloud::adjustPoints()
 {
 	glm::dvec3 adjustment = getCenteringOffsets();
 
 	for (unsigned int i = 0; i < m_nPoints; ++i)
 		m_vvec3AdjustedPointsPositions[i] = m_vdvec3RawPointsPositions[i] + adjustment;
+
+	buildLOD();
+}
+
+void SonarPointCloud::buildLOD()
+{
+	// the preview subsample makes up the coarse LOD levels, so the preview is just the first instances in render order
+	std::vector<unsigned int> previewIndices;
+	float previewSpacing;
+
+	if (!loadPreviewCache(previewIndices, previewSpacing))
+	{
+		glm::vec3 bbMin(std::numeric_limits<float>::max());
+		glm::vec3 bbMax(-std::numeric_limits<float>::max());
+
+		for (auto const &p : m_vvec3AdjustedPointsPositions)
+		{
+			bbMin = glm::min(bbMin, p);
+			bbMax = glm::max(bbMax, p);
+		}
+
+		previewSpacing = PointCloudSubsampler::estimateVoxelSize(bbMin, bbMax, m_nPoints / m_iPreviewReductionFactor);
+		previewIndices = PointCloudSubsampler::voxelGrid(m_vvec3AdjustedPointsPositions, previewSpacing);
+
+		savePreviewCache(previewIndices, previewSpacing);
+	}
+
+	m_LOD.build(m_vvec3AdjustedPointsPositions, &previewIndices, previewSpacing);
+
+	std::vector<unsigned int> const &order = m_LOD.getPointOrder();
+
+	// lay out the instance data in LOD order so each LOD node is one contiguous instance range
+	std::vector<glm::vec3> positions(m_nPoints);
+	std::vector<glm::vec4> colors(m_nPoints);
+	std::vector<unsigned int> highlightSources(m_nPoints);
+
+	for (unsigned int slot = 0u; slot < m_nPoints; ++slot)
+	{
+		unsigned int index = order[slot];
+		positions[slot] = m_vvec3AdjustedPointsPositions[index];
+		colors[slot] = m_vvec4PointsColors[m_vuiPointsRenderSlots[index]];
+		highlightSources[slot] = m_vuiPointsRenderSlots[index];
+	}
+
+	for (unsigned int slot = 0u; slot < m_nPoints; ++slot)
+		m_vuiPointsRenderSlots[order[slot]] = slot;
+
+	m_vvec3AdjustedPointsPositions.swap(positions);
+	m_vvec4PointsColors.swap(colors);
+	m_HighlightTimes.permute(highlightSources);
+}
+
+std::string SonarPointCloud::getPreviewCacheFilename()
+{
+	return getName() + ".preview";
+}
+
+void SonarPointCloud::getSourceFileStats(long long &size, long long &modifiedTime)
+{
+	struct _stat64 stats;
+	if (_stat64(getName().c_str(), &stats) != 0)
+	{
+		size = -1ll;
+		modifiedTime = -1ll;
+		return;
+	}
+
+	size = static_cast<long long>(stats.st_size);
+	modifiedTime = static_cast<long long>(stats.st_mtime);
+}
+
+bool SonarPointCloud::loadPreviewCache(std::vector<unsigned int> &previewIndices, float &previewSpacing)
+{
+	FILE *file = fopen(getPreviewCacheFilename().c_str(), "rb");
+	if (!file)
+		return false;
+
+	long long sourceSize, sourceModifiedTime;
+	getSourceFileStats(sourceSize, sourceModifiedTime);
+
+	PreviewCacheHeader header;
+	bool valid = fread(&header, sizeof(PreviewCacheHeader), 1, file) == 1
+		&& header.magic == PREVIEW_CACHE_MAGIC
+		&& header.version == PREVIEW_CACHE_VERSION
+		&& header.nPoints == m_nPoints
+		&& header.reductionFactor == static_cast<unsigned int>(m_iPreviewReductionFactor)
+		&& header.sourceFileSize == sourceSize
+		&& header.sourceModifiedTime == sourceModifiedTime
+		&& header.nPreviewPoints <= m_nPoints;
+
+	if (valid)
+	{
+		previewIndices.resize(header.nPreviewPoints);
+		valid = fread(previewIndices.data(), sizeof(unsigned int), previewIndices.size(), file) == previewIndices.size();
+	}
+
+	fclose(file);
+
+	// reject corrupt index lists, the LOD build relies on them being unique and in range
+	for (size_t i = 0u; valid && i < previewIndices.size(); ++i)
+		valid = previewIndices[i] < m_nPoints && (i == 0u || previewIndices[i] > previewIndices[i - 1u]);
+
+	if (!valid)
+	{
+		printf("Preview cache %s is stale or invalid, recomputing\n", getPreviewCacheFilename().c_str());
+		previewIndices.clear();
+		return false;
+	}
+
+	previewSpacing = header.spacing;
+
+	return true;
+}
+
+void SonarPointCloud::savePreviewCache(std::vector<unsigned int> const &previewIndices, float previewSpacing)
+{
+	FILE *file = fopen(getPreviewCacheFilename().c_str(), "wb");
+	if (!file)
+	{
+		fprintf(stderr, "Could not write preview cache %s\n", getPreviewCacheFilename().c_str());
+		return;
+	}
+
+	PreviewCacheHeader header;
+	header.magic = PREVIEW_CACHE_MAGIC;
+	header.version = PREVIEW_CACHE_VERSION;
+	header.nPoints = m_nPoints;
+	header.reductionFactor = static_cast<unsigned int>(m_iPreviewReductionFactor);
+	getSourceFileStats(header.sourceFileSize, header.sourceModifiedTime);
+	header.spacing = previewSpacing;
+	header.nPreviewPoints = static_cast<unsigned int>(previewIndices.size());
+
+	fwrite(&header, sizeof(PreviewCacheHeader), 1, file);
+	fwrite(previewIndices.data(), sizeof(unsigned int), previewIndices.size(), file);
+
+	fclose(file);
 }
 
 void SonarPointCloud::createAndLoadBuffers()
@@ -858,17 +982,25 @@ void SonarPointCloud::createAndLoadBuffers()
 		&m_vvec4PointsColors
 	);
 
+	glCreateBuffers(1, &m_glHighlightBufferVBO);
+	glNamedBufferStorage(m_glHighlightBufferVBO, m_HighlightTimes.size() * sizeof(float), m_HighlightTimes.getData(), GL_DYNAMIC_STORAGE_BIT);
+	m_HighlightTimes.markUploaded();
+
 	m_glVAO = Renderer::getInstance().createInstancedPrimitiveVAO(
 		"disc",
 		m_glPointsBufferVBO,
-		static_cast<GLsizei>(m_nPoints)
+		static_cast<GLsizei>(m_nPoints),
+		1,
+		m_glHighlightBufferVBO
 	);
 
+	// the preview points are the coarse LOD levels, i.e. the leading instances of the full point buffer
 	m_glPreviewVAO = Renderer::getInstance().createInstancedPrimitiveVAO(
 		"disc",
 		m_glPointsBufferVBO,
 		static_cast<GLsizei>(m_nPoints),
-		m_iPreviewReductionFactor
+		1,
+		m_glHighlightBufferVBO
 	);	
 }
 
@@ -933,8 +1065,39 @@ bool SonarPointCloud::isEnabled()
 
 void SonarPointCloud::markPoint(unsigned int index, int code)
 {
-	m_vuiPointsMarks[index] = code;	
+	int prevCode = static_cast<int>(m_vuiPointsMarks[index]);
+	m_vuiPointsMarks[index] = code;
+
+	if (m_bTrackDeletions && (prevCode == 1) != (code == 1))
+		m_vuiDeletionChanges.push_back(index);
+
+	// highlights are animated by the shader from their start time, so only newly highlighted points get written
+	if (code >= 100)
+	{
+		if (prevCode < 100)
+			setPointHighlightTime(index, Renderer::getInstance().getElapsedSeconds());
+		return;
+	}
+
+	if (prevCode >= 100)
+	{
+		setPointHighlightTime(index, -1.f);
 
+		// the point color is left untouched while highlighted
+		if (code == 0)
+			return;
+	}
+
+	if (code != 0 && (prevCode == 0 || prevCode >= 100))
+		m_vuiColorMarkedPoints.push_back(index);
+
+	m_vvec4PointsColors[m_vuiPointsRenderSlots[index]] = getMarkColor(index, code);
+
+	setRefreshNeeded();
+}
+
+glm::vec4 SonarPointCloud::getMarkColor(unsigned int index, int code)
+{
 	glm::vec3 color;
 	float a = 1.f;
 
@@ -955,28 +1118,125 @@ void SonarPointCloud::markPoint(unsigned int index, int code)
 	case 4:
 		color = glm::vec3(0.f, 0.f, 1.f);
 		break;
-	default: // if >= 100
-		color = (1.f / getDefaultPointColor(index)) * (static_cast<float>(m_vuiPointsMarks[index]) - 100.f) / 100.f;
-		//g = (1.f / g) * (static_cast<float>(m_vuiPointsMarks[index]) - 100.f) / 100.f;
-		//b = (1.f / b) * (static_cast<float>(m_vuiPointsMarks[index]) - 100.f) / 100.f;
-		a = (static_cast<float>(code) - 100.f) / 100.f;
+	default:
 		break;
 	}
 
-	m_vvec4PointsColors[index] = glm::vec4(color, a);
-
-	setRefreshNeeded();
+	return glm::vec4(color, a);
 }
 
 void SonarPointCloud::resetAllMarks()
 {
+	std::vector<unsigned int> defaultColors(m_nPoints);
+	getDefaultPointColors(m_pColorScaler, 0u, m_nPoints, defaultColors.data());
+
 	for (unsigned int i = 0; i < m_nPoints; i++)
-		markPoint(i, 0);	
+	{
+		if (m_bTrackDeletions && m_vuiPointsMarks[i] == 1u)
+			m_vuiDeletionChanges.push_back(i);
+
+		m_vuiPointsMarks[i] = 0u;
+		m_vvec4PointsColors[m_vuiPointsRenderSlots[i]] = glm::unpackUnorm4x8(defaultColors[i]);
+	}
+
+	m_HighlightTimes.resetAll();
+
+	m_vuiColorMarkedPoints.clear();
+
+	setRefreshNeeded();
+}
+
+void SonarPointCloud::refreshColors()
+{
+	// picked up by updateRecolor() at the next frame
+	m_RecolorBuffer.request();
+}
+
+void SonarPointCloud::recolor(ColorScaler colorScaler, unsigned int request, std::vector<glm::vec4> &shadowColors)
+{
+	// the color scaler is a copy, so the main thread may change the shared one meanwhile
+	shadowColors.resize(m_nPoints);
+
+	const unsigned int chunkSize = 1u << 20;
+	std::vector<unsigned int> colors(chunkSize);
+
+	for (unsigned int first = 0u; first < m_nPoints; first += chunkSize)
+	{
+		// superseded by a newer request
+		if (m_RecolorBuffer.isSuperseded(request))
+			return;
+
+		unsigned int count = (std::min)(chunkSize, m_nPoints - first);
+		getDefaultPointColors(&colorScaler, first, count, colors.data());
+
+		for (unsigned int i = 0u; i < count; ++i)
+			shadowColors[m_vuiPointsRenderSlots[first + i]] = glm::unpackUnorm4x8(colors[i]);
+	}
+}
+
+void SonarPointCloud::updateRecolor()
+{
+	if (m_RecolorBuffer.swap(m_vvec4PointsColors))
+	{
+		reapplyMarkColors();
+		setRefreshNeeded();
+	}
+
+	if (m_RecolorBuffer.isPending())
+	{
+		ColorScaler colorScaler(*m_pColorScaler);
+		m_RecolorBuffer.start([this, colorScaler](std::vector<glm::vec4> &shadowColors, unsigned int request) { recolor(colorScaler, request, shadowColors); });
+	}
+}
+
+void SonarPointCloud::reapplyMarkColors()
+{
+	// the swapped in colors are all default colors, restore the marked points and drop the ones no longer marked
+	size_t nKept = 0u;
+
+	for (auto index : m_vuiColorMarkedPoints)
+	{
+		unsigned int code = m_vuiPointsMarks[index];
+
+		if (code == 0u || code >= 100u)
+			continue;
+
+		m_vvec4PointsColors[m_vuiPointsRenderSlots[index]] = getMarkColor(index, code);
+		m_vuiColorMarkedPoints[nKept++] = index;
+	}
+
+	m_vuiColorMarkedPoints.resize(nKept);
+	std::sort(m_vuiColorMarkedPoints.begin(), m_vuiColorMarkedPoints.end());
+	m_vuiColorMarkedPoints.erase(std::unique(m_vuiColorMarkedPoints.begin(), m_vuiColorMarkedPoints.end()), m_vuiColorMarkedPoints.end());
+}
+
+void SonarPointCloud::setDeletionTracking(bool yesno)
+{
+	m_bTrackDeletions = yesno;
+
+	if (!m_bTrackDeletions)
+		m_vuiDeletionChanges.clear();
+}
+
+void SonarPointCloud::takeDeletionChanges(std::vector<unsigned int> &indices)
+{
+	indices.clear();
+	indices.swap(m_vuiDeletionChanges);
+}
+
+void SonarPointCloud::setPointHighlightTime(unsigned int index, float seconds)
+{
+	m_HighlightTimes.set(m_vuiPointsRenderSlots[index], seconds);
+}
+
+float SonarPointCloud::getPointHighlightTime(unsigned int index)
+{
+	return m_HighlightTimes.get(m_vuiPointsRenderSlots[index]);
 }
 
 glm::vec3 SonarPointCloud::getAdjustedPointPosition(unsigned int index)
 {
-	return m_vvec3AdjustedPointsPositions[index];
+	return m_vvec3AdjustedPointsPositions[m_vuiPointsRenderSlots[index]];
 }
 
 glm::dvec3 SonarPointCloud::getRawPointPosition(unsigned int index)
@@ -998,3 +1258,23 @@ float SonarPointCloud::getPointPositionTPU(unsigned int index)
 {
 	return m_vfPointsPositionTPU[index];
 }
+
+std::vector<glm::dvec3> const & SonarPointCloud::getRawPointsPositions()
+{
+	return m_vdvec3RawPointsPositions;
+}
+
+std::vector<float> const & SonarPointCloud::getPointsDepthTPU()
+{
+	return m_vfPointsDepthTPU;
+}
+
+std::vector<float> const & SonarPointCloud::getPointsPositionTPU()
+{
+	return m_vfPointsPositionTPU;
+}
+
+std::vector<unsigned int> const & SonarPointCloud::getPointsMarks()
+{
+	return m_vuiPointsMarks;
+}
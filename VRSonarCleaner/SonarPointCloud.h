@@ -6,9 +6,11 @@
 #include <stdio.h>
 #include <math.h>
 #include <functional>
-#include <future>
 #include "Dataset.h"
 #include "ColorScaler.h"
+#include "PointCloudLOD.h"
+#include "ShadowBuffer.h"
+#include "HighlightTimes.h"
 
 #include <bag.h>
 
@@ -42,9 +44,16 @@ public:
 		unsigned int getPointCount();
 		GLuint getPreviewVAO();
 		unsigned int getPreviewPointCount();
+		PointCloudLOD* getLOD();
 
 		SONAR_FILETYPE getFiletype();
 
+		// Writes the points not deleted in marks to a LAS file, or LAZ if the file name ends in .laz, with the
+		// depth and positional TPU as extra bytes attributes, or the RGB colors of a cloud colored from its LAS file.
+		// marks is a snapshot of getPointsMarks(), so cleaning can carry on while the export runs on another thread.
+		// Only call once ready().
+		bool exportLAS(std::string fileName, std::vector<unsigned int> const &marks);
+
 		//methods:
 
 		void initPoints(int numPoints);
@@ -64,12 +73,27 @@ public:
 		
 		void markPoint(unsigned int index, int code);
 		void resetAllMarks();
+		// Recolors points that are not marked with the current color scale. The colors are computed on a worker
+		// thread into a shadow buffer that is swapped in by update(); a newer request supersedes one in flight.
+		void refreshColors();
+
+		// While tracking, the indices of points that were deleted or restored are collected until taken, so
+		// per-point statistics can be updated incrementally
+		void setDeletionTracking(bool yesno);
+		void takeDeletionChanges(std::vector<unsigned int> &indices);
+
+		void setPointHighlightTime(unsigned int index, float seconds);
+		float getPointHighlightTime(unsigned int index);
 
 		glm::vec3 getAdjustedPointPosition(unsigned int index);
 		glm::dvec3 getRawPointPosition(unsigned int index);
 		int getPointMark(unsigned int index);
 		float getPointDepthTPU(unsigned int index);
 		float getPointPositionTPU(unsigned int index);
+		std::vector<glm::dvec3> const & getRawPointsPositions();
+		std::vector<float> const & getPointsDepthTPU();
+		std::vector<float> const & getPointsPositionTPU();
+		std::vector<unsigned int> const & getPointsMarks();
 
 		float getMinDepthTPU();
 		float getMaxDepthTPU();
@@ -91,12 +115,20 @@ public:
 		//variables
 		float m_fMinDepthTPU, m_fMaxDepthTPU, m_fMinPositionalTPU, m_fMaxPositionalTPU;
 
+		// GPU instance data, stored in LOD render order (see m_vuiPointsRenderSlots)
 		std::vector<glm::vec3> m_vvec3AdjustedPointsPositions;
-		std::vector<glm::vec3> m_vvec3DefaultPointsColors;
 		std::vector<glm::vec4> m_vvec4PointsColors;
+		HighlightTimes m_HighlightTimes; // renderer elapsed seconds when highlighted per render slot
+
+		std::vector<glm::vec3> m_vvec3DefaultPointsColors;
 		std::vector<GLuint> m_vuiPointsMarks;
 		std::vector<float> m_vfPointsDepthTPU;
 		std::vector<float> m_vfPointsPositionTPU;
+		std::vector<unsigned int> m_vuiPointsRenderSlots; // point index -> render slot
+		std::vector<unsigned int> m_vuiDeletionChanges;
+		std::vector<unsigned int> m_vuiColorMarkedPoints; // points that may be marked 1-4, whose colors don't come from the color scale
+		bool m_bTrackDeletions;
+		bool m_bFileColors; // default colors are the RGB colors read from a LAS file rather than from the color scale
 		unsigned int m_nPoints;
 		bool m_bPointsAllocated;
 
@@ -111,6 +143,11 @@ public:
 		
 		int m_iPreviewReductionFactor;
 
+		PointCloudLOD m_LOD;
+
+		// background recoloring, see refreshColors()
+		ShadowBuffer<glm::vec4> m_RecolorBuffer;
+
 		//preview
 		bool refreshNeeded;
 		bool previewRefreshNeeded;
@@ -118,6 +155,7 @@ public:
 		//OpenGL
 		GLuint m_glVAO, m_glPreviewVAO;
 		GLuint m_glPointsBufferVBO;
+		GLuint m_glHighlightBufferVBO;
 
 		bool loadCARISTxt();
 		bool loadQimeraTxt();
@@ -126,8 +164,31 @@ public:
 		bool loadStudyCSV();
 
 		glm::vec3 getDefaultPointColor(unsigned int index);
+		void getDefaultPointColors(ColorScaler *colorScaler, unsigned int first, unsigned int count, unsigned int *colors); // packed RGBA8
+		void recolor(ColorScaler colorScaler, unsigned int request, std::vector<glm::vec4> &shadowColors);
+		void updateRecolor();
+		void reapplyMarkColors();
+		glm::vec4 getMarkColor(unsigned int index, int code);
 		void adjustPoints();
+		void buildLOD();
+
+		// sidecar cache of the preview subsample, so it is only computed the first time a file is loaded
+		struct PreviewCacheHeader {
+			unsigned int magic;
+			unsigned int version;
+			unsigned int nPoints;
+			unsigned int reductionFactor;
+			long long sourceFileSize;
+			long long sourceModifiedTime;
+			float spacing;
+			unsigned int nPreviewPoints;
+		};
+		std::string getPreviewCacheFilename();
+		void getSourceFileStats(long long &size, long long &modifiedTime);
+		bool loadPreviewCache(std::vector<unsigned int> &previewIndices, float &previewSpacing);
+		void savePreviewCache(std::vector<unsigned int> const &previewIndices, float previewSpacing);
 		void createAndLoadBuffers();
+		void uploadHighlightTimes();
 };
 
 #endif
@@ -32,16 +32,30 @@ SonarScene::SonarScene(TrackedDeviceManager* pTDM)
 	, m_bRightMouseDown(false)
 	, m_bMiddleMouseDown(false)
 	, m_bInitialColorRefresh(false)
+	, m_AppliedColorRanges()
+	, m_fLODMaxScreenSpaceError(2.f)
+	, m_nLODPointBudget(5000000u)
+	, m_glLODIndirectBuffer(0u)
 {
 }
 
 
 SonarScene::~SonarScene()
 {
+	// let the LOD selection and export workers finish with the point clouds before tearing the scene down
+	if (m_futureLODDrawLists.valid())
+		m_futureLODDrawLists.wait();
+
+	if (m_futureExport.valid())
+		m_futureExport.wait();
+
 	if (m_pTableVolume)
 		delete m_pTableVolume;
 	if (m_pWallVolume)
 		delete m_pWallVolume;
+
+	if (m_glLODIndirectBuffer)
+		glDeleteBuffers(1, &m_glLODIndirectBuffer);
 }
 
 void SonarScene::init()
@@ -488,6 +502,43 @@ void SonarScene::processSDLEvent(SDL_Event & ev)
 		}
 	}
 
+	if (ev.type == SDL_KEYDOWN && ev.key.keysym.sym == SDLK_h)
+	{
+		ColorScaler::RangeMode mode = static_cast<ColorScaler::RangeMode>((m_pColorScalerTPU->getRangeMode() + 1) % (ColorScaler::RangeMode_Equalized + 1));
+		m_pColorScalerTPU->setRangeMode(mode);
+
+		printf("Pressed h, color range mode is now %s\n", mode == ColorScaler::RangeMode_MinMax ? "min/max" : mode == ColorScaler::RangeMode_Percentile ? "percentile" : "equalized");
+
+		if (m_bInitialColorRefresh)
+		{
+			applyColorRanges(m_pColorScalerTPU, true);
+
+			for (auto &cloud : m_vpClouds)
+				cloud->refreshColors();
+		}
+	}
+
+	if (ev.type == SDL_KEYDOWN && !ev.key.repeat && ev.key.keysym.sym == SDLK_e)
+	{
+		if (m_futureExport.valid() && m_futureExport.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+			printf("Pressed e, but the last export is still running\n");
+		else
+		{
+			printf("Pressed e, exporting cleaned point clouds\n");
+
+			// the marks are copied here so cleaning can carry on during the export
+			std::vector<std::pair<SonarPointCloud*, std::vector<unsigned int>>> snapshots;
+			for (auto &cloud : m_vpClouds)
+				if (cloud->ready())
+					snapshots.push_back(std::make_pair(cloud, cloud->getPointsMarks()));
+
+			m_futureExport = std::async(std::launch::async, [snapshots]() {
+				for (auto const &snapshot : snapshots)
+					snapshot.first->exportLAS(snapshot.first->getName() + ".cleaned.laz", snapshot.second);
+			});
+		}
+	}
+
 	if (ev.key.keysym.sym == SDLK_g)
 	{
 		printf("Pressed g, generating fake test cloud\n");
@@ -636,6 +687,17 @@ void SonarScene::update()
 	if (!BehaviorManager::getInstance().getBehavior("scale"))
 		BehaviorManager::getInstance().addBehavior("scale", new ScaleDataVolumeBehavior(m_pTDM, m_pTableVolume));
 
+	if (m_bInitialColorRefresh)
+	{
+		updateHistograms(m_vpClouds);
+
+		if (applyColorRanges(m_pColorScalerTPU, false))
+		{
+			for (auto &cloud : m_vpClouds)
+				cloud->refreshColors();
+		}
+	}
+
 	for (auto &cloud : m_vpClouds)
 		cloud->update();
 
@@ -663,6 +725,21 @@ void SonarScene::draw()
 
 	bool unloadedData = false;
 
+	// LOD detail is measured from the left eye in VR, it is near enough to the right eye to serve both,
+	// but culling keeps everything inside either eye's frustum
+	std::vector<Renderer::SceneViewInfo*> cullViews;
+	if (m_bUseVR)
+	{
+		cullViews.push_back(Renderer::getInstance().getLeftEyeInfo());
+		cullViews.push_back(Renderer::getInstance().getRightEyeInfo());
+	}
+	else
+		cullViews.push_back(Renderer::getInstance().getWindow3DViewInfo());
+
+	Renderer::SceneViewInfo *lodView = cullViews.front();
+
+	std::vector<LODRequest> lodRequests;
+
 	for (auto &dv : m_vpDataVolumes)
 	{
 		if (!dv->isVisible()) continue;
@@ -679,30 +756,89 @@ void SonarScene::draw()
 		dv->drawBBox(0.f);
 		dv->drawAxes(1.f);
 
-		Renderer::RendererSubmission rs;
-		rs.glPrimitiveType = GL_TRIANGLES;
-		rs.shaderName = "instanced";
-		rs.indexType = GL_UNSIGNED_SHORT;
-		rs.indexByteOffset = Renderer::getInstance().getPrimitiveIndexByteOffset("disc");
-		rs.indexBaseVertex = Renderer::getInstance().getPrimitiveIndexBaseVertex("disc");
-		rs.vertCount = Renderer::getInstance().getPrimitiveIndexCount("disc");
-		rs.instanced = true;
-		rs.specularExponent = 0.f;
-		//rs.diffuseColor = glm::vec4(1.f, 1.f, 1.f, 0.5f);
-		//rs.diffuseTexName = "resources/images/circle.png";
+		unsigned int cloudPointBudget = m_nLODPointBudget / (std::max)(static_cast<unsigned int>(dv->getDatasets().size()), 1u);
 
 		for (auto &cloud : dv->getDatasets())
 		{
-			if (!static_cast<SonarPointCloud*>(cloud)->ready())
+			SonarPointCloud* pc = static_cast<SonarPointCloud*>(cloud);
+
+			if (!pc->ready())
 			{
 				unloadedData = true;
 				continue;
 			}
 
-			rs.VAO = dv == m_pWallVolume ? static_cast<SonarPointCloud*>(cloud)->getPreviewVAO() : static_cast<SonarPointCloud*>(cloud)->getPreviewVAO();
-			rs.modelToWorldTransform = dv->getTransformDataset(cloud);
-			rs.instanceCount = dv == m_pWallVolume ? static_cast<SonarPointCloud*>(cloud)->getPreviewPointCount() : static_cast<SonarPointCloud*>(cloud)->getPreviewPointCount();
-			Renderer::getInstance().addToDynamicRenderQueue(rs);
+			LODRequest req;
+			req.dataVolume = dv;
+			req.cloud = pc;
+			req.modelView = lodView->view * dv->getTransformDataset(cloud);
+			for (auto const &cullView : cullViews)
+				req.cullModelViewProjections.push_back(cullView->projection * cullView->view * dv->getTransformDataset(cloud));
+			req.pointBudget = cloudPointBudget;
+			lodRequests.push_back(req);
+		}
+	}
+
+	// pick up the draw lists culled from a previous frame's view, if done, and start culling for this one
+	if (!m_futureLODDrawLists.valid() || m_futureLODDrawLists.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready)
+	{
+		if (m_futureLODDrawLists.valid())
+			m_vLODDrawLists = m_futureLODDrawLists.get();
+
+		m_futureLODDrawLists = std::async(std::launch::async, &SonarScene::selectLODs, lodRequests, lodView->projection, static_cast<float>(lodView->m_nRenderHeight), m_fLODMaxScreenSpaceError);
+	}
+
+	m_vLODDrawCommands.clear();
+
+	Renderer::RendererSubmission rs;
+	rs.glPrimitiveType = GL_TRIANGLES;
+	rs.shaderName = "instanced";
+	rs.indexType = GL_UNSIGNED_SHORT;
+	rs.indexByteOffset = Renderer::getInstance().getPrimitiveIndexByteOffset("disc");
+	rs.indexBaseVertex = Renderer::getInstance().getPrimitiveIndexBaseVertex("disc");
+	rs.vertCount = Renderer::getInstance().getPrimitiveIndexCount("disc");
+	rs.instanced = true;
+	rs.specularExponent = 0.f;
+	//rs.diffuseColor = glm::vec4(1.f, 1.f, 1.f, 0.5f);
+	//rs.diffuseTexName = "resources/images/circle.png";
+
+	std::vector<Renderer::RendererSubmission> submissions;
+
+	for (auto const &drawList : m_vLODDrawLists)
+	{
+		if (!drawList.dataVolume->isVisible() || drawList.ranges.size() == 0u)
+			continue;
+
+		rs.VAO = drawList.cloud->getVAO();
+		rs.modelToWorldTransform = drawList.dataVolume->getTransformDataset(drawList.cloud);
+		rs.indirectByteOffset = m_vLODDrawCommands.size() * sizeof(Renderer::DrawElementsIndirectCommand);
+		rs.indirectDrawCount = static_cast<GLsizei>(drawList.ranges.size());
+
+		for (auto const &range : drawList.ranges)
+		{
+			Renderer::DrawElementsIndirectCommand cmd;
+			cmd.count = rs.vertCount;
+			cmd.instanceCount = range.count;
+			cmd.firstIndex = static_cast<GLuint>(rs.indexByteOffset / sizeof(GLushort));
+			cmd.baseVertex = rs.indexBaseVertex;
+			cmd.baseInstance = range.first;
+			m_vLODDrawCommands.push_back(cmd);
+		}
+
+		submissions.push_back(rs);
+	}
+
+	if (submissions.size() > 0u)
+	{
+		if (!m_glLODIndirectBuffer)
+			glCreateBuffers(1, &m_glLODIndirectBuffer);
+
+		glNamedBufferData(m_glLODIndirectBuffer, m_vLODDrawCommands.size() * sizeof(Renderer::DrawElementsIndirectCommand), m_vLODDrawCommands.data(), GL_STREAM_DRAW);
+
+		for (auto &sub : submissions)
+		{
+			sub.indirectBuffer = m_glLODIndirectBuffer;
+			Renderer::getInstance().addToDynamicRenderQueue(sub);
 		}
 	}
 
@@ -714,6 +850,26 @@ void SonarScene::draw()
 }
 
 
+std::vector<SonarScene::LODDrawList> SonarScene::selectLODs(std::vector<LODRequest> requests, glm::mat4 projection, float viewportHeight, float maxScreenSpaceError)
+{
+	std::vector<LODDrawList> drawLists;
+	std::vector<unsigned int> selection;
+
+	for (auto const &req : requests)
+	{
+		LODDrawList drawList;
+		drawList.dataVolume = req.dataVolume;
+		drawList.cloud = req.cloud;
+
+		req.cloud->getLOD()->select(req.modelView, projection, viewportHeight, maxScreenSpaceError, req.pointBudget, req.cullModelViewProjections, selection);
+		req.cloud->getLOD()->getRanges(selection, drawList.ranges);
+
+		drawLists.push_back(std::move(drawList));
+	}
+
+	return drawLists;
+}
+
 void SonarScene::refreshColorScale(ColorScaler * colorScaler, std::vector<SonarPointCloud*> clouds)
 {
 	if (clouds.size() == 0ull)
@@ -725,10 +881,130 @@ void SonarScene::refreshColorScale(ColorScaler * colorScaler, std::vector<SonarP
 	float minPosTPU = (*std::min_element(clouds.begin(), clouds.end(), SonarPointCloud::s_funcPosTPUMinCompare))->getMinPositionalTPU();
 	float maxPosTPU = (*std::max_element(clouds.begin(), clouds.end(), SonarPointCloud::s_funcPosTPUMaxCompare))->getMaxPositionalTPU();
 
-	colorScaler->resetMinMaxForColorScale(m_pTableVolume->getMinDataBound().z, m_pTableVolume->getMaxDataBound().z);
-	colorScaler->resetBiValueScaleMinMax(minDepthTPU, maxDepthTPU, minPosTPU, maxPosTPU);
+	m_DepthHistogram.reset(m_pTableVolume->getMinDataBound().z, m_pTableVolume->getMaxDataBound().z);
+	m_DepthTPUHistogram.reset(minDepthTPU, maxDepthTPU);
+	m_PosTPUHistogram.reset(minPosTPU, maxPosTPU);
+
+	for (auto &cloud : clouds)
+	{
+		if (!cloud->ready() || cloud->getPointCount() == 0u)
+			continue;
+
+		// start tracking from the current marks, so deleted points are left out of the histograms from now on
+		std::vector<unsigned int> discarded;
+		cloud->setDeletionTracking(true);
+		cloud->takeDeletionChanges(discarded);
+
+		unsigned int const *marks = cloud->getPointsMarks().data();
+
+		// depths are read in place from the raw positions, one position apart
+		std::vector<glm::dvec3> const &positions = cloud->getRawPointsPositions();
+		m_DepthHistogram.addValues(&positions[0].z, positions.size(), sizeof(glm::dvec3) / sizeof(double), marks);
+		m_DepthTPUHistogram.addValues(cloud->getPointsDepthTPU().data(), cloud->getPointCount(), 1u, marks);
+		m_PosTPUHistogram.addValues(cloud->getPointsPositionTPU().data(), cloud->getPointCount(), 1u, marks);
+	}
+
+	applyColorRanges(colorScaler, true);
+
+	// apply new color scale, in the background
+	for (auto &cloud : clouds)
+		cloud->refreshColors();
+}
+
+void SonarScene::updateHistograms(std::vector<SonarPointCloud*> clouds)
+{
+	std::vector<unsigned int> changes;
 
-	// apply new color scale
 	for (auto &cloud : clouds)
-		cloud->resetAllMarks();
+	{
+		cloud->takeDeletionChanges(changes);
+
+		if (changes.size() == 0u)
+			continue;
+
+		// a point deleted and restored again since the last update appears twice, only odd counts are real changes
+		std::sort(changes.begin(), changes.end());
+
+		for (size_t i = 0u; i < changes.size(); )
+		{
+			size_t j = i;
+			while (j < changes.size() && changes[j] == changes[i])
+				++j;
+
+			if ((j - i) % 2u == 1u)
+			{
+				unsigned int index = changes[i];
+				double depth = cloud->getRawPointPosition(index).z;
+				float depthTPU = cloud->getPointDepthTPU(index);
+				float posTPU = cloud->getPointPositionTPU(index);
+
+				if (cloud->getPointMark(index) == 1)
+				{
+					m_DepthHistogram.remove(depth);
+					m_DepthTPUHistogram.remove(depthTPU);
+					m_PosTPUHistogram.remove(posTPU);
+				}
+				else
+				{
+					m_DepthHistogram.add(depth);
+					m_DepthTPUHistogram.add(depthTPU);
+					m_PosTPUHistogram.add(posTPU);
+				}
+			}
+
+			i = j;
+		}
+	}
+}
+
+bool SonarScene::applyColorRanges(ColorScaler * colorScaler, bool force)
+{
+	ValueHistogram *histograms[3] = { &m_DepthHistogram, &m_DepthTPUHistogram, &m_PosTPUHistogram };
+
+	ColorRanges ranges;
+	bool changed = force;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		switch (colorScaler->getRangeMode())
+		{
+		case ColorScaler::RangeMode_Percentile:
+		{
+			double clip = colorScaler->getClipPercentile() / 100.;
+			ranges.minVal[i] = histograms[i]->getPercentile(clip);
+			ranges.maxVal[i] = histograms[i]->getPercentile(1. - clip);
+			break;
+		}
+		case ColorScaler::RangeMode_Equalized:
+			histograms[i]->getCDF(COLORSCALER_LUT_SIZE + 1u, ranges.cdf[i]);
+			// fall through
+		default:
+			ranges.minVal[i] = histograms[i]->getMin();
+			ranges.maxVal[i] = histograms[i]->getMax();
+			break;
+		}
+
+		// ignore changes smaller than the histogram resolution or a color step
+		double tolerance = histograms[i]->getBinWidth() * 0.5;
+		if (std::abs(ranges.minVal[i] - m_AppliedColorRanges.minVal[i]) > tolerance || std::abs(ranges.maxVal[i] - m_AppliedColorRanges.maxVal[i]) > tolerance)
+			changed = true;
+
+		if (ranges.cdf[i].size() != m_AppliedColorRanges.cdf[i].size())
+			changed = true;
+
+		for (size_t j = 0u; !changed && j < ranges.cdf[i].size(); ++j)
+			changed = std::abs(ranges.cdf[i][j] - m_AppliedColorRanges.cdf[i][j]) > 1.f / 255.f;
+	}
+
+	if (!changed)
+		return false;
+
+	colorScaler->resetMinMaxForColorScale(ranges.minVal[0], ranges.maxVal[0]);
+	colorScaler->resetBiValueScaleMinMax(ranges.minVal[1], ranges.maxVal[1], ranges.minVal[2], ranges.maxVal[2]);
+	colorScaler->setColorScaleEqualization(ranges.cdf[0]);
+	colorScaler->setBiValueEqualization(ranges.cdf[1], ranges.cdf[2]);
+
+	m_AppliedColorRanges = ranges;
+
+	return true;
 }
\ No newline at end of file
@@ -6,7 +6,9 @@
 #include "DataVolume.h"
 #include "SonarPointCloud.h"
 #include "ColorScaler.h"
+#include "ValueHistogram.h"
 #include <SDL.h>
+#include <future>
 
 class SonarScene :
 	public Scene
@@ -44,7 +46,48 @@ private:
 
 	bool m_bInitialColorRefresh;
 
+	// color ranges in the order depth, depth TPU, positional TPU
+	struct ColorRanges {
+		double minVal[3];
+		double maxVal[3];
+		std::vector<float> cdf[3]; // only when equalizing
+	};
+
+	// histograms of all loaded points, kept current as points are deleted and restored
+	ValueHistogram m_DepthHistogram, m_DepthTPUHistogram, m_PosTPUHistogram;
+	ColorRanges m_AppliedColorRanges;
+
+	struct LODRequest {
+		DataVolume* dataVolume;
+		SonarPointCloud* cloud;
+		glm::mat4 modelView;
+		std::vector<glm::mat4> cullModelViewProjections; // one per eye in VR
+		unsigned int pointBudget;
+	};
+
+	struct LODDrawList {
+		DataVolume* dataVolume;
+		SonarPointCloud* cloud;
+		std::vector<PointCloudLOD::Range> ranges;
+	};
+
+	float m_fLODMaxScreenSpaceError; // in pixels
+	unsigned int m_nLODPointBudget;  // shared by all clouds in a data volume
+
+	// LOD selection and culling run on a worker thread, one frame ahead of the draw lists in use
+	std::future<std::vector<LODDrawList>> m_futureLODDrawLists;
+	std::vector<LODDrawList> m_vLODDrawLists;
+	std::vector<Renderer::DrawElementsIndirectCommand> m_vLODDrawCommands;
+	GLuint m_glLODIndirectBuffer;
+
+	// export of the cleaned clouds in flight, see the 'e' key
+	std::future<void> m_futureExport;
+
 private:
 	void refreshColorScale(ColorScaler* colorScaler, std::vector<SonarPointCloud*> clouds);
+	void updateHistograms(std::vector<SonarPointCloud*> clouds);
+	bool applyColorRanges(ColorScaler* colorScaler, bool force);
+
+	static std::vector<LODDrawList> selectLODs(std::vector<LODRequest> requests, glm::mat4 projection, float viewportHeight, float maxScreenSpaceError);
 };
 
@@ -59,27 +59,7 @@ void StudyTrialDesktopBehavior::init()
 	BehaviorManager::getInstance().addBehavior("desktop_edit", dcb);
 	dcb->init();
 
-	std::stringstream ss;
-
-	ss << "Trial Begin" << "\t" << DataLogger::getInstance().getTimeSinceLogStartString();
-	ss << "\t";
-	ss << "trial-type:\"desktop\"";
-	ss << ";";
-	ss << "file-name:\"" << path(m_strFileName).filename() << "\"";
-	ss << ";";
-	ss << "file-category:\"" << m_strCategory << "\"";
-	ss << ";";
-	ss << "vol-pos:\"" << m_pDataVolume->getPosition().x << "," << m_pDataVolume->getPosition().y << "," << m_pDataVolume->getPosition().z << "\"";
-	ss << ";";
-	ss << "vol-quat:\"" << m_pDataVolume->getOrientation().x << "," << m_pDataVolume->getOrientation().y << "," << m_pDataVolume->getOrientation().z << "," << m_pDataVolume->getOrientation().w << "\"";
-	ss << ";";
-	ss << "vol-dims:\"" << m_pDataVolume->getDimensions().x << "," << m_pDataVolume->getDimensions().y << "," << m_pDataVolume->getDimensions().z << "\"";
-	ss << ";";
-	ss << "cam-pos:\"" << Renderer::getInstance().getCamera()->pos.x << "," << Renderer::getInstance().getCamera()->pos.y << "," << Renderer::getInstance().getCamera()->pos.z << "\"";
-	ss << ";";
-	ss << "cam-lookat:\"" << Renderer::getInstance().getCamera()->lookat.x << "," << Renderer::getInstance().getCamera()->lookat.y << "," << Renderer::getInstance().getCamera()->lookat.z << "\"";
-
-	DataLogger::getInstance().logMessage(ss.str());
+	logTrialEvent(false);
 }
 
 void StudyTrialDesktopBehavior::update()
@@ -114,35 +94,35 @@ void StudyTrialDesktopBehavior::update()
 
 			m_bPointsCleaned = true;
 
-			std::stringstream ss;
-
-			ss << "Trial End" << "\t" << DataLogger::getInstance().getTimeSinceLogStartString();
-			ss << "\t";
-			ss << "trial-type:\"desktop\"";
-			ss << ";";
-			ss << "file-name:\"" << std::experimental::filesystem::v1::path(m_strFileName).filename() << "\"";
-			ss << ";";
-			ss << "file-category:\"" << m_strCategory << "\"";
-			ss << ";";
-			ss << "vol-pos:\"" << m_pDataVolume->getPosition().x << "," << m_pDataVolume->getPosition().y << "," << m_pDataVolume->getPosition().z << "\"";
-			ss << ";";
-			ss << "vol-quat:\"" << m_pDataVolume->getOrientation().x << "," << m_pDataVolume->getOrientation().y << "," << m_pDataVolume->getOrientation().z << "," << m_pDataVolume->getOrientation().w << "\"";
-			ss << ";";
-			ss << "vol-dims:\"" << m_pDataVolume->getDimensions().x << "," << m_pDataVolume->getDimensions().y << "," << m_pDataVolume->getDimensions().z << "\"";
-			ss << ";";
-			ss << "cam-pos:\"" << Renderer::getInstance().getCamera()->pos.x << "," << Renderer::getInstance().getCamera()->pos.y << "," << Renderer::getInstance().getCamera()->pos.z << "\"";
-			ss << ";";
-			ss << "cam-lookat:\"" << Renderer::getInstance().getCamera()->lookat.x << "," << Renderer::getInstance().getCamera()->lookat.y << "," << Renderer::getInstance().getCamera()->lookat.z << "\"";
-			ss << ";";
-			ss << "total-cleaned:\"" << m_nPointsCleaned << "\"";
-			ss << ";";
-			ss << "total-mistakes:\"" << m_nCleanedGoodPoints << "\"";
-
-			DataLogger::getInstance().logMessage(ss.str());
+			logTrialEvent(true);
 		}
 	}
 }
 
+void StudyTrialDesktopBehavior::logTrialEvent(bool end)
+{
+	EventLog::Trial event;
+	event.end = end;
+	event.trialType = "desktop";
+	event.fileName = std::experimental::filesystem::v1::path(m_strFileName).filename().string();
+	event.fileCategory = m_strCategory;
+	event.volPos = m_pDataVolume->getPosition();
+	event.volQuat = m_pDataVolume->getOrientation();
+	event.volDims = m_pDataVolume->getDimensions();
+	event.hasCamera = true;
+	event.camPos = Renderer::getInstance().getCamera()->pos;
+	event.camLookat = Renderer::getInstance().getCamera()->lookat;
+
+	if (end)
+	{
+		event.hasTotals = true;
+		event.totalCleaned = m_nPointsCleaned;
+		event.totalMistakes = m_nCleanedGoodPoints;
+	}
+
+	DataLogger::getInstance().logTrialEvent(event);
+}
+
 void StudyTrialDesktopBehavior::draw()
 {
 	m_pDataVolume->setBackingColor(glm::vec4(0.15f, 0.21f, 0.31f, 1.f));
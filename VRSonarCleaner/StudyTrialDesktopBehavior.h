@@ -23,6 +23,8 @@ public:
 	void finish();
 
 private:
+	void logTrialEvent(bool end);
+
 	ColorScaler* m_pColorScaler;
 	SonarPointCloud* m_pPointCloud;
 	DataVolume* m_pDataVolume;
@@ -21,6 +21,9 @@ public:
 	void draw();
 
 private:
+	EventLog::Pose getDevicePoses();
+	void logTrialEvent(bool end);
+
 	TrackedDeviceManager *m_pTDM;
 	ColorScaler* m_pColorScaler;
 	SonarPointCloud* m_pPointCloud;
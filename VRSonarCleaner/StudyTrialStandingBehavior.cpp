@@ -59,56 +59,15 @@ void StudyTrialStandingBehavior::init()
 	BehaviorManager::getInstance().addBehavior("grab", new GrabObjectBehavior(m_pTDM, m_pDataVolume));
 	BehaviorManager::getInstance().addBehavior("scale", new ScaleDataVolumeBehavior(m_pTDM, m_pDataVolume));
 
-	glm::vec3 hmdPos = m_pTDM->getHMDToWorldTransform()[3];
-	glm::quat hmdQuat = glm::quat_cast(m_pTDM->getHMDToWorldTransform());
-
-	std::stringstream ss;
-
-	ss << "Trial Begin" << "\t" << DataLogger::getInstance().getTimeSinceLogStartString();
-	ss << "\t";
-	ss << "trial-type:\"standing\"";
-	ss << ";";
-	ss << "file-name:\"" << path(m_strFileName).filename() << "\"";
-	ss << ";";
-	ss << "file-category:\"" << m_strCategory << "\"";
-	ss << ";";
-	ss << "vol-pos:\"" << m_pDataVolume->getPosition().x << "," << m_pDataVolume->getPosition().y << "," << m_pDataVolume->getPosition().z << "\"";
-	ss << ";";
-	ss << "vol-quat:\"" << m_pDataVolume->getOrientation().x << "," << m_pDataVolume->getOrientation().y << "," << m_pDataVolume->getOrientation().z << "," << m_pDataVolume->getOrientation().w << "\"";
-	ss << ";";
-	ss << "vol-dims:\"" << m_pDataVolume->getDimensions().x << "," << m_pDataVolume->getDimensions().y << "," << m_pDataVolume->getDimensions().z << "\"";
-	ss << ";";
-	ss << "hmd-pos:\"" << hmdPos.x << "," << hmdPos.y << "," << hmdPos.z << "\"";
-	ss << ";";
-	ss << "hmd-quat:\"" << hmdQuat.x << "," << hmdQuat.y << "," << hmdQuat.z << "," << hmdQuat.w << "\"";
-
-	if (m_pTDM->getPrimaryController())
-	{
-		glm::vec3 primCtrlrPos = m_pTDM->getPrimaryController()->getDeviceToWorldTransform()[3];
-		glm::quat primCtrlrQuat = glm::quat_cast(m_pTDM->getPrimaryController()->getDeviceToWorldTransform());
-
-		ss << ";";
-		ss << "primary-controller-pos:\"" << primCtrlrPos.x << "," << primCtrlrPos.y << "," << primCtrlrPos.z << "\"";
-		ss << ";";
-		ss << "primary-controller-quat:\"" << primCtrlrQuat.x << "," << primCtrlrQuat.y << "," << primCtrlrQuat.z << "," << primCtrlrQuat.w << "\"";
-	}
-
-	if (m_pTDM->getSecondaryController())
-	{
-		glm::vec3 secCtrlrPos = m_pTDM->getSecondaryController()->getDeviceToWorldTransform()[3];
-		glm::quat secCtrlrQuat = glm::quat_cast(m_pTDM->getSecondaryController()->getDeviceToWorldTransform());
-
-		ss << ";";
-		ss << "secondary-controller-pos:\"" << secCtrlrPos.x << "," << secCtrlrPos.y << "," << secCtrlrPos.z << "\"";
-		ss << ";";
-		ss << "secondary-controller-quat:\"" << secCtrlrQuat.x << "," << secCtrlrQuat.y << "," << secCtrlrQuat.z << "," << secCtrlrQuat.w << "\"";
-	}
-
-	DataLogger::getInstance().logMessage(ss.str());
+	logTrialEvent(false);
 }
 
 void StudyTrialStandingBehavior::update()
 {
+	// per-frame poses are only recorded in binary logs, where they are cheap to encode
+	if (DataLogger::getInstance().binary())
+		DataLogger::getInstance().logPose(getDevicePoses());
+
 	m_pPointCloud->update();
 	m_pDataVolume->update();
 
@@ -139,58 +98,45 @@ void StudyTrialStandingBehavior::update()
 
 		m_bActive = false;
 
-		glm::vec3 hmdPos = m_pTDM->getHMDToWorldTransform()[3];
-		glm::quat hmdQuat = glm::quat_cast(m_pTDM->getHMDToWorldTransform());
-
-		std::stringstream ss;
-
-		ss << "Trial End" << "\t" << DataLogger::getInstance().getTimeSinceLogStartString();
-		ss << "\t";
-		ss << "trial-type:\"standing\"";
-		ss << ";";
-		ss << "file-name:\"" << std::experimental::filesystem::v1::path(m_strFileName).filename() << "\"";
-		ss << ";";
-		ss << "file-category:\"" << m_strCategory << "\"";
-		ss << ";";
-		ss << "vol-pos:\"" << m_pDataVolume->getPosition().x << "," << m_pDataVolume->getPosition().y << "," << m_pDataVolume->getPosition().z << "\"";
-		ss << ";";
-		ss << "vol-quat:\"" << m_pDataVolume->getOrientation().x << "," << m_pDataVolume->getOrientation().y << "," << m_pDataVolume->getOrientation().z << "," << m_pDataVolume->getOrientation().w << "\"";
-		ss << ";";
-		ss << "vol-dims:\"" << m_pDataVolume->getDimensions().x << "," << m_pDataVolume->getDimensions().y << "," << m_pDataVolume->getDimensions().z << "\"";
-		ss << ";";
-		ss << "hmd-pos:\"" << hmdPos.x << "," << hmdPos.y << "," << hmdPos.z << "\"";
-		ss << ";";
-		ss << "hmd-quat:\"" << hmdQuat.x << "," << hmdQuat.y << "," << hmdQuat.z << "," << hmdQuat.w << "\"";
-
-		if (m_pTDM->getPrimaryController())
-		{
-			glm::vec3 primCtrlrPos = m_pTDM->getPrimaryController()->getDeviceToWorldTransform()[3];
-			glm::quat primCtrlrQuat = glm::quat_cast(m_pTDM->getPrimaryController()->getDeviceToWorldTransform());
+		logTrialEvent(true);
+	}
+}
 
-			ss << ";";
-			ss << "primary-controller-pos:\"" << primCtrlrPos.x << "," << primCtrlrPos.y << "," << primCtrlrPos.z << "\"";
-			ss << ";";
-			ss << "primary-controller-quat:\"" << primCtrlrQuat.x << "," << primCtrlrQuat.y << "," << primCtrlrQuat.z << "," << primCtrlrQuat.w << "\"";
-		}
+EventLog::Pose StudyTrialStandingBehavior::getDevicePoses()
+{
+	EventLog::Pose pose;
 
-		if (m_pTDM->getSecondaryController())
-		{
-			glm::vec3 secCtrlrPos = m_pTDM->getSecondaryController()->getDeviceToWorldTransform()[3];
-			glm::quat secCtrlrQuat = glm::quat_cast(m_pTDM->getSecondaryController()->getDeviceToWorldTransform());
+	pose.set(EventLog::Pose::HMD, m_pTDM->getHMDToWorldTransform());
+
+	if (m_pTDM->getPrimaryController())
+		pose.set(EventLog::Pose::PrimaryController, m_pTDM->getPrimaryController()->getDeviceToWorldTransform());
 
-			ss << ";";
-			ss << "secondary-controller-pos:\"" << secCtrlrPos.x << "," << secCtrlrPos.y << "," << secCtrlrPos.z << "\"";
-			ss << ";";
-			ss << "secondary-controller-quat:\"" << secCtrlrQuat.x << "," << secCtrlrQuat.y << "," << secCtrlrQuat.z << "," << secCtrlrQuat.w << "\"";
-		}
+	if (m_pTDM->getSecondaryController())
+		pose.set(EventLog::Pose::SecondaryController, m_pTDM->getSecondaryController()->getDeviceToWorldTransform());
 
-		ss << ";";
-		ss << "total-cleaned:\"" << m_nPointsCleaned << "\"";
-		ss << ";";
-		ss << "total-mistakes:\"" << m_nCleanedGoodPoints << "\"";
+	return pose;
+}
 
-		DataLogger::getInstance().logMessage(ss.str());
+void StudyTrialStandingBehavior::logTrialEvent(bool end)
+{
+	EventLog::Trial event;
+	event.end = end;
+	event.trialType = "standing";
+	event.fileName = std::experimental::filesystem::v1::path(m_strFileName).filename().string();
+	event.fileCategory = m_strCategory;
+	event.volPos = m_pDataVolume->getPosition();
+	event.volQuat = m_pDataVolume->getOrientation();
+	event.volDims = m_pDataVolume->getDimensions();
+	event.pose = getDevicePoses();
+
+	if (end)
+	{
+		event.hasTotals = true;
+		event.totalCleaned = m_nPointsCleaned;
+		event.totalMistakes = m_nCleanedGoodPoints;
 	}
+
+	DataLogger::getInstance().logTrialEvent(event);
 }
 
 void StudyTrialStandingBehavior::draw()
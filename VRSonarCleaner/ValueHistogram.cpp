@@ -0,0 +1,130 @@
+#include "ValueHistogram.h"
+
+ValueHistogram::ValueHistogram(unsigned int nBins)
+	: m_dMin(0.)
+	, m_dMax(1.)
+	, m_dBinsPerUnit(static_cast<double>(nBins))
+	, m_vullCounts((std::max)(nBins, 1u), 0ull)
+	, m_ullTotal(0ull)
+{
+}
+
+ValueHistogram::~ValueHistogram()
+{
+}
+
+void ValueHistogram::reset(double minVal, double maxVal)
+{
+	m_dMin = (std::min)(minVal, maxVal);
+	m_dMax = (std::max)(minVal, maxVal);
+
+	double range = m_dMax - m_dMin;
+	m_dBinsPerUnit = range > 0. ? static_cast<double>(m_vullCounts.size()) / range : 0.;
+
+	std::fill(m_vullCounts.begin(), m_vullCounts.end(), 0ull);
+	m_ullTotal = 0ull;
+}
+
+unsigned int ValueHistogram::getBin(double value)
+{
+	double bin = (value - m_dMin) * m_dBinsPerUnit;
+	return static_cast<unsigned int>((std::min)((std::max)(bin, 0.), static_cast<double>(m_vullCounts.size() - 1u)));
+}
+
+void ValueHistogram::add(double value)
+{
+	m_vullCounts[getBin(value)]++;
+	m_ullTotal++;
+}
+
+void ValueHistogram::remove(double value)
+{
+	unsigned int bin = getBin(value);
+
+	if (m_vullCounts[bin] == 0ull)
+		return;
+
+	m_vullCounts[bin]--;
+	m_ullTotal--;
+}
+
+unsigned long long ValueHistogram::getTotalCount()
+{
+	return m_ullTotal;
+}
+
+double ValueHistogram::getMin()
+{
+	return m_dMin;
+}
+
+double ValueHistogram::getMax()
+{
+	return m_dMax;
+}
+
+double ValueHistogram::getBinWidth()
+{
+	return (m_dMax - m_dMin) / static_cast<double>(m_vullCounts.size());
+}
+
+double ValueHistogram::getPercentile(double fraction)
+{
+	if (m_ullTotal == 0ull)
+		return fraction < 0.5 ? m_dMin : m_dMax;
+
+	double target = (std::min)((std::max)(fraction, 0.), 1.) * static_cast<double>(m_ullTotal);
+	double binWidth = getBinWidth();
+
+	unsigned long long cumulative = 0ull;
+	for (size_t i = 0u; i < m_vullCounts.size(); ++i)
+	{
+		if (m_vullCounts[i] == 0ull)
+			continue;
+
+		if (static_cast<double>(cumulative + m_vullCounts[i]) >= target)
+		{
+			double t = (target - static_cast<double>(cumulative)) / static_cast<double>(m_vullCounts[i]);
+			return m_dMin + (static_cast<double>(i) + t) * binWidth;
+		}
+
+		cumulative += m_vullCounts[i];
+	}
+
+	return m_dMax;
+}
+
+void ValueHistogram::getCDF(unsigned int nSamples, std::vector<float> &cdf)
+{
+	cdf.resize(nSamples);
+
+	if (nSamples == 0u)
+		return;
+
+	if (m_ullTotal == 0ull || nSamples == 1u)
+	{
+		// no data, fall back to a linear ramp
+		for (unsigned int i = 0u; i < nSamples; ++i)
+			cdf[i] = nSamples > 1u ? static_cast<float>(i) / static_cast<float>(nSamples - 1u) : 0.f;
+		return;
+	}
+
+	double nBins = static_cast<double>(m_vullCounts.size());
+	double invTotal = 1. / static_cast<double>(m_ullTotal);
+
+	unsigned long long cumulative = 0ull;
+	size_t bin = 0u;
+
+	for (unsigned int i = 0u; i < nSamples; ++i)
+	{
+		// sample position in bins, counting whole bins below it and interpolating the bin it falls in
+		double pos = static_cast<double>(i) / static_cast<double>(nSamples - 1u) * nBins;
+
+		while (bin < m_vullCounts.size() && static_cast<double>(bin + 1u) <= pos)
+			cumulative += m_vullCounts[bin++];
+
+		double partial = bin < m_vullCounts.size() ? (pos - static_cast<double>(bin)) * static_cast<double>(m_vullCounts[bin]) : 0.;
+
+		cdf[i] = static_cast<float>((static_cast<double>(cumulative) + partial) * invTotal);
+	}
+}
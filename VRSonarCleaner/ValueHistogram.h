@@ -0,0 +1,99 @@
+#pragma once
+
+#include <vector>
+#include <future>
+#include <thread>
+#include <algorithm>
+
+// Fixed-range histogram of a data column (e.g. depth or TPU) used to derive robust color ranges.
+// Values outside the range are counted in the first or last bin.
+class ValueHistogram
+{
+public:
+	ValueHistogram(unsigned int nBins = 4096u);
+	~ValueHistogram();
+
+	// Clears all counts and sets the value range
+	void reset(double minVal, double maxVal);
+
+	// Counts count values, read every stride elements, in parallel on nThreads worker threads (0 = hardware concurrency).
+	// Each thread fills its own histogram and the results are merged. If marks is given, points marked deleted (1) are skipped.
+	template <typename T>
+	void addValues(T const *values, size_t count, size_t stride = 1u, unsigned int const *marks = NULL, unsigned int nThreads = 0u);
+
+	// Incremental updates, e.g. when a point is deleted or restored
+	void add(double value);
+	void remove(double value);
+
+	unsigned long long getTotalCount();
+	double getMin();
+	double getMax();
+	double getBinWidth();
+
+	// Value below which the given fraction of the counted values lie, interpolated within its bin
+	double getPercentile(double fraction);
+
+	// Cumulative distribution sampled at nSamples evenly spaced values across the range, from 0 at the minimum to 1 at the maximum
+	void getCDF(unsigned int nSamples, std::vector<float> &cdf);
+
+private:
+	unsigned int getBin(double value);
+
+	template <typename T>
+	static void countValues(T const *values, size_t begin, size_t end, size_t stride, unsigned int const *marks, double minVal, double binsPerUnit, std::vector<unsigned long long> &counts);
+
+	double m_dMin, m_dMax;
+	double m_dBinsPerUnit;
+	std::vector<unsigned long long> m_vullCounts;
+	unsigned long long m_ullTotal;
+};
+
+template <typename T>
+void ValueHistogram::countValues(T const *values, size_t begin, size_t end, size_t stride, unsigned int const *marks, double minVal, double binsPerUnit, std::vector<unsigned long long> &counts)
+{
+	double lastBin = static_cast<double>(counts.size() - 1u);
+
+	for (size_t i = begin; i < end; ++i)
+	{
+		if (marks && marks[i] == 1u)
+			continue;
+
+		double bin = (static_cast<double>(values[i * stride]) - minVal) * binsPerUnit;
+		counts[static_cast<size_t>((std::min)((std::max)(bin, 0.), lastBin))]++;
+	}
+}
+
+template <typename T>
+void ValueHistogram::addValues(T const *values, size_t count, size_t stride, unsigned int const *marks, unsigned int nThreads)
+{
+	if (count == 0u)
+		return;
+
+	if (nThreads == 0u)
+		nThreads = (std::max)(std::thread::hardware_concurrency(), 1u);
+
+	size_t chunkSize = (count + nThreads - 1u) / nThreads;
+
+	std::vector<std::vector<unsigned long long>> threadCounts(nThreads, std::vector<unsigned long long>(m_vullCounts.size(), 0ull));
+	std::vector<std::future<void>> futures;
+
+	for (unsigned int t = 0u; t < nThreads; ++t)
+	{
+		size_t begin = (std::min)(count, t * chunkSize);
+		size_t end = (std::min)(count, begin + chunkSize);
+
+		futures.push_back(std::async(std::launch::async, &ValueHistogram::countValues<T>, values, begin, end, stride, marks, m_dMin, m_dBinsPerUnit, std::ref(threadCounts[t])));
+	}
+
+	for (auto &f : futures)
+		f.get();
+
+	for (auto const &counts : threadCounts)
+	{
+		for (size_t i = 0u; i < counts.size(); ++i)
+		{
+			m_vullCounts[i] += counts[i];
+			m_ullTotal += counts[i];
+		}
+	}
+}
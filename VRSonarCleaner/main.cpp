@@ -1,4 +1,6 @@
 #include "Engine.h"
+#include "DataLogger.h"
+#include "EventLog.h"
 
 //-----------------------------------------------------------------------------
 // Purpose:
@@ -42,6 +44,26 @@ int main(int argc, char *argv[])
 			fScreenDiagInches = static_cast<float>(atof(argv[i + 1]));
 			i++;
 		}
+		else if (!stricmp(argv[i], "-binarylog"))
+		{
+			DataLogger::getInstance().setBinary(true);
+		}
+		else if (!stricmp(argv[i], "-verboselog"))
+		{
+			DataLogger::getInstance().setVerbose(true);
+		}
+		else if (!stricmp(argv[i], "-convertlog") && (argc > i + 1) && (*argv[i + 1] != '-'))
+		{
+			// offline conversion of a binary event log to the text log format, without starting the engine
+			std::string logName(argv[i + 1]);
+			std::string textLogName = (argc > i + 2) ? std::string(argv[i + 2]) : logName + ".txt";
+
+			bool converted = EventLog::convertToText(logName, textLogName);
+
+			FreeConsole();
+
+			return converted ? 0 : 1;
+		}
 		else if (!stricmp(argv[i], "-h") || !stricmp(argv[i], "-help"))
 		{
 			printf_s("CCOM VR Engine\n");
@@ -50,6 +72,9 @@ int main(int argc, char *argv[])
 			printf_s("\t-stereogl\tEnable Quad-Buffered Stereo OpenGL Context\n");
 			printf_s("\t-display i\tPut window on display i\n");
 			printf_s("\t-diagonal d\tSet display diagonal d in inches\n");
+			printf_s("\t-binarylog\tWrite study logs as binary event logs\n");
+			printf_s("\t-verboselog\tLog every cleaned point instead of cleaned index ranges\n");
+			printf_s("\t-convertlog in [out]\tConvert binary event log in to text log out and exit\n");
 			printf_s("\n");
 		}
 	}
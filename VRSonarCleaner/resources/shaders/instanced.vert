@@ -9,6 +9,8 @@ layout(location = INSTANCE_POSITION_ATTRIB_LOCATION)
 	in vec3 v3InstancePos;
 layout(location = INSTANCE_COLOR_ATTRIB_LOCATION)
 	in vec4 v4InstanceCol;
+layout(location = INSTANCE_HIGHLIGHT_ATTRIB_LOCATION)
+	in float fInstanceHighlightTime;
 	
 layout(location = MODEL_MAT_UNIFORM_LOCATION)
 	uniform mat4 m4DataVolumeTransform;
@@ -35,6 +37,14 @@ void main()
 	v3FragPos = vec3(m4View * m4DataVolumeTransform * vec4(v3InstancePos, 1.f));
 	v3Normal =  mat3(transpose(inverse(m4View * m4DataVolumeTransform))) * v3NormalIn;
 	v4Color = v4InstanceCol;
+
+	// highlighted instances blink from the time they were highlighted (negative time = not highlighted)
+	if (fInstanceHighlightTime >= 0.f)
+	{
+		float amt = fract((fGlobalTime - fInstanceHighlightTime) / POINT_HIGHLIGHT_BLINK_PERIOD);
+		v4Color = vec4(amt / v4InstanceCol.rgb, amt);
+	}
+
 	v2TexCoords = v2TexCoordsIn;
 
     gl_Position = m4Projection * (vec4(-v3Position * size, 0.f) + m4View * m4DataVolumeTransform * vec4(v3InstancePos, 1.f));
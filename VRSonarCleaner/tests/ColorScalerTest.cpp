@@ -0,0 +1,229 @@
+#include "Test.h"
+#include "../ColorScaler.h"
+
+#include <random>
+#include <limits>
+#include <chrono>
+
+static unsigned int pack(float r, float g, float b)
+{
+	unsigned int red = static_cast<unsigned int>((std::min)((std::max)(r, 0.f), 1.f) * 255.f + 0.5f);
+	unsigned int green = static_cast<unsigned int>((std::min)((std::max)(g, 0.f), 1.f) * 255.f + 0.5f);
+	unsigned int blue = static_cast<unsigned int>((std::min)((std::max)(b, 0.f), 1.f) * 255.f + 0.5f);
+
+	return red | (green << 8) | (blue << 16) | (255u << 24);
+}
+
+// values spread over the range, plus values packed tightly around the band edges at 1/3 and 2/3 of it
+static std::vector<float> makeValues(size_t count, float minVal, float maxVal, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> u(-0.1f, 1.1f);
+	std::uniform_real_distribution<float> nearEdge(-1e-3f, 1e-3f);
+
+	std::vector<float> values(count);
+	for (size_t i = 0u; i < count; ++i)
+	{
+		float t = u(rng);
+		if (i % 3u == 1u)
+			t = 0.333f + nearEdge(rng);
+		else if (i % 3u == 2u)
+			t = 0.666f + nearEdge(rng);
+
+		values[i] = minVal + (maxVal - minVal) * t;
+	}
+
+	return values;
+}
+
+// a skewed distribution moves the band edges off the even bin grid
+static std::vector<float> makeSkewedCDF()
+{
+	std::vector<float> cdf(65);
+	for (size_t i = 0u; i < cdf.size(); ++i)
+		cdf[i] = powf(static_cast<float>(i) / (cdf.size() - 1u), 0.37f);
+
+	return cdf;
+}
+
+// largest difference of any 8-bit channel between two packed colors
+static unsigned int channelDifference(unsigned int a, unsigned int b)
+{
+	unsigned int diff = 0u;
+	for (int shift = 0; shift < 32; shift += 8)
+	{
+		int ca = (a >> shift) & 0xFF, cb = (b >> shift) & 0xFF;
+		diff = (std::max)(diff, static_cast<unsigned int>(abs(ca - cb)));
+	}
+
+	return diff;
+}
+
+TEST(ColorScaler_BatchMatchesPerValueColors)
+{
+	std::vector<float> values = makeValues(100003u, -40.f, -10.f, 3u);
+	std::vector<unsigned int> colors(values.size());
+
+	// values packed around the band edges of the banded maps, including values exactly on an edge
+	std::mt19937 rng(4u);
+	std::uniform_real_distribution<float> nearEdge(-1e-4f, 1e-4f);
+	float bandEdges[] = { 0.071f, 0.1f, 0.143f, 0.5f, 0.7f, 0.929f };
+	for (size_t i = 0u; i < values.size(); i += 5u)
+		values[i] = -40.f + 30.f * (bandEdges[(i / 5u) % 6u] + (i % 2u ? nearEdge(rng) : 0.f));
+
+	std::vector<float> cdf = makeSkewedCDF();
+
+	for (auto map : { ColorScaler::OrangeBrown, ColorScaler::Rainbow, ColorScaler::RainbowBanded, ColorScaler::BlueBanded })
+	{
+		for (bool equalized : { false, true })
+		{
+			ColorScaler cs;
+			cs.resetMinMaxForColorScale(-40., -10.);
+			cs.setColorMap(map);
+			if (equalized)
+				cs.setColorScaleEqualization(cdf);
+
+			cs.getScaledColors(values.data(), values.size(), colors.data());
+
+			// the banded maps match exactly, the continuous ones within the change of the map across half a table bin:
+			// one 8-bit step, or up to 14 times that near the minimum where the skewed distribution is steepest
+			bool banded = map == ColorScaler::RainbowBanded || map == ColorScaler::BlueBanded;
+			size_t nMismatches = 0u;
+			unsigned int maxDifference = 0u;
+			for (size_t i = 0u; i < values.size(); ++i)
+			{
+				float r, g, b;
+				cs.getScaledColorForValue(values[i], &r, &g, &b);
+				if (colors[i] != pack(r, g, b))
+					nMismatches++;
+				maxDifference = (std::max)(maxDifference, channelDifference(colors[i], pack(r, g, b)));
+			}
+
+			if (banded)
+				CHECK(nMismatches == 0u);
+			else
+				CHECK(maxDifference <= (equalized ? 14u : 1u));
+		}
+	}
+}
+
+TEST(ColorScaler_BiValueBatchMatchesPerValueColors)
+{
+	std::vector<float> values1 = makeValues(100003u, -40.f, -10.f, 1u);
+	std::vector<float> values2 = makeValues(100003u, 0.f, 2.5f, 2u);
+	std::vector<unsigned int> colors(values1.size());
+
+	std::vector<float> cdf = makeSkewedCDF();
+
+	for (auto map : { ColorScaler::PurpleGreen, ColorScaler::Custom })
+	{
+		for (bool equalized : { false, true })
+		{
+			ColorScaler cs;
+			cs.resetBiValueScaleMinMax(-40., -10., 0., 2.5);
+			cs.setBiValueColorMap(map);
+			if (equalized)
+				cs.setBiValueEqualization(cdf, cdf);
+
+			cs.getBiValueScaledColors(values1.data(), values2.data(), values1.size(), colors.data());
+
+			size_t nMismatches = 0u;
+			for (size_t i = 0u; i < values1.size(); ++i)
+			{
+				float r, g, b;
+				cs.getBiValueScaledColor(values1[i], values2[i], &r, &g, &b);
+				if (colors[i] != pack(r, g, b))
+					nMismatches++;
+			}
+
+			CHECK(nMismatches == 0u);
+		}
+	}
+}
+
+TEST(ColorScaler_BatchMapsNaNToTheFirstBin)
+{
+	float nan = std::numeric_limits<float>::quiet_NaN();
+
+	// 5 values, so NaNs go through both the SSE loop and the scalar tail
+	float values[5] = { nan, 0.5f, 0.7f, 0.2f, nan };
+	float lowest[5] = { 0.f, 0.5f, 0.7f, 0.2f, 0.f };
+	unsigned int colors[5], expected[5];
+
+	ColorScaler cs;
+	cs.resetMinMaxForColorScale(0., 1.);
+	cs.getScaledColors(values, 5u, colors);
+	cs.getScaledColors(lowest, 5u, expected);
+	CHECK(colors[0] == expected[0]);
+	CHECK(colors[4] == expected[4]);
+
+	cs.resetBiValueScaleMinMax(0., 1., 0., 1.);
+	cs.setBiValueColorMap(ColorScaler::PurpleGreen);
+	cs.getBiValueScaledColors(values, values, 5u, colors);
+	cs.getBiValueScaledColors(lowest, lowest, 5u, expected);
+	CHECK(colors[0] == expected[0]);
+	CHECK(colors[4] == expected[4]);
+}
+
+BENCHMARK(ColorScaler_ColorsPerSecond)
+{
+	// values spread evenly over the ranges, so few land in band edge bins
+	const size_t count = 20000000u;
+	std::mt19937 rng(5u);
+	std::uniform_real_distribution<float> u(0.f, 1.f);
+	std::vector<float> values(count), values2(count);
+	for (size_t i = 0u; i < count; ++i)
+	{
+		values[i] = -40.f + 30.f * u(rng);
+		values2[i] = 2.5f * u(rng);
+	}
+	std::vector<unsigned int> colors(count);
+
+	auto rate = [count](std::chrono::high_resolution_clock::time_point start) {
+		return count / std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count() / 1.e6;
+	};
+
+	for (auto map : { ColorScaler::Rainbow, ColorScaler::RainbowBanded, ColorScaler::BlueBanded })
+	{
+		ColorScaler cs;
+		cs.resetMinMaxForColorScale(-40., -10.);
+		cs.setColorMap(map);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0u; i < count; ++i)
+		{
+			float r, g, b;
+			cs.getScaledColorForValue(values[i], &r, &g, &b);
+			colors[i] = pack(r, g, b);
+		}
+		double perValue = rate(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		cs.getScaledColors(values.data(), count, colors.data());
+		double batch = rate(start);
+
+		printf("    single-value map %d: %.1f M colors/s per value, %.1f M colors/s batched (%.1fx)\n", static_cast<int>(map), perValue, batch, batch / perValue);
+	}
+
+	for (auto map : { ColorScaler::PurpleGreen, ColorScaler::Custom })
+	{
+		ColorScaler cs;
+		cs.resetBiValueScaleMinMax(-40., -10., 0., 2.5);
+		cs.setBiValueColorMap(map);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0u; i < count; ++i)
+		{
+			float r, g, b;
+			cs.getBiValueScaledColor(values[i], values2[i], &r, &g, &b);
+			colors[i] = pack(r, g, b);
+		}
+		double perValue = rate(start);
+
+		start = std::chrono::high_resolution_clock::now();
+		cs.getBiValueScaledColors(values.data(), values2.data(), count, colors.data());
+		double batch = rate(start);
+
+		printf("    bi-value map %d: %.1f M colors/s per value, %.1f M colors/s batched (%.1fx)\n", static_cast<int>(map), perValue, batch, batch / perValue);
+	}
+}
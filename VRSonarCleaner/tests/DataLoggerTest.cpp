@@ -0,0 +1,123 @@
+#include "Test.h"
+#include "../DataLogger.h"
+
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <string>
+
+namespace
+{
+	std::vector<std::string> readLines(std::string fileName)
+	{
+		std::vector<std::string> lines;
+		std::ifstream file(fileName);
+		for (std::string line; std::getline(file, line);)
+			lines.push_back(line);
+		return lines;
+	}
+}
+
+// Producers still logging while the log is closed must not leave records in the ring that end up in the next log
+TEST(DataLogger_CloseWaitsForProducersInFlight)
+{
+	DataLogger &logger = DataLogger::getInstance();
+	logger.setLogDirectory("./");
+	logger.setBinary(false);
+
+	const int nRounds = 100;
+	const int nProducers = 4;
+	bool complete = true, separate = true;
+
+	for (int round = 0; round < nRounds; ++round)
+	{
+		CHECK(logger.openLog("DataLoggerTest_A.log", false));
+		logger.start();
+
+		std::atomic<bool> run(true);
+		std::vector<std::thread> producers;
+		for (int t = 0; t < nProducers; ++t)
+			producers.push_back(std::thread([&logger, &run]() {
+				while (run)
+					logger.logMessage("A");
+			}));
+
+		std::this_thread::sleep_for(std::chrono::microseconds(100 + 50 * (round % 8)));
+		logger.closeLog();
+		run = false;
+		for (auto &p : producers)
+			p.join();
+
+		CHECK(logger.openLog("DataLoggerTest_B.log", false));
+		logger.start();
+		logger.logMessage("B");
+		logger.closeLog();
+
+		std::vector<std::string> a = readLines("DataLoggerTest_A.log");
+		std::vector<std::string> b = readLines("DataLoggerTest_B.log");
+
+		complete = complete && std::all_of(a.begin(), a.end(), [](std::string const &line) { return line == ",A"; });
+		separate = separate && b.size() == 1u && b[0] == ",B";
+	}
+
+	remove("DataLoggerTest_A.log");
+	remove("DataLoggerTest_B.log");
+
+	CHECK(complete);
+	CHECK(separate);
+}
+
+BENCHMARK(DataLogger_EightProducers)
+{
+	DataLogger &logger = DataLogger::getInstance();
+	logger.setLogDirectory("./");
+	logger.setBinary(false);
+
+	const int nProducers = 8;
+	const int nMessages = 200000;
+	std::string message = "pose,1.234,5.678,9.012,0.1,0.2,0.3,0.9";
+
+	CHECK(logger.openLog("DataLoggerTest_Benchmark.log", false));
+	logger.start();
+
+	// per-call latency of logMessage() as seen by each producer
+	std::vector<std::vector<float>> latencies(nProducers, std::vector<float>(nMessages));
+	std::vector<std::thread> producers;
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (int t = 0; t < nProducers; ++t)
+		producers.push_back(std::thread([&logger, &latencies, &message, t, nMessages]() {
+			for (int i = 0; i < nMessages; ++i)
+			{
+				auto s = std::chrono::high_resolution_clock::now();
+				logger.logMessage(message);
+				latencies[t][i] = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - s).count();
+			}
+		}));
+
+	for (auto &p : producers)
+		p.join();
+
+	double enqueueSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	logger.closeLog();
+
+	double totalSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::vector<float> all;
+	for (auto const &l : latencies)
+		all.insert(all.end(), l.begin(), l.end());
+	std::sort(all.begin(), all.end());
+
+	size_t nLines = readLines("DataLoggerTest_Benchmark.log").size();
+	remove("DataLoggerTest_Benchmark.log");
+
+	CHECK(nLines == static_cast<size_t>(nProducers) * nMessages);
+
+	double nTotal = static_cast<double>(nProducers) * nMessages;
+	printf("    %d producers: %.2fM messages/s enqueued, %.2fM messages/s written\n", nProducers, nTotal / enqueueSeconds * 1e-6, nTotal / totalSeconds * 1e-6);
+	printf("    logMessage latency: p50 %.2fus, p99 %.2fus, p99.9 %.2fus, max %.2fus\n", all[all.size() / 2u], all[all.size() * 99u / 100u], all[all.size() * 999u / 1000u], all.back());
+}
@@ -0,0 +1,498 @@
+#include "Test.h"
+#include "../EventLog.h"
+#include "../DataLogger.h"
+
+#include <random>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <gtc/matrix_transform.hpp>
+
+namespace
+{
+	std::vector<std::string> readLines(std::string fileName)
+	{
+		std::vector<std::string> lines;
+		std::ifstream file(fileName);
+		for (std::string line; std::getline(file, line);)
+			lines.push_back(line);
+		return lines;
+	}
+
+	std::string readFile(std::string fileName)
+	{
+		std::ifstream file(fileName, std::ios::binary);
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void writeFile(std::string fileName, std::string const &data)
+	{
+		std::ofstream file(fileName, std::ios::binary);
+		file.write(data.data(), data.size());
+	}
+
+	// text and binary logs are written at slightly different times, so the time field between the first two tabs
+	// is blanked before comparing lines
+	std::string withoutTime(std::string line)
+	{
+		size_t first = line.find('\t');
+		size_t second = first == std::string::npos ? std::string::npos : line.find('\t', first + 1u);
+		if (second != std::string::npos)
+			line.erase(first + 1u, second - first - 1u);
+		return line;
+	}
+
+	glm::mat4 devicePose(std::mt19937 &rng)
+	{
+		std::uniform_real_distribution<float> unit(-1.f, 1.f);
+		glm::mat4 m = glm::translate(glm::mat4(), glm::vec3(unit(rng), 1.5f + 0.2f * unit(rng), unit(rng)));
+		return glm::rotate(m, 3.f * unit(rng), glm::normalize(glm::vec3(unit(rng), unit(rng), unit(rng)) + glm::vec3(0.f, 2.f, 0.f)));
+	}
+
+	EventLog::Pose makePose(std::mt19937 &rng, unsigned char devices = 7u)
+	{
+		EventLog::Pose pose;
+		for (int i = 0; i < EventLog::Pose::DeviceCount; ++i)
+			if (devices & (1u << i))
+				pose.set(static_cast<EventLog::Pose::Device>(i), devicePose(rng));
+		return pose;
+	}
+
+	EventLog::PointsCleaned makePointsCleaned(std::mt19937 &rng, unsigned int nRanges)
+	{
+		EventLog::PointsCleaned event;
+		event.cloud = "H12345_2011-07-15_surface.txt";
+
+		unsigned int next = rng() % 1000u;
+		for (unsigned int i = 0u; i < nRanges; ++i)
+		{
+			EventLog::PointRange r = { next, 1u + rng() % 40u };
+			event.ranges.push_back(r);
+			next = r.first + r.count + 1u + rng() % 3000u;
+			event.badCount += r.count;
+		}
+		event.goodCount = rng() % 5u;
+		event.badCount -= event.goodCount;
+
+		event.volPos = glm::vec3(0.1f, 1.2f, -0.4f);
+		event.volQuat = glm::quat_cast(devicePose(rng));
+		event.volDims = glm::vec3(1.5f, 0.4f, 1.5f);
+		return event;
+	}
+
+	EventLog::Trial makeTrial(std::mt19937 &rng, bool end)
+	{
+		EventLog::Trial event;
+		event.end = end;
+		event.trialType = "standing";
+		event.fileName = "H12345_2011-07-15_surface.txt";
+		event.fileCategory = "training";
+		event.volPos = glm::vec3(0.f, 1.1f, 0.f);
+		event.volQuat = glm::quat();
+		event.volDims = glm::vec3(1.5f, 0.4f, 1.5f);
+		event.pose = makePose(rng, 5u);
+		event.hasCamera = !end;
+		event.camPos = glm::vec3(0.f, 1.7f, 2.f);
+		event.camLookat = glm::vec3(0.f, 1.1f, 0.f);
+		event.hasTotals = end;
+		event.totalCleaned = 4321u;
+		event.totalMistakes = 12u;
+		return event;
+	}
+
+	// Logs the same events as a text log and as a binary log
+	void logEvents(DataLogger &logger, std::string logName, bool binary)
+	{
+		std::mt19937 rng(21u);
+
+		logger.setBinary(binary);
+		logger.setID("");
+		logger.setHeader("event,time,fields");
+		CHECK(logger.openLog(logName, false));
+		logger.setID("P07");
+		logger.start();
+
+		logger.logTrialEvent(makeTrial(rng, false));
+		for (int i = 0; i < 50; ++i)
+			logger.logPose(makePose(rng, static_cast<unsigned char>(i % 8)));
+		logger.logMessage("Grab\t00:00:01.000\tcontroller:\"primary\"");
+		logger.logPointsCleaned(makePointsCleaned(rng, 0u));
+		logger.logPointsCleaned(makePointsCleaned(rng, 300u));
+		logger.setID("P08");
+		logger.logMessage("");
+		logger.logTrialEvent(makeTrial(rng, true));
+
+		logger.closeLog();
+		logger.setID("");
+		logger.setHeader("");
+		logger.setBinary(false);
+	}
+}
+
+// The converter regenerates the text log line for line from a binary log of the same events
+TEST(EventLog_ConvertedBinaryLogMatchesTextLog)
+{
+	DataLogger &logger = DataLogger::getInstance();
+	logger.setLogDirectory("./");
+
+	logEvents(logger, "EventLogTest_Text.log", false);
+	logEvents(logger, "EventLogTest_Binary", true);
+
+	CHECK(EventLog::convertToText("EventLogTest_Binary.evlog", "EventLogTest_Converted.log"));
+
+	std::vector<std::string> text = readLines("EventLogTest_Text.log");
+	std::vector<std::string> converted = readLines("EventLogTest_Converted.log");
+	std::string binary = readFile("EventLogTest_Binary.evlog");
+
+	remove("EventLogTest_Text.log");
+	remove("EventLogTest_Converted.log");
+	remove("EventLogTest_Binary.evlog");
+
+	CHECK(text.size() == 57u);
+	CHECK(converted.size() == text.size());
+	if (converted.size() != text.size())
+		return;
+
+	bool same = true;
+	for (size_t i = 0u; i < text.size(); ++i)
+		same = same && withoutTime(converted[i]) == withoutTime(text[i]);
+	CHECK(same);
+
+	// the binary log is a fraction of the text log
+	size_t textBytes = 0u;
+	for (auto const &line : text)
+		textBytes += line.size() + 1u;
+	CHECK(binary.size() * 3u < textBytes);
+}
+
+// A log cut off by a crash converts up to the last complete record, and records of unknown types are skipped
+TEST(EventLog_TruncatedAndUnknownRecords)
+{
+	std::mt19937 rng(22u);
+
+	std::string log(8u, '\0');
+	unsigned int fileHeader[2] = { EVENTLOG_MAGIC, EVENTLOG_VERSION };
+	memcpy(&log[0], fileHeader, sizeof(fileHeader));
+
+	EventLog::encodeString(EventLog::Record_Identity, 0u, "P01", log);
+	EventLog::Pose pose = makePose(rng);
+	EventLog::encode(pose, 11u, log);
+
+	// a record type from a newer version, with a payload the converter cannot parse
+	std::string unknown = "\x40\x05\x0C" "abcde";
+	log.append(unknown);
+
+	EventLog::PointsCleaned cleaned = makePointsCleaned(rng, 20u);
+	EventLog::encode(cleaned, 3723004u, log);
+	size_t completeSize = log.size();
+
+	EventLog::Trial trial = makeTrial(rng, true);
+	EventLog::encode(trial, 3723010u, log);
+
+	std::vector<std::string> expected;
+	expected.push_back("P01," + EventLog::format(pose, "00:00:00.011"));
+	expected.push_back("P01," + EventLog::format(cleaned, "01:02:03.004"));
+	expected.push_back("P01," + EventLog::format(trial, "01:02:03.010"));
+
+	// cuts through the header of the last record, through its payload and just before its end drop only that record
+	size_t sizes[] = { completeSize, completeSize + 1u, completeSize + 2u, (completeSize + log.size()) / 2u, log.size() - 1u, log.size() };
+	bool allConverted = true, cutsDropLastRecord = true;
+	for (size_t size : sizes)
+	{
+		writeFile("EventLogTest_Truncated.evlog", log.substr(0u, size));
+		allConverted = allConverted && EventLog::convertToText("EventLogTest_Truncated.evlog", "EventLogTest_Truncated.log");
+
+		std::vector<std::string> lines = readLines("EventLogTest_Truncated.log");
+		size_t nExpected = size == log.size() ? 3u : 2u;
+		cutsDropLastRecord = cutsDropLastRecord && lines == std::vector<std::string>(expected.begin(), expected.begin() + nExpected);
+	}
+	CHECK(allConverted);
+	CHECK(cutsDropLastRecord);
+
+	// files that are not event logs are rejected
+	writeFile("EventLogTest_Truncated.evlog", "Trial Begin\t00:00:00.000\t");
+	CHECK(!EventLog::convertToText("EventLogTest_Truncated.evlog", "EventLogTest_Truncated.log"));
+
+	remove("EventLogTest_Truncated.evlog");
+	remove("EventLogTest_Truncated.log");
+	CHECK(!EventLog::convertToText("EventLogTest_Truncated.evlog", "EventLogTest_Truncated.log"));
+}
+
+// A 10 minute study session: HMD and both controllers logged every frame at 90Hz, a cleaning stroke every 2s and
+// a trial every minute. Compares the binary records with the text lines logMessage() writes, first the encoding
+// alone and then through the logger.
+BENCHMARK(EventLog_TenMinuteSession)
+{
+	const unsigned int nFrames = 10u * 60u * 90u;
+	std::mt19937 rng(23u);
+
+	std::vector<EventLog::Pose> poses;
+	std::vector<EventLog::PointsCleaned> cleaned;
+	std::vector<EventLog::Trial> trials;
+	for (unsigned int frame = 0u; frame < nFrames; ++frame)
+	{
+		poses.push_back(makePose(rng));
+		if (frame % 180u == 0u)
+			cleaned.push_back(makePointsCleaned(rng, 1u + rng() % 100u));
+		if (frame % 5400u == 0u)
+			trials.push_back(makeTrial(rng, (frame / 5400u) % 2u == 1u));
+	}
+
+	auto timeMs = [](unsigned int frame) { return frame * 1000u / 90u; };
+	size_t nEvents = poses.size() + cleaned.size() + trials.size();
+
+	// encoding alone: the binary records against the text lines, formatted and prefixed with the id like enqueue() does
+	std::string id = "P07", binary, text;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0u; frame < nFrames; ++frame)
+	{
+		EventLog::encode(poses[frame], timeMs(frame), binary);
+		if (frame % 180u == 0u)
+			EventLog::encode(cleaned[frame / 180u], timeMs(frame), binary);
+		if (frame % 5400u == 0u)
+			EventLog::encode(trials[frame / 5400u], timeMs(frame), binary);
+	}
+	double binarySeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0u; frame < nFrames; ++frame)
+	{
+		std::string time = EventLog::formatTime(timeMs(frame));
+		text += id + ',' + EventLog::format(poses[frame], time) + '\n';
+		if (frame % 180u == 0u)
+			text += id + ',' + EventLog::format(cleaned[frame / 180u], time) + '\n';
+		if (frame % 5400u == 0u)
+			text += id + ',' + EventLog::format(trials[frame / 5400u], time) + '\n';
+	}
+	double textSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("    %zu events (%zu poses, %zu cleaning strokes, %zu trial events)\n", nEvents, poses.size(), cleaned.size(), trials.size());
+	printf("    encoding: binary %.1f bytes/event, %.0f ns/event; text %.1f bytes/event, %.0f ns/event\n",
+		static_cast<double>(binary.size()) / nEvents, binarySeconds * 1e9 / nEvents, static_cast<double>(text.size()) / nEvents, textSeconds * 1e9 / nEvents);
+
+	// through the logger, as fast as the events can be logged, until they are all on disk
+	DataLogger &logger = DataLogger::getInstance();
+	logger.setLogDirectory("./");
+
+	for (bool isBinary : { false, true })
+	{
+		logger.setBinary(isBinary);
+		logger.setID("P07");
+		CHECK(logger.openLog("EventLogTest_Session", false));
+		logger.start();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (unsigned int frame = 0u; frame < nFrames; ++frame)
+		{
+			logger.logPose(poses[frame]);
+			if (frame % 180u == 0u)
+				logger.logPointsCleaned(cleaned[frame / 180u]);
+			if (frame % 5400u == 0u)
+				logger.logTrialEvent(trials[frame / 5400u]);
+		}
+		double logSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		logger.closeLog();
+
+		std::string fileName = isBinary ? "EventLogTest_Session.evlog" : "EventLogTest_Session";
+		size_t fileBytes = readFile(fileName).size();
+		remove(fileName.c_str());
+
+		printf("    %s log: %.1f bytes/event, %.0f ns/event on the logging thread, %.1f MB for the session\n",
+			isBinary ? "binary" : "text", static_cast<double>(fileBytes) / nEvents, logSeconds * 1e9 / nEvents, fileBytes / 1048576.0);
+	}
+
+	logger.setID("");
+	logger.setBinary(false);
+}
+
+namespace
+{
+	// a lasso selection over a swath: runs of neighbouring points with gaps between them, about 1 in 8 flagged bad
+	void makeSelection(unsigned int nPoints, unsigned int seed, std::vector<unsigned int> &selected, std::vector<bool> &bad)
+	{
+		std::mt19937 rng(seed);
+		selected.clear();
+		bad.assign(nPoints, false);
+
+		for (unsigned int i = rng() % 5u; i < nPoints;)
+		{
+			unsigned int run = 1u + rng() % 50u;
+			for (unsigned int j = i; j < i + run && j < nPoints; ++j)
+			{
+				selected.push_back(j);
+				bad[j] = rng() % 8u == 0u;
+			}
+			i += run + 1u + rng() % 20u;
+		}
+	}
+
+	std::vector<EventLog::PointsCleaned> collect(std::vector<unsigned int> const &selected, std::vector<bool> const &bad, size_t maxRanges)
+	{
+		EventLog::PointsCleaned prototype;
+		prototype.cloud = "cloud.txt";
+		prototype.volPos = glm::vec3(1.f, 2.f, 3.f);
+		prototype.badCount = 99u;
+
+		std::vector<EventLog::PointsCleaned> events;
+		EventLog::PointsCleanedCollector collector(prototype, maxRanges, [&events](EventLog::PointsCleaned const &e) { events.push_back(e); });
+		for (unsigned int i : selected)
+			collector.add(i, bad[i]);
+		collector.finish();
+
+		return events;
+	}
+}
+
+// The collected ranges cover exactly the cleaned points, and splitting a large selection keeps every range whole
+TEST(EventLog_PointsCleanedCollectorCoalescesAndSplits)
+{
+	std::vector<unsigned int> selected;
+	std::vector<bool> bad;
+	makeSelection(200000u, 24u, selected, bad);
+
+	// expected ranges: maximal runs of consecutive indices
+	std::vector<EventLog::PointRange> expected;
+	unsigned int expectedBad = 0u;
+	for (unsigned int i : selected)
+	{
+		if (expected.size() > 0u && expected.back().first + expected.back().count == i)
+			expected.back().count++;
+		else
+			expected.push_back({ i, 1u });
+		expectedBad += bad[i] ? 1u : 0u;
+	}
+
+	for (size_t maxRanges : { size_t(1u), size_t(7u), size_t(4096u), size_t(1000000u) })
+	{
+		std::vector<EventLog::PointsCleaned> events = collect(selected, bad, maxRanges);
+		CHECK(events.size() == (expected.size() + maxRanges - 1u) / maxRanges);
+
+		std::vector<EventLog::PointRange> ranges;
+		bool withinLimit = true, prototypeKept = true, countsMatch = true;
+		unsigned int nBad = 0u;
+		for (auto const &e : events)
+		{
+			withinLimit = withinLimit && e.ranges.size() <= maxRanges;
+			prototypeKept = prototypeKept && e.cloud == "cloud.txt" && e.volPos == glm::vec3(1.f, 2.f, 3.f);
+
+			unsigned int nPoints = 0u;
+			for (auto const &r : e.ranges)
+				nPoints += r.count;
+			countsMatch = countsMatch && e.badCount + e.goodCount == nPoints;
+
+			ranges.insert(ranges.end(), e.ranges.begin(), e.ranges.end());
+			nBad += e.badCount;
+		}
+
+		CHECK(withinLimit);
+		CHECK(prototypeKept);
+		CHECK(countsMatch);
+		CHECK(nBad == expectedBad);
+		CHECK(ranges.size() == expected.size());
+		bool same = ranges.size() == expected.size();
+		for (size_t i = 0u; same && i < ranges.size(); ++i)
+			same = ranges[i].first == expected[i].first && ranges[i].count == expected[i].count;
+		CHECK(same);
+	}
+
+	// no cleaned points, no event
+	CHECK(collect(std::vector<unsigned int>(), bad, 4096u).empty());
+
+	// at DesktopCleanBehavior's 4096 ranges per event, a worst case event over a billion point cloud still fits in
+	// one DataLogger record
+	EventLog::PointsCleaned worst;
+	worst.cloud = std::string(255u, 'x');
+	for (unsigned int i = 0u; i < 4096u; ++i)
+		worst.ranges.push_back({ 0xF0000000u + i * 0x10000u, 0x8000u });
+	std::string record;
+	EventLog::encode(worst, 0xFFFFFFFFu, record);
+	CHECK(record.size() <= DATALOGGER_SLOT_PAYLOAD * (DATALOGGER_RING_SLOTS / 2));
+
+	// verbose logs keep the per-point lines
+	EventLog::PointCleaned point;
+	point.bad = true;
+	point.index = 7u;
+	point.worldPos = glm::vec3(1.f, 2.5f, 3.f);
+	point.screenPos = glm::vec2(4.f, 5.f);
+	point.volDims = glm::vec3(1.f);
+	CHECK(EventLog::format(point, "00:00:01.000") == "Bad Point Cleaned\t00:00:01.000\tpoint-id:\"7\";point-pos:\"1,2.5,3\";point-pos-screen:\"4,5\";"
+		"vol-pos:\"0,0,0\";vol-quat:\"0,0,0,1\";vol-dims:\"1,1,1\"");
+}
+
+// Deleting a 5M point lasso selection: the per-point lines of verbose logs against the range events logged by
+// default. Reports the time spent logging in the frame of the deletion, until the log is on disk, and the log size.
+BENCHMARK(EventLog_FiveMillionPointLasso)
+{
+	const unsigned int nPoints = 7500000u;
+	std::vector<unsigned int> selected;
+	std::vector<bool> bad;
+	makeSelection(nPoints, 25u, selected, bad);
+	selected.resize((std::min)(selected.size(), size_t(5000000u)));
+
+	DataLogger &logger = DataLogger::getInstance();
+	logger.setLogDirectory("./");
+
+	for (bool binary : { false, true })
+	{
+		for (bool verbose : { true, false })
+		{
+			logger.setBinary(binary);
+			logger.setVerbose(verbose);
+			logger.setID("P07");
+			CHECK(logger.openLog("EventLogTest_Lasso", false));
+			logger.start();
+
+			EventLog::PointsCleaned prototype;
+			prototype.cloud = "H12345_2011-07-15_surface.txt";
+			prototype.volPos = glm::vec3(0.1f, 1.2f, -0.4f);
+			prototype.volQuat = glm::quat(0.9f, 0.1f, 0.3f, 0.2f);
+			prototype.volDims = glm::vec3(1.5f, 0.4f, 1.5f);
+
+			size_t nEvents = 0u;
+			auto start = std::chrono::high_resolution_clock::now();
+			if (verbose)
+			{
+				// what DesktopCleanBehavior::logPointCleaned() logs for each point
+				EventLog::PointCleaned event;
+				event.volPos = prototype.volPos;
+				event.volQuat = prototype.volQuat;
+				event.volDims = prototype.volDims;
+				for (unsigned int i : selected)
+				{
+					event.bad = bad[i];
+					event.index = i;
+					event.worldPos = glm::vec3(i * 1e-6f, 0.5f, -0.25f);
+					event.screenPos = glm::vec2(640.5f, 360.25f);
+					logger.logMessage(EventLog::format(event, logger.getTimeSinceLogStartString()));
+				}
+				nEvents = selected.size();
+			}
+			else
+			{
+				EventLog::PointsCleanedCollector collector(prototype, 4096u, [&logger, &nEvents](EventLog::PointsCleaned const &e) {
+					logger.logPointsCleaned(e);
+					nEvents++;
+				});
+				for (unsigned int i : selected)
+					collector.add(i, bad[i]);
+				collector.finish();
+			}
+			double frameSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			logger.closeLog();
+			double totalSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			std::string fileName = binary ? "EventLogTest_Lasso.evlog" : "EventLogTest_Lasso";
+			size_t fileBytes = readFile(fileName).size();
+			remove(fileName.c_str());
+
+			printf("    %s %s: %zu points in %zu events, %.1f ms in the frame, %.1f ms until written, %.2f MB\n", binary ? "binary" : "text  ", verbose ? "verbose" : "ranges ",
+				selected.size(), nEvents, frameSeconds * 1000.0, totalSeconds * 1000.0, fileBytes / 1048576.0);
+		}
+	}
+
+	logger.setID("");
+	logger.setVerbose(false);
+	logger.setBinary(false);
+}
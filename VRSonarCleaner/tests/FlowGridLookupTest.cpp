@@ -0,0 +1,204 @@
+#include "Test.h"
+#include "../FlowGridLookup.h"
+
+#include <random>
+#include <memory>
+#include <limits>
+#include <chrono>
+
+namespace
+{
+	// A one-timestep flowgrid of 2x2x2 water cells over [bbMin, bbMax], with depth levels from bbMin.z to bbMax.z,
+	// or from bbMax.z to bbMin.z if descending
+	std::unique_ptr<FlowGrid> makeGrid(glm::vec3 const &bbMin, glm::vec3 const &bbMax, bool descending = false)
+	{
+		std::string fileName = "FlowGridLookupTest.fg";
+		FILE *file = fopen(fileName.c_str(), "wb");
+
+		int n = 2, nt = 1;
+		float header[] = { bbMin.x, bbMax.x, bbMin.y, bbMax.y, bbMin.z, bbMax.z };
+		fwrite(&header[0], sizeof(float), 2, file);
+		fwrite(&n, sizeof(int), 1, file);
+		fwrite(&header[2], sizeof(float), 2, file);
+		fwrite(&n, sizeof(int), 1, file);
+		fwrite(&header[4], sizeof(float), 2, file);
+		fwrite(&n, sizeof(int), 1, file);
+		fwrite(&nt, sizeof(int), 1, file);
+
+		float depths[] = { descending ? bbMax.z : bbMin.z, descending ? bbMin.z : bbMax.z };
+		fwrite(depths, sizeof(float), 2, file);
+		float time = 0.f;
+		fwrite(&time, sizeof(float), 1, file);
+
+		for (int i = 0; i < n * n * n * nt; ++i)
+		{
+			int isWater = 1;
+			float uvw[3] = { 1.f, 0.f, 0.f };
+			fwrite(&isWater, sizeof(int), 1, file);
+			fwrite(uvw, sizeof(float), 3, file);
+		}
+
+		fclose(file);
+
+		std::unique_ptr<FlowGrid> grid(new FlowGrid(fileName.c_str(), true));
+		remove(fileName.c_str());
+		return grid;
+	}
+
+	// side x side tiles of one unit sharing their edges, two units deep
+	void makeTiles(int side, std::vector<std::unique_ptr<FlowGrid>> &grids)
+	{
+		for (int y = 0; y < side; ++y)
+			for (int x = 0; x < side; ++x)
+				grids.push_back(makeGrid(glm::vec3(x, y, 0.f), glm::vec3(x + 1, y + 1, 2.f)));
+	}
+
+	// Testing contains() on every grid in turn, the way particles found their grid before FlowGridLookup, except
+	// that NaN positions, which contains() accepts, are in no grid
+	FlowGrid* findLinear(std::vector<FlowGrid*> const &grids, glm::vec3 const &pos)
+	{
+		if (glm::any(glm::isnan(pos)))
+			return NULL;
+
+		for (auto const &grid : grids)
+			if (grid->contains(pos.x, pos.y, pos.z))
+				return grid;
+
+		return NULL;
+	}
+
+	std::vector<FlowGrid*> pointers(std::vector<std::unique_ptr<FlowGrid>> const &grids)
+	{
+		std::vector<FlowGrid*> result;
+		for (auto const &grid : grids)
+			result.push_back(grid.get());
+
+		return result;
+	}
+
+	// Random positions over bbMin to bbMax widened by a tenth on each side, and positions on the unit lattice, where
+	// tiles meet
+	std::vector<glm::vec3> makePositions(glm::vec3 const &bbMin, glm::vec3 const &bbMax, size_t count, unsigned int seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(-0.1f, 1.1f);
+
+		std::vector<glm::vec3> positions;
+		for (size_t i = 0u; i < count; ++i)
+			positions.push_back(bbMin + (bbMax - bbMin) * glm::vec3(unit(rng), unit(rng), unit(rng)));
+
+		for (float z = bbMin.z; z <= bbMax.z; z += 1.f)
+			for (float y = bbMin.y; y <= bbMax.y; y += 1.f)
+				for (float x = bbMin.x; x <= bbMax.x; x += 1.f)
+					positions.push_back(glm::vec3(x, y, z));
+
+		positions.push_back(glm::vec3(std::numeric_limits<float>::quiet_NaN()));
+		return positions;
+	}
+
+	size_t countMismatches(std::vector<FlowGrid*> const &grids, std::vector<glm::vec3> const &positions, size_t &nFound)
+	{
+		FlowGridLookup lookup;
+		lookup.update(grids);
+
+		size_t nMismatches = 0u;
+		nFound = 0u;
+		for (auto const &pos : positions)
+		{
+			FlowGrid *expected = findLinear(grids, pos);
+			nMismatches += lookup.findGrid(pos) != expected ? 1u : 0u;
+			nFound += expected ? 1u : 0u;
+		}
+
+		return nMismatches;
+	}
+}
+
+// Tiles sharing their edges, where a position on an edge goes to the first tile in collection order, in both orders
+TEST(FlowGridLookup_TiledGridsMatchLinearSearch)
+{
+	std::vector<std::unique_ptr<FlowGrid>> grids;
+	makeTiles(6, grids);
+
+	std::vector<FlowGrid*> ordered = pointers(grids);
+	std::vector<FlowGrid*> reversed(ordered.rbegin(), ordered.rend());
+	std::vector<glm::vec3> positions = makePositions(glm::vec3(0.f), glm::vec3(6.f, 6.f, 2.f), 20000u, 1u);
+
+	for (auto const &order : { ordered, reversed })
+	{
+		size_t nFound;
+		CHECK(countMismatches(order, positions, nFound) == 0u);
+		CHECK(nFound > positions.size() / 2u && nFound < positions.size());
+	}
+
+	// fewer grids than FLOWGRIDLOOKUP_MIN_GRIDS are searched in turn
+	std::vector<FlowGrid*> few(ordered.begin(), ordered.begin() + FLOWGRIDLOOKUP_MIN_GRIDS - 1);
+	size_t nFound;
+	CHECK(countMismatches(few, positions, nFound) == 0u);
+}
+
+// Small grids inside a large one, listed before and after it, so the large one hides the later ones, plus
+// partially overlapping grids, a flat one and one with descending depth levels, which contains nothing
+TEST(FlowGridLookup_NestedGridsMatchLinearSearch)
+{
+	std::vector<std::unique_ptr<FlowGrid>> grids;
+	grids.push_back(makeGrid(glm::vec3(1.f, 1.f, 0.5f), glm::vec3(1.5f, 1.25f, 1.f)));
+	grids.push_back(makeGrid(glm::vec3(6.f, 2.f, 0.f), glm::vec3(7.f, 3.f, 1.f), true));
+	grids.push_back(makeGrid(glm::vec3(0.f), glm::vec3(8.f, 8.f, 4.f)));
+	grids.push_back(makeGrid(glm::vec3(2.f, 2.f, 1.f), glm::vec3(3.f, 3.f, 2.f)));
+	grids.push_back(makeGrid(glm::vec3(7.f, 7.f, 3.f), glm::vec3(10.f, 9.f, 5.f)));
+	grids.push_back(makeGrid(glm::vec3(-2.f, 4.f, 2.f), glm::vec3(1.f, 4.5f, 2.f)));
+	grids.push_back(makeGrid(glm::vec3(9.f, -1.f, 0.f), glm::vec3(9.25f, 0.f, 0.125f)));
+	grids.push_back(makeGrid(glm::vec3(-3.f, -3.f, -1.f), glm::vec3(-2.f, -2.f, 0.f), true));
+
+	std::vector<FlowGrid*> ordered = pointers(grids);
+	std::vector<FlowGrid*> reversed(ordered.rbegin(), ordered.rend());
+	std::vector<glm::vec3> positions = makePositions(glm::vec3(-3.f, -3.f, -1.f), glm::vec3(10.f, 9.f, 5.f), 50000u, 2u);
+	for (auto const &grid : grids)
+	{
+		std::vector<glm::vec3> inside = makePositions(glm::vec3(grid->m_fXMin, grid->m_fYMin, (std::min)(grid->getMinDepth(), grid->getMaxDepth())),
+			glm::vec3(grid->m_fXMax, grid->m_fYMax, (std::max)(grid->getMinDepth(), grid->getMaxDepth())), 2000u, 3u);
+		positions.insert(positions.end(), inside.begin(), inside.end());
+	}
+
+	for (auto const &order : { ordered, reversed })
+	{
+		size_t nFound;
+		CHECK(countMismatches(order, positions, nFound) == 0u);
+		CHECK(nFound > 0u);
+	}
+}
+
+// Lookups against testing every grid in turn, for 1, 16 and 128 tiles
+BENCHMARK(FlowGridLookup_LookupsPerSecond)
+{
+	for (int side : { 1, 4, 11 })
+	{
+		std::vector<std::unique_ptr<FlowGrid>> grids;
+		makeTiles(side, grids);
+		// 121 tiles, topped up to 128 with grids nested in them
+		for (int i = 0; side == 11 && i < 7; ++i)
+			grids.push_back(makeGrid(glm::vec3(i + 0.25f, i + 0.25f, 0.5f), glm::vec3(i + 0.75f, i + 0.75f, 1.5f)));
+
+		std::vector<FlowGrid*> pointerGrids = pointers(grids);
+		std::vector<glm::vec3> positions = makePositions(glm::vec3(0.f), glm::vec3(static_cast<float>(side), static_cast<float>(side), 2.f), 1000000u, 4u);
+
+		FlowGridLookup lookup;
+		lookup.update(pointerGrids);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t lookupSum = 0u;
+		for (auto const &pos : positions)
+			lookupSum += reinterpret_cast<size_t>(lookup.findGrid(pos));
+		double lookupSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		size_t linearSum = 0u;
+		for (auto const &pos : positions)
+			linearSum += reinterpret_cast<size_t>(findLinear(pointerGrids, pos));
+		double linearSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		CHECK(lookupSum == linearSum);
+		printf("    %3zu grids: %7.1fM lookups/s, linear %7.1fM lookups/s\n", grids.size(), positions.size() / lookupSeconds * 1e-6, positions.size() / linearSeconds * 1e-6);
+	}
+}
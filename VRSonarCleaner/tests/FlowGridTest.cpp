@@ -0,0 +1,1185 @@
+#include "Test.h"
+#include "../FlowGrid.h"
+
+#include <random>
+#include <functional>
+#include <memory>
+#include <limits>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
+// The test project builds with a small FLOWGRID_LOAD_CHUNK_BYTES, so the grids below are read in several chunks
+
+namespace
+{
+	struct GridShape {
+		int nx, ny, nz, nt;
+	};
+
+	struct CellRecord {
+		bool isWater;
+		glm::vec3 uvw;
+	};
+
+	// Writes a flowgrid file (or a raw u, v, w file without header) with the cells given by getRecord(x, y, z, t),
+	// called in file order: x-outermost and t-innermost. Cells are one unit wide in the flowgrid file, times and
+	// depth levels are their indices. Truncates the records to recordBytes if it is not negative.
+	void writeGridFile(std::string fileName, GridShape const &shape, bool withHeader, bool hasW, std::function<CellRecord(int, int, int, int)> getRecord, long long recordBytes = -1)
+	{
+		FILE *file = fopen(fileName.c_str(), "wb");
+
+		if (withHeader)
+		{
+			float xMin = 0.f, xMax = static_cast<float>(shape.nx), yMin = 0.f, yMax = static_cast<float>(shape.ny), zMin = 0.f, zMax = static_cast<float>(shape.nz);
+			fwrite(&xMin, sizeof(float), 1, file);
+			fwrite(&xMax, sizeof(float), 1, file);
+			fwrite(&shape.nx, sizeof(int), 1, file);
+			fwrite(&yMin, sizeof(float), 1, file);
+			fwrite(&yMax, sizeof(float), 1, file);
+			fwrite(&shape.ny, sizeof(int), 1, file);
+			if (hasW)
+			{
+				fwrite(&zMin, sizeof(float), 1, file);
+				fwrite(&zMax, sizeof(float), 1, file);
+			}
+			fwrite(&shape.nz, sizeof(int), 1, file);
+			fwrite(&shape.nt, sizeof(int), 1, file);
+			for (int z = 0; z < shape.nz; ++z)
+			{
+				float depth = static_cast<float>(z);
+				fwrite(&depth, sizeof(float), 1, file);
+			}
+			for (int t = 0; t < shape.nt; ++t)
+			{
+				float time = static_cast<float>(t);
+				fwrite(&time, sizeof(float), 1, file);
+			}
+		}
+
+		std::vector<char> records;
+		auto append = [&records](void const *data, size_t size) { records.insert(records.end(), static_cast<char const*>(data), static_cast<char const*>(data) + size); };
+
+		for (int x = 0; x < shape.nx; ++x)
+			for (int y = 0; y < shape.ny; ++y)
+				for (int z = 0; z < shape.nz; ++z)
+					for (int t = 0; t < shape.nt; ++t)
+					{
+						CellRecord record = getRecord(x, y, z, t);
+						if (withHeader)
+						{
+							int isWater = record.isWater ? 1 : 0;
+							append(&isWater, sizeof(int));
+						}
+						append(&record.uvw[0], (hasW ? 3u : 2u) * sizeof(float));
+					}
+
+		if (recordBytes >= 0 && static_cast<size_t>(recordBytes) < records.size())
+			records.resize(static_cast<size_t>(recordBytes));
+
+		fwrite(records.data(), 1, records.size(), file);
+		fclose(file);
+	}
+
+	std::function<CellRecord(int, int, int, int)> randomRecords(unsigned int seed)
+	{
+		auto rng = std::make_shared<std::mt19937>(seed);
+
+		return [rng](int, int, int, int) {
+			std::uniform_real_distribution<float> value(-2.f, 2.f);
+			std::bernoulli_distribution water(0.8);
+
+			CellRecord record;
+			record.isWater = water(*rng);
+			record.uvw.x = value(*rng);
+			record.uvw.y = value(*rng);
+			record.uvw.z = value(*rng);
+			return record;
+		};
+	}
+
+	// Reads the records one at a time in file order, the way FlowGrid read them before cells were loaded in chunks,
+	// into t-outermost, x-innermost arrays. Cells whose record is cut off by the end of the file are zero, and not
+	// water if the file has a water mask.
+	void readReference(std::string fileName, GridShape const &shape, bool withHeader, bool hasW, std::vector<glm::vec4> &cells, std::vector<bool> &isWater, float &maxVelocity)
+	{
+		FILE *file = fopen(fileName.c_str(), "rb");
+
+		if (withHeader)
+			fseek(file, static_cast<long>((hasW ? 10 : 8) * 4 + (shape.nz + shape.nt) * 4), SEEK_SET);
+
+		size_t nCells = static_cast<size_t>(shape.nx) * shape.ny * shape.nz * shape.nt;
+		cells.assign(nCells, glm::vec4(0.f));
+		isWater.assign(nCells, false);
+		maxVelocity = 0.f;
+
+		for (int x = 0; x < shape.nx; ++x)
+			for (int y = 0; y < shape.ny; ++y)
+				for (int z = 0; z < shape.nz; ++z)
+					for (int t = 0; t < shape.nt; ++t)
+					{
+						size_t index = ((static_cast<size_t>(t) * shape.nz + z) * shape.ny + y) * shape.nx + x;
+
+						int water = 1;
+						float uvw[3] = { 0.f, 0.f, 0.f };
+						bool complete = !withHeader || fread(&water, sizeof(int), 1, file) == 1;
+						complete = complete && fread(uvw, sizeof(float), hasW ? 3 : 2, file) == (hasW ? 3u : 2u);
+						if (!complete)
+						{
+							water = withHeader ? 0 : 1;
+							uvw[0] = uvw[1] = uvw[2] = 0.f;
+						}
+
+						float velocity = sqrt(uvw[0] * uvw[0] + uvw[1] * uvw[1] + uvw[2] * uvw[2]);
+						cells[index] = glm::vec4(uvw[0], uvw[1], uvw[2], velocity);
+						isWater[index] = water != 0;
+						maxVelocity = (std::max)(maxVelocity, velocity);
+					}
+
+		fclose(file);
+	}
+
+	void checkLoadedCells(FlowGrid &grid, std::string fileName, GridShape const &shape, bool withHeader, bool hasW)
+	{
+		std::vector<glm::vec4> cells;
+		std::vector<bool> isWater;
+		float maxVelocity;
+		readReference(fileName, shape, withHeader, hasW, cells, isWater, maxVelocity);
+
+		CHECK(grid.m_nXCells == shape.nx && grid.m_nYCells == shape.ny && grid.m_nZCells == shape.nz && grid.m_nTimesteps == shape.nt);
+		CHECK(grid.m_vCells.size() == cells.size());
+		if (grid.m_vCells.size() != cells.size())
+			return;
+
+		size_t nCellMismatches = 0u, nWaterMismatches = 0u;
+		for (int t = 0; t < shape.nt; ++t)
+			for (int z = 0; z < shape.nz; ++z)
+				for (int y = 0; y < shape.ny; ++y)
+					for (int x = 0; x < shape.nx; ++x)
+					{
+						size_t index = ((static_cast<size_t>(t) * shape.nz + z) * shape.ny + y) * shape.nx + x;
+						if (grid.m_vCells[index] != cells[index])
+							nCellMismatches++;
+						if (grid.isWater(x, y, z, t) != isWater[index])
+							nWaterMismatches++;
+					}
+
+		CHECK(nCellMismatches == 0u);
+		CHECK(nWaterMismatches == 0u);
+		CHECK(grid.m_fMaxVelocity == maxVelocity);
+	}
+
+	void checkFlowGridFile(GridShape const &shape, bool hasW, unsigned int seed, long long recordBytes = -1)
+	{
+		std::string fileName = "FlowGridTest.fg";
+		writeGridFile(fileName, shape, true, hasW, randomRecords(seed), recordBytes);
+
+		{
+			FlowGrid grid(fileName.c_str(), hasW);
+			checkLoadedCells(grid, fileName, shape, true, hasW);
+		}
+
+		remove(fileName.c_str());
+	}
+}
+
+// Slabs of odd widths, so chunks end partway through the 16-cell transpose blocks and the 32-cell water mask words
+TEST(FlowGrid_LoadMatchesRecordLoader)
+{
+	checkFlowGridFile({ 53, 70, 9, 5 }, true, 1u);
+	checkFlowGridFile({ 45, 70, 9, 5 }, false, 2u);
+	checkFlowGridFile({ 7, 3, 2, 3 }, true, 3u);
+	checkFlowGridFile({ 33, 1, 1, 1 }, false, 4u);
+}
+
+TEST(FlowGrid_RawLoadMatchesRecordLoader)
+{
+	GridShape shape = { 41, 96, 40, 1 };
+	std::string fileName = "FlowGridTest.raw";
+	writeGridFile(fileName, shape, false, true, randomRecords(5u));
+
+	{
+		FlowGrid grid(fileName.c_str(), 0.f, 1.f, shape.nx, 0.f, 1.f, shape.ny, 0.f, 1.f, shape.nz);
+		checkLoadedCells(grid, fileName, shape, false, true);
+	}
+
+	remove(fileName.c_str());
+}
+
+// Ends partway through a record in the second chunk
+TEST(FlowGrid_TruncatedLoadMatchesRecordLoader)
+{
+	GridShape shape = { 53, 70, 9, 5 };
+	long long slabBytes = static_cast<long long>(shape.ny) * shape.nz * shape.nt * 16;
+	checkFlowGridFile(shape, true, 6u, slabBytes * 27 + 1000 + 6);
+}
+
+// Quadrilinear interpolation reproduces a field linear in space and time between the outermost cell centers
+TEST(FlowGrid_InterpolationIsExactForLinearFields)
+{
+	GridShape shape = { 13, 11, 7, 3 };
+	auto field = [](glm::vec3 p, float t) {
+		return glm::vec3(0.1f + 0.02f * p.x - 0.03f * p.y + 0.05f * p.z + 0.2f * t,
+			-0.2f + 0.04f * p.x + 0.01f * p.y - 0.02f * p.z - 0.1f * t,
+			0.03f - 0.01f * p.x + 0.02f * p.y + 0.01f * p.z + 0.05f * t);
+	};
+
+	std::string fileName = "FlowGridTest.fg";
+	writeGridFile(fileName, shape, true, true, [&field](int x, int y, int z, int t) {
+		CellRecord record;
+		record.isWater = true;
+		record.uvw = field(glm::vec3(x, y, z) + 0.5f, static_cast<float>(t));
+		return record;
+	});
+
+	{
+		FlowGrid grid(fileName.c_str(), true);
+
+		std::mt19937 rng(7u);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		float maxError = 0.f;
+		bool allValid = true;
+		for (int i = 0; i < 2000; ++i)
+		{
+			glm::vec3 p = glm::vec3(0.5f) + glm::vec3(unit(rng), unit(rng), unit(rng)) * (glm::vec3(shape.nx, shape.ny, shape.nz) - 1.f);
+			float t = unit(rng) * (shape.nt - 1);
+
+			glm::vec3 uvw;
+			bool valid = grid.getUVWatInterpolated(p.x, p.y, p.z, t, &uvw.x, &uvw.y, &uvw.z);
+			allValid = allValid && valid;
+			if (valid)
+			{
+				glm::vec3 d = glm::abs(uvw - field(p, t));
+				maxError = (std::max)(maxError, (std::max)(d.x, (std::max)(d.y, d.z)));
+			}
+		}
+
+		CHECK(allValid);
+		CHECK(maxError < 1e-5f);
+	}
+
+	remove(fileName.c_str());
+}
+
+// The interpolation error of a smooth field drops by four each time the cells are halved
+TEST(FlowGrid_InterpolationConvergesAtSecondOrder)
+{
+	auto field = [](glm::vec3 p) {
+		return glm::vec3(sin(3.f * p.x) * cos(2.f * p.y), cos(p.x) * exp(p.z), 0.5f * sin(p.x + 2.f * p.y + 3.f * p.z));
+	};
+
+	// the same points for every resolution, between the outermost cell centers of the coarsest grid
+	std::mt19937 rng(8u);
+	std::uniform_real_distribution<float> inside(0.5f / 16.f, 1.f - 0.5f / 16.f);
+	std::vector<glm::vec3> points(2000);
+	for (auto &p : points)
+		p = glm::vec3(inside(rng), inside(rng), inside(rng));
+
+	std::vector<float> maxErrors;
+	for (int n : { 16, 32, 64 })
+	{
+		std::string fileName = "FlowGridTest.raw";
+		writeGridFile(fileName, { n, n, n, 1 }, false, true, [&field, n](int x, int y, int z, int) {
+			CellRecord record;
+			record.isWater = true;
+			record.uvw = field((glm::vec3(x, y, z) + 0.5f) / static_cast<float>(n));
+			return record;
+		});
+
+		{
+			FlowGrid grid(fileName.c_str(), 0.f, 1.f, n, 0.f, 1.f, n, 0.f, 1.f, n);
+
+			float maxError = 0.f;
+			for (auto const &p : points)
+			{
+				glm::vec3 uvw(std::numeric_limits<float>::max());
+				grid.getUVWatInterpolated(p.x, p.y, p.z, 0.f, &uvw.x, &uvw.y, &uvw.z);
+				glm::vec3 d = glm::abs(uvw - field(p));
+				maxError = (std::max)(maxError, (std::max)(d.x, (std::max)(d.y, d.z)));
+			}
+			maxErrors.push_back(maxError);
+		}
+
+		remove(fileName.c_str());
+	}
+
+	for (size_t i = 1u; i < maxErrors.size(); ++i)
+	{
+		float order = log2(maxErrors[i - 1] / maxErrors[i]);
+		printf("    max error %g at %d cells, order %.2f\n", maxErrors[i], 16 << i, order);
+		CHECK(order > 1.8f && order < 2.2f);
+	}
+}
+
+namespace
+{
+	struct Samples {
+		std::vector<FlowGrid::TimeBracket> brackets;
+		std::vector<glm::vec3> uv, uvw, interpolated, batch;
+		std::vector<float> velocity;
+		std::vector<char> valid;	// bits: uv, uvw, velocity, interpolated, batch
+
+		bool operator==(Samples const &other) const
+		{
+			for (size_t i = 0u; i < brackets.size(); ++i)
+			{
+				FlowGrid::TimeBracket const &a = brackets[i], &b = other.brackets[i];
+				if (a.t1 != b.t1 || a.t2 != b.t2 || a.factor1 != b.factor1 || a.factor2 != b.factor2 || a.onTimestep != b.onTimestep)
+					return false;
+			}
+
+			return uv == other.uv && uvw == other.uvw && interpolated == other.interpolated && batch == other.batch && velocity == other.velocity && valid == other.valid;
+		}
+	};
+
+	// Samples every position with each of the const samplers, entries that failed stay zero
+	Samples sampleAll(FlowGrid const &grid, std::vector<glm::vec3> const &positions, std::vector<float> const &times)
+	{
+		size_t n = positions.size();
+
+		Samples s;
+		s.brackets.resize(n);
+		s.uv.assign(n, glm::vec3(0.f));
+		s.uvw.assign(n, glm::vec3(0.f));
+		s.interpolated.assign(n, glm::vec3(0.f));
+		s.batch.assign(n, glm::vec3(0.f));
+		s.velocity.assign(n, 0.f);
+		s.valid.assign(n, 0);
+
+		for (size_t i = 0u; i < n; ++i)
+		{
+			glm::vec3 const &p = positions[i];
+			s.brackets[i] = grid.getTimeBracket(times[i]);
+
+			char valid = 0;
+			valid |= grid.getUVat(p.x, p.y, p.z, times[i], &s.uv[i].x, &s.uv[i].y) ? 1 : 0;
+			valid |= grid.getUVWat(p.x, p.y, p.z, times[i], &s.uvw[i].x, &s.uvw[i].y, &s.uvw[i].z) ? 2 : 0;
+			valid |= grid.getVelocityAt(p.x, p.y, p.z, times[i], &s.velocity[i]) ? 4 : 0;
+			valid |= grid.getUVWatInterpolated(p.x, p.y, p.z, s.brackets[i], &s.interpolated[i].x, &s.interpolated[i].y, &s.interpolated[i].z) ? 8 : 0;
+			s.valid[i] = valid;
+		}
+
+		// the batch sampler over runs of positions sharing a time
+		std::unique_ptr<bool[]> batchValid(new bool[n]);
+		for (size_t begin = 0u; begin < n; begin += 100u)
+		{
+			size_t count = (std::min)(n - begin, static_cast<size_t>(100u));
+			grid.getUVWatInterpolated(&positions[begin], count, times[begin], &s.batch[begin], &batchValid[begin]);
+		}
+		for (size_t i = 0u; i < n; ++i)
+		{
+			if (batchValid[i])
+				s.valid[i] |= 16;
+			else
+				s.batch[i] = glm::vec3(0.f);
+		}
+
+		return s;
+	}
+
+	// Positions over and around the grid with times over and around its timesteps, the same time for each run of 100
+	void makeSamplePositions(GridShape const &shape, size_t count, unsigned int seed, std::vector<glm::vec3> &positions, std::vector<float> &times)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(-0.05f, 1.05f);
+
+		positions.resize(count);
+		times.resize(count);
+		for (size_t i = 0u; i < count; ++i)
+		{
+			positions[i] = glm::vec3(unit(rng), unit(rng), unit(rng)) * glm::vec3(shape.nx, shape.ny, shape.nz);
+			times[i] = i % 100u == 0u ? unit(rng) * (shape.nt - 1) : times[i - 1];
+		}
+	}
+}
+
+// Samplers called from many threads at once agree with the same calls made on one thread. Also run under
+// ThreadSanitizer, which reports any shared state they still write.
+TEST(FlowGrid_ConcurrentSamplingMatchesSingleThreaded)
+{
+	GridShape shape = { 37, 29, 11, 6 };
+	std::string fileName = "FlowGridTest.fg";
+	writeGridFile(fileName, shape, true, true, randomRecords(9u));
+
+	{
+		FlowGrid grid(fileName.c_str(), true);
+
+		const int nThreads = 16;
+		std::vector<std::vector<glm::vec3>> positions(nThreads);
+		std::vector<std::vector<float>> times(nThreads);
+		std::vector<Samples> expected(nThreads);
+		for (int i = 0; i < nThreads; ++i)
+		{
+			makeSamplePositions(shape, 5000u, 100u + i, positions[i], times[i]);
+			expected[i] = sampleAll(grid, positions[i], times[i]);
+		}
+
+		std::vector<std::future<bool>> futures;
+		for (int i = 0; i < nThreads; ++i)
+			futures.push_back(std::async(std::launch::async, [&grid, &positions, &times, &expected, i]() {
+				bool same = true;
+				for (int round = 0; round < 4; ++round)
+					same = same && sampleAll(grid, positions[i], times[i]) == expected[i];
+				return same;
+			}));
+
+		bool allSame = true;
+		for (auto &f : futures)
+			allSame = f.get() && allSame;
+
+		CHECK(allSame);
+
+		// some of each kind of sample succeeded
+		char anyValid = 0;
+		for (auto const &s : expected)
+			for (char v : s.valid)
+				anyValid |= v;
+		CHECK(anyValid == 31);
+	}
+
+	remove(fileName.c_str());
+}
+
+BENCHMARK(FlowGrid_ConcurrentSamplesPerSecond)
+{
+	GridShape shape = { 200, 200, 20, 4 };
+	std::string fileName = "FlowGridTest_Benchmark.fg";
+	writeGridFile(fileName, shape, true, true, [](int, int, int, int) {
+		CellRecord record;
+		record.isWater = true;
+		record.uvw = glm::vec3(0.1f, 0.2f, 0.3f);
+		return record;
+	});
+
+	{
+		FlowGrid grid(fileName.c_str(), true);
+
+		std::vector<glm::vec3> positions;
+		std::vector<float> times;
+		makeSamplePositions(shape, 1000000u, 10u, positions, times);
+
+		for (int nThreads : { 1, 16 })
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+
+			// each thread samples all positions, in batches and one at a time
+			std::vector<std::future<void>> futures;
+			for (int i = 0; i < nThreads; ++i)
+				futures.push_back(std::async(std::launch::async, [&grid, &positions, &times]() {
+					std::vector<glm::vec3> velocities(FLOWGRID_SAMPLE_BLOCK);
+					std::unique_ptr<bool[]> valid(new bool[FLOWGRID_SAMPLE_BLOCK]);
+					for (size_t begin = 0u; begin < positions.size(); begin += FLOWGRID_SAMPLE_BLOCK)
+					{
+						size_t count = (std::min)(positions.size() - begin, static_cast<size_t>(FLOWGRID_SAMPLE_BLOCK));
+						grid.getUVWatInterpolated(&positions[begin], count, grid.getTimeBracket(times[begin]), velocities.data(), valid.get());
+					}
+
+					glm::vec3 uvw;
+					for (size_t i = 0u; i < positions.size(); ++i)
+						grid.getUVWatInterpolated(positions[i].x, positions[i].y, positions[i].z, times[i], &uvw.x, &uvw.y, &uvw.z);
+				}));
+
+			for (auto &f : futures)
+				f.get();
+
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			printf("    %d threads: %.2fM samples/s\n", nThreads, 2. * nThreads * positions.size() / seconds * 1e-6);
+		}
+	}
+
+	remove(fileName.c_str());
+}
+
+// The cost of interpolating on one thread: the nearest cell lookups the interpolated samplers replace, the scalar
+// interpolated sampler with a time and with a precomputed time bracket, and the batch sampler
+BENCHMARK(FlowGrid_InterpolatedVsNearestSamplesPerSecond)
+{
+	GridShape shape = { 200, 200, 20, 4 };
+	std::string fileName = "FlowGridTest_Benchmark.fg";
+	writeGridFile(fileName, shape, true, true, randomRecords(11u));
+
+	{
+		FlowGrid grid(fileName.c_str(), true);
+
+		std::vector<glm::vec3> positions;
+		std::vector<float> times;
+		makeSamplePositions(shape, 4000000u, 12u, positions, times);
+
+		std::vector<glm::vec3> velocities(positions.size());
+		std::unique_ptr<bool[]> valid(new bool[positions.size()]);
+
+		auto measure = [&positions, &velocities, &valid](char const *name, double nearestRate, std::function<void()> sample) {
+			auto start = std::chrono::high_resolution_clock::now();
+			sample();
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			size_t nValid = 0u;
+			for (size_t i = 0u; i < positions.size(); ++i)
+				nValid += valid[i] ? 1u : 0u;
+
+			double rate = positions.size() / seconds;
+			printf("    %-30s %6.2fM samples/s (%4.2fx nearest), %.0f%% valid\n", name, rate * 1e-6, nearestRate > 0.0 ? rate / nearestRate : 1.0, 100.0 * nValid / positions.size());
+			return rate;
+		};
+
+		double nearest = measure("getUVWat (nearest)", 0.0, [&]() {
+			for (size_t i = 0u; i < positions.size(); ++i)
+				valid[i] = grid.getUVWat(positions[i].x, positions[i].y, positions[i].z, times[i], &velocities[i].x, &velocities[i].y, &velocities[i].z);
+		});
+
+		measure("getUVWatInterpolated", nearest, [&]() {
+			for (size_t i = 0u; i < positions.size(); ++i)
+				valid[i] = grid.getUVWatInterpolated(positions[i].x, positions[i].y, positions[i].z, times[i], &velocities[i].x, &velocities[i].y, &velocities[i].z);
+		});
+
+		measure("getUVWatInterpolated, bracket", nearest, [&]() {
+			FlowGrid::TimeBracket bracket = grid.getTimeBracket(times[0]);
+			for (size_t i = 0u; i < positions.size(); ++i)
+			{
+				if (i > 0u && times[i] != times[i - 1u])
+					bracket = grid.getTimeBracket(times[i]);
+				valid[i] = grid.getUVWatInterpolated(positions[i].x, positions[i].y, positions[i].z, bracket, &velocities[i].x, &velocities[i].y, &velocities[i].z);
+			}
+		});
+
+		// runs of 100 positions share a time
+		measure("getUVWatInterpolated, batch", nearest, [&]() {
+			for (size_t begin = 0u; begin < positions.size(); begin += 100u)
+			{
+				size_t count = (std::min)(positions.size() - begin, static_cast<size_t>(100u));
+				grid.getUVWatInterpolated(&positions[begin], count, times[begin], &velocities[begin], &valid[begin]);
+			}
+		});
+	}
+
+	remove(fileName.c_str());
+}
+
+namespace
+{
+	// The level scan getDepthLevel replaced
+	int scanDepthLevel(std::vector<float> const &levels, float depth)
+	{
+		int level = 0;
+		for (int i = 0; i < static_cast<int>(levels.size()); ++i)
+		{
+			if (depth >= levels[i])
+				level = i;
+		}
+		return level;
+	}
+
+	// Compares getDepthLevel with the scan at random depths around the levels, on the levels and halfway between them
+	void checkDepthLevels(std::vector<float> const &levels, unsigned int seed)
+	{
+		int nLevels = static_cast<int>(levels.size());
+		std::string fileName = "FlowGridTest.raw";
+		writeGridFile(fileName, { 1, 1, nLevels, 1 }, false, true, randomRecords(seed));
+
+		{
+			FlowGrid grid(fileName.c_str(), 0.f, 1.f, 1, 0.f, 1.f, 1, 0.f, 1.f, nLevels);
+			for (int i = 0; i < nLevels; ++i)
+				grid.setDepthValue(i, levels[i]);
+			grid.updateDepthLookup();
+
+			float lo = (std::min)(levels.front(), levels.back()), hi = (std::max)(levels.front(), levels.back());
+			float margin = 0.1f * (hi - lo) + 1.f;
+
+			std::vector<float> depths = { std::numeric_limits<float>::quiet_NaN(), lo - margin, hi + margin };
+			for (int i = 0; i < nLevels; ++i)
+			{
+				depths.push_back(levels[i]);
+				if (i > 0)
+					depths.push_back(0.5f * (levels[i - 1] + levels[i]));
+			}
+
+			std::mt19937 rng(seed);
+			std::uniform_real_distribution<float> around(lo - margin, hi + margin);
+			for (int i = 0; i < 100000; ++i)
+				depths.push_back(around(rng));
+
+			size_t nMismatches = 0u;
+			for (float depth : depths)
+				if (grid.getDepthLevel(depth) != scanDepthLevel(levels, depth))
+					nMismatches++;
+
+			CHECK(nMismatches == 0u);
+		}
+
+		remove(fileName.c_str());
+	}
+}
+
+TEST(FlowGrid_DepthLevelMatchesScan)
+{
+	std::vector<float> uniform, stretched, stronglyStretched;
+	for (int i = 0; i < 20; ++i)
+		uniform.push_back(5.f * i);
+	for (int i = 0; i < 100; ++i)
+		stretched.push_back(0.05f * i * i + i);
+	// too many buckets for the table, left to the binary search
+	for (int i = 0; i < 1000; ++i)
+		stronglyStretched.push_back(0.001f * i * i * i / 1000.f + 0.01f * i);
+
+	auto reversed = [](std::vector<float> levels) { std::reverse(levels.begin(), levels.end()); return levels; };
+	auto negated = [](std::vector<float> levels) { for (float &l : levels) l = -l; return levels; };
+
+	checkDepthLevels(uniform, 1u);
+	checkDepthLevels(stretched, 2u);
+	checkDepthLevels(stronglyStretched, 3u);
+	checkDepthLevels(negated(reversed(stretched)), 4u);
+
+	// decreasing levels, as in files storing z up
+	checkDepthLevels({ 0.f, -10.f, -20.f }, 5u);
+	checkDepthLevels(negated(uniform), 6u);
+	checkDepthLevels(reversed(stretched), 7u);
+
+	// repeated and single levels
+	checkDepthLevels({ 0.f, 1.f, 1.f, 2.f, 5.f }, 8u);
+	checkDepthLevels({ 3.f }, 9u);
+}
+
+TEST(FlowGrid_DepthLevelOfDecreasingLevels)
+{
+	std::string fileName = "FlowGridTest.raw";
+	writeGridFile(fileName, { 1, 1, 3, 1 }, false, true, randomRecords(11u));
+
+	{
+		FlowGrid grid(fileName.c_str(), 0.f, 1.f, 1, 0.f, 1.f, 1, 0.f, 1.f, 3);
+		grid.setDepthValue(0, 0.f);
+		grid.setDepthValue(1, -10.f);
+		grid.setDepthValue(2, -20.f);
+		grid.updateDepthLookup();
+
+		CHECK(grid.getDepthLevel(-15.f) == 2);
+		CHECK(grid.getDepthLevel(-20.f) == 2);
+		CHECK(grid.getDepthLevel(5.f) == 2);
+		CHECK(grid.getDepthLevel(-25.f) == 0);
+	}
+
+	remove(fileName.c_str());
+}
+
+// Depth lookups per second with 20, 100 and 1000 layers against the level scan they replaced. Uniform layers and
+// the 100 stretched ones fit the bucket table, the 1000 strongly stretched ones fall back to the binary search.
+BENCHMARK(FlowGrid_DepthLevelLookupsPerSecond)
+{
+	struct Layers {
+		char const *name;
+		std::vector<float> levels;
+	};
+
+	std::vector<Layers> layerSets(5u);
+	layerSets[0].name = "20 uniform";
+	layerSets[1].name = "100 stretched";
+	layerSets[2].name = "1000 uniform";
+	layerSets[3].name = "1000 stretched";
+	layerSets[4].name = "1000 strongly stretched";
+	for (int i = 0; i < 20; ++i)
+		layerSets[0].levels.push_back(5.f * i);
+	for (int i = 0; i < 100; ++i)
+		layerSets[1].levels.push_back(0.05f * i * i + i);
+	for (int i = 0; i < 1000; ++i)
+	{
+		layerSets[2].levels.push_back(0.5f * i);
+		layerSets[3].levels.push_back(0.0005f * i * i + 0.5f * i);
+		layerSets[4].levels.push_back(0.001f * i * i * i / 1000.f + 0.01f * i);
+	}
+
+	const size_t nLookups = 10000000u;
+
+	for (auto const &layers : layerSets)
+	{
+		int nLevels = static_cast<int>(layers.levels.size());
+		std::string fileName = "FlowGridTest.raw";
+		writeGridFile(fileName, { 1, 1, nLevels, 1 }, false, true, randomRecords(12u));
+
+		{
+			FlowGrid grid(fileName.c_str(), 0.f, 1.f, 1, 0.f, 1.f, 1, 0.f, 1.f, nLevels);
+			for (int i = 0; i < nLevels; ++i)
+				grid.setDepthValue(i, layers.levels[i]);
+			grid.updateDepthLookup();
+
+			std::mt19937 rng(13u);
+			std::uniform_real_distribution<float> around(layers.levels.front() - 1.f, layers.levels.back() + 1.f);
+			std::vector<float> depths(1u << 16);
+			for (float &d : depths)
+				d = around(rng);
+
+			// the scan is slow with many layers, so it gets fewer lookups
+			size_t nScans = nLookups / (1u + nLevels / 20u);
+
+			long long sum = 0, scannedSum = 0;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0u; i < nLookups; ++i)
+			{
+				sum += grid.getDepthLevel(depths[i & (depths.size() - 1u)]);
+				if (i + 1u == nScans)
+					scannedSum = sum;
+			}
+			double lookupSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			long long scanSum = 0;
+			start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0u; i < nScans; ++i)
+				scanSum += scanDepthLevel(layers.levels, depths[i & (depths.size() - 1u)]);
+			double scanSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			CHECK(scannedSum == scanSum);
+			printf("    %-24s %7.1fM lookups/s, scan %7.2fM lookups/s\n", layers.name, nLookups / lookupSeconds * 1e-6, nScans / scanSeconds * 1e-6);
+		}
+
+		remove(fileName.c_str());
+	}
+}
+
+// Looping playback through a streamed grid, with the reading thread given time to keep up, never waits for a
+// timestep, including when it wraps around from the last timestep to the first. The streamed samples match
+// those of the fully loaded grid.
+TEST(FlowGrid_StreamingLoopsWithoutStalls)
+{
+	// 10 timesteps in 4 slots, so the window wrapping around doesn't line up with the slots
+	GridShape shape = { 16, 12, 4, 10 };
+	std::string fileName = "FlowGridTest.fg";
+	writeGridFile(fileName, shape, true, true, randomRecords(12u));
+
+	{
+		FlowGrid loaded(fileName.c_str(), true);
+		FlowGrid streamed(fileName.c_str(), true, 2);
+		CHECK(streamed.isStreaming());
+
+		std::vector<glm::vec3> positions;
+		std::vector<float> times;
+		makeSamplePositions(shape, 500u, 13u, positions, times);
+
+		std::vector<glm::vec3> expected(positions.size()), velocities(positions.size());
+		std::unique_ptr<bool[]> expectedValid(new bool[positions.size()]), valid(new bool[positions.size()]);
+
+		bool allSame = true;
+		for (int lap = 0; lap < 3; ++lap)
+		{
+			for (float time = 0.f; time <= shape.nt - 1; time += 0.25f)
+			{
+				streamed.updateStream(time);
+
+				loaded.getUVWatInterpolated(positions.data(), positions.size(), time, expected.data(), expectedValid.get());
+				streamed.getUVWatInterpolated(positions.data(), positions.size(), time, velocities.data(), valid.get());
+				for (size_t i = 0u; i < positions.size(); ++i)
+					allSame = allSame && valid[i] == expectedValid[i] && (!valid[i] || velocities[i] == expected[i]);
+
+				// playback takes longer than reading a timestep this small
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+		}
+
+		CHECK(allSame);
+		CHECK(streamed.getStreamStalls() == 0);
+	}
+
+	remove(fileName.c_str());
+	remove((fileName + ".tsteps").c_str());
+}
+
+namespace
+{
+	// The per-particle RK4 step the particle system used before advectRK4
+	bool scalarRK4(FlowGrid const &grid, glm::vec3 startPos, float time, float step, glm::vec3 &newPos)
+	{
+		FlowGrid::TimeBracket bracket = grid.getTimeBracket(time);
+		glm::vec3 k1, k2, k3, k4, y1, y2, y3;
+
+		if (!grid.getUVWatInterpolated(startPos.x, startPos.y, startPos.z, bracket, &k1.x, &k1.y, &k1.z))
+			return false;
+		y1 = startPos + k1 * step * 0.5f;
+		if (!grid.getUVWatInterpolated(y1.x, y1.y, y1.z, bracket, &k2.x, &k2.y, &k2.z))
+			return false;
+		y2 = startPos + k2 * step * 0.5f;
+		if (!grid.getUVWatInterpolated(y2.x, y2.y, y2.z, bracket, &k3.x, &k3.y, &k3.z))
+			return false;
+		y3 = startPos + k3 * step;
+		if (!grid.getUVWatInterpolated(y3.x, y3.y, y3.z, bracket, &k4.x, &k4.y, &k4.z))
+			return false;
+
+		newPos = startPos + step * (k1 + 2.f * k2 + 2.f * k3 + k4) / 6.f;
+		return true;
+	}
+}
+
+// Samplers on other threads keep sampling all times, resident or not, while the window races through the timesteps
+// and the reading thread replaces slots. A sample either fails or matches the fully loaded grid, never a mix of the
+// old and new timestep of a slot. Also run under ThreadSanitizer, which reports a slot written while it is read.
+TEST(FlowGrid_StreamedSamplingDuringReplacement)
+{
+	GridShape shape = { 24, 20, 6, 12 };
+	std::string fileName = "FlowGridTest.fg";
+	writeGridFile(fileName, shape, true, true, randomRecords(14u));
+
+	{
+		FlowGrid loaded(fileName.c_str(), true);
+		FlowGrid streamed(fileName.c_str(), true, 1);
+
+		const int nThreads = 4;
+		std::atomic<bool> run(true);
+		std::vector<std::future<std::pair<size_t, size_t>>> futures;
+		for (int i = 0; i < nThreads; ++i)
+			futures.push_back(std::async(std::launch::async, [&loaded, &streamed, &run, &shape, i]() {
+				std::vector<glm::vec3> positions;
+				std::vector<float> times;
+				makeSamplePositions(shape, 400u, 200u + i, positions, times);
+
+				std::vector<glm::vec3> expected(positions.size()), velocities(positions.size());
+				std::unique_ptr<bool[]> expectedValid(new bool[positions.size()]), valid(new bool[positions.size()]);
+
+				size_t nMismatches = 0u, nValid = 0u;
+				for (size_t round = 0u; run; ++round)
+				{
+					float time = times[(round * 100u) % times.size()];
+					loaded.getUVWatInterpolated(positions.data(), positions.size(), time, expected.data(), expectedValid.get());
+					nValid += streamed.getUVWatInterpolated(positions.data(), positions.size(), time, velocities.data(), valid.get());
+					for (size_t j = 0u; j < positions.size(); ++j)
+						nMismatches += valid[j] && (!expectedValid[j] || velocities[j] != expected[j]) ? 1u : 0u;
+
+					glm::vec3 const &p = positions[round % positions.size()];
+					glm::vec3 uvw, expectedUVW;
+					if (streamed.getUVWat(p.x, p.y, p.z, time, &uvw.x, &uvw.y, &uvw.z))
+					{
+						bool ok = loaded.getUVWat(p.x, p.y, p.z, time, &expectedUVW.x, &expectedUVW.y, &expectedUVW.z);
+						nMismatches += !ok || uvw != expectedUVW ? 1u : 0u;
+					}
+				}
+
+				return std::make_pair(nMismatches, nValid);
+			}));
+
+		// playback far faster than the timesteps can be read, back and forth
+		for (int lap = 0; lap < 20; ++lap)
+			for (float time = 0.f; time <= shape.nt - 1; time += 0.5f)
+				streamed.updateStream(lap % 2 ? shape.nt - 1 - time : time);
+
+		run = false;
+		size_t nMismatches = 0u, nValid = 0u;
+		for (auto &f : futures)
+		{
+			std::pair<size_t, size_t> result = f.get();
+			nMismatches += result.first;
+			nValid += result.second;
+		}
+
+		CHECK(nMismatches == 0u);
+		CHECK(nValid > 0u);
+	}
+
+	remove(fileName.c_str());
+	remove((fileName + ".tsteps").c_str());
+}
+
+// Particles advected through a 1000-timestep grid streamed with lookaheads of 0 to 8 timesteps: resident memory
+// against loading every timestep, and stalls at playback speeds of one and four timesteps per 90Hz frame
+BENCHMARK(FlowGrid_StreamingThousandTimesteps)
+{
+	GridShape shape = { 48, 48, 8, 1000 };
+	std::string fileName = "FlowGridTest_Benchmark.fg";
+	writeGridFile(fileName, shape, true, true, [](int x, int y, int z, int t) {
+		CellRecord record;
+		record.isWater = true;
+		record.uvw = glm::vec3(sin(0.1f * y + 0.01f * t), cos(0.1f * x + 0.01f * t), 0.1f * sin(0.3f * z));
+		return record;
+	});
+
+	size_t nCells = static_cast<size_t>(shape.nx) * shape.ny * shape.nz * shape.nt;
+	size_t loadedBytes = nCells * sizeof(glm::vec4) + nCells / 8u;
+	printf("    all %d timesteps loaded: %.1f MB\n", shape.nt, loadedBytes / 1048576.0);
+
+	std::mt19937 rng(15u);
+	std::uniform_real_distribution<float> unit(0.f, 1.f);
+	std::vector<glm::vec3> particles(20000u);
+	for (auto &p : particles)
+		p = glm::vec3(unit(rng) * shape.nx, unit(rng) * shape.ny, unit(rng) * shape.nz);
+
+	for (int lookahead : { 0, 2, 8 })
+	{
+		FlowGrid grid(fileName.c_str(), true, lookahead);
+
+		for (float timestepsPerFrame : { 1.f, 4.f })
+		{
+			std::vector<glm::vec3> positions(particles), newPositions(particles.size());
+			std::unique_ptr<bool[]> valid(new bool[particles.size()]);
+			int stallsBefore = grid.getStreamStalls();
+
+			// 90 frames a second, each advecting every particle
+			auto start = std::chrono::high_resolution_clock::now();
+			double frameSeconds = 0.0;
+			int nFrames = 0;
+			size_t nValid = 0u;
+			for (float time = 0.f; time < shape.nt - 1; time += timestepsPerFrame, ++nFrames)
+			{
+				auto frameStart = std::chrono::high_resolution_clock::now();
+				grid.updateStream(time);
+				nValid += grid.advectRK4(positions.data(), positions.size(), time, 0.1f, newPositions.data(), valid.get());
+				for (size_t i = 0u; i < positions.size(); ++i)
+					if (valid[i])
+						positions[i] = newPositions[i];
+
+				std::chrono::duration<double> frame = std::chrono::high_resolution_clock::now() - frameStart;
+				frameSeconds += frame.count();
+				std::this_thread::sleep_for(std::chrono::duration<double>(1.0 / 90.0) - frame);
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			printf("    lookahead %d, %4.2f timesteps/frame: %.1f MB resident, %d stalls in %d frames, %.2f ms/frame advecting, %.1fs, %.0f%% valid\n",
+				lookahead, timestepsPerFrame, grid.getResidentBytes() / 1048576.0, grid.getStreamStalls() - stallsBefore, nFrames, frameSeconds * 1000.0 / nFrames, seconds,
+				100.0 * nValid / (static_cast<double>(nFrames) * particles.size()));
+		}
+	}
+
+	remove(fileName.c_str());
+	remove((fileName + ".tsteps").c_str());
+}
+
+// Quantized grids, loaded and streamed, give the same valid samples as the float grid, each off by at most half a
+// quantization step per component: interpolating weighs the rounded cells, whose errors are at most that, to one.
+TEST(FlowGrid_QuantizedSamplesMatchFloatSamples)
+{
+	GridShape shape = { 21, 17, 5, 8 };
+	std::string fileName = "FlowGridTest.fg";
+	writeGridFile(fileName, shape, true, true, randomRecords(16u));
+
+	{
+		FlowGrid full(fileName.c_str(), true);
+		FlowGrid loaded(fileName.c_str(), true, -1, true);
+		FlowGrid streamed(fileName.c_str(), true, 2, true);
+		CHECK(!full.isQuantized() && loaded.isQuantized() && streamed.isQuantized());
+		CHECK(streamed.isStreaming());
+		CHECK(loaded.getResidentBytes() < full.getResidentBytes() * 6u / 10u);
+
+		std::vector<glm::vec3> positions;
+		std::vector<float> times;
+		makeSamplePositions(shape, 2000u, 17u, positions, times);
+
+		std::vector<glm::vec3> expected(positions.size()), velocities(positions.size());
+		std::unique_ptr<bool[]> expectedValid(new bool[positions.size()]), valid(new bool[positions.size()]);
+
+		for (FlowGrid *grid : { &loaded, &streamed })
+		{
+			glm::vec3 maxError = glm::vec3(grid->m_vec4QuantizeScale) * 0.5f * 1.0001f + 1.e-6f;
+
+			size_t nValidMismatches = 0u, nOutOfBounds = 0u, nValid = 0u;
+			for (float time = 0.f; time <= shape.nt - 1; time += 0.25f)
+			{
+				grid->updateStream(time);
+
+				full.getUVWatInterpolated(positions.data(), positions.size(), time, expected.data(), expectedValid.get());
+				nValid += grid->getUVWatInterpolated(positions.data(), positions.size(), time, velocities.data(), valid.get());
+				for (size_t i = 0u; i < positions.size(); ++i)
+				{
+					nValidMismatches += valid[i] != expectedValid[i] ? 1u : 0u;
+					if (valid[i] && expectedValid[i] && glm::any(glm::greaterThan(glm::abs(velocities[i] - expected[i]), maxError)))
+						nOutOfBounds++;
+				}
+			}
+
+			CHECK(nValid > 0u);
+			CHECK(nValidMismatches == 0u);
+			CHECK(nOutOfBounds == 0u);
+		}
+	}
+
+	remove(fileName.c_str());
+	remove((fileName + ".tsteps").c_str());
+}
+
+// Memory and sampling throughput of a loaded grid with float and quantized cells, batch sampling and advecting
+BENCHMARK(FlowGrid_QuantizedMemoryAndThroughput)
+{
+	GridShape shape = { 96, 96, 20, 24 };
+	std::string fileName = "FlowGridTest_Benchmark.fg";
+	writeGridFile(fileName, shape, true, true, [](int x, int y, int z, int t) {
+		CellRecord record;
+		record.isWater = (x + y + z) % 13 != 0;
+		record.uvw = glm::vec3(sin(0.1f * y + 0.2f * t), cos(0.1f * x + 0.2f * t), 0.1f * sin(0.3f * z));
+		return record;
+	});
+
+	std::vector<glm::vec3> positions;
+	std::vector<float> times;
+	makeSamplePositions(shape, 1000000u, 18u, positions, times);
+
+	std::vector<glm::vec3> velocities(positions.size()), newPositions(positions.size());
+	std::unique_ptr<bool[]> valid(new bool[positions.size()]);
+
+	for (bool quantize : { false, true })
+	{
+		FlowGrid grid(fileName.c_str(), true, -1, quantize);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t nValid = 0u;
+		for (size_t i = 0u; i < positions.size(); i += 100u)
+			nValid += grid.getUVWatInterpolated(positions.data() + i, 100u, times[i], velocities.data() + i, valid.get() + i);
+		double sampleSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		start = std::chrono::high_resolution_clock::now();
+		for (size_t i = 0u; i < positions.size(); i += 100u)
+			grid.advectRK4(positions.data() + i, 100u, times[i], 0.1f, newPositions.data() + i, valid.get() + i);
+		double advectSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		printf("    %-9s %6.1f MB, %6.2fM samples/s, %6.2fM RK4 steps/s (%zu samples valid)\n", quantize ? "quantized" : "float",
+			grid.getResidentBytes() / 1048576.0, positions.size() / sampleSeconds * 1e-6, positions.size() / advectSeconds * 1e-6, nValid);
+	}
+
+	remove(fileName.c_str());
+}
+
+// Batches that aren't a whole number of FLOWGRID_RK4_BATCH, on a grid with land cells and steps long enough for
+// stages to leave it, so some positions in most batches fail
+TEST(FlowGrid_BatchedRK4MatchesScalarRK4)
+{
+	GridShape shape = { 23, 19, 7, 4 };
+	std::string fileName = "FlowGridTest.fg";
+	writeGridFile(fileName, shape, true, true, randomRecords(14u));
+
+	{
+		FlowGrid grid(fileName.c_str(), true);
+
+		std::vector<glm::vec3> positions;
+		std::vector<float> times;
+		makeSamplePositions(shape, 5003u, 15u, positions, times);
+
+		std::vector<glm::vec3> newPositions(positions.size());
+		std::unique_ptr<bool[]> valid(new bool[positions.size()]);
+
+		size_t nMismatches = 0u, nValid = 0u, nReturned = 0u;
+		float maxError = 0.f;
+		for (float step : { 0.05f, 0.5f, 2.f })
+		{
+			for (size_t begin = 0u; begin < positions.size(); begin += 100u)
+			{
+				size_t count = (std::min)(positions.size() - begin, static_cast<size_t>(100u));
+				nReturned += grid.advectRK4(&positions[begin], count, times[begin], step, &newPositions[begin], &valid[begin]);
+			}
+
+			for (size_t i = 0u; i < positions.size(); ++i)
+			{
+				glm::vec3 expected;
+				bool expectedValid = scalarRK4(grid, positions[i], times[i], step, expected);
+				if (valid[i] != expectedValid)
+					nMismatches++;
+				else if (valid[i])
+				{
+					glm::vec3 d = glm::abs(newPositions[i] - expected);
+					maxError = (std::max)(maxError, (std::max)(d.x, (std::max)(d.y, d.z)));
+					nValid++;
+				}
+			}
+		}
+
+		CHECK(nMismatches == 0u);
+		CHECK(nReturned == nValid);
+		CHECK(maxError <= 1e-5f);
+		CHECK(nValid > 0u && nValid < 3u * positions.size());
+	}
+
+	remove(fileName.c_str());
+}
+
+// The SSE sampler and RK4 steps against the scalar code, for float and quantized cells, on a grid with land cells
+// and positions inside and outside it
+TEST(FlowGrid_SIMDMatchesScalar)
+{
+	GridShape shape = { 23, 19, 7, 4 };
+	std::string fileName = "FlowGridTest.fg";
+	writeGridFile(fileName, shape, true, true, randomRecords(19u));
+
+	for (bool quantize : { false, true })
+	{
+		FlowGrid grid(fileName.c_str(), true, -1, quantize);
+
+		std::vector<glm::vec3> positions;
+		std::vector<float> times;
+		makeSamplePositions(shape, 5003u, 20u, positions, times);
+
+		std::vector<glm::vec3> simd(positions.size()), scalar(positions.size());
+		std::unique_ptr<bool[]> simdValid(new bool[positions.size()]), scalarValid(new bool[positions.size()]);
+
+		size_t nValid = 0u, nMismatches = 0u;
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			for (size_t i = 0u; i < positions.size(); i += 100u)
+			{
+				size_t n = (std::min)(positions.size() - i, size_t(100u));
+
+				grid.m_bUseSIMD = true;
+				if (pass == 0)
+					grid.getUVWatInterpolated(positions.data() + i, n, times[i], simd.data() + i, simdValid.get() + i);
+				else
+					grid.advectRK4(positions.data() + i, n, times[i], 0.7f, simd.data() + i, simdValid.get() + i);
+
+				grid.m_bUseSIMD = false;
+				if (pass == 0)
+					grid.getUVWatInterpolated(positions.data() + i, n, times[i], scalar.data() + i, scalarValid.get() + i);
+				else
+					grid.advectRK4(positions.data() + i, n, times[i], 0.7f, scalar.data() + i, scalarValid.get() + i);
+			}
+
+			for (size_t i = 0u; i < positions.size(); ++i)
+			{
+				nValid += scalarValid[i] ? 1u : 0u;
+				if (simdValid[i] != scalarValid[i] || (scalarValid[i] && glm::any(glm::greaterThan(glm::abs(simd[i] - scalar[i]), glm::vec3(1.e-6f) * (1.f + glm::abs(scalar[i]))))))
+					nMismatches++;
+			}
+		}
+
+		CHECK(nValid > positions.size() / 2u);
+		CHECK(nMismatches == 0u);
+	}
+
+	remove(fileName.c_str());
+}
+
+// Batch samples and RK4 steps per second with the SSE and the scalar code, for float and quantized cells
+BENCHMARK(FlowGrid_SIMDSpeedup)
+{
+	GridShape shape = { 96, 96, 20, 8 };
+	std::string fileName = "FlowGridTest_Benchmark.fg";
+	writeGridFile(fileName, shape, true, true, [](int x, int y, int z, int t) {
+		CellRecord record;
+		record.isWater = (x + y + z) % 13 != 0;
+		record.uvw = glm::vec3(sin(0.1f * y + 0.2f * t), cos(0.1f * x + 0.2f * t), 0.1f * sin(0.3f * z));
+		return record;
+	});
+
+	std::vector<glm::vec3> positions;
+	std::vector<float> times;
+	makeSamplePositions(shape, 1000000u, 21u, positions, times);
+
+	std::vector<glm::vec3> results(positions.size());
+	std::unique_ptr<bool[]> valid(new bool[positions.size()]);
+
+	for (bool quantize : { false, true })
+	{
+		FlowGrid grid(fileName.c_str(), true, -1, quantize);
+
+		double rates[2][2];
+		for (int simd = 0; simd < 2; ++simd)
+		{
+			grid.m_bUseSIMD = simd != 0;
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0u; i < positions.size(); i += 100u)
+				grid.getUVWatInterpolated(positions.data() + i, 100u, times[i], results.data() + i, valid.get() + i);
+			rates[simd][0] = positions.size() / std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			start = std::chrono::high_resolution_clock::now();
+			for (size_t i = 0u; i < positions.size(); i += 100u)
+				grid.advectRK4(positions.data() + i, 100u, times[i], 0.1f, results.data() + i, valid.get() + i);
+			rates[simd][1] = positions.size() / std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+
+		printf("    %-9s scalar %5.2fM samples/s, %5.2fM RK4 steps/s; SSE %5.2fM samples/s (%.2fx), %5.2fM RK4 steps/s (%.2fx)\n", quantize ? "quantized" : "float",
+			rates[0][0] * 1e-6, rates[0][1] * 1e-6, rates[1][0] * 1e-6, rates[1][0] / rates[0][0], rates[1][1] * 1e-6, rates[1][1] / rates[0][1]);
+	}
+
+	remove(fileName.c_str());
+}
@@ -0,0 +1,160 @@
+#include "Test.h"
+#include "../HighlightTimes.h"
+
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+namespace
+{
+	struct Upload {
+		unsigned int first, count;
+	};
+
+	// records the uploads and applies them to a mirror of the GPU buffer
+	struct FakeBuffer {
+		std::vector<float> data;
+		std::vector<Upload> uploads;
+
+		HighlightTimes::UploadFunction function()
+		{
+			return [this](unsigned int first, unsigned int count, float const *values) {
+				Upload u = { first, count };
+				uploads.push_back(u);
+				std::copy(values, values + count, data.begin() + first);
+			};
+		}
+	};
+
+	bool matches(HighlightTimes const &times, FakeBuffer const &buffer)
+	{
+		for (unsigned int slot = 0u; slot < times.size(); ++slot)
+			if (times.get(slot) != buffer.data[slot])
+				return false;
+
+		return true;
+	}
+}
+
+TEST(HighlightTimes_UploadsCoalescedRunsOfChangedSlots)
+{
+	HighlightTimes times;
+	times.resize(1000u);
+
+	FakeBuffer buffer;
+	buffer.data.assign(1000u, 0.f);
+
+	// the first upload after resizing covers every slot
+	CHECK(times.fullUploadNeeded());
+	CHECK(times.upload(buffer.function()) == 1000u * sizeof(float));
+	CHECK(buffer.uploads.size() == 1u && buffer.uploads[0].first == 0u && buffer.uploads[0].count == 1000u);
+	CHECK(!times.uploadNeeded());
+	CHECK(matches(times, buffer));
+
+	// changes arrive out of order and with repeats; adjacent slots merge into one run
+	buffer.uploads.clear();
+	unsigned int slots[] = { 12u, 10u, 11u, 500u, 11u, 999u, 13u, 0u };
+	for (unsigned int slot : slots)
+		times.set(slot, 2.5f);
+
+	CHECK(times.uploadNeeded() && !times.fullUploadNeeded());
+	CHECK(times.upload(buffer.function()) == 7u * sizeof(float));
+	CHECK(buffer.uploads.size() == 4u);
+	if (buffer.uploads.size() == 4u)
+	{
+		CHECK(buffer.uploads[0].first == 0u && buffer.uploads[0].count == 1u);
+		CHECK(buffer.uploads[1].first == 10u && buffer.uploads[1].count == 4u);
+		CHECK(buffer.uploads[2].first == 500u && buffer.uploads[2].count == 1u);
+		CHECK(buffer.uploads[3].first == 999u && buffer.uploads[3].count == 1u);
+	}
+	CHECK(matches(times, buffer));
+
+	// nothing changed, nothing uploaded
+	buffer.uploads.clear();
+	CHECK(!times.uploadNeeded());
+	CHECK(times.upload(buffer.function()) == 0u);
+	CHECK(buffer.uploads.empty());
+}
+
+TEST(HighlightTimes_ResetAndPermuteUploadEverything)
+{
+	HighlightTimes times;
+	times.resize(64u);
+	times.markUploaded();
+
+	FakeBuffer buffer;
+	buffer.data.assign(64u, -1.f);
+
+	for (unsigned int slot = 0u; slot < 64u; slot += 3u)
+		times.set(slot, static_cast<float>(slot));
+
+	// the LOD build reverses the slots: new slot i holds old slot 63 - i
+	std::vector<unsigned int> sources(64u);
+	for (unsigned int slot = 0u; slot < 64u; ++slot)
+		sources[slot] = 63u - slot;
+
+	times.permute(sources);
+	for (unsigned int slot = 0u; slot < 64u; ++slot)
+		CHECK(times.get(slot) == ((63u - slot) % 3u == 0u ? static_cast<float>(63u - slot) : -1.f));
+
+	CHECK(times.fullUploadNeeded());
+	CHECK(times.upload(buffer.function()) == 64u * sizeof(float));
+	CHECK(buffer.uploads.size() == 1u);
+	CHECK(matches(times, buffer));
+
+	// a change made while a full upload is pending must not be uploaded separately, nor lost
+	times.set(5u, 1.f);
+	times.resetAll();
+	times.set(7u, 3.f);
+	CHECK(times.fullUploadNeeded());
+
+	buffer.uploads.clear();
+	CHECK(times.upload(buffer.function()) == 64u * sizeof(float));
+	CHECK(buffer.uploads.size() == 1u);
+	CHECK(times.get(5u) == -1.f && times.get(7u) == 3.f);
+	CHECK(matches(times, buffer));
+}
+
+// A probe sweeping along a swath: every frame highlights the points newly entering the probe and unhighlights
+// those leaving it. Reports the bytes uploaded per frame against re-uploading the whole buffer.
+BENCHMARK(HighlightTimes_SweepUploadBytesPerFrame)
+{
+	const unsigned int nPoints = 10000000u;
+	const unsigned int nInProbe = 20000u;
+	const unsigned int nFrames = 900u;
+	const unsigned int pointsPerFrame = (nPoints - nInProbe) / nFrames;
+
+	HighlightTimes times;
+	times.resize(nPoints);
+	times.markUploaded();
+
+	// render slots are in LOD order, so points next to each other along the swath are scattered across the buffer
+	std::vector<unsigned int> slots(nPoints);
+	for (unsigned int i = 0u; i < nPoints; ++i)
+		slots[i] = i;
+	std::shuffle(slots.begin(), slots.end(), std::mt19937(1u));
+
+	size_t totalBytes = 0u, maxBytes = 0u, nRuns = 0u;
+	auto countRuns = [&nRuns](unsigned int, unsigned int, float const *) { nRuns++; };
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int frame = 0u; frame < nFrames; ++frame)
+	{
+		unsigned int enter = nInProbe + frame * pointsPerFrame;
+		unsigned int leave = frame * pointsPerFrame;
+
+		for (unsigned int i = 0u; i < pointsPerFrame; ++i)
+		{
+			times.set(slots[enter + i], frame / 90.f);
+			times.set(slots[leave + i], -1.f);
+		}
+
+		size_t bytes = times.upload(countRuns);
+		totalBytes += bytes;
+		maxBytes = (std::max)(maxBytes, bytes);
+	}
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("    %u points, %u entering and leaving per frame: %.1f KB/frame average (%.1f KB max, %.1f runs), full buffer %.1f KB; %.3f ms/frame bookkeeping\n",
+		nPoints, pointsPerFrame, totalBytes / 1024.0 / nFrames, maxBytes / 1024.0, static_cast<double>(nRuns) / nFrames, nPoints * sizeof(float) / 1024.0, ms / nFrames);
+}
@@ -0,0 +1,179 @@
+#include "Test.h"
+#include "../IllustrativeParticleAdvector.h"
+
+#include <random>
+#include <memory>
+#include <chrono>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	typedef std::chrono::time_point<std::chrono::high_resolution_clock> TimePoint;
+
+	// A flowgrid of nx x ny x nz cells of one unit, with depth levels 0 to nz - 1 and nt timesteps at times 0 to
+	// nt - 1, swirling around its center. Every seventh cell is land.
+	std::unique_ptr<FlowGrid> makeSwirl(int nx, int ny, int nz, int nt)
+	{
+		std::string fileName = "IllustrativeParticleAdvectorTest.fg";
+		FILE *file = fopen(fileName.c_str(), "wb");
+
+		float bounds[] = { 0.f, static_cast<float>(nx), 0.f, static_cast<float>(ny), 0.f, static_cast<float>(nz) };
+		fwrite(&bounds[0], sizeof(float), 2, file);
+		fwrite(&nx, sizeof(int), 1, file);
+		fwrite(&bounds[2], sizeof(float), 2, file);
+		fwrite(&ny, sizeof(int), 1, file);
+		fwrite(&bounds[4], sizeof(float), 2, file);
+		fwrite(&nz, sizeof(int), 1, file);
+		fwrite(&nt, sizeof(int), 1, file);
+		for (int z = 0; z < nz; ++z)
+		{
+			float depth = static_cast<float>(z);
+			fwrite(&depth, sizeof(float), 1, file);
+		}
+		for (int t = 0; t < nt; ++t)
+		{
+			float time = static_cast<float>(t);
+			fwrite(&time, sizeof(float), 1, file);
+		}
+
+		for (int x = 0; x < nx; ++x)
+			for (int y = 0; y < ny; ++y)
+				for (int z = 0; z < nz; ++z)
+					for (int t = 0; t < nt; ++t)
+					{
+						int isWater = (x * 3 + y * 5 + z) % 7 != 0 ? 1 : 0;
+						float uvw[3] = { -(y - 0.5f * ny) / ny * (1.f + 0.1f * t), (x - 0.5f * nx) / nx, 0.05f * sinf(0.5f * z) };
+						fwrite(&isWater, sizeof(int), 1, file);
+						fwrite(uvw, sizeof(float), 3, file);
+					}
+
+		fclose(file);
+
+		std::unique_ptr<FlowGrid> grid(new FlowGrid(fileName.c_str(), true));
+		remove(fileName.c_str());
+		return grid;
+	}
+
+	// count particles at random positions over the grid and a margin around it, living 0.5 to 1.5s
+	void seed(IllustrativeParticlePool &pool, FlowGrid const &grid, int count, TimePoint birth, unsigned int seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> unit(-0.1f, 1.1f);
+		std::uniform_int_distribution<int> lifetime(500, 1500);
+
+		glm::vec3 size(grid.m_fXMax, grid.m_fYMax, grid.m_vDepthValues.back());
+		for (int i = 0; i < count; ++i)
+		{
+			int particle = pool.allocate();
+			glm::vec3 pos = size * glm::vec3(unit(rng), unit(rng), unit(rng));
+			pool.init(particle, pos, glm::vec3(1.f), 0.f, std::chrono::milliseconds(lifetime(rng)), 300ms, birth, i % 3 != 0);
+		}
+	}
+
+	bool samePools(IllustrativeParticlePool &a, IllustrativeParticlePool &b)
+	{
+		a.sortLiveParticles();
+		b.sortLiveParticles();
+		if (a.getLiveParticles() != b.getLiveParticles())
+			return false;
+
+		for (int particle : a.getLiveParticles())
+		{
+			if (a.m_vucFlags[particle] != b.m_vucFlags[particle] || a.m_vpFlowGrids[particle] != b.m_vpFlowGrids[particle] ||
+				a.m_vvec3Positions[particle] != b.m_vvec3Positions[particle] || a.m_vvec3Velocities[particle] != b.m_vvec3Velocities[particle] ||
+				a.getNumLivePositions(particle) != b.getNumLivePositions(particle))
+				return false;
+
+			for (int i = 0; i < a.getNumLivePositions(particle); ++i)
+				if (a.getLivePosition(particle, i) != b.getLivePosition(particle, i))
+					return false;
+		}
+
+		return true;
+	}
+}
+
+// Advecting on 8 threads leaves the pool exactly as advecting on one, over many chunks and with particles dying,
+// leaving the grid and being respawned into released slots
+TEST(IllustrativeParticleAdvector_ResultDoesNotDependOnThreadCount)
+{
+	std::unique_ptr<FlowGrid> grid = makeSwirl(24, 20, 6, 3);
+	std::vector<FlowGrid*> grids(1, grid.get());
+
+	for (bool euler : { true, false })
+	{
+		const int capacity = 12 * PARTICLE_SYSTEM_ADVECTION_CHUNK_SIZE;
+		IllustrativeParticlePool single(capacity), multi(capacity);
+		IllustrativeParticleAdvector singleAdvector, multiAdvector;
+		singleAdvector.setThreads(1u);
+		multiAdvector.setThreads(8u);
+		if (euler)
+		{
+			singleAdvector.setEulerIntegration();
+			multiAdvector.setEulerIntegration();
+		}
+
+		TimePoint birth = std::chrono::high_resolution_clock::now();
+		seed(single, *grid, capacity - 1000, birth, 1u);
+		seed(multi, *grid, capacity - 1000, birth, 1u);
+
+		bool same = true;
+		int nStart = single.getNumLive(), nMin = nStart;
+		for (int step = 1; step <= 40; ++step)
+		{
+			TimePoint tick = birth + std::chrono::milliseconds(50 * step);
+			singleAdvector.advect(single, grids, 0.05f * step, 50ms, tick);
+			multiAdvector.advect(multi, grids, 0.05f * step, 50ms, tick);
+			same = same && samePools(single, multi);
+			nMin = (std::min)(nMin, single.getNumLive());
+
+			// top up the released slots, in the order the pools hand them out
+			if (step % 10 == 0)
+			{
+				seed(single, *grid, capacity - single.getNumLive(), tick, 2u + step);
+				seed(multi, *grid, capacity - multi.getNumLive(), tick, 2u + step);
+			}
+		}
+
+		CHECK(same);
+		CHECK(nMin < nStart * 9 / 10);
+		CHECK(single.getNumLive() == capacity);
+	}
+}
+
+// Particles advected per second by 1 to 16 threads, with Euler and RK4 integration
+BENCHMARK(IllustrativeParticleAdvector_ParticlesPerSecond)
+{
+	std::unique_ptr<FlowGrid> grid = makeSwirl(96, 96, 20, 10);
+	std::vector<FlowGrid*> grids(1, grid.get());
+	const int nParticles = 100000, nFrames = 20;
+
+	for (bool euler : { true, false })
+	{
+		for (unsigned int nThreads : { 1u, 2u, 4u, 8u, 16u })
+		{
+			IllustrativeParticlePool pool(nParticles);
+			IllustrativeParticleAdvector advector;
+			advector.setThreads(nThreads);
+			if (euler)
+				advector.setEulerIntegration();
+
+			TimePoint birth = std::chrono::high_resolution_clock::now();
+			seed(pool, *grid, nParticles, birth, 3u);
+			for (int particle : pool.getLiveParticles())
+				pool.m_vtpTimesToStartDying[particle] = birth + 1h;
+
+			size_t nAdvected = 0u;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 1; frame <= nFrames; ++frame)
+			{
+				nAdvected += pool.getNumLive();
+				advector.advect(pool, grids, 0.1f * frame, 11ms, birth + std::chrono::milliseconds(11 * frame));
+			}
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+			printf("    %-5s %2u threads: %6.2fM particles/s, %5.2f ms/frame\n", euler ? "Euler" : "RK4", nThreads, nAdvected / seconds * 1e-6, seconds * 1000.0 / nFrames);
+		}
+	}
+}
@@ -0,0 +1,399 @@
+#include "Test.h"
+#include "../IllustrativeParticlePool.h"
+
+#include <random>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+
+using namespace std::chrono_literals;
+
+namespace
+{
+	typedef std::chrono::time_point<std::chrono::high_resolution_clock> TimePoint;
+
+	int spawn(IllustrativeParticlePool &pool, TimePoint birth, std::chrono::milliseconds timeToLive, std::chrono::milliseconds trailTime, bool userCreated = true)
+	{
+		int particle = pool.allocate();
+		if (particle >= 0)
+			pool.init(particle, glm::vec3(0.f), glm::vec3(1.f), 0.f, timeToLive, trailTime, birth, userCreated);
+
+		return particle;
+	}
+}
+
+// A full ring drops its oldest position for each new one, so it keeps the last MAX_NUM_TRAIL_POSITIONS in order
+TEST(IllustrativeParticlePool_TrailRingWraps)
+{
+	IllustrativeParticlePool pool(4);
+	TimePoint birth = std::chrono::high_resolution_clock::now();
+	int particle = spawn(pool, birth, 1h, 1h);
+	CHECK(particle >= 0);
+	CHECK(pool.getNumLivePositions(particle) == 1);
+
+	const int nUpdates = 2 * MAX_NUM_TRAIL_POSITIONS + 50;
+	for (int k = 1; k <= nUpdates; ++k)
+	{
+		pool.updatePosition(particle, birth + std::chrono::milliseconds(k), glm::vec3(static_cast<float>(k), 0.f, 0.f));
+		CHECK(pool.getNumLivePositions(particle) == (std::min)(k + 1, MAX_NUM_TRAIL_POSITIONS));
+	}
+
+	bool inOrder = true;
+	for (int i = 0; i < MAX_NUM_TRAIL_POSITIONS; ++i)
+	{
+		float k = static_cast<float>(nUpdates - MAX_NUM_TRAIL_POSITIONS + 1 + i);
+		inOrder = inOrder && pool.getLivePosition(particle, i).x == k && pool.getLivePositionTime(particle, i) == k;
+	}
+	CHECK(inOrder);
+	CHECK(pool.m_vvec3Positions[particle].x == static_cast<float>(nUpdates));
+	CHECK(!pool.isDying(particle) && !pool.isDead(particle));
+}
+
+// Positions older than the trail time are dropped from the tail, the start position included
+TEST(IllustrativeParticlePool_TrailIsTrimmedToTrailTime)
+{
+	IllustrativeParticlePool pool(4);
+	TimePoint birth = std::chrono::high_resolution_clock::now();
+	int particle = spawn(pool, birth, 1h, 50ms);
+
+	for (int k = 10; k <= 200; k += 10)
+	{
+		pool.updatePosition(particle, birth + std::chrono::milliseconds(k), glm::vec3(static_cast<float>(k), 0.f, 0.f));
+
+		// positions exactly the trail time old stay
+		int expected = (std::min)(k, 50) / 10 + 1;
+		CHECK(pool.getNumLivePositions(particle) == expected);
+		CHECK(pool.getLivePositionTime(particle, 0) == static_cast<float>((std::max)(k - 50, 0)));
+		CHECK(pool.getLivePosition(particle, expected - 1).x == static_cast<float>(k));
+	}
+}
+
+// Past its time to live a particle stops moving and its trail fades out, then it is dead but stays allocated until
+// released, after which its slot is reused
+TEST(IllustrativeParticlePool_DyingParticlesDieWhenTheirTrailIsGone)
+{
+	IllustrativeParticlePool pool(4);
+	TimePoint birth = std::chrono::high_resolution_clock::now();
+	int particle = spawn(pool, birth, 100ms, 30ms);
+
+	for (int k = 10; k <= 90; k += 10)
+		pool.updatePosition(particle, birth + std::chrono::milliseconds(k), glm::vec3(static_cast<float>(k), 0.f, 0.f));
+	CHECK(!pool.isDying(particle));
+	CHECK(pool.getNumLivePositions(particle) == 4);
+
+	// dying: no new positions, the trail shrinks from 60-90ms down to 90ms
+	for (int k = 100; k <= 120; k += 10)
+	{
+		pool.updatePosition(particle, birth + std::chrono::milliseconds(k), glm::vec3(-1.f));
+		CHECK(pool.isDying(particle) && !pool.isDead(particle));
+		CHECK(pool.getNumLivePositions(particle) == (120 - k) / 10 + 1);
+		CHECK(pool.m_vvec3Positions[particle].x == 90.f);
+	}
+
+	pool.updatePosition(particle, birth + 130ms, glm::vec3(-1.f));
+	CHECK(pool.isDead(particle));
+	CHECK(pool.getNumLivePositions(particle) == 0);
+	CHECK(pool.getNumLive() == 1);
+
+	// dead particles ignore updates
+	pool.updatePosition(particle, birth + 140ms, glm::vec3(-1.f));
+	CHECK(pool.getNumLivePositions(particle) == 0);
+
+	pool.release(particle);
+	CHECK(pool.getNumLive() == 0);
+	CHECK(pool.allocate() == particle);
+}
+
+// After a pause the trail, the update times and the time to live carry on as if no time had passed
+TEST(IllustrativeParticlePool_ShiftTimesSkipsAPause)
+{
+	IllustrativeParticlePool pool(4);
+	TimePoint birth = std::chrono::high_resolution_clock::now();
+	int shifted = spawn(pool, birth, 100ms, 50ms);
+	int unshifted = spawn(pool, birth, 100ms, 50ms);
+
+	for (int k = 10; k <= 40; k += 10)
+		for (int particle : { shifted, unshifted })
+			pool.updatePosition(particle, birth + std::chrono::milliseconds(k), glm::vec3(static_cast<float>(k), 0.f, 0.f));
+
+	pool.shiftTimes(shifted, 1000ms);
+	for (int particle : { shifted, unshifted })
+		pool.updatePosition(particle, birth + 1050ms, glm::vec3(50.f, 0.f, 0.f));
+
+	CHECK(pool.getNumLivePositions(shifted) == 6);
+	CHECK(pool.getLivePositionTime(shifted, 0) == 0.f);
+	CHECK(pool.getLivePositionTime(shifted, 5) == 50.f);
+	CHECK(pool.m_vfLastUpdateTimes[shifted] == 50.f);
+	CHECK(!pool.isDying(shifted));
+
+	CHECK(pool.isDying(unshifted));
+	CHECK(pool.getNumLivePositions(unshifted) == 0);
+}
+
+namespace
+{
+	// A particle the way IllustrativeParticleSystem stored them before the pool: a heap object per particle with
+	// vectors for its trail positions and times, whose live positions were counted by walking the ring
+	struct ObjectParticle {
+		ObjectParticle()
+			: positions(MAX_NUM_TRAIL_POSITIONS)
+			, times(MAX_NUM_TRAIL_POSITIONS)
+			, tail(0)
+			, head(1)
+			, dying(false)
+			, dead(false)
+		{
+		}
+
+		void updatePosition(TimePoint currentTime, glm::vec3 const &newPos)
+		{
+			if (dead)
+				return;
+
+			if (currentTime >= timeToStartDying)
+				dying = true;
+
+			if (!dying)
+			{
+				positions[head] = newPos;
+				times[head] = currentTime;
+				head = (head + 1) % MAX_NUM_TRAIL_POSITIONS;
+			}
+
+			for (int i = tail; i != head; i = (i + 1) % MAX_NUM_TRAIL_POSITIONS)
+			{
+				if (std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - times[i]) > trailTime)
+					tail = (i + 1) % MAX_NUM_TRAIL_POSITIONS;
+				else
+					break;
+			}
+
+			if (dying && tail == head)
+				dead = true;
+		}
+
+		int getNumLivePositions() const
+		{
+			int n = 0;
+			for (int i = tail; i != head; i = (i + 1) % MAX_NUM_TRAIL_POSITIONS)
+				n++;
+
+			return n;
+		}
+
+		std::vector<glm::vec3> positions;
+		std::vector<TimePoint> times;
+		int tail, head;
+		bool dying, dead;
+		glm::vec3 color;
+		float gravity;
+		TimePoint birthTime, timeToStartDying;
+		std::chrono::milliseconds trailTime;
+		FlowGrid *flowGrid;
+	};
+}
+
+// Memory per particle and the time to update 100K particles and count their trail vertices for rendering, as
+// heap objects and in the pool
+BENCHMARK(IllustrativeParticlePool_HundredThousandParticleUpdates)
+{
+	const int nParticles = 100000, nFrames = 200;
+	TimePoint birth = std::chrono::high_resolution_clock::now();
+
+	std::mt19937 rng(1u);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	std::vector<glm::vec3> steps(nParticles);
+	for (auto &step : steps)
+		step = glm::vec3(unit(rng), unit(rng), unit(rng)) * 0.01f;
+
+	size_t objectBytes = sizeof(ObjectParticle*) + sizeof(ObjectParticle) + MAX_NUM_TRAIL_POSITIONS * (sizeof(glm::vec3) + sizeof(TimePoint));
+	std::vector<std::unique_ptr<ObjectParticle>> objects;
+	for (int i = 0; i < nParticles; ++i)
+	{
+		objects.emplace_back(new ObjectParticle());
+		objects.back()->times[0] = birth;
+		objects.back()->trailTime = 500ms;
+		objects.back()->timeToStartDying = birth + 1h;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	size_t objectVertices = 0u;
+	for (int frame = 1; frame <= nFrames; ++frame)
+	{
+		TimePoint now = birth + std::chrono::milliseconds(11 * frame);
+		for (int i = 0; i < nParticles; ++i)
+			objects[i]->updatePosition(now, static_cast<float>(frame) * steps[i]);
+		for (int i = 0; i < nParticles; ++i)
+			objectVertices += objects[i]->getNumLivePositions();
+	}
+	double objectSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	IllustrativeParticlePool pool(nParticles);
+	size_t poolBytes = sizeof(glm::vec3) * 3u + sizeof(float) * 3u + sizeof(FlowGrid*) + sizeof(unsigned char) + sizeof(TimePoint) * 2u + sizeof(std::chrono::milliseconds) +
+		MAX_NUM_TRAIL_POSITIONS * (sizeof(glm::vec3) + sizeof(float)) + sizeof(unsigned short) * 2u + sizeof(int) * 5u;
+	for (int i = 0; i < nParticles; ++i)
+		spawn(pool, birth, 1h, 500ms);
+
+	start = std::chrono::high_resolution_clock::now();
+	size_t poolVertices = 0u;
+	for (int frame = 1; frame <= nFrames; ++frame)
+	{
+		TimePoint now = birth + std::chrono::milliseconds(11 * frame);
+		for (int particle : pool.getLiveParticles())
+			pool.updatePosition(particle, now, static_cast<float>(frame) * steps[particle]);
+		for (int particle : pool.getLiveParticles())
+			poolVertices += pool.getNumLivePositions(particle);
+	}
+	double poolSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	CHECK(objectVertices == poolVertices);
+	printf("    heap objects: %5zu bytes/particle, %6.2f ms/frame\n", objectBytes, objectSeconds * 1000.0 / nFrames);
+	printf("    pool:         %5zu bytes/particle, %6.2f ms/frame\n", poolBytes, poolSeconds * 1000.0 / nFrames);
+}
+
+// Random allocations, releases, inits and sorts checked against a set of the live slots after every operation:
+// the live and seed lists hold each live slot once, allocate fails only when the pool is full and never hands out
+// a live slot, and sorting orders the live list by slot
+TEST(IllustrativeParticlePool_RandomOperationsKeepTheListsConsistent)
+{
+	const int capacity = 300;
+	IllustrativeParticlePool pool(capacity);
+	TimePoint birth = std::chrono::high_resolution_clock::now();
+
+	std::vector<bool> live(capacity, false), seed(capacity, false);
+	std::mt19937 rng(5u);
+
+	size_t nFailures = 0u;
+	auto checkLists = [&]() {
+		std::vector<int> liveCount(capacity, 0), seedCount(capacity, 0);
+		for (int particle : pool.getLiveParticles())
+			liveCount[particle]++;
+		for (int particle : pool.getLiveSeeds())
+			seedCount[particle]++;
+
+		for (int i = 0; i < capacity; ++i)
+			if (liveCount[i] != (live[i] ? 1 : 0) || seedCount[i] != (seed[i] ? 1 : 0))
+				nFailures++;
+	};
+
+	for (int op = 0; op < 100000; ++op)
+	{
+		int nLive = pool.getNumLive();
+		int r = static_cast<int>(rng() % 100u);
+
+		// allocations and releases come in phases, so the pool fills up and empties out now and then
+		bool filling = (op / 5000) % 2 == 0;
+		if (r < (filling ? 50 : 25))
+		{
+			int particle = pool.allocate();
+			if ((particle < 0) != (nLive == capacity) || (particle >= 0 && live[particle]))
+				nFailures++;
+
+			if (particle >= 0)
+				live[particle] = true;
+		}
+		else if (r < 75 && nLive > 0)
+		{
+			int particle = pool.getLiveParticles()[rng() % nLive];
+			pool.release(particle);
+			live[particle] = seed[particle] = false;
+
+			// releasing again does nothing
+			pool.release(particle);
+		}
+		else if (r < 95 && nLive > 0)
+		{
+			int particle = pool.getLiveParticles()[rng() % nLive];
+			bool userCreated = rng() % 2u == 0u;
+			pool.init(particle, glm::vec3(0.f), glm::vec3(1.f), 0.f, 1s, 100ms, birth, userCreated);
+			seed[particle] = !userCreated;
+		}
+		else
+		{
+			pool.sortLiveParticles();
+			if (!std::is_sorted(pool.getLiveParticles().begin(), pool.getLiveParticles().end()))
+				nFailures++;
+		}
+
+		checkLists();
+		if (pool.getNumLive() != static_cast<int>(std::count(live.begin(), live.end(), true)) || pool.getNumLiveSeeds() != static_cast<int>(std::count(seed.begin(), seed.end(), true)))
+			nFailures++;
+	}
+
+	CHECK(nFailures == 0u);
+}
+
+// Per-tick cost of walking the particles and recycling a hundredth of them at 1%, 10% and 100% of MAX_PARTICLES
+// live, through the pool's lists and by scanning every slot for the dead and live ones as before
+BENCHMARK(IllustrativeParticlePool_TickOverhead)
+{
+	const int capacity = 100000, nTicks = 200;
+	TimePoint birth = std::chrono::high_resolution_clock::now();
+
+	for (int percent : { 1, 10, 100 })
+	{
+		int nLive = capacity / 100 * percent;
+		int nRecycled = (std::max)(nLive / 100, 1);
+
+		IllustrativeParticlePool pool(capacity);
+		for (int i = 0; i < nLive; ++i)
+			spawn(pool, birth, 1h, 1h);
+
+		std::mt19937 rng(6u);
+
+		// the free list and live lists: visit the live particles, release some and take new ones
+		auto start = std::chrono::high_resolution_clock::now();
+		size_t listSum = 0u;
+		for (int tick = 0; tick < nTicks; ++tick)
+		{
+			pool.sortLiveParticles();
+			for (int particle : pool.getLiveParticles())
+				listSum += pool.isDead(particle) ? 0u : 1u;
+
+			for (int i = 0; i < nRecycled; ++i)
+				pool.release(pool.getLiveParticles()[rng() % pool.getNumLive()]);
+			for (int i = 0; i < nRecycled; ++i)
+				spawn(pool, birth, 1h, 1h);
+		}
+		double listSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		// scanning: build the dead and live lists from every slot, and search the dead ones for free slots
+		std::vector<unsigned char> dead(capacity, 1u);
+		for (int i = 0; i < nLive; ++i)
+			dead[i] = 0u;
+
+		start = std::chrono::high_resolution_clock::now();
+		size_t scanSum = 0u;
+		std::vector<int> deadParticles, liveParticles;
+		for (int tick = 0; tick < nTicks; ++tick)
+		{
+			deadParticles.clear();
+			liveParticles.clear();
+			for (int i = 0; i < capacity; ++i)
+				(dead[i] ? deadParticles : liveParticles).push_back(i);
+
+			for (int particle : liveParticles)
+				scanSum += dead[particle] ? 0u : 1u;
+
+			for (int i = 0; i < nRecycled; ++i)
+			{
+				size_t j = rng() % liveParticles.size();
+				dead[liveParticles[j]] = 1u;
+				liveParticles[j] = liveParticles.back();
+				liveParticles.pop_back();
+			}
+			for (int i = 0; i < nRecycled; ++i)
+			{
+				int free = 0;
+				while (free < capacity && !dead[free])
+					free++;
+				if (free < capacity)
+					dead[free] = 0u;
+			}
+		}
+		double scanSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		CHECK(listSum == scanSum);
+		printf("    %3d%% live (%6d particles): lists %8.1f us/tick, scanning %8.1f us/tick\n", percent, nLive, listSeconds * 1.e6 / nTicks, scanSeconds * 1.e6 / nTicks);
+	}
+}
@@ -0,0 +1,231 @@
+#include "Test.h"
+#include "../LASFile.h"
+
+#include <random>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <limits>
+
+// Needs the LASzip DLL next to the test executable
+
+namespace
+{
+	// survey-like points: a few km wide tile in projected coordinates, 20-60m deep
+	std::vector<LASFile::Point> makePoints(unsigned int count)
+	{
+		std::mt19937 rng(11u);
+		std::uniform_real_distribution<double> xy(0.0, 2000.0);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+
+		std::vector<LASFile::Point> points(count);
+		for (auto &p : points)
+		{
+			p.position = glm::dvec3(683000.0 + xy(rng), 4760000.0 + xy(rng), -20.0 - 0.02 * xy(rng));
+			p.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+			p.depthTPU = 0.5f * unit(rng);
+			p.positionTPU = 2.f * unit(rng);
+		}
+
+		return points;
+	}
+
+	bool writePoints(std::string fileName, std::vector<LASFile::Point> const &points, bool withColors, bool withTPU, unsigned int nThreads)
+	{
+		glm::dvec3 bbMin(std::numeric_limits<double>::max());
+		glm::dvec3 bbMax(-std::numeric_limits<double>::max());
+		for (auto const &p : points)
+		{
+			bbMin = glm::min(bbMin, p.position);
+			bbMax = glm::max(bbMax, p.position);
+		}
+
+		return LASFile::write(fileName, static_cast<unsigned int>(points.size()), bbMin, bbMax, withColors, withTPU, [&points](unsigned int index, LASFile::Point &p) { p = points[index]; }, nThreads);
+	}
+
+	std::vector<LASFile::Point> readPoints(std::string fileName, bool &success, bool *hasTPU = NULL)
+	{
+		std::vector<LASFile::Point> points;
+		success = LASFile::read(fileName, [&points, hasTPU](long long count, bool tpu) {
+			points.resize(static_cast<size_t>(count));
+			if (hasTPU)
+				*hasTPU = tpu;
+		}, [&points](long long index, LASFile::Point const &p) { points[static_cast<size_t>(index)] = p; });
+		return points;
+	}
+
+	void checkRoundTrip(std::string fileName, bool withColors, unsigned int nThreads)
+	{
+		// several of LASzip's chunks and a short last one
+		std::vector<LASFile::Point> points = makePoints(4u * 50000u + 1234u);
+
+		CHECK(writePoints(fileName, points, withColors, true, nThreads));
+
+		bool success, hasTPU = false;
+		std::vector<LASFile::Point> read = readPoints(fileName, success, &hasTPU);
+		remove(fileName.c_str());
+
+		CHECK(success);
+		CHECK(hasTPU);
+		CHECK(read.size() == points.size());
+		if (read.size() != points.size())
+			return;
+
+		// 0.1mm scale for a tile this size
+		double maxPositionError = 0.0, maxColorError = 0.0;
+		bool tpuExact = true;
+		for (size_t i = 0u; i < points.size(); ++i)
+		{
+			glm::dvec3 d = glm::abs(read[i].position - points[i].position);
+			maxPositionError = std::max(maxPositionError, std::max(d.x, std::max(d.y, d.z)));
+			if (withColors)
+			{
+				glm::vec3 c = glm::abs(read[i].color - points[i].color);
+				maxColorError = std::max(maxColorError, static_cast<double>(std::max(c.r, std::max(c.g, c.b))));
+			}
+			tpuExact = tpuExact && read[i].depthTPU == points[i].depthTPU && read[i].positionTPU == points[i].positionTPU;
+		}
+
+		CHECK(maxPositionError <= 0.00005 + 1e-9);
+		CHECK(maxColorError <= 0.5 / 65535.0 + 1e-6);
+		CHECK(tpuExact);
+	}
+}
+
+// Writes points fetched on several threads and reads them back through the reader loadLIDAR uses
+TEST(LASFile_LAZRoundTrip)
+{
+	checkRoundTrip("LASFile_LAZRoundTrip.laz", true, 4u);
+	checkRoundTrip("LASFile_LAZRoundTripNoColors.laz", false, 3u);
+}
+
+TEST(LASFile_LASRoundTrip)
+{
+	checkRoundTrip("LASFile_LASRoundTrip.las", true, 4u);
+}
+
+TEST(LASFile_EmptyRoundTrip)
+{
+	CHECK(LASFile::write("LASFile_Empty.laz", 0u, glm::dvec3(0.0), glm::dvec3(1.0), true, true, [](unsigned int, LASFile::Point &) {}, 4u));
+
+	bool success;
+	std::vector<LASFile::Point> read = readPoints("LASFile_Empty.laz", success);
+	remove("LASFile_Empty.laz");
+
+	CHECK(success);
+	CHECK(read.empty());
+}
+
+// Exports clouds the way SonarPointCloud::exportLAS does and loads them back the way loadLIDAR does: depths flip to
+// heights and back, deleted points are dropped, and a cloud keeps its TPUs or its colors, whichever it was loaded with
+TEST(LASFile_ExportedCloudLoadsBack)
+{
+	std::vector<LASFile::Point> source = makePoints(123457u);
+
+	std::vector<glm::dvec3> positions(source.size());
+	std::vector<glm::vec3> colors(source.size());
+	std::vector<float> depthTPU(source.size()), positionTPU(source.size());
+	std::vector<unsigned int> marks(source.size(), 0u);
+	std::mt19937 rng(12u);
+	for (size_t i = 0u; i < source.size(); ++i)
+	{
+		positions[i] = glm::dvec3(source[i].position.x, source[i].position.y, -source[i].position.z);
+		colors[i] = source[i].color;
+		depthTPU[i] = source[i].depthTPU;
+		positionTPU[i] = source[i].positionTPU;
+		marks[i] = rng() % 5u == 0u ? 1u : (rng() % 2u == 0u ? 2u : 0u);
+	}
+
+	// the deepest point is deleted, so no loaded point reaches its depth
+	size_t deepest = std::max_element(positions.begin(), positions.end(), [](glm::dvec3 const &a, glm::dvec3 const &b) { return a.z < b.z; }) - positions.begin();
+	marks[deepest] = 1u;
+
+	std::vector<unsigned int> kept;
+	for (unsigned int i = 0u; i < source.size(); ++i)
+		if (marks[i] != 1u)
+			kept.push_back(i);
+
+	for (bool fileColors : { false, true })
+	{
+		const char *fileName = "LASFile_ExportedCloud.laz";
+
+		LASFile::Cloud cloud;
+		cloud.count = static_cast<unsigned int>(positions.size());
+		cloud.positions = positions.data();
+		cloud.colors = fileColors ? colors.data() : NULL;
+		cloud.depthTPU = fileColors ? NULL : depthTPU.data();
+		cloud.positionTPU = fileColors ? NULL : positionTPU.data();
+		cloud.marks = marks.data();
+
+		unsigned int nWritten = 0u;
+		CHECK(LASFile::writeCloud(fileName, cloud, 4u, &nWritten));
+		CHECK(nWritten == kept.size());
+
+		// loadLIDAR: files with TPUs load like sonar data, other files keep their colors
+		bool hasTPU = !fileColors;
+		std::vector<glm::dvec3> loadedPositions;
+		std::vector<glm::vec3> loadedColors;
+		std::vector<float> loadedDepthTPU, loadedPositionTPU;
+		bool success = LASFile::read(fileName, [&](long long count, bool tpu) {
+			hasTPU = tpu;
+			loadedPositions.resize(static_cast<size_t>(count));
+			loadedColors.resize(static_cast<size_t>(count));
+			loadedDepthTPU.resize(static_cast<size_t>(count));
+			loadedPositionTPU.resize(static_cast<size_t>(count));
+		}, [&](long long index, LASFile::Point const &p) {
+			loadedPositions[index] = glm::dvec3(p.position.x, p.position.y, -p.position.z);
+			loadedColors[index] = p.color;
+			loadedDepthTPU[index] = p.depthTPU;
+			loadedPositionTPU[index] = p.positionTPU;
+		});
+		remove(fileName);
+
+		CHECK(success);
+		CHECK(hasTPU == !fileColors);
+		CHECK(loadedPositions.size() == kept.size());
+		if (loadedPositions.size() != kept.size())
+			continue;
+
+		double maxPositionError = 0.0, maxColorError = 0.0;
+		bool tpuExact = true, deepestDropped = true;
+		for (size_t i = 0u; i < kept.size(); ++i)
+		{
+			deepestDropped = deepestDropped && loadedPositions[i].z < positions[deepest].z;
+			glm::dvec3 d = glm::abs(loadedPositions[i] - positions[kept[i]]);
+			maxPositionError = std::max(maxPositionError, std::max(d.x, std::max(d.y, d.z)));
+			if (fileColors)
+			{
+				glm::vec3 c = glm::abs(loadedColors[i] - colors[kept[i]]);
+				maxColorError = std::max(maxColorError, static_cast<double>(std::max(c.r, std::max(c.g, c.b))));
+			}
+			else
+				tpuExact = tpuExact && loadedDepthTPU[i] == depthTPU[kept[i]] && loadedPositionTPU[i] == positionTPU[kept[i]];
+		}
+
+		// within half the 0.1mm scale chosen for these bounds
+		CHECK(maxPositionError <= 0.00005 + 1e-9);
+		CHECK(maxColorError <= 0.5 / 65535.0 + 1e-6);
+		CHECK(tpuExact);
+		CHECK(deepestDropped);
+	}
+}
+
+BENCHMARK(LASFile_ExportPointsPerSecond)
+{
+	std::vector<LASFile::Point> points = makePoints(4000000u);
+	unsigned int nHardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	for (const char *fileName : { "LASFile_Benchmark.las", "LASFile_Benchmark.laz" })
+	{
+		for (unsigned int nThreads : { 1u, nHardwareThreads })
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			bool success = writePoints(fileName, points, true, true, nThreads);
+			double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+			remove(fileName);
+
+			CHECK(success);
+			printf("    %s on %u threads: %.2fs, %.2fM points/s\n", fileName, nThreads, seconds, points.size() / seconds * 1e-6);
+		}
+	}
+}
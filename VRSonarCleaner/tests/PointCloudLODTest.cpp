@@ -0,0 +1,421 @@
+#include "Test.h"
+#include "../PointCloudLOD.h"
+#include "../PointCloudSubsampler.h"
+
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <gtc/matrix_transform.hpp>
+
+// Sonar-like swath: a gently sloping, rippled seabed with some noise
+static std::vector<glm::vec3> makeSwath(size_t count, unsigned int seed = 1u)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> u(0.f, 1.f);
+	std::normal_distribution<float> noise(0.f, 0.05f);
+
+	std::vector<glm::vec3> points(count);
+	for (auto &p : points)
+	{
+		p.x = 200.f * u(rng);
+		p.y = 100.f * u(rng);
+		p.z = -20.f - 0.05f * p.x + 0.5f * sinf(p.y * 0.3f) + noise(rng);
+	}
+
+	return points;
+}
+
+static glm::mat4 getProjection()
+{
+	return glm::perspective(glm::radians(60.f), 1.5f, 0.1f, 1000.f);
+}
+
+static unsigned int countPoints(PointCloudLOD &lod, std::vector<unsigned int> const &nodes)
+{
+	unsigned int n = 0u;
+	for (auto node : nodes)
+		n += lod.getNodes()[node].count;
+	return n;
+}
+
+TEST(PointCloudLOD_BuildLaysOutEveryPointOnce)
+{
+	std::vector<glm::vec3> points = makeSwath(200000u);
+
+	PointCloudLOD lod;
+	lod.build(points);
+	CHECK(lod.isBuilt());
+
+	auto const &nodes = lod.getNodes();
+	auto const &order = lod.getPointOrder();
+	CHECK(order.size() == points.size());
+
+	std::vector<bool> seen(points.size(), false);
+	bool permutation = true;
+	for (auto i : order)
+	{
+		if (i >= points.size() || seen[i])
+			permutation = false;
+		else
+			seen[i] = true;
+	}
+	CHECK(permutation);
+
+	// nodes are consecutive ranges of the point order, each point lies in its node, children halve the spacing
+	unsigned int next = 0u;
+	bool contiguous = true, contained = true, halved = true;
+	for (auto const &node : nodes)
+	{
+		contiguous = contiguous && node.first == next;
+		next = node.first + node.count;
+
+		for (unsigned int slot = node.first; slot < node.first + node.count; ++slot)
+		{
+			glm::vec3 const &p = points[order[slot]];
+			contained = contained && glm::all(glm::greaterThanEqual(p, node.bbMin)) && glm::all(glm::lessThanEqual(p, node.bbMax));
+		}
+
+		for (int child : node.children)
+			if (child >= 0)
+				halved = halved && fabs(nodes[child].spacing - node.spacing * 0.5f) <= node.spacing * 1e-4f;
+	}
+	CHECK(contiguous);
+	CHECK(next == points.size());
+	CHECK(contained);
+	CHECK(halved);
+}
+
+TEST(PointCloudLOD_SelectRespectsPointBudget)
+{
+	std::vector<glm::vec3> points = makeSwath(300000u);
+
+	PointCloudLOD lod;
+	lod.build(points);
+
+	glm::mat4 view = glm::lookAt(glm::vec3(100.f, -60.f, 40.f), glm::vec3(100.f, 50.f, -25.f), glm::vec3(0.f, 0.f, 1.f));
+
+	std::vector<unsigned int> selection;
+	unsigned int previous = 0u;
+
+	for (unsigned int budget : { 40000u, 60000u, 100000u, 150000u, 250000u, 1000000u })
+	{
+		unsigned int n = lod.select(view, getProjection(), 1080.f, 0.f, budget, selection);
+
+		CHECK(n > 0u);
+		CHECK(n <= budget);
+		CHECK(n == countPoints(lod, selection));
+		CHECK(n >= previous);
+		previous = n;
+
+		// a node is only selected along with its parent
+		std::vector<bool> selected(lod.getNodes().size(), false);
+		for (auto node : selection)
+			selected[node] = true;
+
+		bool closed = true;
+		for (size_t node = 0u; node < lod.getNodes().size(); ++node)
+			for (int child : lod.getNodes()[node].children)
+				if (child >= 0 && selected[child] && !selected[node])
+					closed = false;
+		CHECK(closed);
+	}
+}
+
+TEST(PointCloudLOD_SelectAlwaysTakesTheRoot)
+{
+	std::vector<glm::vec3> points = makeSwath(300000u);
+
+	PointCloudLOD lod;
+	lod.build(points);
+
+	glm::mat4 view = glm::lookAt(glm::vec3(100.f, -60.f, 40.f), glm::vec3(100.f, 50.f, -25.f), glm::vec3(0.f, 0.f, 1.f));
+	std::vector<unsigned int> selection;
+
+	// a budget smaller than the root still draws the root, and nothing else
+	unsigned int n = lod.select(view, getProjection(), 1080.f, 0.f, lod.getNodes()[0].count / 2u, selection);
+	CHECK(selection.size() == 1u && selection[0] == 0u);
+	CHECK(n == lod.getNodes()[0].count);
+}
+
+TEST(PointCloudLOD_PreviewMakesUpTheCoarseLevels)
+{
+	std::vector<glm::vec3> points = makeSwath(500000u);
+
+	glm::vec3 bbMin(0.f, 0.f, -31.f), bbMax(200.f, 100.f, -19.f);
+	float previewSpacing = PointCloudSubsampler::estimateVoxelSize(bbMin, bbMax, static_cast<unsigned int>(points.size() / 10u));
+	std::vector<unsigned int> preview = PointCloudSubsampler::voxelGrid(points, previewSpacing, 4u);
+
+	PointCloudLOD lod;
+	lod.build(points, &preview, previewSpacing);
+
+	auto const &nodes = lod.getNodes();
+	auto const &order = lod.getPointOrder();
+	CHECK(order.size() == points.size());
+
+	// the preview is a prefix of the point order that holds every preview point
+	std::vector<bool> inPreview(points.size(), false);
+	for (auto i : preview)
+		inPreview[i] = true;
+
+	unsigned int nPreview = lod.getPreviewPointCount();
+	size_t nPreviewInPrefix = 0u;
+	for (unsigned int slot = 0u; slot < nPreview; ++slot)
+		if (inPreview[order[slot]])
+			nPreviewInPrefix++;
+	CHECK(nPreview == preview.size());
+	CHECK(nPreviewInPrefix == preview.size());
+
+	// the root is a coarse level, not the whole preview
+	CHECK(nodes[0].count < preview.size() / 10u);
+	CHECK(nodes[0].spacing > previewSpacing);
+
+	// point spacing never grows from a node to its children
+	bool finer = true;
+	for (auto const &node : nodes)
+		for (int child : node.children)
+			if (child >= 0)
+				finer = finer && nodes[child].spacing <= node.spacing;
+	CHECK(finer);
+}
+
+TEST(PointCloudLOD_RefinementIsMonotonic)
+{
+	std::vector<glm::vec3> points = makeSwath(300000u);
+
+	PointCloudLOD lod;
+	lod.build(points);
+
+	glm::mat4 projection = getProjection();
+	float projectionFactor = projection[1][1] * 1080.f * 0.5f;
+	glm::mat4 view = glm::lookAt(glm::vec3(100.f, -60.f, 40.f), glm::vec3(100.f, 50.f, -25.f), glm::vec3(0.f, 0.f, 1.f));
+
+	// a child's error never exceeds its parent's
+	auto const &nodes = lod.getNodes();
+	bool childFiner = true;
+	for (unsigned int node = 0u; node < nodes.size(); ++node)
+		for (int child : nodes[node].children)
+			if (child >= 0)
+				childFiner = childFiner && lod.getScreenSpaceError(child, view, projectionFactor) <= lod.getScreenSpaceError(node, view, projectionFactor);
+	CHECK(childFiner);
+
+	// the error of a node grows as the viewer approaches it (from outside its bounding sphere)
+	float lastError = 0.f;
+	bool growing = true;
+	for (float distance = 2000.f; distance > 200.f; distance *= 0.8f)
+	{
+		glm::mat4 v = glm::lookAt(glm::vec3(100.f, 50.f, -25.f + distance), glm::vec3(100.f, 50.f, -25.f), glm::vec3(0.f, 1.f, 0.f));
+		float error = lod.getScreenSpaceError(0u, v, projectionFactor);
+		growing = growing && error > lastError;
+		lastError = error;
+	}
+	CHECK(growing);
+
+	// lowering the error threshold only adds nodes
+	std::vector<unsigned int> coarser, finer;
+	lod.select(view, projection, 1080.f, 32.f, 0xFFFFFFFFu, coarser);
+	for (float maxError : { 16.f, 8.f, 4.f, 2.f, 1.f })
+	{
+		lod.select(view, projection, 1080.f, maxError, 0xFFFFFFFFu, finer);
+
+		std::sort(coarser.begin(), coarser.end());
+		std::sort(finer.begin(), finer.end());
+		CHECK(finer.size() >= coarser.size());
+		CHECK(std::includes(finer.begin(), finer.end(), coarser.begin(), coarser.end()));
+
+		coarser.swap(finer);
+	}
+}
+
+TEST(PointCloudLOD_FrustumRejectsOnlyInvisibleNodes)
+{
+	std::vector<glm::vec3> points = makeSwath(200000u);
+
+	PointCloudLOD lod;
+	lod.build(points);
+
+	glm::mat4 projection = getProjection();
+	std::vector<unsigned int> selection;
+
+	// looking away from the cloud selects nothing
+	glm::mat4 away = glm::lookAt(glm::vec3(100.f, -300.f, -25.f), glm::vec3(100.f, -400.f, -25.f), glm::vec3(0.f, 0.f, 1.f));
+	CHECK(lod.select(away, projection, 1080.f, 0.f, 0xFFFFFFFFu, selection) == 0u);
+	CHECK(selection.empty());
+
+	// looking down at a corner of the swath at full refinement keeps every visible point and drops most others
+	glm::mat4 corner = glm::lookAt(glm::vec3(10.f, 10.f, 0.f), glm::vec3(10.f, 10.f, -22.f), glm::vec3(0.f, 1.f, 0.f));
+	unsigned int n = lod.select(corner, projection, 1080.f, 0.f, 0xFFFFFFFFu, selection);
+
+	std::vector<bool> selectedPoint(points.size(), false);
+	for (auto node : selection)
+		for (unsigned int slot = lod.getNodes()[node].first; slot < lod.getNodes()[node].first + lod.getNodes()[node].count; ++slot)
+			selectedPoint[lod.getPointOrder()[slot]] = true;
+
+	glm::mat4 mvp = projection * corner;
+	size_t nVisible = 0u, nLost = 0u;
+	for (size_t i = 0u; i < points.size(); ++i)
+	{
+		glm::vec4 clip = mvp * glm::vec4(points[i], 1.f);
+		bool visible = clip.w > 0.f && fabs(clip.x) <= clip.w && fabs(clip.y) <= clip.w && fabs(clip.z) <= clip.w;
+		if (visible)
+		{
+			nVisible++;
+			if (!selectedPoint[i])
+				nLost++;
+		}
+	}
+
+	CHECK(nVisible > 0u);
+	CHECK(nLost == 0u);
+	CHECK(n < points.size() / 2u);
+}
+
+// HMD-like stereo pair: eyes apart along the view's x axis, each with an off-center projection skewed outwards
+static void getStereoViews(glm::vec3 const &eye, glm::vec3 const &target, float separation, glm::mat4 (&views)[2], glm::mat4 (&projections)[2])
+{
+	glm::mat4 head = glm::lookAt(eye, target, glm::vec3(0.f, 0.f, 1.f));
+
+	views[0] = glm::translate(glm::mat4(), glm::vec3(separation * 0.5f, 0.f, 0.f)) * head;
+	views[1] = glm::translate(glm::mat4(), glm::vec3(-separation * 0.5f, 0.f, 0.f)) * head;
+	projections[0] = glm::frustum(-0.14f, 0.06f, -0.1f, 0.1f, 0.1f, 1000.f);
+	projections[1] = glm::frustum(-0.06f, 0.14f, -0.1f, 0.1f, 0.1f, 1000.f);
+}
+
+static bool isPointVisible(glm::mat4 const &mvp, glm::vec3 const &p)
+{
+	glm::vec4 clip = mvp * glm::vec4(p, 1.f);
+	return clip.w > 0.f && fabs(clip.x) <= clip.w && fabs(clip.y) <= clip.w && fabs(clip.z) <= clip.w;
+}
+
+TEST(PointCloudLOD_StereoCullKeepsPointsVisibleToEitherEye)
+{
+	std::vector<glm::vec3> points = makeSwath(200000u);
+
+	PointCloudLOD lod;
+	lod.build(points);
+
+	std::mt19937 rng(7u);
+	std::uniform_real_distribution<float> u(0.f, 1.f);
+
+	std::vector<unsigned int> selection;
+	std::vector<bool> selectedPoint(points.size());
+	size_t nVisible = 0u, nLost = 0u, nRightOnly = 0u, nSelected = 0u;
+
+	for (int view = 0; view < 20; ++view)
+	{
+		glm::vec3 eye(200.f * u(rng), 100.f * u(rng), -15.f + 30.f * u(rng));
+		glm::vec3 target(200.f * u(rng), 100.f * u(rng), -25.f);
+
+		glm::mat4 views[2], projections[2];
+		getStereoViews(eye, target, 4.f, views, projections);
+
+		std::vector<glm::mat4> mvps = { projections[0] * views[0], projections[1] * views[1] };
+		nSelected += lod.select(views[0], projections[0], 1080.f, 0.f, 0xFFFFFFFFu, mvps, selection);
+
+		std::fill(selectedPoint.begin(), selectedPoint.end(), false);
+		for (auto node : selection)
+			for (unsigned int slot = lod.getNodes()[node].first; slot < lod.getNodes()[node].first + lod.getNodes()[node].count; ++slot)
+				selectedPoint[lod.getPointOrder()[slot]] = true;
+
+		for (size_t i = 0u; i < points.size(); ++i)
+		{
+			bool left = isPointVisible(mvps[0], points[i]);
+			bool right = isPointVisible(mvps[1], points[i]);
+
+			if (left || right)
+			{
+				nVisible++;
+				if (!selectedPoint[i])
+					nLost++;
+				if (!left)
+					nRightOnly++;
+			}
+		}
+	}
+
+	CHECK(nVisible > 0u);
+	CHECK(nRightOnly > 0u);
+	CHECK(nLost == 0u);
+	CHECK(nSelected < points.size() * 20u);
+}
+
+BENCHMARK(PointCloudLOD_CullTenThousandNodes)
+{
+	std::vector<glm::vec3> points = makeSwath(2000000u);
+
+	PointCloudLOD lod(32u, 256u);
+	lod.build(points);
+
+	unsigned int nNodes = static_cast<unsigned int>(lod.getNodes().size());
+	glm::mat4 projection = getProjection();
+	std::vector<unsigned int> selection;
+	const int nFrames = 300;
+	double frustumMs = 0.0, selectMs = 0.0, stereoMs = 0.0;
+	size_t nInside = 0u;
+
+	for (int frame = 0; frame < nFrames; ++frame)
+	{
+		float angle = static_cast<float>(frame) / nFrames * 6.2831853f;
+		glm::vec3 eye(100.f + 120.f * cosf(angle), 50.f + 80.f * sinf(angle), 20.f);
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(100.f, 50.f, -25.f), glm::vec3(0.f, 0.f, 1.f));
+
+		// frustum test of every node on its own
+		auto s = std::chrono::high_resolution_clock::now();
+		glm::vec4 planes[6];
+		PointCloudLOD::getFrustumPlanes(projection * view, planes);
+		for (unsigned int node = 0u; node < nNodes; ++node)
+			if (lod.isInFrustum(node, planes))
+				nInside++;
+		frustumMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s).count();
+
+		// hierarchical culling at full refinement, mono and stereo
+		s = std::chrono::high_resolution_clock::now();
+		lod.select(view, projection, 1080.f, 0.f, 0xFFFFFFFFu, selection);
+		selectMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s).count();
+
+		glm::mat4 views[2], projections[2];
+		getStereoViews(eye, glm::vec3(100.f, 50.f, -25.f), 0.064f, views, projections);
+		std::vector<glm::mat4> mvps = { projections[0] * views[0], projections[1] * views[1] };
+		s = std::chrono::high_resolution_clock::now();
+		lod.select(views[0], projections[0], 1080.f, 0.f, 0xFFFFFFFFu, mvps, selection);
+		stereoMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s).count();
+	}
+
+	printf("    %u nodes, %.0f%% inside on average; per frame: all-node frustum test %.3f ms, mono select %.3f ms, stereo select %.3f ms\n",
+		nNodes, 100.0 * nInside / (static_cast<double>(nNodes) * nFrames), frustumMs / nFrames, selectMs / nFrames, stereoMs / nFrames);
+}
+
+BENCHMARK(PointCloudLOD_SelectAlongCameraPath)
+{
+	std::vector<glm::vec3> points = makeSwath(2000000u);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	PointCloudLOD lod;
+	lod.build(points);
+	float buildMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	// fly-over path: a slow orbit above the swath that dips down towards the seabed and back up
+	glm::mat4 projection = getProjection();
+	std::vector<unsigned int> selection;
+	const int nFrames = 900;
+	double totalMs = 0.0, maxMs = 0.0, totalPoints = 0.0;
+
+	for (int frame = 0; frame < nFrames; ++frame)
+	{
+		float t = static_cast<float>(frame) / nFrames;
+		float angle = t * 6.2831853f;
+		float height = 10.f + 80.f * (0.5f + 0.5f * cosf(angle * 2.f));
+		glm::vec3 eye(100.f + 120.f * cosf(angle), 50.f + 80.f * sinf(angle), -20.f + height);
+		glm::mat4 view = glm::lookAt(eye, glm::vec3(100.f, 50.f, -25.f), glm::vec3(0.f, 0.f, 1.f));
+
+		auto s = std::chrono::high_resolution_clock::now();
+		unsigned int n = lod.select(view, projection, 1080.f, 2.f, 1000000u, selection);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s).count();
+
+		totalMs += ms;
+		maxMs = (std::max)(maxMs, ms);
+		totalPoints += n;
+	}
+
+	printf("    %zu points, %zu nodes, build %.0f ms; select over %d frames: mean %.3f ms, max %.3f ms, mean %.0f points\n",
+		points.size(), lod.getNodes().size(), buildMs, nFrames, totalMs / nFrames, maxMs, totalPoints / nFrames);
+}
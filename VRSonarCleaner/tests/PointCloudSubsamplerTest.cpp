@@ -0,0 +1,153 @@
+#include "Test.h"
+#include "../PointCloudSubsampler.h"
+
+#include <random>
+#include <chrono>
+#include <algorithm>
+
+// Multibeam-like swath: pings of equiangular beams, so the beams bunch up under the ship and spread out at the edges
+static std::vector<glm::vec3> makePings(unsigned int nPings, unsigned int nBeams, unsigned int seed = 1u)
+{
+	std::mt19937 rng(seed);
+	std::normal_distribution<float> noise(0.f, 0.02f);
+
+	std::vector<glm::vec3> points;
+	points.reserve(nPings * nBeams);
+
+	for (unsigned int ping = 0u; ping < nPings; ++ping)
+	{
+		for (unsigned int beam = 0u; beam < nBeams; ++beam)
+		{
+			float angle = glm::radians(-60.f + 120.f * (beam + 0.5f) / nBeams);
+			float depth = 20.f + 0.5f * sinf(ping * 0.01f);
+			points.push_back(glm::vec3(0.25f * ping + noise(rng), depth * tanf(angle), -depth + noise(rng)));
+		}
+	}
+
+	return points;
+}
+
+// Counts the kept points in each occupied square of a 2D grid over x/y
+static void countPerCell(std::vector<glm::vec3> const &points, std::vector<unsigned int> const &kept, float cellSize, std::vector<unsigned int> &counts)
+{
+	glm::vec3 bbMin(std::numeric_limits<float>::max()), bbMax(-std::numeric_limits<float>::max());
+	for (auto const &p : points)
+	{
+		bbMin = glm::min(bbMin, p);
+		bbMax = glm::max(bbMax, p);
+	}
+
+	int nx = static_cast<int>((bbMax.x - bbMin.x) / cellSize) + 1;
+	int ny = static_cast<int>((bbMax.y - bbMin.y) / cellSize) + 1;
+
+	std::vector<int> occupied(nx * ny, 0);
+	for (auto const &p : points)
+		occupied[static_cast<int>((p.y - bbMin.y) / cellSize) * nx + static_cast<int>((p.x - bbMin.x) / cellSize)] = 1;
+
+	std::vector<unsigned int> all(nx * ny, 0u);
+	for (auto i : kept)
+		all[static_cast<int>((points[i].y - bbMin.y) / cellSize) * nx + static_cast<int>((points[i].x - bbMin.x) / cellSize)]++;
+
+	counts.clear();
+	for (size_t cell = 0u; cell < all.size(); ++cell)
+		if (occupied[cell])
+			counts.push_back(all[cell]);
+}
+
+TEST(PointCloudSubsampler_ResultDoesNotDependOnThreadCount)
+{
+	std::vector<glm::vec3> points = makePings(400u, 512u);
+
+	std::vector<unsigned int> reference = PointCloudSubsampler::voxelGrid(points, 0.5f, 1u);
+	CHECK(reference.size() > 1000u && reference.size() < points.size() / 4u);
+	CHECK(std::is_sorted(reference.begin(), reference.end()));
+
+	unsigned int threadCounts[] = { 2u, 3u, 7u, 16u, 0u };
+	for (unsigned int nThreads : threadCounts)
+		CHECK(PointCloudSubsampler::voxelGrid(points, 0.5f, nThreads) == reference);
+
+	// ties between points equally far from the voxel center go to the lower index, whichever thread bins them
+	std::vector<glm::vec3> duplicates(10000u, glm::vec3(1.f, 2.f, 3.f));
+	duplicates.push_back(glm::vec3(0.f));
+	for (unsigned int nThreads : threadCounts)
+	{
+		std::vector<unsigned int> kept = PointCloudSubsampler::voxelGrid(duplicates, 0.75f, nThreads);
+		CHECK(kept.size() == 2u && kept[0] == 0u && kept[1] == 10000u);
+	}
+}
+
+TEST(PointCloudSubsampler_CoversTheSwathMoreEvenlyThanStriding)
+{
+	std::vector<glm::vec3> points = makePings(400u, 512u);
+
+	float voxelSize = 1.f;
+	std::vector<unsigned int> voxels = PointCloudSubsampler::voxelGrid(points, voxelSize);
+
+	// every Nth point, keeping the same number of points
+	std::vector<unsigned int> strided;
+	size_t stride = (points.size() + voxels.size() - 1u) / voxels.size();
+	for (size_t i = 0u; i < points.size(); i += stride)
+		strided.push_back(static_cast<unsigned int>(i));
+
+	// coverage: occupied cells two voxels wide that keep at least one point; uniformity: the spread of kept points per cell
+	auto evaluate = [&points, voxelSize](std::vector<unsigned int> const &kept, double &coverage, double &cv) {
+		std::vector<unsigned int> counts;
+		countPerCell(points, kept, 2.f * voxelSize, counts);
+
+		double n = static_cast<double>(counts.size()), sum = 0.0, sumSq = 0.0, covered = 0.0;
+		for (auto c : counts)
+		{
+			covered += c > 0u ? 1.0 : 0.0;
+			sum += c;
+			sumSq += static_cast<double>(c) * c;
+		}
+		double mean = sum / n;
+		coverage = covered / n;
+		cv = sqrt((std::max)(sumSq / n - mean * mean, 0.0)) / mean;
+	};
+
+	double voxelCoverage, voxelCV, strideCoverage, strideCV;
+	evaluate(voxels, voxelCoverage, voxelCV);
+	evaluate(strided, strideCoverage, strideCV);
+	printf("    %zu voxel points: coverage %.3f, cv %.3f; %zu strided points (every %zu): coverage %.3f, cv %.3f\n",
+		voxels.size(), voxelCoverage, voxelCV, strided.size(), stride, strideCoverage, strideCV);
+
+	CHECK(voxelCoverage > 0.99);
+	CHECK(voxelCoverage > strideCoverage + 0.1);
+	CHECK(voxelCV < 0.5 * strideCV);
+}
+
+TEST(PointCloudSubsampler_WideExtentsDoNotShareVoxels)
+{
+	// 2^21 voxels apart, so the packed voxel keys would wrap around to the same key
+	float voxelSize = 0.5f;
+	std::vector<glm::vec3> points;
+	points.push_back(glm::vec3(0.f));
+	points.push_back(glm::vec3(2097152.f * voxelSize, 0.f, 0.f));
+	points.push_back(glm::vec3(0.f, 2097152.f * voxelSize, 2097152.f * voxelSize));
+
+	std::vector<unsigned int> kept = PointCloudSubsampler::voxelGrid(points, voxelSize, 1u);
+	CHECK(kept.size() == 3u);
+
+	// far apart points in a wide survey stay apart, close ones are merged by the coarsened voxels
+	std::vector<glm::vec3> survey = makePings(100u, 64u);
+	survey.push_back(glm::vec3(1.e6f, 0.f, 0.f));
+	kept = PointCloudSubsampler::voxelGrid(survey, 0.001f, 4u);
+	CHECK(kept.size() > 1u && kept.size() < survey.size());
+	CHECK(kept.back() == survey.size() - 1u);
+}
+
+BENCHMARK(PointCloudSubsampler_Throughput)
+{
+	std::vector<glm::vec3> points = makePings(20000u, 512u);
+
+	unsigned int threadCounts[] = { 1u, 2u, 4u, 8u, 16u };
+	for (unsigned int nThreads : threadCounts)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<unsigned int> kept = PointCloudSubsampler::voxelGrid(points, 0.5f, nThreads);
+		double s = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		printf("    %2u threads: %zu of %zu points kept in %.0f ms, %.1f M points/s\n", nThreads, kept.size(), points.size(), s * 1000.0, points.size() / s / 1.e6);
+	}
+}
@@ -0,0 +1,156 @@
+#include "Test.h"
+#include "../PointsCSVWriter.h"
+
+#include <random>
+#include <chrono>
+#include <sstream>
+#include <limits>
+
+namespace
+{
+	struct Points {
+		std::vector<glm::dvec3> positions;
+		std::vector<unsigned int> marks;
+		std::vector<float> flags;
+	};
+
+	// survey coordinates: UTM-sized eastings and northings, depths, and a few values that format unusually
+	Points makePoints(size_t count, unsigned int seed)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<double> easting(300000., 700000.), northing(4.e6, 5.e6), depth(-200., 0.);
+
+		Points points;
+		points.positions.resize(count);
+		points.marks.resize(count);
+		points.flags.resize(count);
+
+		double specials[] = { 0., -0., 1., -1.5, 1e-300, 1e300, 123456789012345678., 0.1, 1. / 3., std::numeric_limits<double>::denorm_min() };
+
+		for (size_t i = 0u; i < count; ++i)
+		{
+			points.positions[i] = glm::dvec3(easting(rng), northing(rng), depth(rng));
+			if (i % 97u == 0u)
+				points.positions[i].z = specials[(i / 97u) % 10u];
+			if (i % 89u == 0u)
+				points.positions[i].x = std::floor(points.positions[i].x);
+
+			points.marks[i] = rng() % 5u == 0u ? 1u : (rng() % 3u == 0u ? 2u : 0u);
+			points.flags[i] = rng() % 4u == 0u ? 1.f : 0.5f * (rng() % 3u);
+		}
+
+		return points;
+	}
+
+	// how savePoints() wrote the rows before, with operator<< at max_digits10 precision (std::endl written as '\n')
+	std::string formatWithStream(Points const &points, unsigned int first, unsigned int count)
+	{
+		std::ostringstream out;
+		out.precision(std::numeric_limits<double>::max_digits10);
+
+		for (unsigned int i = first; i < first + count; ++i)
+		{
+			if (points.marks[i] == 1u)
+				continue;
+
+			out << points.positions[i].x << "," << points.positions[i].y << "," << points.positions[i].z << "," << (points.flags[i] == 1.f ? "1" : "0") << '\n';
+		}
+
+		return out.str();
+	}
+
+	std::string readFile(FILE *file)
+	{
+		std::string contents;
+		fseek(file, 0, SEEK_END);
+		contents.resize(static_cast<size_t>(ftell(file)));
+		fseek(file, 0, SEEK_SET);
+		if (contents.size() > 0u)
+			fread(&contents[0], 1u, contents.size(), file);
+		return contents;
+	}
+}
+
+TEST(PointsCSVWriter_RowsMatchStreamOutput)
+{
+	Points points = makePoints(200000u, 1u);
+
+	CHECK(PointsCSVWriter::formatRows(points.positions.data(), points.marks.data(), points.flags.data(), 0u, 200000u) == formatWithStream(points, 0u, 200000u));
+	CHECK(PointsCSVWriter::formatRows(points.positions.data(), points.marks.data(), points.flags.data(), 1234u, 777u) == formatWithStream(points, 1234u, 777u));
+	CHECK(PointsCSVWriter::formatRows(points.positions.data(), points.marks.data(), points.flags.data(), 10u, 0u).empty());
+}
+
+TEST(PointsCSVWriter_WritesBlocksInOrder)
+{
+	// several clouds, with block sizes that do not divide them, through a queue shorter than the number of blocks
+	std::vector<Points> clouds;
+	clouds.push_back(makePoints(10007u, 2u));
+	clouds.push_back(makePoints(1u, 3u));
+	clouds.push_back(makePoints(0u, 4u));
+	clouds.push_back(makePoints(30000u, 5u));
+
+	std::string expected;
+	for (auto const &cloud : clouds)
+		expected += formatWithStream(cloud, 0u, static_cast<unsigned int>(cloud.positions.size()));
+
+	for (unsigned int blockSize : { 1000u, 4096u, 1u << 18 })
+	{
+		FILE *file = tmpfile();
+		CHECK(file != NULL);
+		if (!file)
+			return;
+
+		{
+			PointsCSVWriter writer(file, blockSize, 2u);
+			for (auto const &cloud : clouds)
+				writer.addPoints(cloud.positions.data(), cloud.marks.data(), cloud.flags.data(), static_cast<unsigned int>(cloud.positions.size()));
+		}
+
+		CHECK(readFile(file) == expected);
+		fclose(file);
+	}
+}
+
+BENCHMARK(PointsCSVWriter_FiftyMillionPoints)
+{
+	const unsigned int count = 50000000u;
+	Points points = makePoints(count, 6u);
+
+	FILE *file = tmpfile();
+	if (!file)
+		return;
+
+	auto start = std::chrono::high_resolution_clock::now();
+	{
+		PointsCSVWriter writer(file);
+		writer.addPoints(points.positions.data(), points.marks.data(), points.flags.data(), count);
+	}
+	fflush(file);
+	double s = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	long bytes = ftell(file);
+	fclose(file);
+
+	printf("    blocked: %u points, %.0f MB written in %.1f s, %.1f M points/s\n", count, bytes / 1048576.0, s, count / s / 1.e6);
+
+	// the previous operator<< rows, flushed per row by std::endl
+	const unsigned int streamCount = 5000000u;
+	file = tmpfile();
+	if (!file)
+		return;
+
+	start = std::chrono::high_resolution_clock::now();
+	for (unsigned int first = 0u; first < streamCount; first += 1u << 16)
+	{
+		std::string rows = formatWithStream(points, first, (std::min)(1u << 16, streamCount - first));
+		for (size_t begin = 0u, end; begin < rows.size(); begin = end + 1u)
+		{
+			end = rows.find('\n', begin);
+			fwrite(rows.data() + begin, 1u, end - begin + 1u, file);
+			fflush(file);
+		}
+	}
+	s = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	fclose(file);
+
+	printf("    operator<< with a flush per row: first %u points in %.1f s, %.1f M points/s (%.0f s projected for all)\n", streamCount, s, streamCount / s / 1.e6, s * count / streamCount);
+}
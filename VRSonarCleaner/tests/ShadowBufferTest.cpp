@@ -0,0 +1,180 @@
+#include "Test.h"
+#include "../ShadowBuffer.h"
+#include "../ColorScaler.h"
+
+#include <random>
+#include <thread>
+#include <algorithm>
+#include <glm.hpp>
+#include <gtc/packing.hpp>
+
+// Run under ThreadSanitizer to check that the worker and the owning thread never touch the same buffer
+TEST(ShadowBuffer_SwapsInOnlyCompleteLatestResults)
+{
+	const size_t size = 1u << 16;
+	const size_t chunkSize = 1u << 10;
+	const unsigned int nRequests = 2000u;
+
+	ShadowBuffer<unsigned int> buffer;
+	std::vector<unsigned int> front(size, 0u);
+
+	// the worker fills the buffer with its request number, chunk by chunk, and stops early when superseded
+	auto compute = [&buffer, size, chunkSize](std::vector<unsigned int> &shadow, unsigned int request) {
+		shadow.resize(size);
+		for (size_t first = 0u; first < size; first += chunkSize)
+		{
+			if (buffer.isSuperseded(request))
+				return;
+
+			std::fill(shadow.begin() + first, shadow.begin() + first + chunkSize, request);
+		}
+	};
+
+	std::atomic<bool> done(false);
+	std::thread requester([&]() {
+		std::mt19937 rng(3u);
+		for (unsigned int i = 0u; i < nRequests; ++i)
+		{
+			buffer.request();
+			std::this_thread::sleep_for(std::chrono::microseconds(rng() % 200u));
+		}
+		done = true;
+	});
+
+	unsigned int lastApplied = 0u;
+	size_t nSwaps = 0u;
+	bool complete = true, newer = true;
+
+	auto frame = [&]() {
+		if (buffer.swap(front))
+		{
+			unsigned int value = front[0];
+			complete = complete && std::all_of(front.begin(), front.end(), [value](unsigned int v) { return v == value; });
+			newer = newer && value > lastApplied;
+			lastApplied = value;
+			nSwaps++;
+		}
+
+		if (buffer.isPending())
+			buffer.start(compute);
+	};
+
+	while (!done)
+		frame();
+
+	requester.join();
+
+	// the last request is always delivered
+	for (int i = 0; i < 100 && lastApplied != nRequests; ++i)
+	{
+		buffer.wait();
+		frame();
+	}
+
+	CHECK(complete);
+	CHECK(newer);
+	CHECK(lastApplied == nRequests);
+	CHECK(nSwaps > 0u);
+	CHECK(!buffer.isPending());
+}
+
+TEST(ShadowBuffer_SupersededResultsAreDropped)
+{
+	ShadowBuffer<int> buffer;
+	std::vector<int> front(4, 0);
+
+	buffer.request();
+	CHECK(buffer.isPending());
+	buffer.start([](std::vector<int> &shadow, unsigned int request) { shadow.assign(4, static_cast<int>(request)); });
+	CHECK(!buffer.isPending());
+
+	// a request while the worker runs makes its result stale
+	buffer.request();
+	buffer.wait();
+	CHECK(!buffer.swap(front));
+	CHECK(front[0] == 0);
+	CHECK(buffer.isPending());
+
+	buffer.start([](std::vector<int> &shadow, unsigned int request) { shadow.assign(4, static_cast<int>(request)); });
+	buffer.wait();
+	CHECK(buffer.swap(front));
+	CHECK(front[0] == 2);
+	CHECK(!buffer.isPending());
+}
+
+// Main thread time spent per frame on a color scale change: recoloring in place (the old path) against the swap protocol
+BENCHMARK(ShadowBuffer_RecolorMainThreadStall)
+{
+	const unsigned int nPoints = 20000000u;
+	const unsigned int chunkSize = 1u << 20;
+
+	std::mt19937 rng(5u);
+	std::uniform_real_distribution<float> depth(-60.f, -10.f);
+	std::vector<float> depths(nPoints);
+	for (auto &d : depths)
+		d = depth(rng);
+
+	ColorScaler colorScaler;
+	colorScaler.resetMinMaxForColorScale(-60., -10.);
+
+	ShadowBuffer<glm::vec4> buffer;
+	std::vector<glm::vec4> front(nPoints);
+
+	auto recolor = [&](std::vector<glm::vec4> &colors, unsigned int request) {
+		ColorScaler scaler(colorScaler);
+		std::vector<unsigned int> packed(chunkSize);
+		colors.resize(nPoints);
+
+		for (unsigned int first = 0u; first < nPoints; first += chunkSize)
+		{
+			if (buffer.isSuperseded(request))
+				return;
+
+			unsigned int count = (std::min)(chunkSize, nPoints - first);
+			scaler.getScaledColors(depths.data() + first, count, packed.data());
+
+			for (unsigned int i = 0u; i < count; ++i)
+				colors[first + i] = glm::unpackUnorm4x8(packed[i]);
+		}
+	};
+
+	double syncMs = 1e30;
+	for (int run = 0; run < 3; ++run)
+	{
+		auto s = std::chrono::high_resolution_clock::now();
+		recolor(front, 0u);
+		syncMs = (std::min)(syncMs, std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s).count());
+	}
+
+	double maxFrameMs = 0.0, totalFrameMs = 0.0, latencyMs = 0.0;
+	size_t nFrames = 0u;
+	const int nChanges = 5;
+
+	for (int change = 0; change < nChanges; ++change)
+	{
+		auto requested = std::chrono::high_resolution_clock::now();
+		buffer.request();
+
+		for (bool swapped = false; !swapped; )
+		{
+			auto s = std::chrono::high_resolution_clock::now();
+
+			swapped = buffer.swap(front);
+			if (buffer.isPending())
+				buffer.start(recolor);
+
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - s).count();
+			maxFrameMs = (std::max)(maxFrameMs, ms);
+			totalFrameMs += ms;
+			nFrames++;
+
+			// rest of an 11 ms frame
+			std::this_thread::sleep_for(std::chrono::milliseconds(11));
+		}
+
+		latencyMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - requested).count();
+	}
+
+	printf("    %u points: in-place recolor stalls the main thread %.1f ms; with the shadow buffer %.4f ms max, %.4f ms mean per frame, change visible after %.0f ms\n",
+		nPoints, syncMs, maxFrameMs, totalFrameMs / nFrames, latencyMs / nChanges);
+}
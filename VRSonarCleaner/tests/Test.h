@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+// Minimal test registry for the headless tests. TEST(name) defines a test that TestMain runs, BENCHMARK(name)
+// one that only runs when asked for with --benchmarks. CHECK records a failure and carries on with the test.
+namespace Test
+{
+	typedef void(*Function)();
+
+	struct Case {
+		const char *name;
+		Function function;
+		bool benchmark;
+	};
+
+	std::vector<Case>& getCases();
+	void fail(const char *file, int line, const char *expression);
+
+	struct Registrar {
+		Registrar(const char *name, Function function, bool benchmark)
+		{
+			Case c = { name, function, benchmark };
+			getCases().push_back(c);
+		}
+	};
+}
+
+#define TEST(name) static void name(); static Test::Registrar name##Registrar(#name, name, false); static void name()
+#define BENCHMARK(name) static void name(); static Test::Registrar name##Registrar(#name, name, true); static void name()
+
+#define CHECK(condition) do { if (!(condition)) Test::fail(__FILE__, __LINE__, #condition); } while (0)
+#define CHECK_CLOSE(a, b, tolerance) do { if (!(fabs(static_cast<double>(a) - static_cast<double>(b)) <= static_cast<double>(tolerance))) { \
+	printf("    %s = %g, %s = %g\n", #a, static_cast<double>(a), #b, static_cast<double>(b)); Test::fail(__FILE__, __LINE__, #a " ~= " #b); } } while (0)
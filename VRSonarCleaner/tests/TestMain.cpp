@@ -0,0 +1,69 @@
+#include "Test.h"
+
+#include <string.h>
+#include <chrono>
+
+// Usage: VRSonarCleanerTests [--benchmarks] [name filter]
+// Runs the tests (or the benchmarks) whose names contain the filter and returns the number of failed ones.
+
+namespace Test
+{
+	static int s_nFailures = 0;
+
+	std::vector<Case>& getCases()
+	{
+		static std::vector<Case> cases;
+		return cases;
+	}
+
+	void fail(const char *file, int line, const char *expression)
+	{
+		printf("    %s(%d): CHECK failed: %s\n", file, line, expression);
+		s_nFailures++;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	bool benchmarks = false;
+	const char *filter = NULL;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--benchmarks") == 0)
+			benchmarks = true;
+		else
+			filter = argv[i];
+	}
+
+	int nRun = 0;
+	int nFailed = 0;
+
+	for (auto const &c : Test::getCases())
+	{
+		if (c.benchmark != benchmarks || (filter && !strstr(c.name, filter)))
+			continue;
+
+		printf("[ RUN    ] %s\n", c.name);
+		fflush(stdout);
+
+		int failuresBefore = Test::s_nFailures;
+		auto start = std::chrono::high_resolution_clock::now();
+
+		c.function();
+
+		float ms = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		bool failed = Test::s_nFailures > failuresBefore;
+
+		printf("[ %s ] %s (%.0f ms)\n", failed ? "FAILED" : "    OK", c.name, ms);
+		fflush(stdout);
+
+		nRun++;
+		if (failed)
+			nFailed++;
+	}
+
+	printf("%d of %d %s passed\n", nRun - nFailed, nRun, benchmarks ? "benchmarks" : "tests");
+
+	return nFailed;
+}
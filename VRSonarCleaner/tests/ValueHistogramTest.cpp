@@ -0,0 +1,175 @@
+#include "Test.h"
+#include "../ValueHistogram.h"
+
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <glm.hpp>
+
+// depths of a skewed seabed: mostly shallow with a long tail into a deep trench
+static std::vector<float> makeDepths(size_t count, unsigned int seed)
+{
+	std::mt19937 rng(seed);
+	std::gamma_distribution<float> gamma(2.f, 3.f);
+
+	std::vector<float> depths(count);
+	for (auto &d : depths)
+		d = -10.f - gamma(rng);
+
+	return depths;
+}
+
+TEST(ValueHistogram_PercentilesMatchSortedData)
+{
+	std::vector<float> depths = makeDepths(1000000u, 1u);
+	float minDepth = *std::min_element(depths.begin(), depths.end());
+	float maxDepth = *std::max_element(depths.begin(), depths.end());
+
+	ValueHistogram histogram;
+	histogram.reset(minDepth, maxDepth);
+	histogram.addValues(depths.data(), depths.size());
+	CHECK(histogram.getTotalCount() == depths.size());
+
+	std::vector<float> sorted(depths);
+	std::sort(sorted.begin(), sorted.end());
+	for (double fraction : { 0.001, 0.01, 0.25, 0.5, 0.75, 0.99, 0.999 })
+		CHECK_CLOSE(histogram.getPercentile(fraction), sorted[static_cast<size_t>(fraction * (sorted.size() - 1u))], histogram.getBinWidth());
+
+	CHECK_CLOSE(histogram.getPercentile(0.), minDepth, histogram.getBinWidth());
+	CHECK_CLOSE(histogram.getPercentile(1.), maxDepth, histogram.getBinWidth());
+
+	// an empty histogram falls back to the range
+	ValueHistogram empty;
+	empty.reset(-5., 5.);
+	CHECK(empty.getPercentile(0.01) == -5.);
+	CHECK(empty.getPercentile(0.99) == 5.);
+}
+
+TEST(ValueHistogram_StridedMarkedCountsMatchIncrementalUpdates)
+{
+	std::vector<float> depths = makeDepths(300001u, 2u);
+
+	// read in place from positions like SonarScene does, skipping the points marked deleted
+	std::vector<glm::dvec3> positions(depths.size());
+	std::vector<unsigned int> marks(depths.size(), 0u);
+	std::mt19937 rng(3u);
+	for (size_t i = 0u; i < depths.size(); ++i)
+	{
+		positions[i] = glm::dvec3(static_cast<double>(i), 1., depths[i]);
+		marks[i] = rng() % 10u == 0u ? 1u : 0u;
+	}
+
+	ValueHistogram reference;
+	reference.reset(-40., -10.);
+	for (size_t i = 0u; i < depths.size(); ++i)
+		if (marks[i] != 1u)
+			reference.add(positions[i].z);
+
+	std::vector<float> referenceCDF;
+	reference.getCDF(257u, referenceCDF);
+
+	for (unsigned int nThreads : { 1u, 3u, 8u })
+	{
+		ValueHistogram histogram;
+		histogram.reset(-40., -10.);
+		histogram.addValues(&positions[0].z, positions.size(), sizeof(glm::dvec3) / sizeof(double), marks.data(), nThreads);
+		CHECK(histogram.getTotalCount() == reference.getTotalCount());
+
+		std::vector<float> cdf;
+		histogram.getCDF(257u, cdf);
+		CHECK(cdf == referenceCDF);
+	}
+
+	// deleting points one by one gives the same histogram as counting only the remaining ones
+	ValueHistogram remaining;
+	remaining.reset(-40., -10.);
+	for (size_t i = 0u; i < depths.size(); ++i)
+		if (marks[i] != 1u && i % 7u != 0u)
+			remaining.add(depths[i]);
+
+	for (size_t i = 0u; i < depths.size(); i += 7u)
+		if (marks[i] != 1u)
+			reference.remove(depths[i]);
+
+	std::vector<float> cdf, remainingCDF;
+	reference.getCDF(257u, cdf);
+	remaining.getCDF(257u, remainingCDF);
+	CHECK(reference.getTotalCount() == remaining.getTotalCount());
+	CHECK(cdf == remainingCDF);
+
+	// removing from an empty bin is ignored rather than wrapping the count
+	ValueHistogram single;
+	single.reset(0., 1.);
+	single.add(0.25);
+	single.remove(0.75);
+	CHECK(single.getTotalCount() == 1u);
+}
+
+TEST(ValueHistogram_EqualizationSpreadsValuesEvenly)
+{
+	std::vector<float> depths = makeDepths(1000000u, 4u);
+	double minDepth = *std::min_element(depths.begin(), depths.end());
+	double maxDepth = *std::max_element(depths.begin(), depths.end());
+
+	ValueHistogram histogram;
+	histogram.reset(minDepth, maxDepth);
+	histogram.addValues(depths.data(), depths.size());
+
+	std::vector<float> cdf;
+	histogram.getCDF(1025u, cdf);
+	CHECK(cdf.front() == 0.f);
+	CHECK_CLOSE(cdf.back(), 1.f, 1e-6f);
+	CHECK(std::is_sorted(cdf.begin(), cdf.end()));
+
+	// mapping the values through the CDF the way ColorScaler does flattens their distribution: each tenth of the
+	// equalized range holds a tenth of the values, where the linear range is far from even
+	std::vector<size_t> linearCounts(10u, 0u), equalizedCounts(10u, 0u);
+	for (float d : depths)
+	{
+		double factor = (d - minDepth) / (maxDepth - minDepth);
+		double pos = factor * (cdf.size() - 1u);
+		size_t i = (std::min)(static_cast<size_t>(pos), cdf.size() - 2u);
+		double equalized = cdf[i] + (cdf[i + 1u] - cdf[i]) * (pos - i);
+
+		linearCounts[(std::min)(static_cast<size_t>(factor * 10.), size_t(9u))]++;
+		equalizedCounts[(std::min)(static_cast<size_t>(equalized * 10.), size_t(9u))]++;
+	}
+
+	size_t maxLinear = *std::max_element(linearCounts.begin(), linearCounts.end());
+	CHECK(maxLinear > depths.size() / 4u);
+	for (size_t count : equalizedCounts)
+		CHECK_CLOSE(count, depths.size() / 10u, depths.size() / 200u);
+}
+
+BENCHMARK(ValueHistogram_HundredMillionValues)
+{
+	const size_t count = 100000000u;
+	std::vector<float> depths = makeDepths(count, 5u);
+
+	ValueHistogram histogram;
+	for (unsigned int nThreads : { 1u, 4u, 16u })
+	{
+		histogram.reset(-80., -10.);
+
+		auto start = std::chrono::high_resolution_clock::now();
+		histogram.addValues(depths.data(), count, 1u, NULL, nThreads);
+		double s = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+		printf("    %2u threads: %zu values counted in %.0f ms, %.0f M values/s\n", nThreads, count, s * 1000.0, count / s / 1.e6);
+	}
+
+	// a million deletions applied one by one, then the percentile and CDF refresh that follows a cleaning step
+	const size_t nDeletions = 1000000u;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (size_t i = 0u; i < nDeletions; ++i)
+		histogram.remove(depths[i * (count / nDeletions)]);
+	double removeMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	start = std::chrono::high_resolution_clock::now();
+	double low = histogram.getPercentile(0.01), high = histogram.getPercentile(0.99);
+	std::vector<float> cdf;
+	histogram.getCDF(1025u, cdf);
+	double refreshMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+	printf("    %zu deletions in %.1f ms (%.1f ns each); percentiles [%.2f, %.2f] and CDF in %.3f ms\n", nDeletions, removeMs, removeMs * 1.e6 / nDeletions, low, high, refreshMs);
+}